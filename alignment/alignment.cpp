@@ -163,9 +163,10 @@ void Alignment::checkSeqName() {
 //    double *freq_per_sequence = new double[num_states*getNSeq()];
     double *freq_per_sequence = new double[num_states];
     unsigned *count_per_seq = new unsigned[num_states*getNSeq()];
+    // per-sequence counts first: its single pass also fills the character counts for computeStateFreq
+    countStatePerSequence(count_per_seq);
     computeStateFreq(state_freq);
 //    computeStateFreqPerSequence(freq_per_sequence);
-    countStatePerSequence(count_per_seq);
 
     int i, df = -1;
     for (i = 0; i < num_states; i++)
@@ -349,11 +350,8 @@ Alignment *Alignment::removeIdenticalSeq(string not_remove, bool keep_two, StrVe
 
 bool Alignment::isGapOnlySeq(int seq_id) {
     ASSERT(seq_id < getNSeq());
-    for (iterator it = begin(); it != end(); it++)
-        if ((*it)[seq_id] != STATE_UNKNOWN) {
-            return false;
-        }
-    return true;
+    computeSeqStats();
+    return seq_unknown_counts[seq_id] == seq_stats_nsite;
 }
 
 Alignment *Alignment::removeGappySeq() {
@@ -484,6 +482,105 @@ bool Alignment::isStandardGeneticCode() {
 	return (genetic_code == genetic_code1 || genetic_code == genetic_code11);
 }
 
+/**
+    @return bit mask of the nucleotides of a DNA state, all four for unknown
+*/
+inline int getNucleotideMask(int state) {
+    if (state < 4)
+        return 1 << state;
+    if (state < 18)
+        return state - 3; // ambiguous nucleotide
+    return 15;
+}
+
+uint64_t Alignment::getCodonSet(int nt1, int nt2, int nt3) {
+    int mask1 = getNucleotideMask(nt1), mask2 = getNucleotideMask(nt2), mask3 = getNucleotideMask(nt3);
+    uint64_t codon_set = 0;
+    for (int i = 0; i < 4; i++)
+        if (mask1 & (1 << i))
+            for (int j = 0; j < 4; j++)
+                if (mask2 & (1 << j))
+                    for (int k = 0; k < 4; k++)
+                        if (mask3 & (1 << k)) {
+                            int codon = i*16 + j*4 + k;
+                            if (genetic_code[codon] != '*')
+                                codon_set |= (uint64_t)1 << non_stop_codon[codon];
+                        }
+    return codon_set;
+}
+
+StateType Alignment::getCodonSetState(uint64_t codon_set) {
+    size_t count = bitset<64>(codon_set).count();
+    if (count == 0 || count >= num_states)
+        return STATE_UNKNOWN;
+    if (count == 1) {
+        StateType state = 0;
+        while (!(codon_set & 1)) {
+            codon_set >>= 1;
+            state++;
+        }
+        return state;
+    }
+    auto it = lower_bound(codon_ambiguity.begin(), codon_ambiguity.end(), codon_set);
+    if (it != codon_ambiguity.end() && *it == codon_set)
+        return num_states + (it - codon_ambiguity.begin());
+    return STATE_UNKNOWN;
+}
+
+void Alignment::initCodonAmbiguity(int nseq, int ncodon, function<int(int, int)> get_nt) {
+    codon_ambiguity.clear();
+    // number of occurrences of each set of a partially ambiguous codon
+    map<uint64_t, size_t> set_count;
+    // codon sets shared by all sequences of a site, which become the const_char of the pattern
+    set<uint64_t> const_sets;
+    for (int site = 0; site < ncodon; site++) {
+        uint64_t site_set = ~(uint64_t)0;
+        bool partial = false;
+        for (int seq = 0; seq < nseq; seq++) {
+            int nt1 = get_nt(seq, site*3), nt2 = get_nt(seq, site*3+1), nt3 = get_nt(seq, site*3+2);
+            if (nt1 == STATE_INVALID || nt2 == STATE_INVALID || nt3 == STATE_INVALID)
+                continue;
+            uint64_t codon_set = getCodonSet(nt1, nt2, nt3);
+            size_t count = bitset<64>(codon_set).count();
+            if (count == 0)
+                continue; // stop codon, reported when building the patterns
+            site_set &= codon_set;
+            if (count > 1 && count < num_states) {
+                set_count[codon_set]++;
+                partial = true;
+            }
+        }
+        size_t count = bitset<64>(site_set).count();
+        if (partial && count > 1 && count < num_states)
+            const_sets.insert(site_set);
+    }
+    if (set_count.empty() && const_sets.empty())
+        return;
+
+    // states must stay below 126 to fit the char-based state maps
+    size_t max_sets = 125 - num_states;
+    vector<pair<size_t, uint64_t> > ranked;
+    for (auto it = const_sets.begin(); it != const_sets.end(); it++)
+        ranked.push_back(make_pair(SIZE_MAX, *it));
+    for (auto it = set_count.begin(); it != set_count.end(); it++)
+        if (const_sets.find(it->first) == const_sets.end())
+            ranked.push_back(make_pair(it->second, it->first));
+    stable_sort(ranked.begin(), ranked.end(), [](const pair<size_t, uint64_t> &a, const pair<size_t, uint64_t> &b) {
+        return a.first > b.first;
+    });
+    size_t num_dropped = 0;
+    for (size_t i = 0; i < ranked.size(); i++)
+        if (i < max_sets)
+            codon_ambiguity.push_back(ranked[i].second);
+        else if (ranked[i].first != SIZE_MAX)
+            num_dropped += ranked[i].first;
+    sort(codon_ambiguity.begin(), codon_ambiguity.end());
+    STATE_UNKNOWN = num_states + codon_ambiguity.size();
+    cout << "Partially ambiguous codons represented by " << codon_ambiguity.size() << " ambiguous states" << endl;
+    if (num_dropped)
+        outWarning(convertInt64ToString(num_dropped) + " partially ambiguous codons of rare kinds are treated as unknown");
+}
+
 void Alignment::buildSeqStates(bool add_unobs_const) {
 	string unobs_const;
 	if (add_unobs_const) unobs_const = getUnobservedConstPatterns();
@@ -792,6 +889,18 @@ void Alignment::computeConst(Pattern &pat) {
             else if (state_app[9] && state_app[10]) // 512+1024 // U = I or L
                 pat.const_char = num_states+2;
             else ASSERT(0);
+        } else if (seq_type == SEQ_CODON) {
+            uint64_t codon_set = 0;
+            for (j = 0; j < num_states; j++)
+                if (state_app[j])
+                    codon_set |= (uint64_t)1 << j;
+            pat.const_char = getCodonSetState(codon_set);
+            // the shared codons have no state if their set was dropped from codon_ambiguity,
+            // then the pattern is treated as variable
+            if (pat.const_char == STATE_UNKNOWN) {
+                pat.const_char = STATE_UNKNOWN+1;
+                is_const = false;
+            }
         } else {
             ASSERT(0);
         }
@@ -875,6 +984,8 @@ void Alignment::printSiteInfo(const char* filename) {
 }
 
 bool Alignment::addPattern(Pattern &pat, int site, int freq) {
+    state_counts.clear();
+    seq_proper_counts.clear();
     // check if pattern contains only gaps
     bool gaps_only = true;
     for (Pattern::iterator it = pat.begin(); it != pat.end(); it++)
@@ -1306,8 +1417,23 @@ string Alignment::convertStateBackStr(StateType state) {
         return " " + convertIntToString(state);
 	if (seq_type == SEQ_CODON) {
         // codon data
-        if (state >= num_states) return "???";
+        if (state >= STATE_UNKNOWN) return "???";
         assert(codon_table);
+        if (state >= num_states) {
+            // ambiguous codon: IUPAC code of the nucleotides at each position
+            int mask[3] = {0, 0, 0};
+            for (int i = 0; i < num_states; i++)
+                if (codon_ambiguity[state-num_states] & ((uint64_t)1 << i)) {
+                    int codon = codon_table[i];
+                    mask[0] |= 1 << (codon/16);
+                    mask[1] |= 1 << ((codon%16)/4);
+                    mask[2] |= 1 << (codon%4);
+                }
+            const char *iupac = "?ACMGRSVTWYHKDBN";
+            for (int i = 0; i < 3; i++)
+                str += iupac[mask[i]];
+            return str;
+        }
         state = codon_table[(int)state];
         str = symbols_dna[state/16];
         str += symbols_dna[(state%16)/4];
@@ -1535,8 +1661,16 @@ int Alignment::buildPattern(StrVector &sequences, char *sequence_type, int nseq,
     if (nt2aa) {
         buildStateMap(char_to_state, SEQ_DNA);
         buildStateMap(AA_to_state, SEQ_PROTEIN);
-    } else
+    } else {
         buildStateMap(char_to_state, seq_type);
+        if (seq_type == SEQ_CODON && nsite % 3 == 0) {
+            initCodonAmbiguity(nseq, nsite/3, [&](int seq, int site) {
+                return (int)char_to_state[(int)(sequences[seq][site])];
+            });
+            // STATE_UNKNOWN may have moved behind the ambiguous codon states
+            buildStateMap(char_to_state, seq_type);
+        }
+    }
 
     Pattern pat;
     pat.resize(nseq);
@@ -1572,14 +1706,17 @@ int Alignment::buildPattern(StrVector &sequences, char *sequence_type, int nseq,
             	} else if (state == STATE_INVALID || state2 == STATE_INVALID || state3 == STATE_INVALID) {
             		state = STATE_INVALID;
             	} else {
-            		if (state != STATE_UNKNOWN || state2 != STATE_UNKNOWN || state3 != STATE_UNKNOWN) {
+            		bool partial = (state != STATE_UNKNOWN || state2 != STATE_UNKNOWN || state3 != STATE_UNKNOWN);
+            		state = STATE_UNKNOWN;
+            		if (partial && seq_type == SEQ_CODON)
+            			state = getCodonSetState(getCodonSet(char_to_state[(int)(sequences[seq][site])], state2, state3));
+            		if (partial && state == STATE_UNKNOWN) {
             			ostringstream warn_str;
                         warn_str << "Sequence " << seq_names[seq] << " has ambiguous character " <<
                         		sequences[seq][site] << sequences[seq][site+1] << sequences[seq][site+2] <<
                         		" at site " << site+1;
                         outWarning(warn_str.str());
             		}
-            		state = STATE_UNKNOWN;
             	}
             }
             if (state == STATE_INVALID) {
@@ -2658,6 +2795,7 @@ void Alignment::extractSubAlignment(Alignment *aln, IntVector &seq_id, int min_t
     num_states = aln->num_states;
     seq_type = aln->seq_type;
     STATE_UNKNOWN = aln->STATE_UNKNOWN;
+    codon_ambiguity = aln->codon_ambiguity;
 	genetic_code = aln->genetic_code;
     if (seq_type == SEQ_CODON) {
     	codon_table = new char[num_states];
@@ -2711,6 +2849,7 @@ void Alignment::extractPatterns(Alignment *aln, IntVector &ptn_id) {
     num_states = aln->num_states;
     seq_type = aln->seq_type;
     STATE_UNKNOWN = aln->STATE_UNKNOWN;
+    codon_ambiguity = aln->codon_ambiguity;
     genetic_code = aln->genetic_code;
     if (seq_type == SEQ_CODON) {
     	codon_table = new char[num_states];
@@ -2759,6 +2898,7 @@ void Alignment::extractPatternFreqs(Alignment *aln, IntVector &ptn_freq) {
     	memcpy(non_stop_codon, aln->non_stop_codon, strlen(genetic_code));
     }
     STATE_UNKNOWN = aln->STATE_UNKNOWN;
+    codon_ambiguity = aln->codon_ambiguity;
     site_pattern.resize(accumulate(ptn_freq.begin(), ptn_freq.end(), 0), -1);
     clear();
     pattern_index.clear();
@@ -2793,6 +2933,7 @@ void Alignment::extractSites(Alignment *aln, IntVector &site_id) {
     num_states = aln->num_states;
     seq_type = aln->seq_type;
     STATE_UNKNOWN = aln->STATE_UNKNOWN;
+    codon_ambiguity = aln->codon_ambiguity;
     genetic_code = aln->genetic_code;
     if (seq_type == SEQ_CODON) {
     	codon_table = new char[num_states];
@@ -2850,6 +2991,10 @@ void Alignment::convertToCodonOrAA(Alignment *aln, char *gene_code_id, bool nt2a
 
     if (nt2aa) {
         buildStateMap(AA_to_state, SEQ_PROTEIN);
+    } else {
+        initCodonAmbiguity(aln->getNSeq(), aln->getNSite()/3, [&](int seq, int site) {
+            return (int)aln->at(aln->getPatternID(site))[seq];
+        });
     }
 
     site_pattern.resize(aln->getNSite()/3, -1);
@@ -2889,13 +3034,17 @@ void Alignment::convertToCodonOrAA(Alignment *aln, char *gene_code_id, bool nt2a
             } else if (state == STATE_INVALID || state2 == STATE_INVALID || state3 == STATE_INVALID) {
                 state = STATE_INVALID;
             } else {
-                if (state != STATE_UNKNOWN || state2 != STATE_UNKNOWN || state3 != STATE_UNKNOWN) {
+                bool partial = (state != aln->STATE_UNKNOWN || state2 != aln->STATE_UNKNOWN || state3 != aln->STATE_UNKNOWN);
+                int nt1 = state;
+                state = STATE_UNKNOWN;
+                if (partial && !nt2aa)
+                    state = getCodonSetState(getCodonSet(nt1, state2, state3));
+                if (partial && state == STATE_UNKNOWN) {
                     ostringstream warn_str;
                     warn_str << "Sequence " << seq_names[seq] << " has ambiguous character " <<
                         " at site " << site+1;
                     outWarning(warn_str.str());
                 }
-                state = STATE_UNKNOWN;
             }
             if (state == STATE_INVALID) {
                 if (num_error < 100) {
@@ -3032,6 +3181,7 @@ void Alignment::createBootstrapAlignment(Alignment *aln, IntVector* pattern_freq
     	memcpy(non_stop_codon, aln->non_stop_codon, strlen(genetic_code));
     }
     STATE_UNKNOWN = aln->STATE_UNKNOWN;
+    codon_ambiguity = aln->codon_ambiguity;
     site_pattern.resize(nsite, -1);
     clear();
     pattern_index.clear();
@@ -3340,6 +3490,7 @@ void Alignment::createGapMaskedAlignment(Alignment *masked_aln, Alignment *aln)
     	memcpy(non_stop_codon, aln->non_stop_codon, strlen(genetic_code));
     }
     STATE_UNKNOWN = aln->STATE_UNKNOWN;
+    codon_ambiguity = aln->codon_ambiguity;
     site_pattern.resize(nsite, -1);
     clear();
     pattern_index.clear();
@@ -3414,6 +3565,7 @@ void Alignment::copyAlignment(Alignment *aln) {
     	memcpy(non_stop_codon, aln->non_stop_codon, strlen(genetic_code));
     }
     STATE_UNKNOWN = aln->STATE_UNKNOWN;
+    codon_ambiguity = aln->codon_ambiguity;
     site_pattern.resize(nsite, -1);
     clear();
     pattern_index.clear();
@@ -3466,11 +3618,8 @@ string Alignment::getUnobservedConstPatterns() {
 }
 
 int Alignment::countProperChar(int seq_id) {
-    int num_proper_chars = 0;
-    for (iterator it = begin(); it != end(); it++) {
-        if ((*it)[seq_id] < num_states + pomo_sampled_states.size()) num_proper_chars+=(*it).frequency;
-    }
-    return num_proper_chars;
+    computeSeqStats();
+    return seq_proper_counts[seq_id];
 }
 
 Alignment::~Alignment()
@@ -3662,37 +3811,91 @@ double Alignment::readDist(const char *file_name, double *dist_mat) {
 // the virtual population size is also the sample size (for every species and
 // every site).
 void Alignment::computeStateFreq (double *state_freq, size_t num_unknown_states) {
-    int i, j;
-    double *states_app = new double[num_states*(STATE_UNKNOWN+1)];
-    double *new_freq = new double[num_states];
-    unsigned *state_count = new unsigned[STATE_UNKNOWN+1];
-    double *new_state_freq = new double[num_states];
-
+    int i;
+    size_t aln_len = 0;
+    for (iterator it = begin(); it != end(); it++)
+        aln_len += it->frequency;
 
-    memset(state_count, 0, sizeof(unsigned)*(STATE_UNKNOWN+1));
-    state_count[(int)STATE_UNKNOWN] = num_unknown_states;
+    if (aln_len > 0) {
+        vector<size_t> state_count = getStateCounts();
+        state_count[STATE_UNKNOWN] += num_unknown_states;
+        computeStateFreqFromCounts(state_count, state_freq);
+    } else {
+        for (i = 0; i < num_states; i++)
+            state_freq[i] = 1.0/num_states;
+    }
 
-    for (i = 0; i <= STATE_UNKNOWN; i++)
-        getAppearance(i, &states_app[i*num_states]);
+	convfreq(state_freq);
 
-    size_t aln_len = 0;
+    if (verbose_mode >= VB_MED) {
+        cout << "Empirical state frequencies: ";
+        cout << setprecision(10);
+        for (i = 0; i < num_states; i++)
+            cout << state_freq[i] << " ";
+        cout << endl;
+    }
+}
 
-    for (iterator it = begin(); it != end(); it++) {
-        aln_len += it->frequency;
-        for (Pattern::iterator it2 = it->begin(); it2 != it->end(); it2++)
-            state_count[convertPomoState((int)*it2)] += it->frequency;
+const vector<size_t> &Alignment::getStateCounts() {
+    if (!state_counts.empty())
+        return state_counts;
+    size_t nchars = STATE_UNKNOWN+1;
+    int npattern = size();
+    state_counts.resize(nchars, 0);
+
+    // count patterns in parallel into thread-local histograms, then reduce
+#ifdef _OPENMP
+#pragma omp parallel if(npattern > 1000)
+#endif
+    {
+        vector<size_t> local_count(nchars, 0);
+        size_t *count = &local_count[0];
+#ifdef _OPENMP
+#pragma omp for schedule(static)
+#endif
+        for (int ptn = 0; ptn < npattern; ptn++) {
+            Pattern &pat = at(ptn);
+            size_t freq = pat.frequency;
+            if (freq == 0) continue;
+            if (seq_type == SEQ_POMO) {
+                for (Pattern::iterator it = pat.begin(); it != pat.end(); it++)
+                    count[convertPomoState((int)*it)] += freq;
+            } else {
+                for (Pattern::iterator it = pat.begin(); it != pat.end(); it++)
+                    count[*it] += freq;
+            }
+        }
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+        for (size_t i = 0; i < nchars; i++)
+            state_counts[i] += local_count[i];
     }
+    return state_counts;
+}
+
+void Alignment::computeStateFreqFromCounts(const vector<size_t> &state_count, double *state_freq) {
+    int i, j;
+    // look-up table of the states covered by each observed (possibly ambiguous) character
+    IntVector chars;
+    for (i = 0; i < state_count.size(); i++)
+        if (state_count[i] > 0)
+            chars.push_back(i);
+    int nchars = chars.size();
+    double *states_app = new double[num_states*nchars];
+    double *new_freq = new double[num_states];
+    double *new_state_freq = new double[num_states];
+    for (i = 0; i < nchars; i++)
+        getAppearance(chars[i], &states_app[i*num_states]);
 
     for (i = 0; i < num_states; i++)
         state_freq[i] = 1.0/num_states;
 
     const int NUM_TIME = 8;
-    if (aln_len > 0)
     for (int k = 0; k < NUM_TIME; k++) {
         memset(new_state_freq, 0, sizeof(double)*num_states);
 
-        for (i = 0; i <= STATE_UNKNOWN; i++) {
-            if (state_count[i] == 0) continue;
+        for (i = 0; i < nchars; i++) {
             double sum_freq = 0.0;
             for (j = 0; j < num_states; j++) {
                 new_freq[j] = state_freq[j] * states_app[i*num_states+j];
@@ -3700,7 +3903,7 @@ void Alignment::computeStateFreq (double *state_freq, size_t num_unknown_states)
             }
             sum_freq = 1.0/sum_freq;
             for (j = 0; j < num_states; j++) {
-                new_state_freq[j] += new_freq[j]*sum_freq*state_count[i];
+                new_state_freq[j] += new_freq[j]*sum_freq*state_count[chars[i]];
             }
         }
 
@@ -3712,18 +3915,7 @@ void Alignment::computeStateFreq (double *state_freq, size_t num_unknown_states)
             state_freq[j] = new_state_freq[j]*sum_freq;
     }
 
-	convfreq(state_freq);
-
-    if (verbose_mode >= VB_MED) {
-        cout << "Empirical state frequencies: ";
-        cout << setprecision(10);
-        for (i = 0; i < num_states; i++)
-            cout << state_freq[i] << " ";
-        cout << endl;
-    }
-
     delete [] new_state_freq;
-    delete [] state_count;
     delete [] new_freq;
     delete [] states_app;
 }
@@ -3785,95 +3977,115 @@ int Alignment::convertPomoState(int state) {
 }
 
 void Alignment::computeAbsoluteStateFreq(unsigned int *abs_state_freq) {
-    memset(abs_state_freq, 0, num_states * sizeof(unsigned int));
-
-    if (seq_type == SEQ_POMO) {
-        for (iterator it = begin(); it != end(); it++)
-            for (Pattern::iterator it2 = it->begin(); it2 != it->end(); it2++)
-                abs_state_freq[convertPomoState((int)*it2)] += it->frequency;
-    } else {
-        for (iterator it = begin(); it != end(); it++)
-            for (Pattern::iterator it2 = it->begin(); it2 != it->end(); it2++)
-                abs_state_freq[(int)*it2] += it->frequency;
-    }
+    const vector<size_t> &state_count = getStateCounts();
+    for (int i = 0; i < num_states; i++)
+        abs_state_freq[i] = state_count[i];
 }
 
 
 void Alignment::countStatePerSequence (unsigned *count_per_sequence) {
-    int i;
+    computeSeqStats();
+    memcpy(count_per_sequence, &seq_state_counts[0], sizeof(unsigned)*num_states*getNSeq());
+}
+
+void Alignment::computeSeqStats() {
     int nseqs = getNSeq();
-    memset(count_per_sequence, 0, sizeof(unsigned)*num_states*nseqs);
-    for (iterator it = begin(); it != end(); it++)
-        for (i = 0; i != nseqs; i++) {
-            int state = convertPomoState(it->at(i));
-            if (state < num_states) {
-                count_per_sequence[i*num_states + state] += it->frequency;
+    if (seq_proper_counts.size() == nseqs && seq_state_counts.size() == num_states*nseqs)
+        return;
+    int npattern = size();
+    size_t nchars = STATE_UNKNOWN+1;
+    int num_proper = num_states + pomo_sampled_states.size();
+    bool count_chars = state_counts.empty();
+    seq_state_counts.assign(num_states*nseqs, 0);
+    seq_proper_counts.assign(nseqs, 0);
+    seq_unknown_counts.assign(nseqs, 0);
+    seq_stats_nsite = 0;
+    if (count_chars)
+        state_counts.resize(nchars, 0);
+
+    // one pass over the patterns into thread-local counts, then reduce
+#ifdef _OPENMP
+#pragma omp parallel if(npattern > 1000)
+#endif
+    {
+        vector<unsigned> local_state(num_states*nseqs, 0), local_proper(nseqs, 0), local_unknown(nseqs, 0);
+        vector<size_t> local_chars(count_chars ? nchars : 0, 0);
+        unsigned local_nsite = 0;
+        unsigned *count = &local_state[0];
+#ifdef _OPENMP
+#pragma omp for schedule(static)
+#endif
+        for (int ptn = 0; ptn < npattern; ptn++) {
+            Pattern &pat = at(ptn);
+            unsigned freq = pat.frequency;
+            local_nsite += freq;
+            for (int i = 0; i != nseqs; i++) {
+                int ch = pat[i];
+                int state = convertPomoState(ch);
+                if (state < num_states)
+                    count[i*num_states + state] += freq;
+                if (ch < num_proper)
+                    local_proper[i] += freq;
+                else if (ch == STATE_UNKNOWN)
+                    local_unknown[i] += freq;
+                if (count_chars)
+                    local_chars[state] += freq;
             }
         }
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+        {
+            for (int i = 0; i < num_states*nseqs; i++)
+                seq_state_counts[i] += local_state[i];
+            for (int i = 0; i < nseqs; i++) {
+                seq_proper_counts[i] += local_proper[i];
+                seq_unknown_counts[i] += local_unknown[i];
+            }
+            for (size_t i = 0; i < local_chars.size(); i++)
+                state_counts[i] += local_chars[i];
+            seq_stats_nsite += local_nsite;
+        }
+    }
 }
 
 void Alignment::computeStateFreqPerSequence (double *freq_per_sequence) {
-    int i, j;
     int nseqs = getNSeq();
-    double *states_app = new double[num_states*(STATE_UNKNOWN+1)];
-    double *new_freq = new double[num_states];
-    unsigned *state_count = new unsigned[(STATE_UNKNOWN+1)*nseqs];
-    double *new_state_freq = new double[num_states];
-
-
-    memset(state_count, 0, sizeof(unsigned)*(STATE_UNKNOWN+1)*nseqs);
-
-    for (i = 0; i <= STATE_UNKNOWN; i++)
-        getAppearance(i, &states_app[i*num_states]);
-
-    for (iterator it = begin(); it != end(); it++)
-        for (i = 0; i != nseqs; i++) {
-            state_count[i*(STATE_UNKNOWN+1) + it->at(i)] += it->frequency;
+    int npattern = size();
+    size_t nchars = STATE_UNKNOWN+1;
+    vector<size_t> state_count(nchars*nseqs, 0);
+
+    // character counts per sequence, patterns split among threads
+#ifdef _OPENMP
+#pragma omp parallel if(npattern > 1000)
+#endif
+    {
+        vector<size_t> local_count(nchars*nseqs, 0);
+        size_t *count = &local_count[0];
+#ifdef _OPENMP
+#pragma omp for schedule(static)
+#endif
+        for (int ptn = 0; ptn < npattern; ptn++) {
+            Pattern &pat = at(ptn);
+            size_t freq = pat.frequency;
+            for (int i = 0; i != nseqs; i++)
+                count[i*nchars + pat[i]] += freq;
         }
-    double equal_freq = 1.0/num_states;
-    for (i = 0; i < num_states*nseqs; i++)
-        freq_per_sequence[i] = equal_freq;
-
-    const int NUM_TIME = 8;
-    for (int k = 0; k < NUM_TIME; k++) {
-        for (int seq = 0; seq < nseqs; seq++) {
-            double *state_freq = &freq_per_sequence[seq*num_states];
-            memset(new_state_freq, 0, sizeof(double)*num_states);
-            for (i = 0; i <= STATE_UNKNOWN; i++) {
-                if (state_count[seq*(STATE_UNKNOWN+1)+i] == 0) continue;
-                double sum_freq = 0.0;
-                for (j = 0; j < num_states; j++) {
-                    new_freq[j] = state_freq[j] * states_app[i*num_states+j];
-                    sum_freq += new_freq[j];
-                }
-                sum_freq = 1.0/sum_freq;
-                for (j = 0; j < num_states; j++) {
-                    new_state_freq[j] += new_freq[j]*sum_freq*state_count[seq*(STATE_UNKNOWN+1)+i];
-                }
-            }
-
-            double sum_freq = 0.0;
-            for (j = 0; j < num_states; j++)
-                sum_freq += new_state_freq[j];
-            sum_freq = 1.0/sum_freq;
-            for (j = 0; j < num_states; j++)
-                state_freq[j] = new_state_freq[j]*sum_freq;
-         }
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+        for (size_t i = 0; i < nchars*nseqs; i++)
+            state_count[i] += local_count[i];
     }
 
-//	convfreq(state_freq);
-//
-//    if (verbose_mode >= VB_MED) {
-//        cout << "Empirical state frequencies: ";
-//        for (i = 0; i < num_states; i++)
-//            cout << state_freq[i] << " ";
-//        cout << endl;
-//    }
-
-    delete [] new_state_freq;
-    delete [] state_count;
-    delete [] new_freq;
-    delete [] states_app;
+    // EM estimate for every sequence independently
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) if(nseqs > 100)
+#endif
+    for (int seq = 0; seq < nseqs; seq++) {
+        vector<size_t> seq_count(state_count.begin() + seq*nchars, state_count.begin() + (seq+1)*nchars);
+        computeStateFreqFromCounts(seq_count, &freq_per_sequence[seq*num_states]);
+    }
 }
 
 //void Alignment::computeStateFreq (double *stateFrqArr) {
@@ -3976,6 +4188,12 @@ void Alignment::getAppearance(StateType state, double *state_app) {
 				state_app[i] = 1.0;
 			}
 		break;
+	case SEQ_CODON:
+		ASSERT(state < STATE_UNKNOWN);
+		for (i = 0; i < num_states; i++)
+			if (codon_ambiguity[state-num_states] & ((uint64_t)1 << i))
+				state_app[i] = 1.0;
+		break;
     case SEQ_POMO:
 //        state -= num_states;
 //        assert(state < pomo_sampled_states.size());
@@ -4019,6 +4237,12 @@ void Alignment::getAppearance(StateType state, StateBitset &state_app) {
 				state_app[i] = 1;
 			}
 		break;
+	case SEQ_CODON:
+		ASSERT(state < STATE_UNKNOWN);
+		for (i = 0; i < num_states; i++)
+			if (codon_ambiguity[state-num_states] & ((uint64_t)1 << i))
+				state_app[i] = 1;
+		break;
     case SEQ_POMO:
 //        state -= num_states;
 //        assert(state < pomo_sampled_states.size());
@@ -4038,7 +4262,7 @@ void Alignment::computeCodonFreq(StateFreqType freq, double *state_freq, double
 	if (freq == FREQ_CODON_1x4) {
 		memset(ntfreq, 0, sizeof(double)*4);
 		for (iterator it = begin(); it != end(); it++) {
-			for (int seq = 0; seq < nseqs; seq++) if ((*it)[seq] != STATE_UNKNOWN) {
+			for (int seq = 0; seq < nseqs; seq++) if ((*it)[seq] < num_states) {
 				int codon = codon_table[(int)(*it)[seq]];
 //				int codon = (int)(*it)[seq];
 				int nt1 = codon / 16;
@@ -4085,7 +4309,7 @@ void Alignment::computeCodonFreq(StateFreqType freq, double *state_freq, double
 		// F3x4 frequency model
 		memset(ntfreq, 0, sizeof(double)*12);
 		for (iterator it = begin(); it != end(); it++) {
-			for (int seq = 0; seq < nseqs; seq++) if ((*it)[seq] != STATE_UNKNOWN) {
+			for (int seq = 0; seq < nseqs; seq++) if ((*it)[seq] < num_states) {
 				int codon = codon_table[(int)(*it)[seq]];
 //				int codon = (int)(*it)[seq];
 				int nt1 = codon / 16;
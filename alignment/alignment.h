@@ -14,6 +14,7 @@
 
 #include <vector>
 #include <bitset>
+#include <functional>
 #include "pattern.h"
 #include "ncl/ncl.h"
 #include "utils/tools.h"
@@ -588,6 +589,21 @@ public:
      */
     virtual void computeStateFreq(double *state_freq, size_t num_unknown_states = 0);
 
+    /**
+            count every character 0..STATE_UNKNOWN over all sites (PoMo states converted).
+            These are the sufficient statistics of computeStateFreq(): they are cached until
+            the patterns change and summed up over partitions for concatenated alignments.
+            @return character counts, of size STATE_UNKNOWN+1
+     */
+    const vector<size_t> &getStateCounts();
+
+    /**
+            estimate state frequencies from character counts, resolving ambiguous characters by EM
+            @param state_count character counts, of size STATE_UNKNOWN+1
+            @param state_freq (OUT) state frequencies, of size num_states
+     */
+    void computeStateFreqFromCounts(const vector<size_t> &state_count, double *state_freq);
+
     int convertPomoState(int state);
 
     /** 
@@ -606,8 +622,19 @@ public:
      */
     void computeStateFreqPerSequence (double *freq_per_sequence);
 
+    /**
+            count states for each sequence (ambiguous characters ignored)
+            @param count_per_sequence (OUT) state counts for each sequence, of size num_states*num_freq
+     */
     void countStatePerSequence (unsigned *count_per_sequence);
 
+    /**
+            compute per-sequence statistics (state counts, proper and unknown characters) in one
+            pass over the patterns and cache them until the patterns change. Character counts of
+            getStateCounts() are filled in the same pass if not yet available.
+     */
+    void computeSeqStats();
+
     /**
      * Make all frequencies a little different and non-zero
      * @param stateFrqArr (IN/OUT) state frequencies
@@ -707,6 +734,14 @@ public:
 	 */
 	char *genetic_code;
 
+	/**
+	 * For codon sequences: sets of sense codons of the partially ambiguous codons (e.g. AAR, AC-),
+	 * sorted, bit i meaning codon state i. State num_states+k stands for any codon in
+	 * codon_ambiguity[k] and STATE_UNKNOWN follows the last set.
+	 * For other sequences: empty
+	 */
+	vector<uint64_t> codon_ambiguity;
+
 	/**
 	 * Virtual population size for PoMo model
 	 */
@@ -742,6 +777,28 @@ public:
 
     bool isStandardGeneticCode();
 
+    /**
+     * @param nt1, nt2, nt3 nucleotide states (DNA coding, ambiguous states allowed)
+     * @return set of sense codon states compatible with the nucleotides, bit i meaning codon state i
+     */
+    uint64_t getCodonSet(int nt1, int nt2, int nt3);
+
+    /**
+     * @param codon_set set of sense codon states
+     * @return the codon state if the set has one codon, its ambiguous codon state if listed in
+     *      codon_ambiguity, otherwise STATE_UNKNOWN
+     */
+    StateType getCodonSetState(uint64_t codon_set);
+
+    /**
+     * collect the partially ambiguous codons of the input into codon_ambiguity before
+     * building the patterns, the most frequent ones first, and move STATE_UNKNOWN behind them
+     * @param nseq number of sequences
+     * @param ncodon number of codon sites
+     * @param get_nt returns the nucleotide state (DNA coding) of a sequence at a nucleotide site
+     */
+    void initCodonAmbiguity(int nseq, int ncodon, function<int(int, int)> get_nt);
+
 	/**
 	 * @return number of non-stop codons in the genetic code
 	 */
@@ -823,6 +880,31 @@ protected:
      */
     PatternIntMap pattern_index;
 
+    /**
+            cached character counts of getStateCounts(), empty if not yet computed
+     */
+    vector<size_t> state_counts;
+
+    /**
+            cached state counts per sequence of computeSeqStats(), of size num_states*nseq
+     */
+    vector<unsigned> seq_state_counts;
+
+    /**
+            cached number of ungappy and unambiguous characters per sequence, empty if not yet computed
+     */
+    vector<unsigned> seq_proper_counts;
+
+    /**
+            cached number of unknown characters per sequence
+     */
+    vector<unsigned> seq_unknown_counts;
+
+    /**
+            number of sites counted by computeSeqStats()
+     */
+    unsigned seq_stats_nsite;
+
 
     /**
 	 * special initialization for codon sequences, e.g., setting #states, genetic_code
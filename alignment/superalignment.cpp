@@ -147,12 +147,85 @@ void SuperAlignment::buildPattern() {
     buildSeqStates();
 }
 
+/**
+    specification of one partition to be built from an already parsed input alignment
+*/
+struct PartitionSpec {
+    /** input alignment, shared between partitions of the same file if owned is FALSE */
+    Alignment *input;
+    /** TRUE if input was read for this partition alone and is taken over, FALSE if it is shared */
+    bool owned;
+    /** TRUE to extract site_id from input, FALSE to take over input as it is (requires owned) */
+    bool extract;
+    /** sites of the partition */
+    IntVector site_id;
+    /** partition information copied into the resulting alignment */
+    string name, model_name, aln_file, position_spec, sequence_type;
+};
+
+/**
+    build partition alignments from parsed input alignments. Input files are read and site
+    ranges resolved beforehand, so partitions only share read-only input and are extracted,
+    pattern-compressed and converted in parallel; the order of specs is preserved.
+    @param specs partition specifications
+    @param remove_empty_seq TRUE to remove sequences with only gaps
+    @param convert_codon TRUE to convert DNA into codon or amino-acid for CODON/NT2AA sequence types
+    @param[out] partitions resulting partition alignments
+*/
+static void buildPartitions(vector<PartitionSpec> &specs, bool remove_empty_seq, bool convert_codon,
+    vector<Alignment*> &partitions)
+{
+    size_t first = partitions.size();
+    partitions.resize(first + specs.size(), NULL);
+    // extractSites() and convertToCodonOrAA() temporarily lower verbose_mode,
+    // lower it here once so that threads do not race on restoring it
+    VerboseMode save_mode = verbose_mode;
+    verbose_mode = min(verbose_mode, VB_MIN);
+    int num_specs = specs.size();
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (int i = 0; i < num_specs; i++) {
+        PartitionSpec &spec = specs[i];
+        // a shared input is read by other threads and deleted by the caller, never take it over
+        ASSERT(spec.owned || spec.extract);
+        Alignment *part_aln = spec.input;
+        if (spec.extract) {
+            part_aln = new Alignment();
+            part_aln->extractSites(spec.input, spec.site_id);
+        }
+        if (convert_codon && part_aln->seq_type == SEQ_DNA &&
+            (spec.sequence_type.substr(0, 5) == "CODON" || spec.sequence_type.substr(0, 5) == "NT2AA")) {
+            Alignment *new_aln = new Alignment();
+            new_aln->convertToCodonOrAA(part_aln, &spec.sequence_type[5], spec.sequence_type.substr(0, 5) == "NT2AA");
+            if (part_aln != spec.input || spec.owned) delete part_aln;
+            part_aln = new_aln;
+        }
+        if (remove_empty_seq) {
+            Alignment *new_aln = part_aln->removeGappySeq();
+            // also rebuild states set of each sequence for likelihood computation
+            new_aln->buildSeqStates();
+            if (new_aln != part_aln && (part_aln != spec.input || spec.owned)) delete part_aln;
+            part_aln = new_aln;
+        }
+        part_aln->name = spec.name;
+        part_aln->model_name = spec.model_name;
+        part_aln->aln_file = spec.aln_file;
+        part_aln->position_spec = spec.position_spec;
+        part_aln->sequence_type = spec.sequence_type;
+        partitions[first + i] = part_aln;
+    }
+    verbose_mode = save_mode;
+}
+
 void SuperAlignment::readPartition(Params &params) {
     try {
         ifstream in;
         in.exceptions(ios::failbit | ios::badbit);
         in.open(params.partition_file);
         in.exceptions(ios::badbit);
+        map<string, Alignment*> input_alns;
+        vector<PartitionSpec> specs;
         
         while (!in.eof()) {
             CharSet info;
@@ -175,19 +248,25 @@ void SuperAlignment::readPartition(Params &params) {
 //            info.nniMoves[1].ptnlh = NULL;
 //            info.cur_ptnlh = NULL;
 //            part_info.push_back(info);
-            Alignment *part_aln = new Alignment((char*)info.aln_file.c_str(), (char*)info.sequence_type.c_str(), params.intype, info.model_name);
-            if (!info.position_spec.empty()) {
-                Alignment *new_aln = new Alignment();
-                new_aln->extractSites(part_aln, info.position_spec.c_str());
-                delete part_aln;
-                part_aln = new_aln;
+            PartitionSpec spec;
+            spec.extract = !info.position_spec.empty();
+            spec.owned = !spec.extract;
+            if (spec.extract) {
+                // parse each alignment file only once for all its partitions
+                Alignment *&input_aln = input_alns[info.aln_file + "\t" + info.sequence_type];
+                if (!input_aln)
+                    input_aln = new Alignment((char*)info.aln_file.c_str(), (char*)info.sequence_type.c_str(), params.intype, info.model_name);
+                spec.input = input_aln;
+                extractSiteID(input_aln, info.position_spec.c_str(), spec.site_id);
+            } else {
+                spec.input = new Alignment((char*)info.aln_file.c_str(), (char*)info.sequence_type.c_str(), params.intype, info.model_name);
             }
-            part_aln->name = info.name;
-            part_aln->model_name = info.model_name;
-            part_aln->position_spec = info.position_spec;
-            part_aln->aln_file = info.aln_file;
-            part_aln->sequence_type = info.sequence_type;
-            partitions.push_back(part_aln);
+            spec.name = info.name;
+            spec.model_name = info.model_name;
+            spec.position_spec = info.position_spec;
+            spec.aln_file = info.aln_file;
+            spec.sequence_type = info.sequence_type;
+            specs.push_back(spec);
             // TODO move this to supertree
 //            PhyloTree *tree = new PhyloTree(part_aln);
 //            push_back(tree);
@@ -197,6 +276,10 @@ void SuperAlignment::readPartition(Params &params) {
         // set the failbit again
         in.exceptions(ios::failbit | ios::badbit);
         in.close();
+
+        buildPartitions(specs, false, false, partitions);
+        for (map<string, Alignment*>::iterator mit = input_alns.begin(); mit != input_alns.end(); mit++)
+            delete mit->second;
     } catch(ios::failure) {
         outError(ERR_READ_INPUT);
     } catch (string str) {
@@ -225,6 +308,7 @@ void SuperAlignment::readPartitionRaxml(Params &params) {
         string rate_type = "";
         if (pos != string::npos) rate_type = params.model_name.substr(pos);
         
+        vector<PartitionSpec> specs;
         while (!in.eof()) {
             CharSet info;
             getline(in, info.model_name, ',');
@@ -294,25 +378,17 @@ void SuperAlignment::readPartitionRaxml(Params &params) {
 //            info.nniMoves[1].ptnlh = NULL;
 //            info.cur_ptnlh = NULL;
 //            part_info.push_back(info);
-            Alignment *part_aln = new Alignment();
-            part_aln->extractSites(input_aln, info.position_spec.c_str());
-            
-            Alignment *new_aln;
-            if (params.remove_empty_seq)
-                new_aln = part_aln->removeGappySeq();
-            else
-                new_aln = part_aln;
-            // also rebuild states set of each sequence for likelihood computation
-            new_aln->buildSeqStates();
-            
-            if (part_aln != new_aln) delete part_aln;
-
-            new_aln->name = info.name;
-            new_aln->model_name = info.model_name;
-            new_aln->position_spec = info.position_spec;
-            new_aln->aln_file = info.aln_file;
-            new_aln->sequence_type = info.sequence_type;
-            partitions.push_back(new_aln);
+            PartitionSpec spec;
+            spec.input = input_aln;
+            spec.owned = false;
+            spec.extract = true;
+            extractSiteID(input_aln, info.position_spec.c_str(), spec.site_id);
+            spec.name = info.name;
+            spec.model_name = info.model_name;
+            spec.position_spec = info.position_spec;
+            spec.aln_file = info.aln_file;
+            spec.sequence_type = info.sequence_type;
+            specs.push_back(spec);
             // TODO move to supertree
 //            PhyloTree *tree = new PhyloTree(new_aln);
 //            push_back(tree);
@@ -324,6 +400,9 @@ void SuperAlignment::readPartitionRaxml(Params &params) {
         // set the failbit again
         in.exceptions(ios::failbit | ios::badbit);
         in.close();
+
+        buildPartitions(specs, params.remove_empty_seq, false, partitions);
+        delete input_aln;
     } catch(ios::failure) {
         outError(ERR_READ_INPUT);
     } catch (string str) {
@@ -359,6 +438,9 @@ void SuperAlignment::readPartitionNexus(Params &params) {
     
     cout << endl << "Loading " << sets_block->charsets.size() << " partitions..." << endl;
     
+    // alignment files parsed so far, each shared by all partitions taken from it
+    map<string, Alignment*> input_alns;
+    vector<PartitionSpec> specs;
     for (it = sets_block->charsets.begin(); it != sets_block->charsets.end(); it++)
         if (empty_partition || (*it)->char_partition != "") {
             if ((*it)->model_name == "")
@@ -386,45 +468,40 @@ void SuperAlignment::readPartitionNexus(Params &params) {
 //            info.nniMoves[1].ptnlh = NULL;
 //            info.cur_ptnlh = NULL;
 //            part_info.push_back(info);
-            Alignment *part_aln;
-            if ((*it)->aln_file != "") {
-                part_aln = new Alignment((char*)(*it)->aln_file.c_str(), (char*)(*it)->sequence_type.c_str(), params.intype, (*it)->model_name);
+            PartitionSpec spec;
+            spec.extract = !(*it)->position_spec.empty() && (*it)->position_spec != "*";
+            spec.owned = false;
+            if ((*it)->aln_file == "") {
+                // the main alignment is deleted below, so its partitions are always extracted
+                // (an empty position range was rejected above)
+                spec.input = input_aln;
+                spec.extract = true;
+            } else if (spec.extract) {
+                Alignment *&part_input = input_alns[(*it)->aln_file + "\t" + (*it)->sequence_type];
+                if (!part_input)
+                    part_input = new Alignment((char*)(*it)->aln_file.c_str(), (char*)(*it)->sequence_type.c_str(), params.intype, (*it)->model_name);
+                spec.input = part_input;
             } else {
-                part_aln = input_aln;
-            }
-            if (!(*it)->position_spec.empty() && (*it)->position_spec != "*") {
-                Alignment *new_aln = new Alignment();
-                new_aln->extractSites(part_aln, (*it)->position_spec.c_str());
-                if (part_aln != input_aln) delete part_aln;
-                part_aln = new_aln;
-            }
-            if (part_aln->seq_type == SEQ_DNA && ((*it)->sequence_type.substr(0, 5) == "CODON" || (*it)->sequence_type.substr(0, 5) == "NT2AA")) {
-                Alignment *new_aln = new Alignment();
-                new_aln->convertToCodonOrAA(part_aln, &(*it)->sequence_type[5], (*it)->sequence_type.substr(0, 5) == "NT2AA");
-                if (part_aln != input_aln) delete part_aln;
-                part_aln = new_aln;
+                spec.input = new Alignment((char*)(*it)->aln_file.c_str(), (char*)(*it)->sequence_type.c_str(), params.intype, (*it)->model_name);
+                spec.owned = true;
             }
-            Alignment *new_aln;
-            if (params.remove_empty_seq)
-                new_aln = part_aln->removeGappySeq();
-            else
-                new_aln = part_aln;
-            // also rebuild states set of each sequence for likelihood computation
-            new_aln->buildSeqStates();
-            
-            if (part_aln != new_aln && part_aln != input_aln) delete part_aln;
-            new_aln->name = (*it)->name;
-            new_aln->model_name = (*it)->model_name;
-            new_aln->aln_file = (*it)->aln_file;
-            new_aln->position_spec = (*it)->position_spec;
-            new_aln->sequence_type = (*it)->sequence_type;
-            partitions.push_back(new_aln);
+            if (spec.extract)
+                extractSiteID(spec.input, (*it)->position_spec.c_str(), spec.site_id);
+            spec.name = (*it)->name;
+            spec.model_name = (*it)->model_name;
+            spec.aln_file = (*it)->aln_file;
+            spec.position_spec = (*it)->position_spec;
+            spec.sequence_type = (*it)->sequence_type;
+            specs.push_back(spec);
 //            PhyloTree *tree = new PhyloTree(new_aln);
 //            push_back(tree);
 //            params = origin_params;
             //            cout << new_aln->getNSeq() << " sequences and " << new_aln->getNSite() << " sites extracted" << endl;
         }
     
+    buildPartitions(specs, params.remove_empty_seq, true, partitions);
+    for (map<string, Alignment*>::iterator mit = input_alns.begin(); mit != input_alns.end(); mit++)
+        delete mit->second;
     if (input_aln)
         delete input_aln;
     delete sets_block;
@@ -1224,6 +1301,21 @@ Alignment *SuperAlignment::concatenateAlignments(set<int> &ids) {
     	memcpy(aln->non_stop_codon, partitions[*ids.begin()]->non_stop_codon, strlen(aln->genetic_code));
     }
 
+    // partitions read separately may have different ambiguous codon states: use their union
+    bool remap_codons = false;
+    if (aln->seq_type == SEQ_CODON) {
+        set<uint64_t> codon_sets;
+        for (it = ids.begin(); it != ids.end(); it++) {
+            codon_sets.insert(partitions[*it]->codon_ambiguity.begin(), partitions[*it]->codon_ambiguity.end());
+            if (partitions[*it]->codon_ambiguity != partitions[*ids.begin()]->codon_ambiguity)
+                remap_codons = true;
+        }
+        aln->codon_ambiguity.assign(codon_sets.begin(), codon_sets.end());
+        if (aln->codon_ambiguity.size() > 125 - nstates)
+            aln->codon_ambiguity.resize(125 - nstates);
+        aln->STATE_UNKNOWN = nstates + aln->codon_ambiguity.size();
+    }
+
     int site = 0;
     for (it = ids.begin(); it != ids.end(); it++) {
     	int id = *it;
@@ -1238,8 +1330,12 @@ Alignment *SuperAlignment::concatenateAlignments(set<int> &ids) {
     			if (union_taxa[seq] == 1) {
     				char ch = aln->STATE_UNKNOWN;
                     int seq_part = taxa_index[seq][id];
-                    if (seq_part >= 0)
+                    if (seq_part >= 0) {
                         ch = (*it)[seq_part];
+                        if (remap_codons && ch >= nstates)
+                            ch = (ch == partitions[id]->STATE_UNKNOWN) ? aln->STATE_UNKNOWN :
+                                aln->getCodonSetState(partitions[id]->codon_ambiguity[ch - nstates]);
+                    }
                     //if (taxa_set[seq] == 1) {
                     //    ch = (*it)[part_seq++];
                     //}
@@ -1257,6 +1353,19 @@ Alignment *SuperAlignment::concatenateAlignments(set<int> &ids) {
     aln->countConstSite();
     aln->buildSeqStates();
 
+    // character counts of the concatenation are the sums over the partitions plus the
+    // unknown characters of missing taxa, so merged candidates in ModelFinder need no recount
+    if (aln->seq_type != SEQ_POMO && !remap_codons) {
+        aln->state_counts.resize(aln->STATE_UNKNOWN+1, 0);
+        for (it = ids.begin(); it != ids.end(); it++) {
+            const vector<size_t> &part_counts = partitions[*it]->getStateCounts();
+            for (size_t i = 0; i < part_counts.size(); i++)
+                aln->state_counts[i] += part_counts[i];
+            aln->state_counts[aln->STATE_UNKNOWN] +=
+                (size_t)partitions[*it]->getNSite() * (aln->getNSeq() - partitions[*it]->getNSeq());
+        }
+    }
+
 	return aln;
 }
 
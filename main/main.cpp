@@ -48,6 +48,7 @@
 #include "pda/circularnetwork.h"
 #include "tree/mtreeset.h"
 #include "tree/mexttree.h"
+#include "tree/randomtreesampler.h"
 #include "ncl/ncl.h"
 #include "nclextra/msetsblock.h"
 #include "nclextra/myreader.h"
@@ -62,6 +63,7 @@
 #include "tree/upperbounds.h"
 #include "pda/ecopdmtreeset.h"
 #include "pda/gurobiwrapper.h"
+#include "pda/ilpsolver.h"
 #include "utils/timeutil.h"
 //#include <unistd.h>
 #include <stdlib.h>
@@ -73,10 +75,47 @@
 	#include <omp.h>
 #endif
 
+#if !defined WIN32 && !defined _WIN32 && !defined __WIN32__
+	#include <sys/wait.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
 using namespace std;
 
 
 
+/**
+	generate params.repeated_time random trees in parallel batches and print them
+	@param params program parameters
+	@param out output stream
+*/
+void generateRandomTreeBatches(Params &params, ostream &out) {
+	int ntaxa = params.sub_size;
+	StrVector names;
+	if (params.aln_file) {
+		// leaf set taken from an alignment
+		Alignment aln(params.aln_file, params.sequence_type, params.intype, params.model_name);
+		ntaxa = aln.getNSeq();
+		for (int i = 0; i < ntaxa; i++)
+			names.push_back(aln.getSeqName(i));
+	}
+	RandomTreeSampler sampler(ntaxa, params.tree_gen, params);
+	if (!names.empty())
+		sampler.setTaxonNames(names);
+	int num_threads = 1;
+#ifdef _OPENMP
+	num_threads = (params.num_threads > 0) ? params.num_threads : countPhysicalCPUCores();
+#endif
+	// keep the node arrays of one batch within 64 MB
+	int batch_size = RandomTreeSampler::getBatchSize(ntaxa, (size_t)64 << 20);
+	for (int first = 0; first < params.repeated_time; first += batch_size) {
+		int count = min(batch_size, params.repeated_time - first);
+		sampler.generate(first, count, num_threads);
+		sampler.printTrees(out, num_threads);
+	}
+}
+
 void generateRandomTree(Params &params)
 {
 	if (params.sub_size < 3 && !params.aln_file) {
@@ -128,6 +167,9 @@ void generateRandomTree(Params &params)
 				str += ".collapsed";
 				out2.open(str.c_str());
 			}
+			if (params.random_tree_batch && !itree.root && !params.num_zero_len && params.tree_gen != STAR_TREE)
+				generateRandomTreeBatches(params, out);
+			else
 			for (int i = 0; i < params.repeated_time; i++) {
 				MExtTree mtree;
 				if (itree.root) {
@@ -1364,7 +1406,8 @@ void calcDistribution(Params &params) {
 	}
 }
 
-void printRFDist(ostream &out, int *rfdist, int n, int m, int rf_dist_mode) {
+template <class T>
+void printRFDist(ostream &out, T *rfdist, int n, int m, int rf_dist_mode) {
 	int i, j;
 	if (rf_dist_mode == RF_ADJACENT_PAIR) {
 		out << "XXX        ";
@@ -1436,10 +1479,69 @@ void computeRFDistExtended(const char *trees1, const char *trees2, const char *f
 
 }
 
+/**
+	compute quartet, triplet, matching split or Kuhner-Felsenstein distances
+	between trees, in the layout of computeRFDist()
+*/
+void computeTreeDist(Params &params) {
+	const char *dist_names[] = {"Robinson-Foulds", "Quartet", "Triplet", "Matching split",
+		"Kuhner-Felsenstein branch score"};
+	const char *dist_suffixes[] = {".rfdist", ".qdist", ".tripdist", ".msdist", ".kfdist"};
+	if (params.rf_dist_mode == RF_TWO_TREE_SETS_EXTENDED)
+		outError("-rf2 only supports Robinson-Foulds distance");
+
+	string filename = params.out_prefix;
+	filename += dist_suffixes[params.tree_dist];
+
+	MTreeSet trees(params.user_file, params.is_rooted, params.tree_burnin, params.tree_max_count);
+	MTreeSet *treeset2 = NULL;
+	int n = trees.size(), m = trees.size();
+	if (params.rf_dist_mode == RF_TWO_TREE_SETS) {
+		treeset2 = new MTreeSet(params.second_tree, params.is_rooted, params.tree_burnin, params.tree_max_count);
+		m = treeset2->size();
+	}
+	double *dist = new double [n*m];
+	memset(dist, 0, n*m* sizeof(double));
+
+	cout << "Computing " << dist_names[params.tree_dist] << " distances..." << endl;
+	double start_time = getRealTime();
+	trees.computeTreeDist(dist, params.tree_dist, params.rf_dist_mode, treeset2);
+	cout << "Wall-clock time: " << getRealTime() - start_time << " seconds" << endl;
+
+	// counts are exact integers, branch scores are real numbers
+	int precision = (params.tree_dist == TREE_DIST_KF) ? 6 : 0;
+	if (verbose_mode >= VB_MED) {
+		int old_precision = cout.precision(precision);
+		printRFDist(cout, dist, n, m, params.rf_dist_mode);
+		cout.precision(old_precision);
+	}
+
+	try {
+		ofstream out;
+		out.exceptions(ios::failbit | ios::badbit);
+		out.open(filename.c_str());
+		out.setf(ios::fixed);
+		out.precision(precision);
+		printRFDist(out, dist, n, m, params.rf_dist_mode);
+		out.close();
+		cout << dist_names[params.tree_dist] << " distances printed to " << filename << endl;
+	} catch (ios::failure) {
+		outError(ERR_WRITE_OUTPUT, filename);
+	}
+
+	if (treeset2) delete treeset2;
+	delete [] dist;
+}
+
 void computeRFDist(Params &params) {
 
 	if (!params.user_file) outError("User tree file not provided");
 
+	if (params.tree_dist != TREE_DIST_RF) {
+		computeTreeDist(params);
+		return;
+	}
+
 	string filename = params.out_prefix;
 	filename += ".rfdist";
 
@@ -1790,8 +1892,11 @@ class errstreambuf : public streambuf {
 public:
     void init(streambuf *fout_buf) {
         this->fout_buf = fout_buf;
-        cerr_buf = cerr.rdbuf();
-        cerr.rdbuf(this);
+        // a -jobs process starts its own log again, keep the original cerr buffer
+        if (cerr.rdbuf() != this) {
+            cerr_buf = cerr.rdbuf();
+            cerr.rdbuf(this);
+        }
         new_line = true;
     }
     
@@ -2019,7 +2124,6 @@ void processECOpd(Params &params) {
 	int i;
 	double score;
 	double *variables;
-	int threads = params.gurobi_threads;
 	params.gurobi_format=true;
 
 	string model_file,subFoodWeb,outFile;
@@ -2092,18 +2196,21 @@ void processECOpd(Params &params) {
 
 		// IP formulation
 		cout<<"Formulating an IP problem..."<<endl;
+		ILPSolver lp;
 		if(tree.rooted){
-			tree.printECOlpRooted(model_file.c_str(),tree);
+			tree.transformECOlpRooted(lp,tree);
 		} else {
-			tree.printECOlpUnrooted(model_file.c_str(),tree);
+			tree.transformECOlpUnrooted(lp,tree);
 		}
 
 		// Solve IP problem
 		cout<<"Solving the problem..."<<endl;
 		variables = new double[tree.nvar];
-		int g_return = gurobi_solve((char*)model_file.c_str(), tree.nvar, &score, variables, verbose_mode, threads);
+		int g_return = solveILP(params, lp, model_file.c_str(), tree.nvar, &score, variables);
+		if (g_return != 0)
+			outError("Something went wrong with ILP solver!");
 		if(verbose_mode == VB_MAX){
-			cout<<"GUROBI finished with "<<g_return<<" return."<<endl;
+			cout<<"ILP solver finished with "<<g_return<<" return."<<endl;
 			for(i=0; i<tree.nvar; i++)
 				cout<<"x"<<i<<" = "<<variables[i]<<endl;
 			cout<<"score = "<<score<<endl;
@@ -2141,7 +2248,8 @@ void processECOpd(Params &params) {
 		ecoInfDAG.defineK(params);
 
 		cout<<"Formulating an IP problem..."<<endl;
-		splitSYS.transformEcoLP(params, model_file.c_str(), 0);
+		ILPSolver lp;
+		splitSYS.transformEcoLP(params, lp, 0);
 		/**
 		 * (subset_size-4) - influences constraints for conserved splits.
 		 * should be less than taxaNUM in the split system.
@@ -2149,12 +2257,14 @@ void processECOpd(Params &params) {
 		 * Values different of 0 reduce the # of constraints.
 		 **/
 
-		ecoInfDAG.printInfDAG(model_file.c_str(),splitSYS,params);
+		ecoInfDAG.transformInfDAG(lp,splitSYS,params);
 		cout<<"Solving the problem..."<<endl;
 		variables = new double[ecoInfDAG.nvar];
-		int g_return = gurobi_solve((char*)model_file.c_str(), ecoInfDAG.nvar, &score, variables, verbose_mode, threads);
+		int g_return = solveILP(params, lp, model_file.c_str(), ecoInfDAG.nvar, &score, variables);
+		if (g_return != 0)
+			outError("Something went wrong with ILP solver!");
 		if(verbose_mode == VB_MAX){
-			cout<<"GUROBI finished with "<<g_return<<" return."<<endl;
+			cout<<"ILP solver finished with "<<g_return<<" return."<<endl;
 			for(i=0; i<ecoInfDAG.nvar; i++)
 				cout<<"x"<<i<<" = "<<variables[i]<<endl;
 			cout<<"score = "<<score<<endl;
@@ -2186,6 +2296,220 @@ void collapseLowBranchSupport(char *user_file, char *split_threshold_str) {
     cout << "Tree with collapsed branches written to " << outfile << endl;
 }
 
+#if !defined WIN32 && !defined _WIN32 && !defined __WIN32__
+
+/**
+	one line of the -jobs file, run as an analysis in its own process
+*/
+struct PhyloAnalysisJob {
+	/** job number, starting from 1 */
+	int id;
+	/** IQ-TREE options of the job */
+	string command;
+	/** the options split into words, params keeps pointers into them */
+	StrVector args;
+	/** parameters of the job */
+	Params params;
+	/** verbose level of the job */
+	VerboseMode verbose;
+	/** process ID while the job is running */
+	pid_t pid;
+	/** wall-clock time when the job was started */
+	double start_time;
+
+	PhyloAnalysisJob(int id, string command) : id(id), command(command), params(Params::getInstance()) {
+		verbose = VB_MIN;
+		pid = 0;
+		start_time = 0.0;
+	}
+};
+
+/**
+	run a job in the forked child process, its output only goes to its own log
+	@param job the job
+*/
+static void runPhyloAnalysisJob(PhyloAnalysisJob &job) {
+	// the process was forked from the job runner: replace its parameters, log and random stream
+	Params::getInstance() = job.params;
+	verbose_mode = job.verbose;
+	Params &params = Params::getInstance();
+	int null_fd = open("/dev/null", O_WRONLY);
+	if (null_fd >= 0) {
+		dup2(null_fd, STDOUT_FILENO);
+		close(null_fd);
+	}
+
+	Checkpoint *checkpoint = new Checkpoint;
+	string filename = (string)params.out_prefix + ".ckp.gz";
+	checkpoint->setFileName(filename);
+	bool append_log = false;
+	if (!params.ignore_checkpoint && fileExists(filename)) {
+		checkpoint->load();
+		append_log = checkpoint->hasKey("finished");
+		if (!append_log)
+			checkpoint->clear();
+	}
+
+	endLogFile();
+	_log_file = (string)params.out_prefix + ".log";
+	startLogFile(append_log);
+	if (append_log) {
+		cout << endl << "******************************************************"
+			 << endl << "CHECKPOINT: Resuming analysis from " << filename << endl << endl;
+	}
+	cout << "Job:     " << job.id << endl;
+	cout << "Command:" << job.command << endl;
+	checkpoint->get("iqtree.seed", params.ran_seed);
+	cout << "Seed:    " << params.ran_seed << " ";
+	init_random(params.ran_seed, true);
+	time_t start_time;
+	time(&start_time);
+	cout << "Time:    " << ctime(&start_time);
+#ifdef _OPENMP
+	if (params.num_threads >= 1) {
+		omp_set_num_threads(params.num_threads);
+		params.num_threads = omp_get_max_threads();
+	}
+#endif
+	cout << endl;
+	cout.precision(3);
+	cout.setf(ios::fixed);
+
+	runPhyloAnalysis(params, checkpoint);
+	delete checkpoint;
+	exit(EXIT_SUCCESS);
+}
+
+#endif
+
+/**
+	run every line of params.jobs_file as an independent analysis in its own process,
+	with its own parameters, log, checkpoint and random stream. At most
+	params.num_jobs jobs run at the same time, each with the threads given by its -nt
+	@param params program parameters
+*/
+void runPhyloAnalysisJobs(Params &params) {
+#if defined WIN32 || defined _WIN32 || defined __WIN32__
+	outError("-jobs is not supported on Windows");
+#else
+	if (MPIHelper::getInstance().getNumProcesses() > 1)
+		outError("-jobs cannot be used with MPI");
+	ifstream in;
+	in.exceptions(ios::badbit);
+	StrVector commands;
+	try {
+		in.open(params.jobs_file);
+		string line;
+		while (getline(in, line)) {
+			trimString(line);
+			if (line.empty() || line[0] == '#')
+				continue;
+			commands.push_back(" " + line);
+		}
+		in.close();
+	} catch (ios::failure) {
+		outError(ERR_READ_INPUT, params.jobs_file);
+	}
+	if (commands.empty())
+		outError("No job found in ", params.jobs_file);
+
+	// parse all jobs before starting any, so that a wrong option stops the run right away
+	int num_jobs = commands.size();
+	vector<PhyloAnalysisJob*> jobs;
+	VerboseMode runner_verbose = verbose_mode;
+	for (int i = 0; i < num_jobs; i++) {
+		PhyloAnalysisJob *job = new PhyloAnalysisJob(i+1, commands[i]);
+		job->args.push_back("iqtree");
+		stringstream ss(commands[i]);
+		string arg;
+		while (ss >> arg)
+			job->args.push_back(arg);
+		vector<char*> argv;
+		for (StrVector::iterator it = job->args.begin(); it != job->args.end(); it++)
+			argv.push_back(&(*it)[0]);
+		argv.push_back(NULL);
+		parseArg(argv.size()-1, argv.data(), job->params);
+		job->params.SSE = min(job->params.SSE, params.SSE);
+		job->verbose = verbose_mode;
+		verbose_mode = runner_verbose;
+		jobs.push_back(job);
+	}
+
+	int max_running = params.num_jobs;
+	if (max_running <= 0)
+		max_running = countPhysicalCPUCores();
+	max_running = min(max_running, num_jobs);
+	cout << "Running " << num_jobs << " jobs from " << params.jobs_file << ", "
+		 << max_running << " at the same time" << endl << endl;
+
+	int num_running = 0, num_failed = 0, num_skipped = 0;
+	int next = 0;
+	while (next < num_jobs || num_running > 0) {
+		if (next < num_jobs && num_running < max_running) {
+			PhyloAnalysisJob *job = jobs[next++];
+			string filename = (string)job->params.out_prefix + ".ckp.gz";
+			if (!job->params.ignore_checkpoint && !job->params.force_unfinished && fileExists(filename)) {
+				Checkpoint checkpoint;
+				checkpoint.setFileName(filename);
+				checkpoint.load();
+				if (checkpoint.getBool("finished")) {
+					cout << "Job " << job->id << " skipped: checkpoint " << filename
+						 << " indicates a finished run" << endl;
+					num_skipped++;
+					continue;
+				}
+			}
+			cout << "Job " << job->id << " started:" << job->command << endl;
+			// buffered output would be written again by the child
+			cout.flush();
+			job->start_time = getRealTime();
+			job->pid = fork();
+			if (job->pid < 0)
+				outError("Cannot start a process for job " + convertIntToString(job->id));
+			if (job->pid == 0)
+				runPhyloAnalysisJob(*job);
+			num_running++;
+			continue;
+		}
+
+		int status;
+		pid_t pid = waitpid(-1, &status, 0);
+		if (pid < 0)
+			outError("Lost track of the running jobs");
+		vector<PhyloAnalysisJob*>::iterator it;
+		for (it = jobs.begin(); it != jobs.end() && (*it)->pid != pid; it++);
+		if (it == jobs.end())
+			continue;
+		PhyloAnalysisJob *job = *it;
+		job->pid = 0;
+		num_running--;
+		if (WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS) {
+			cout << "Job " << job->id << " finished in " << getRealTime() - job->start_time
+				 << " seconds, log written to " << job->params.out_prefix << ".log" << endl;
+		} else {
+			num_failed++;
+			cout << "Job " << job->id << " failed (";
+			if (WIFSIGNALED(status))
+				cout << "signal " << WTERMSIG(status);
+			else
+				cout << "exit status " << WEXITSTATUS(status);
+			cout << "), see " << job->params.out_prefix << ".log" << endl;
+		}
+	}
+
+	cout << endl << num_jobs - num_failed - num_skipped << " jobs finished";
+	if (num_skipped)
+		cout << ", " << num_skipped << " skipped";
+	if (num_failed)
+		cout << ", " << num_failed << " failed";
+	cout << endl;
+	for (vector<PhyloAnalysisJob*>::iterator it = jobs.begin(); it != jobs.end(); it++)
+		delete *it;
+	if (num_failed)
+		outError("Not all jobs finished successfully");
+#endif
+}
+
 
 /********************************************************
 	main function
@@ -2545,6 +2869,12 @@ int main(int argc, char *argv[]) {
 		processNCBITree(Params::getInstance());
 	} else if (Params::getInstance().user_file && Params::getInstance().eco_dag_file) { /**ECOpd analysis*/
 		processECOpd(Params::getInstance());
+	} else if (Params::getInstance().gene_trees_file || Params::getInstance().site_concordance) {
+		computeConcordanceFactors(Params::getInstance());
+	} else if (Params::getInstance().place_ref) {
+		runPlacement(Params::getInstance());
+	} else if (Params::getInstance().jobs_file) {
+		runPhyloAnalysisJobs(Params::getInstance());
 	} else if (Params::getInstance().aln_file || Params::getInstance().partition_file) {
 		if ((Params::getInstance().siteLL_file || Params::getInstance().second_align) && !Params::getInstance().gbo_replicates)
 		{
@@ -782,11 +782,17 @@ void printOutfilesInfo(Params &params, IQTree &tree) {
 		cout << "  Site probability per rate/mix: " << params.out_prefix << ".siteprob"
 				<< endl;
 
-    if (params.print_ancestral_sequence) {
+    if (params.print_ancestral_sequence == AST_JOINT) {
+        cout << "  Ancestral sequences:           " << params.out_prefix << ".aseq" << endl;
+    } else if (params.print_ancestral_sequence) {
         cout << "  Ancestral state:               " << params.out_prefix << ".state" << endl;
 //        cout << "  Ancestral sequences:           " << params.out_prefix << ".aseq" << endl;
     }
 
+    if (params.print_subst_count) {
+        cout << "  Substitution counts:           " << params.out_prefix << ".subcount" << endl;
+    }
+
 	if (params.write_intermediate_trees)
 		cout << "  All intermediate trees:        " << params.out_prefix << ".treels"
 				<< endl;
@@ -1731,6 +1737,10 @@ void printMiscInfo(Params &params, IQTree &iqtree, double *pattern_lh) {
     if (params.print_ancestral_sequence) {
         printAncestralSequences(params.out_prefix, &iqtree, params.print_ancestral_sequence);
     }
+
+    if (params.print_subst_count) {
+        printSubstitutionCounts(params.out_prefix, &iqtree, params.print_subst_count);
+    }
     
     if (params.print_site_state_freq != WSF_NONE && !params.site_freq_file && !params.tree_freq_file) {
 		string site_freq_file = params.out_prefix;
@@ -1947,7 +1957,7 @@ void startTreeReconstruction(Params &params, IQTree* &iqtree, ModelCheckpoint &m
     }
     
     /********************* Compute pairwise distances *******************/
-    if (params.start_tree == STT_BIONJ || params.iqp || params.leastSquareBranch) {
+    if (params.start_tree == STT_BIONJ || params.start_tree == STT_BME || params.iqp || params.leastSquareBranch) {
         computeInitialDist(params, *iqtree);
     }
     
@@ -2017,7 +2027,7 @@ void runTreeReconstruction(Params &params, IQTree* &iqtree) {
     
     
     /********************* Compute pairwise distances *******************/
-    if ((params.start_tree == STT_BIONJ || params.iqp || params.leastSquareBranch) && !iqtree->root) {
+    if ((params.start_tree == STT_BIONJ || params.start_tree == STT_BME || params.iqp || params.leastSquareBranch) && !iqtree->root) {
         computeInitialDist(params, *iqtree);
     }
     
@@ -2230,7 +2240,7 @@ void runTreeReconstruction(Params &params, IQTree* &iqtree) {
 //    if ( params.start_tree != STT_BIONJ && ((params.snni && !params.iqp) || params.min_iterations == 0)) {
 //        params.compute_ml_dist = false;
 //    }
-    if ((params.min_iterations <= 1 || params.numInitTrees <= 1) && params.start_tree != STT_BIONJ)
+    if ((params.min_iterations <= 1 || params.numInitTrees <= 1) && params.start_tree != STT_BIONJ && params.start_tree != STT_BME)
         params.compute_ml_dist = false;
 
     if ((params.user_file || params.start_tree == STT_RANDOM_TREE) && params.snni && !params.iqp) {
@@ -2251,6 +2261,8 @@ void runTreeReconstruction(Params &params, IQTree* &iqtree) {
                 bool orig_rooted = iqtree->rooted;
                 iqtree->rooted = false;
                 iqtree->computeBioNJ(params, iqtree->aln, iqtree->dist_file);
+                if (params.start_tree == STT_BME)
+                    iqtree->optimizeBME(params.bme_spr_radius);
                 cout << getRealTime() - start_bionj << " seconds" << endl;
                 if (iqtree->isSuperTree())
                     iqtree->wrapperFixNegativeBranch(true);
@@ -2259,12 +2271,12 @@ void runTreeReconstruction(Params &params, IQTree* &iqtree) {
                 if (orig_rooted)
                     iqtree->convertToRooted();
                 iqtree->initializeAllPartialLh();
-                if (params.start_tree == STT_BIONJ) {
+                if (params.start_tree == STT_BIONJ || params.start_tree == STT_BME) {
                     initTree = iqtree->optimizeModelParameters(params.min_iterations==0, initEpsilon);
                 } else {
                     initTree = iqtree->optimizeBranches();
                 }
-                cout << "Log-likelihood of BIONJ tree: " << iqtree->getCurScore() << endl;
+                cout << "Log-likelihood of " << ((params.start_tree == STT_BME) ? "BME" : "BIONJ") << " tree: " << iqtree->getCurScore() << endl;
 //                cout << "BIONJ tree: " << iqtree->getTreeString() << endl;
                 iqtree->candidateTrees.update(initTree, iqtree->getCurScore());
             }
@@ -3321,8 +3333,8 @@ void runPhyloAnalysis(Params &params, Checkpoint *checkpoint) {
         tree->constraintTree.readConstraint(params.constraint_tree_file, alignment->getSeqNames());
         if (params.start_tree == STT_PLL_PARSIMONY)
             params.start_tree = STT_PARSIMONY;
-        else if (params.start_tree == STT_BIONJ)
-            outError("Constraint tree does not work with -t BIONJ");
+        else if (params.start_tree == STT_BIONJ || params.start_tree == STT_BME)
+            outError("Constraint tree does not work with -t BIONJ or -t BME");
         if (params.num_bootstrap_samples || params.gbo_replicates)
             cout << "INFO: Constraint tree will be applied to ML tree and all bootstrap trees." << endl;
     }
@@ -3427,6 +3439,214 @@ void runPhyloAnalysis(Params &params, Checkpoint *checkpoint) {
     checkpoint->dump(true);
 }
 
+/**
+    number the branches in post-order of the tree printed from the neighbor of the root leaf,
+    each branch by the node away from that neighbor
+*/
+static void numberPlacementEdges(Node *node, Node *dad, IntVector &edge_num, int &num) {
+    FOR_NEIGHBOR_IT(node, dad, it)
+        numberPlacementEdges((*it)->node, node, edge_num, num);
+    if (dad)
+        edge_num[node->id] = num++;
+}
+
+static void printPlacementTree(ostream &out, Node *node, Node *dad, IntVector &edge_num) {
+    if (!node->isLeaf() || !dad) {
+        out << "(";
+        bool first = true;
+        FOR_NEIGHBOR_IT(node, dad, it) {
+            if (!first)
+                out << ",";
+            printPlacementTree(out, (*it)->node, node, edge_num);
+            first = false;
+        }
+        out << ")";
+    } else
+        out << node->name;
+    if (dad)
+        out << ":" << node->findNeighbor(dad)->length << "{" << edge_num[node->id] << "}";
+}
+
+/**
+    @return str as a quoted JSON string, with quotes, backslashes and control characters escaped
+*/
+static string quotePlacementString(const string &str) {
+    string quoted = "\"";
+    for (string::const_iterator it = str.begin(); it != str.end(); it++) {
+        if (*it == '"' || *it == '\\') {
+            quoted += '\\';
+            quoted += *it;
+        } else if ((unsigned char)*it < 0x20) {
+            char code[8];
+            snprintf(code, sizeof(code), "\\u%04x", (unsigned char)*it);
+            quoted += code;
+        } else
+            quoted += *it;
+    }
+    return quoted + "\"";
+}
+
+/**
+    print placements in the jplace format (Matsen et al. 2012, PLoS ONE 7:e31009)
+    @param filename output file name
+    @param tree reference tree
+    @param query_names names of the query sequences
+    @param placements placements of each query from PhyloTree::placeQueries()
+*/
+static void printPlacements(const char *filename, PhyloTree *tree, StrVector &query_names,
+    vector<vector<PlacementInfo> > &placements)
+{
+    Node *top = tree->root->neighbors[0]->node;
+    IntVector edge_num(tree->nodeNum, -1);
+    int num = 0;
+    numberPlacementEdges(top, NULL, edge_num, num);
+    try {
+        ofstream out;
+        out.exceptions(ios::failbit | ios::badbit);
+        out.open(filename);
+        out.precision(10);
+        ostringstream tree_str;
+        tree_str.precision(10);
+        printPlacementTree(tree_str, top, NULL, edge_num);
+        tree_str << ";";
+        out << "{" << endl << "  \"tree\": " << quotePlacementString(tree_str.str()) << "," << endl
+            << "  \"placements\": [" << endl;
+        for (size_t q = 0; q < placements.size(); q++) {
+            out << "    {\"p\": [";
+            for (size_t i = 0; i < placements[q].size(); i++) {
+                PlacementInfo &info = placements[q][i];
+                double len = info.node->findNeighbor(info.dad)->length;
+                // the branch to the root leaf points away from top, the other branches towards it
+                bool to_root = (info.dad == tree->root);
+                out << ((i > 0) ? ", " : "") << "[" << edge_num[to_root ? info.dad->id : info.node->id]
+                    << ", " << info.logl << ", " << info.lwr << ", "
+                    << (to_root ? len - info.distal_length : info.distal_length) << ", " << info.pendant_length << "]";
+            }
+            out << "], \"n\": [" << quotePlacementString(query_names[q]) << "]}" << ((q+1 < placements.size()) ? "," : "") << endl;
+        }
+        out << "  ]," << endl
+            << "  \"metadata\": {\"invocation\": \"IQ-TREE " << iqtree_VERSION_MAJOR << "." << iqtree_VERSION_MINOR
+            << "." << iqtree_VERSION_PATCH << " -place\"}," << endl
+            << "  \"version\": 3," << endl
+            << "  \"fields\": [\"edge_num\", \"likelihood\", \"like_weight_ratio\", \"distal_length\", \"pendant_length\"]" << endl
+            << "}" << endl;
+        out.close();
+    } catch (ios::failure) {
+        outError(ERR_WRITE_OUTPUT, filename);
+    }
+}
+
+void runPlacement(Params &params) {
+    string ref_prefix = params.place_ref;
+    string tree_file = ref_prefix + ".treefile";
+    cout << endl << "===> PLACING SEQUENCES ONTO REFERENCE TREE " << tree_file << endl;
+    if (params.partition_file || !params.aln_file)
+        outError("Sequence placement requires a single alignment (use -s option)");
+    Alignment *alignment = new Alignment(params.aln_file, params.sequence_type, params.intype, params.model_name);
+
+    // reference sequences are the taxa of the reference tree, all others are queries
+    bool is_rooted = params.is_rooted;
+    MTree ref_tree(tree_file.c_str(), is_rooted);
+    StrVector ref_names;
+    ref_tree.getTaxaName(ref_names);
+    vector<bool> is_ref(alignment->getNSeq(), false);
+    IntVector ref_ids, query_ids;
+    for (auto name : ref_names) {
+        int id = alignment->getSeqID(name);
+        if (id < 0)
+            outError("Sequence " + name + " of the reference tree not found in the alignment");
+        is_ref[id] = true;
+        ref_ids.push_back(id);
+    }
+    StrVector query_names;
+    for (int id = 0; id < alignment->getNSeq(); id++)
+        if (!is_ref[id]) {
+            query_ids.push_back(id);
+            query_names.push_back(alignment->getSeqName(id));
+        }
+    if (query_ids.empty())
+        outError("No sequence to place, all sequences of the alignment are in " + tree_file);
+    cout << ref_ids.size() << " reference sequences, " << query_ids.size() << " query sequences" << endl;
+    Alignment *ref_aln = new Alignment;
+    ref_aln->extractSubAlignment(alignment, ref_ids, 0);
+
+    // model from -m or from ModelFinder of the reference analysis
+    string model_name = params.model_name;
+    if (model_name.empty()) {
+        ModelCheckpoint model_info;
+        model_info.setFileName(ref_prefix + ".model.gz");
+        if (!fileExists(model_info.getFileName()) || !model_info.load() || !model_info.getBestModel(model_name))
+            outError("Please specify the model of the reference analysis (use -m option)");
+    }
+    ref_aln->model_name = model_name;
+
+    if (params.min_branch_length <= 0.0)
+        params.min_branch_length = 1e-6;
+    PhyloTree *tree = new PhyloTree(ref_aln);
+    tree->setParams(&params);
+    tree->readTree(tree_file.c_str(), is_rooted);
+    tree->setAlignment(ref_aln);
+    tree->setRootNode(params.root);
+    ModelsBlock *models_block = readModelsDefinition(params);
+    tree->setModelFactory(new ModelFactory(params, model_name, tree, models_block));
+    delete models_block;
+    tree->setModel(tree->getModelFactory()->model);
+    tree->setRate(tree->getModelFactory()->site_rate);
+    tree->setLikelihoodKernel(params.SSE);
+    tree->setNumThreads(params.num_threads);
+    if (tree->getModel()->isSiteSpecificModel() || !tree->getModel()->isReversible() || ref_aln->seq_type == SEQ_POMO)
+        outError("Sequence placement only supports single reversible models");
+
+#ifdef _OPENMP
+    if (tree->num_threads <= 0) {
+        int bestThreads = tree->testNumThreads();
+        omp_set_num_threads(bestThreads);
+    } else
+        tree->warnNumThreads();
+#endif
+
+    // model parameters of the reference analysis
+    string ckp_file = ref_prefix + ".ckp.gz";
+    Checkpoint *ref_checkpoint = new Checkpoint;
+    bool restored = false;
+    if (fileExists(ckp_file)) {
+        ref_checkpoint->setFileName(ckp_file);
+        restored = ref_checkpoint->load();
+    }
+    if (restored) {
+        tree->getModelFactory()->setCheckpoint(ref_checkpoint);
+        tree->getModelFactory()->restoreCheckpoint();
+        cout << "Model parameters restored from " << ckp_file << endl;
+    }
+    tree->initializeAllPartialLh();
+    if (!restored) {
+        outWarning(ckp_file + " not found, model parameters are optimized on the reference tree");
+        tree->getModelFactory()->optimizeParameters(BRLEN_FIX, false, params.modelEps);
+    }
+    cout << "Model: " << tree->getModelName() << endl;
+    cout << "Log-likelihood of the reference tree: " << tree->computeLikelihood() << endl;
+
+    double start_time = getRealTime();
+    vector<vector<PlacementInfo> > placements;
+    tree->placeQueries(alignment, query_ids, params.place_keep, !params.place_fast, placements);
+    cout << query_ids.size() << " sequences placed in " << getRealTime() - start_time << " seconds" << endl;
+
+    string out_file = (string)params.out_prefix + ".jplace";
+    printPlacements(out_file.c_str(), tree, query_names, placements);
+    cout << "Placements printed to " << out_file << endl;
+
+    // the tree with the inserted queries no longer matches ref_aln, it is only printed
+    tree->insertQueries(query_names, placements);
+    out_file = (string)params.out_prefix + ".treefile";
+    tree->printTree(out_file.c_str());
+    cout << "Tree with sequences inserted at their best placements printed to " << out_file << endl;
+
+    delete tree;
+    delete ref_checkpoint;
+    delete ref_aln;
+    delete alignment;
+}
+
 void assignBranchSupportNew(Params &params) {
 	if (!params.user_file)
 		outError("No trees file provided");
@@ -3446,6 +3666,137 @@ void assignBranchSupportNew(Params &params) {
 
 
 
+void computeConcordanceFactors(Params &params) {
+	if (!params.user_file)
+		outError("Reference tree not provided (use -t option)");
+	if (params.site_concordance && !params.aln_file && !params.partition_file)
+		outError("Site concordance factors require an alignment (use -s option)");
+	cout << "Reading reference tree " << params.user_file << " ..." << endl;
+	bool is_rooted = false;
+	PhyloTree tree;
+	tree.readTree(params.user_file, is_rooted);
+	if (is_rooted)
+		outError("Reference tree must be unrooted");
+	// the NNI alternatives of a branch are only defined between four subtrees
+	if (!tree.isBifurcating())
+		outError("Reference tree must be bifurcating, please resolve its multifurcations first");
+	Alignment *alignment = NULL;
+	if (params.site_concordance) {
+		if (params.partition_file) {
+			// partitions share the taxa, sites of missing taxa become unknown states
+			SuperAlignment *super_aln = new SuperAlignment(params);
+			alignment = super_aln->concatenateAlignments();
+			delete super_aln;
+		} else {
+			alignment = new Alignment(params.aln_file, params.sequence_type, params.intype, params.model_name);
+		}
+		tree.setAlignment(alignment);
+	}
+	cout << tree.leafNum << " taxa and " << tree.branchNum << " branches" << endl;
+
+	vector<Split*> subtrees;
+	vector<Branch> branches;
+	tree.extractQuadSubtrees(subtrees, tree.root->neighbors[0]->node, NULL, &branches);
+	int nbranches = branches.size(), i;
+
+	IntVector gcf, gdf1, gdf2, decisive;
+	if (params.gene_trees_file)
+		tree.computeGeneConcordance(params.gene_trees_file, subtrees, gcf, gdf1, gdf2, decisive);
+
+	DoubleVector scf, sdf1, sdf2, sites;
+	if (params.site_concordance) {
+		cout << "Computing site concordance factors from " << params.site_concordance
+			<< " quartets per branch ..." << endl;
+		tree.computeSiteConcordance(subtrees, params.site_concordance, scf, sdf1, sdf2, sites);
+	}
+
+	string prefix = params.out_prefix;
+	string filename = prefix + ".cf.stat";
+	try {
+		ofstream out;
+		out.exceptions(ios::failbit | ios::badbit);
+		out.open(filename.c_str());
+		out << "# Concordance factors of the branches in " << params.user_file << endl
+			<< "# ID: Branch ID, as in the .cf.branch tree" << endl;
+		if (params.gene_trees_file)
+			out << "# gCF: Gene concordance factor (=gCF_N/gN %)" << endl
+				<< "# gCF_N: Number of gene trees concordant with the branch" << endl
+				<< "# gDF1: Gene discordance factor for the first NNI alternative (=gDF1_N/gN %)" << endl
+				<< "# gDF1_N: Number of gene trees concordant with the first NNI alternative" << endl
+				<< "# gDF2: Gene discordance factor for the second NNI alternative (=gDF2_N/gN %)" << endl
+				<< "# gDF2_N: Number of gene trees concordant with the second NNI alternative" << endl
+				<< "# gDFP: Gene discordance factor due to paraphyly (=gDFP_N/gN %)" << endl
+				<< "# gDFP_N: Number of gene trees decisive but discordant due to paraphyly" << endl
+				<< "# gN: Number of gene trees decisive for the branch" << endl;
+		if (params.site_concordance)
+			out << "# sCF: Site concordance factor averaged over " << params.site_concordance << " quartets" << endl
+				<< "# sDF1: Site discordance factor for the first NNI alternative" << endl
+				<< "# sDF2: Site discordance factor for the second NNI alternative" << endl
+				<< "# sN: Number of informative sites averaged over the quartets" << endl;
+		out << "# Label: Existing branch label" << endl
+			<< "# Length: Branch length" << endl
+			<< "ID";
+		if (params.gene_trees_file)
+			out << "\tgCF\tgCF_N\tgDF1\tgDF1_N\tgDF2\tgDF2_N\tgDFP\tgDFP_N\tgN";
+		if (params.site_concordance)
+			out << "\tsCF\tsDF1\tsDF2\tsN";
+		out << "\tLabel\tLength" << endl;
+		out.precision(2);
+		out << fixed;
+		for (i = 0; i < nbranches; i++) {
+			Node *child = branches[i].second;
+			out << child->id;
+			if (params.gene_trees_file) {
+				int gdfp = decisive[i] - gcf[i] - gdf1[i] - gdf2[i];
+				double scale = (decisive[i] > 0) ? 100.0 / decisive[i] : 0.0;
+				out << "\t" << gcf[i] * scale << "\t" << gcf[i] << "\t" << gdf1[i] * scale << "\t" << gdf1[i]
+					<< "\t" << gdf2[i] * scale << "\t" << gdf2[i] << "\t" << gdfp * scale << "\t" << gdfp
+					<< "\t" << decisive[i];
+			}
+			if (params.site_concordance)
+				out << "\t" << scf[i] * 100 << "\t" << sdf1[i] * 100 << "\t" << sdf2[i] * 100 << "\t" << sites[i];
+			out << "\t" << child->name << "\t" << child->findNeighbor(branches[i].first)->length << endl;
+		}
+		out.close();
+	} catch (ios::failure) {
+		outError(ERR_WRITE_OUTPUT, filename);
+	}
+	cout << "Concordance factors per branch printed to " << filename << endl;
+
+	// tree labelled with the concordance factors, then with the branch IDs
+	StrVector labels(nbranches);
+	for (i = 0; i < nbranches; i++) {
+		Node *child = branches[i].second;
+		labels[i] = child->name;
+		stringstream tmp;
+		if (!child->name.empty())
+			tmp << child->name << "/";
+		if (params.gene_trees_file)
+			tmp << ((decisive[i] > 0) ? round(gcf[i] * 1000.0 / decisive[i]) / 10 : 0.0);
+		if (params.gene_trees_file && params.site_concordance)
+			tmp << "/";
+		if (params.site_concordance)
+			tmp << round(scf[i] * 1000) / 10;
+		child->name = tmp.str();
+	}
+	filename = prefix + ".cf.tree";
+	tree.printTree(filename.c_str());
+	cout << "Tree with concordance factors written to " << filename << endl;
+	for (i = 0; i < nbranches; i++)
+		branches[i].second->name = convertIntToString(branches[i].second->id);
+	filename = prefix + ".cf.branch";
+	tree.printTree(filename.c_str());
+	cout << "Tree with branch IDs written to " << filename << endl;
+	for (i = 0; i < nbranches; i++)
+		branches[i].second->name = labels[i];
+
+	for (vector<Split*>::reverse_iterator it = subtrees.rbegin(); it != subtrees.rend(); it++)
+		delete (*it);
+	if (alignment)
+		delete alignment;
+}
+
+
 /**
  * assign split occurence frequencies from a set of input trees onto a target tree
  * NOTE: input trees must have the same taxon set
@@ -38,6 +38,15 @@ class IQTree;
 */
 void runPhyloAnalysis(Params &params, Checkpoint *checkpoint);
 
+/**
+	place the sequences of params.aln_file that are not in the reference tree
+	<params.place_ref>.treefile onto this fixed tree, with the model parameters of the
+	reference analysis, and write the placements (.jplace) and the tree with every
+	sequence inserted at its best placement (.treefile)
+	@param params program parameters
+*/
+void runPlacement(Params &params);
+
 void startTreeReconstruction(Params &params, IQTree* &iqtree,
         ModelCheckpoint &model_info);
 
@@ -63,6 +72,13 @@ void assignBootstrapSupport(const char *input_trees, int burnin, int max_count,
  */
 void assignBranchSupportNew(Params &params);
 
+/**
+ * compute gene and/or site concordance factors for the branches of the reference tree
+ * params.user_file, from params.gene_trees_file and params.site_concordance
+ * @param params program parameters
+ */
+void computeConcordanceFactors(Params &params);
+
 /**
 	Compute the consensus tree from the collection of trees from input_trees
 	and print resulting tree to output_tree. 
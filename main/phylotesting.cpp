@@ -518,8 +518,63 @@ void printSiteLhCategory(const char*filename, PhyloTree *tree, SiteLoglType wsl)
 
 }
 
+void printJointAncestralSequences(const char *out_prefix, PhyloTree *tree) {
+    string filename = (string)out_prefix + ".aseq";
+    size_t nptn = tree->getAlnNPattern();
+    size_t nsites = tree->getAlnNSite();
+    int *joint_ancestral = new int[nptn*(tree->nodeNum-tree->leafNum)];
+
+    double begin_time = getRealTime();
+    double joint_lh = tree->computeJointAncestralSequences(joint_ancestral);
+    tree->clearAllPartialLH();
+    cout << "Joint ancestral reconstruction log-likelihood: " << joint_lh
+         << " (" << getRealTime() - begin_time << " sec)" << endl;
+
+    try {
+		ofstream out;
+		out.exceptions(ios::failbit | ios::badbit);
+		out.open(filename.c_str());
+
+        NodeVector nodes;
+        tree->getInternalNodes(nodes);
+        IntVector pattern_index;
+        tree->aln->getSitePatternIndex(pattern_index);
+        int name_width = max(tree->aln->getMaxSeqNameLength(), 6) + 10;
+
+        out << nodes.size() << " " << nsites << endl;
+        for (NodeVector::iterator it = nodes.begin(); it != nodes.end(); it++) {
+            PhyloNode *node = (PhyloNode*)(*it);
+            // set node name if neccessary
+            if (node->name.empty() || !isalpha(node->name[0])) {
+                node->name = "Node" + convertIntToString(node->id-tree->leafNum+1);
+            }
+            int *joint_ancestral_node = joint_ancestral + (node->id - tree->leafNum)*nptn;
+            out.width(name_width);
+            out << left << node->name << " ";
+            for (size_t site = 0; site < nsites; site++)
+                out << tree->aln->convertStateBackStr(joint_ancestral_node[pattern_index[site]]);
+            out << endl;
+        }
+		out.close();
+		cout << "Joint ancestral sequences printed to " << filename << endl;
+	} catch (ios::failure) {
+		outError(ERR_WRITE_OUTPUT, filename);
+	}
+    delete[] joint_ancestral;
+}
+
 void printAncestralSequences(const char *out_prefix, PhyloTree *tree, AncestralSeqType ast) {
 
+    if (ast == AST_JOINT) {
+        if (tree->isSuperTree() || tree->isMixlen() || tree->getModel()->isSiteSpecificModel() ||
+            tree->aln->seq_type == SEQ_POMO) {
+            outWarning("Joint ancestral reconstruction is not supported for this model, switch to marginal reconstruction");
+        } else {
+            printJointAncestralSequences(out_prefix, tree);
+            return;
+        }
+    }
+
 //    int *joint_ancestral = NULL;
 //    
 //    if (tree->params->print_ancestral_sequence == AST_JOINT) {
@@ -634,6 +689,91 @@ void printAncestralSequences(const char *out_prefix, PhyloTree *tree, AncestralS
 
 }
 
+void printSubstitutionCounts(const char *out_prefix, PhyloTree *tree, SubstCountType sct) {
+    if (tree->isSuperTree() || tree->isMixlen() || tree->getModel()->isSiteSpecificModel() ||
+        !tree->getModel()->isReversible() || tree->aln->seq_type == SEQ_POMO) {
+        outWarning("Substitution counts are only supported for single reversible models, skip -wsc");
+        return;
+    }
+    string filename = (string)out_prefix + ".subcount";
+    bool by_type = (sct == SCT_TYPE);
+    int nptn = tree->getAlnNPattern();
+    int nsites = tree->getAlnNSite();
+    int nstates = tree->aln->num_states;
+    int ntypes = by_type ? nstates*(nstates-1) : 1;
+
+    NodeVector nodes, dads;
+    tree->getBranches(nodes, dads);
+    int nbranches = nodes.size();
+
+    // name internal nodes like the ancestral state reconstruction
+    NodeVector all_nodes;
+    tree->getInternalNodes(all_nodes);
+    for (NodeVector::iterator it = all_nodes.begin(); it != all_nodes.end(); it++)
+        if ((*it)->name.empty() || !isalpha((*it)->name[0]))
+            (*it)->name = "Node" + convertIntToString((*it)->id-tree->leafNum+1);
+    tree->getTaxa(all_nodes);
+    StrVector node_names(tree->nodeNum);
+    for (NodeVector::iterator it = all_nodes.begin(); it != all_nodes.end(); it++)
+        node_names[(*it)->id] = (*it)->name;
+    stringstream tree_str;
+    tree->printTree(tree_str, WT_BR_LEN);
+
+    double begin_time = getRealTime();
+    double total_count = 0.0;
+    try {
+        ofstream out;
+        out.exceptions(ios::failbit | ios::badbit);
+        out.open(filename.c_str(), ios::out | ios::binary);
+
+        // header
+        out.write("IQSUBCNT", 8);
+        int32_t header[] = {1, nbranches, nptn, nsites, ntypes, nstates, (int32_t)node_names.size()};
+        out.write((char*)header, sizeof(header));
+        int32_t len = tree_str.str().length();
+        out.write((char*)&len, sizeof(len));
+        out.write(tree_str.str().c_str(), len);
+        for (auto name : node_names) {
+            len = name.length();
+            out.write((char*)&len, sizeof(len));
+            out.write(name.c_str(), len);
+        }
+        IntVector pattern_index;
+        tree->aln->getSitePatternIndex(pattern_index);
+        vector<int32_t> int_buf(pattern_index.begin(), pattern_index.end());
+        out.write((char*)&int_buf[0], sizeof(int32_t)*nsites);
+        int_buf.clear();
+        for (int i = 0; i < nbranches; i++) {
+            int_buf.push_back(nodes[i]->id);
+            int_buf.push_back(dads[i]->id);
+        }
+        out.write((char*)&int_buf[0], sizeof(int32_t)*int_buf.size());
+
+        // expected counts, one branch at a time
+        bool orig_kernel_nonrev;
+        tree->initSubstitutionCounts(orig_kernel_nonrev);
+        double *ptn_count = aligned_alloc<double>((size_t)nptn*ntypes);
+        vector<float> count_buf((size_t)nptn*ntypes);
+        for (int i = 0; i < nbranches; i++) {
+            tree->computeSubstitutionCounts((PhyloNeighbor*)dads[i]->findNeighbor(nodes[i]), (PhyloNode*)dads[i],
+                by_type, ptn_count);
+            for (size_t j = 0; j < count_buf.size(); j++) {
+                count_buf[j] = ptn_count[j];
+                total_count += ptn_count[j] * tree->ptn_freq[j/ntypes];
+            }
+            out.write((char*)&count_buf[0], sizeof(float)*count_buf.size());
+        }
+        aligned_free(ptn_count);
+        tree->endSubstitutionCounts(orig_kernel_nonrev);
+
+        out.close();
+        cout << "Expected number of substitutions: " << total_count << " (" << getRealTime() - begin_time << " sec)" << endl;
+        cout << "Substitution counts printed to " << filename << endl;
+    } catch (ios::failure) {
+        outError(ERR_WRITE_OUTPUT, filename);
+    }
+}
+
 void printSiteProbCategory(const char*filename, PhyloTree *tree, SiteLoglType wsl) {
 
     if (wsl == WSL_NONE || wsl == WSL_SITE)
@@ -1387,6 +1527,120 @@ void printModelFile(ostream &fmodel, Params &params, PhyloTree *tree, ModelInfo
     }
 }
 
+/**
+    split a model name into substitution, frequency, invariant and rate components,
+    e.g. "GTR+F+I+G4" -> "GTR", "+F", "+I", "+G4"; remaining components (+ASC, ...) go to other
+    @return TRUE if the name can be decomposed, FALSE otherwise (mixture or unknown components)
+*/
+bool splitModelName(string &model_name, string &subst, string &freq, string &invar, string &rate, string &other) {
+    size_t pos = model_name.find('+');
+    subst = model_name.substr(0, pos);
+    freq = invar = rate = other = "";
+    while (pos != string::npos) {
+        size_t next = model_name.find('+', pos+1);
+        string comp = model_name.substr(pos, (next == string::npos) ? string::npos : next-pos);
+        pos = next;
+        if (comp.length() < 2)
+            return false;
+        if (comp[1] == 'F')
+            freq = comp;
+        else if (comp == "+I")
+            invar = comp;
+        else if ((comp[1] == 'G' || comp[1] == 'R') && comp.length() > 2 && isdigit(comp[2]))
+            rate = comp;
+        else if (comp == "+ASC")
+            other += comp;
+        else
+            return false;
+    }
+    return true;
+}
+
+/**
+    @param invar invariant component of a model name ("" or "+I")
+    @param rate rate component of a model name ("", "+G4", "+R3", ...)
+    @return key of the rate heterogeneity parameter that saveModelParams() keeps for such a model,
+    e.g. "RateGamma!gamma_shape", empty string without rate heterogeneity
+*/
+string rateParamKey(string invar, string rate) {
+    string sep(1, CKP_SEP);
+    if (rate.empty())
+        return invar.empty() ? "" : "RateInvar" + sep + "p_invar";
+    if (rate[1] == 'G')
+        return (invar.empty() ? "RateGamma" : "RateGammaInvar") + sep + "gamma_shape";
+    return (invar.empty() ? "RateFree" : "RateFreeInvar") + rate.substr(2) + sep + "rates";
+}
+
+/**
+    @return TRUE if the rate heterogeneity parameters of a tested model were kept in the checkpoint
+*/
+bool hasModelParams(ModelCheckpoint &model_info, string model_name, string invar, string rate) {
+    string key = rateParamKey(invar, rate);
+    return !key.empty() && model_info.hasKey(model_name + CKP_SEP + key);
+}
+
+/**
+    keep the optimised substitution rates, estimated state frequencies and rate heterogeneity
+    parameters of a tested model under its own name, so that related candidates can be initialized from them
+*/
+void saveModelParams(IQTree *iqtree, ModelCheckpoint &model_info, string &model_name) {
+    // only models that warmStartModel() can initialize from
+    if (iqtree->getModel()->isMixture() || iqtree->getRate()->isHeterotachy() || iqtree->isSuperTree())
+        return;
+    model_info.startStruct(model_name);
+    iqtree->getModel()->saveCheckpoint();
+    iqtree->getRate()->saveCheckpoint();
+    model_info.endStruct();
+}
+
+/**
+    initialize parameters of a candidate model from its closest already optimised relative
+    in the lattice of tested models: substitution rates of +R(k) from +R(k-1) and of +I+G
+    from +G, otherwise substitution rates from a variant differing only in state frequencies,
+    plus the rate heterogeneity parameters for +I and +G
+    @param iqtree tree with the candidate model initialized
+    @param model_info checkpoint with parameters of tested models
+    @param model_name candidate model name
+    @return name of the relative used, empty string if none found
+*/
+string warmStartModel(IQTree *iqtree, ModelCheckpoint &model_info, string &model_name) {
+    if (iqtree->getModel()->isMixture() || iqtree->getRate()->isHeterotachy() || iqtree->isSuperTree())
+        return "";
+    string subst, freq, invar, rate, other;
+    if (!splitModelName(model_name, subst, freq, invar, rate, other))
+        return "";
+    string relative;
+
+    // substitution rates of +R(k) from +R(k-1) and of +I+G from +G
+    if (!rate.empty() && rate[1] == 'R' && convert_int(rate.substr(2).c_str()) > 2) {
+        string prev_rate = "+R" + convertIntToString(convert_int(rate.substr(2).c_str()) - 1);
+        relative = subst + freq + invar + prev_rate + other;
+        if (!hasModelParams(model_info, relative, invar, prev_rate))
+            relative = "";
+    } else if (!invar.empty() && !rate.empty() && rate[1] == 'G') {
+        relative = subst + freq + rate + other;
+        if (!hasModelParams(model_info, relative, "", rate))
+            relative = "";
+    }
+
+    // otherwise the same rate heterogeneity with different state frequencies
+    const char *freq_names[] = {"", "+F", "+FO", "+FQ", "+F1X4", "+F3X4"};
+    for (int i = 0; relative.empty() && i < sizeof(freq_names)/sizeof(char*); i++)
+        if (freq != freq_names[i] && hasModelParams(model_info, subst + freq_names[i] + invar + rate + other, invar, rate))
+            relative = subst + freq_names[i] + invar + rate + other;
+    if (relative.empty())
+        return "";
+
+    model_info.startStruct(relative);
+    iqtree->getModel()->restoreCheckpoint();
+    // +R(k) and +I+G keep their default start: splitting a category of +R(k-1) or starting
+    // +I+G from the Gamma shape of +G leads the optimizer to worse local optima
+    if (rate.empty() || (invar.empty() && rate[1] == 'G'))
+        iqtree->getRate()->restoreCheckpoint();
+    model_info.endStruct();
+    return relative;
+}
+
 /**
     test one single model
     @param model_name model to be tested
@@ -1524,6 +1778,11 @@ string testOneModel(string &model_name, Params &params, Alignment *in_aln,
             iqtree->warnNumThreads();
         #endif
 
+        // initialize from the closest already optimised relative
+        string relative = warmStartModel(iqtree, model_info, info.name);
+        if (!relative.empty() && verbose_mode >= VB_MED)
+            cout << "Initializing " << info.name << " from " << relative << endl;
+
         iqtree->initializeAllPartialLh();
 
         for (int step = 0; step < 2; step++) {
@@ -1544,6 +1803,8 @@ string testOneModel(string &model_name, Params &params, Alignment *in_aln,
             }
         }
 
+        saveModelParams(iqtree, model_info, info.name);
+
     }
 
     info.df = iqtree->getModelFactory()->getNParameters(brlen_type);
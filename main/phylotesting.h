@@ -217,6 +217,32 @@ void printSiteStateFreq(const char*filename, PhyloTree *tree, double *state_freq
 */
 void printSiteStateFreq(const char* filename, Alignment *aln);
 
+/**
+    print expected substitution counts per branch and pattern to out_prefix.subcount, in binary
+    with native byte order:
+        char[8]     "IQSUBCNT"
+        int32[7]    version (1), #branches B, #patterns P, #sites S, #counts per pattern T,
+                    #states, #nodes N
+        int32, char tree in NEWICK format with internal node names, preceded by its length
+        N x (int32, char) node names by node ID, each preceded by its length
+        int32[S]    pattern of each site
+        int32[2B]   node IDs (node, dad) of each branch
+        float[B][P][T]  expected counts, T = 1 for all substitutions or #states*(#states-1)
+                    for substitution types i->j ordered by i and then by j != i
+    @param out_prefix output prefix
+    @param tree phylogenetic tree
+    @param sct SCT_TOTAL or SCT_TYPE
+*/
+void printSubstitutionCounts(const char *out_prefix, PhyloTree *tree, SubstCountType sct);
+
+/**
+    print joint maximum-likelihood ancestral sequences of all internal nodes in PHYLIP format
+    to out_prefix.aseq
+    @param out_prefix output prefix
+    @param tree phylogenetic tree
+*/
+void printJointAncestralSequences(const char *out_prefix, PhyloTree *tree);
+
 /**
     print ancestral sequences
     @param filename output file name
@@ -16,6 +16,10 @@
 #include "modelpomo.h"
 //#include "phylokernelmixture.h"
 #include "modelpomomixture.h"
+#include "utils/timeutil.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 using namespace std;
 
@@ -1617,25 +1621,22 @@ double ModelMixture::optimizeWeights() {
     return phylo_tree->computeLikelihood();
 }
 
-double ModelMixture::optimizeWithEM(double gradient_epsilon) {
-    size_t ptn, c;
-    size_t nptn = phylo_tree->aln->getNPattern();
-    size_t nmix = size();
-
-    double *new_prop = aligned_alloc<double>(nmix);
+PhyloTree *ModelMixture::newClassTree(bool share_memory, int num_threads) {
     PhyloTree *tree = new PhyloTree;
 
-    // attach memory to save space
-    tree->central_partial_lh = phylo_tree->central_partial_lh;
-    tree->central_scale_num = phylo_tree->central_scale_num;
-    tree->central_partial_pars = phylo_tree->central_partial_pars;
+    if (share_memory) {
+        // attach memory to save space
+        tree->central_partial_lh = phylo_tree->central_partial_lh;
+        tree->central_scale_num = phylo_tree->central_scale_num;
+        tree->central_partial_pars = phylo_tree->central_partial_pars;
+    }
 
     tree->copyPhyloTree(phylo_tree);
     tree->optimize_by_newton = phylo_tree->optimize_by_newton;
     tree->setParams(phylo_tree->params);
     tree->setLikelihoodKernel(phylo_tree->sse);
-    tree->setNumThreads(phylo_tree->num_threads);
-    
+    tree->setNumThreads(num_threads);
+
     // initialize model
     ModelFactory *model_fac = new ModelFactory();
     model_fac->joint_optimize = phylo_tree->params->optimize_model_rate_joint;
@@ -1648,6 +1649,46 @@ double ModelMixture::optimizeWithEM(double gradient_epsilon) {
     model_fac->site_rate = site_rate;
     tree->model_factory = model_fac;
     tree->setParams(phylo_tree->params);
+    return tree;
+}
+
+double ModelMixture::optimizeWithEM(double gradient_epsilon) {
+    size_t c;
+    int nptn = phylo_tree->aln->getNPattern();
+    size_t nmix = size();
+    int num_threads = max(phylo_tree->num_threads, 1);
+
+    double *new_prop = aligned_alloc<double>(nmix);
+
+    // classes whose parameters are optimized in the M-step
+    IntVector opt_classes;
+    for (c = 0; c < nmix; c++)
+        if (at(c)->getNDim() > 0)
+            opt_classes.push_back(c);
+
+    // the classes are optimized concurrently on one tree per thread, each with its own
+    // partial likelihoods, as far as memory allows. The tree copies are made once and reused
+    // by all EM steps, except for mixed branch lengths that need a copy per class.
+    int num_trees = 1;
+    if (!phylo_tree->isMixlen() && num_threads > 1 && opt_classes.size() > 1) {
+        num_trees = min(num_threads, (int)opt_classes.size());
+        uint64_t total_mem = getMemorySize();
+        uint64_t tree_mem = phylo_tree->getMemoryRequired() / (phylo_tree->getRate()->getNRate() * nmix);
+        uint64_t free_mem = total_mem - min(total_mem, phylo_tree->getMemoryRequired());
+        num_trees = max(1, min(num_trees, (int)(1 + free_mem/2/max(tree_mem, (uint64_t)1))));
+    }
+    vector<PhyloTree*> trees;
+    for (int i = 0; i < num_trees; i++)
+        trees.push_back(newClassTree(i == 0, (num_trees > 1) ? 1 : num_threads));
+    if (verbose_mode >= VB_MED && num_trees > 1)
+        cout << "Optimizing " << opt_classes.size() << " mixture classes on " << num_trees << " threads" << endl;
+
+    // E-step in fixed blocks of patterns, added up in block order
+    // so that the weights do not depend on the number of threads
+    int block_size = computeReductionPacketSize(nptn, 1);
+    int num_blocks = (nptn+block_size-1)/block_size;
+    DoubleVector block_prop(num_blocks*nmix);
+
     double prev_score = -DBL_MAX, score;
 
 //    int num_steps = 100000; //SC
@@ -1662,27 +1703,38 @@ double ModelMixture::optimizeWithEM(double gradient_epsilon) {
             break;
         prev_score = score;
 
-        memset(new_prop, 0, nmix*sizeof(double));
-
         // E-step
         // decoupled weights (prop) from _pattern_lh_cat to obtain L_ci and compute pattern likelihood L_i
-        for (ptn = 0; ptn < nptn; ptn++) {
-            double *this_lk_cat = phylo_tree->_pattern_lh_cat + ptn*nmix;
-            double lk_ptn = phylo_tree->ptn_invar[ptn];
-//            double lk_ptn = 0.0;
-            for (c = 0; c < nmix; c++) {
-                lk_ptn += this_lk_cat[c];
-            }
-            ASSERT(lk_ptn != 0.0);
-            lk_ptn = phylo_tree->ptn_freq[ptn] / lk_ptn;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) num_threads(num_threads) if (num_threads > 1)
+#endif
+        for (int block = 0; block < num_blocks; block++) {
+            double *my_prop = &block_prop[block*nmix];
+            memset(my_prop, 0, nmix*sizeof(double));
+            int ptn_upper = min(nptn, (block+1)*block_size);
+            for (int ptn = block*block_size; ptn < ptn_upper; ptn++) {
+                double *this_lk_cat = phylo_tree->_pattern_lh_cat + ptn*nmix;
+                double lk_ptn = phylo_tree->ptn_invar[ptn];
+//                double lk_ptn = 0.0;
+                for (size_t m = 0; m < nmix; m++) {
+                    lk_ptn += this_lk_cat[m];
+                }
+                ASSERT(lk_ptn != 0.0);
+                lk_ptn = phylo_tree->ptn_freq[ptn] / lk_ptn;
 
-            // transform _pattern_lh_cat into posterior probabilities of each category
-            for (c = 0; c < nmix; c++) {
-                this_lk_cat[c] *= lk_ptn;
-                new_prop[c] += this_lk_cat[c];
+                // transform _pattern_lh_cat into posterior probabilities of each category
+                for (size_t m = 0; m < nmix; m++) {
+                    this_lk_cat[m] *= lk_ptn;
+                    my_prop[m] += this_lk_cat[m];
+                }
             }
         }
 
+        memset(new_prop, 0, nmix*sizeof(double));
+        for (int block = 0; block < num_blocks; block++)
+            for (c = 0; c < nmix; c++)
+                new_prop[c] += block_prop[block*nmix+c];
+
         // M-step, update weights according to (*)
 
         bool converged = !fix_prop;
@@ -1728,21 +1780,32 @@ double ModelMixture::optimizeWithEM(double gradient_epsilon) {
             */
         }
 
-        // now optimize model one by one
-        for (c = 0; c < nmix; c++) if (at(c)->getNDim() > 0) {
-            tree->copyPhyloTreeMixlen(phylo_tree, c);
+        // now optimize the classes, concurrently if there are several trees
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) num_threads(num_trees) if (num_trees > 1)
+#endif
+        for (int i = 0; i < opt_classes.size(); i++) {
+#ifdef _OPENMP
+            PhyloTree *tree = trees[omp_get_thread_num()];
+#else
+            PhyloTree *tree = trees[0];
+#endif
+            int cls = opt_classes[i];
+            if (phylo_tree->isMixlen())
+                tree->copyPhyloTreeMixlen(phylo_tree, cls);
             ModelMarkov *subst_model;
-            subst_model = at(c);
+            subst_model = at(cls);
             tree->setModel(subst_model);
             subst_model->setTree(tree);
-            model_fac->model = subst_model;
+            tree->getModelFactory()->model = subst_model;
 
-            // initialize likelihood
+            // initialize likelihood, the tree may hold partial likelihoods of another class
             tree->initializeAllPartialLh();
+            tree->clearAllPartialLH();
             // copy posterior probability into ptn_freq
             tree->computePtnFreq();
-            double *this_lk_cat = phylo_tree->_pattern_lh_cat+c;
-            for (ptn = 0; ptn < nptn; ptn++)
+            double *this_lk_cat = phylo_tree->_pattern_lh_cat+cls;
+            for (int ptn = 0; ptn < nptn; ptn++)
                 tree->ptn_freq[ptn] = this_lk_cat[ptn*nmix];
             subst_model->optimizeParameters(gradient_epsilon);
             // reset subst model
@@ -1756,11 +1819,12 @@ double ModelMixture::optimizeWithEM(double gradient_epsilon) {
     }
 
     // deattach memory
-    tree->central_partial_lh = NULL;
-    tree->central_scale_num = NULL;
-    tree->central_partial_pars = NULL;
+    trees[0]->central_partial_lh = NULL;
+    trees[0]->central_scale_num = NULL;
+    trees[0]->central_partial_pars = NULL;
 
-    delete tree;
+    for (int i = 0; i < num_trees; i++)
+        delete trees[i];
     aligned_free(new_prop);
     score = phylo_tree->computeLikelihood();
     phylo_tree->clearAllPartialLH();
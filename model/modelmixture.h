@@ -185,6 +185,14 @@ public:
     */
     double optimizeWithEM(double gradient_epsilon);
 
+    /**
+        create a tree to optimize the parameters of one mixture class in the M-step of
+        optimizeWithEM(), with its own model factory and a single rate category
+        @param share_memory TRUE to use the partial likelihood memory of phylo_tree
+        @param num_threads number of threads of the likelihood kernels
+        @return the new tree
+    */
+    PhyloTree *newClassTree(bool share_memory, int num_threads);
 
     /** 
         set number of optimization steps
@@ -397,495 +397,160 @@ void ECOpd::readDAG(istream &in) {
 /* =========================================================================================================
  *	ROOTED TREES
  * =========================================================================================================*/
-void ECOpd::printECOlpRooted(const char* fileOUT,ECOpd &tree){
-	ofstream out;
-	out.exceptions(ios::failbit | ios::badbit);
-	out.open(fileOUT);
+void ECOpd::transformECOlpRooted(ILPSolver &lp, ECOpd &tree){
 	int m,i,j;
-	//int step=0,step_all=0;
-	//cout<<"# of species to conserve:"<<nspecies<<endl;
 	int nspecies=k;
 	nspecies++; //you have to include also one place for the root
-//----------------------------------------------------------------------------------------------------------------
-// Dealing with d levels
-//----------------------------------------------------------------------------------------------------------------
-// max d level-------------------------------------------------
-	int maxlevel;
-	maxlevel=levelDAG[0]; //i=0;
-// 	cout<<"DAG levels:"<<endl;
-// 	cout<<"LevelDAG[0]:"<<levelDAG[0]<<endl;
- 	for(i=1;i<nvar;i++){
-//  		//cout<<"LevelDAG["<<i<<"]:"<<levelDAG[i]<<endl;
- 		if(maxlevel<levelDAG[i])
- 			maxlevel=levelDAG[i];
-	}
-	//cout<<"max DAG level:"<<maxlevel+1<<endl;
-//# of species at each d level---------------------------------
-// 	int hit=0;
-// 	hvec.resize(maxlevel+1,0);
-// 	while(hit<=maxlevel){
-// 		for(i=0;i<nvar;i++)
-// 			if(levelDAG[i]==hit) hvec[hit]++;
-// 		hit++;
-// 	}
-	/*cout<<"# of species at each level"<<endl;
-	for(i=0;i<hvec.size();i++)
-		cout<<hvec[i]<<" ";
-	cout<<endl;
-	*/
 
  /****************************************************************************************************************
   * Integer Programming formulation
   ****************************************************************************************************************/
 //----------------------------------------------------------------------------------------------------------------
-// Printing objective function
+// Variables: x for species, y for branches of the PhyloTree
+//----------------------------------------------------------------------------------------------------------------
+	IntVector x(nvar), y(tree.branchNum);
+	for(j=0;j<nvar;j++)
+		x[j]=lp.addVariable("x"+convertIntToString(j),0.0,1.0,true);
+	for(i=0;i<tree.branchNum;i++)
+		y[i]=lp.addVariable("y"+convertIntToString(i),0.0,1.0,true);
+//----------------------------------------------------------------------------------------------------------------
+// Objective function
 //----------------------------------------------------------------------------------------------------------------
-	out<<"Maximize"<<endl;
+	lp.maximize=true;
 	tree.getBranchOrdered(nodes1,nodes2);
 	for(i=0;i<tree.branchNum;i++){
 		nodes1[i]->findNeighbor(nodes2[i])->id=i;
 		nodes2[i]->findNeighbor(nodes1[i])->id=i;
-		if(i<tree.branchNum-1)
-			out<<nodes1[i]->findNeighbor(nodes2[i])->length<<" "<<"y"<<i<<" + ";
-		else
-			out<<nodes1[i]->findNeighbor(nodes2[i])->length<<" "<<"y"<<i<<endl;
-		}
-//----------------------------------------------------------------------------------------------------------------
-// Printing constraints
+		lp.obj_coef[y[i]]+=nodes1[i]->findNeighbor(nodes2[i])->length;
+	}
 //----------------------------------------------------------------------------------------------------------------
-	out<<"Subject To"<<endl;
+// Constraints
 //----------------------------------------------------------------------------------------------------------------
 // 1. constraint: species present in the set
-	if(initialTaxa.size()!=0)
-		for(m=0;m<initialTaxa.size();m++)
-			out<<"x"<<findSpeciesIDname(&initialTaxa[m])<<" = 1"<<endl;
+	for(m=0;m<initialTaxa.size();m++){
+		ILPConstraint row('E',1.0);
+		row.addTerm(x[findSpeciesIDname(&initialTaxa[m])],1.0);
+		lp.addConstraint(row);
+	}
 //----------------------------------------------------------------------------------------------------------------
 // 2. constraint: the sum of all species is <= k
-	for(i=0;i<nvar-1;i++)
-		out<<"x"<<i<<" + ";
-	out<<"x"<<nvar-1<<" <= "<<nspecies<<endl;
-
-//----------------------------------------------------------------------------------------------------------------
-// 3. constraint: the sum of leaves in the DAG is >= to 1
-// 	SpeciesNUM++;
-// 	int nleafDAG=0,nleaf=0;
-// 	for(i=0;i<SpeciesNUM;i++)
-// 		if(levelDAG[i]==0)
-// 			nleafDAG++;
-// 		for(j=0;j<SpeciesNUM;j++){
-// 			if(taxaDAG[j]->degree()==0){
-// 				nleaf++;
-// 			if(nleaf<nleafDAG)
-// 				out<<"x"<<taxaDAG[j]->id<<" + ";
-// 			else
-// 				out<<"x"<<taxaDAG[j]->id<<" >= 1"<<endl;
-// 			}
-// 		}
-
+	{
+		ILPConstraint row('L',nspecies);
+		for(i=0;i<nvar;i++)
+			row.addTerm(x[i],1.0);
+		lp.addConstraint(row);
+	}
 //----------------------------------------------------------------------------------------------------------------
 // 4. constraints: SURVIVAL CONSTRAINT
-	if(weighted){
-		//weighted food web: sum of weights is greater than a given threshold--------------------------------
-		for(j=0;j<nvar;j++)
-			if(taxaDAG[j]->degree()>0){//the ones that have children in the DAG
-				for(i=0;i<taxaDAG[j]->degree();i++){
-					if(i<taxaDAG[j]->degree()-1){
-						out<<taxaDAG[j]->neighbors[i]->length<<" x"<<taxaDAG[j]->neighbors[i]->node->id<<" + ";
-					} else {
-						out<<taxaDAG[j]->neighbors[i]->length<<" x"<<taxaDAG[j]->neighbors[i]->node->id<<" - "<<T<<" x"<<taxaDAG[j]->id<<" >= 0"<<endl;
-					}
-				}
-			}
-	}else{
-		//for each predator the sum of children in the DAG is >= to its value-------------------------------
-		for(j=0;j<nvar;j++)
-			if(taxaDAG[j]->degree()>0){//the ones that have children in the DAG
-				for(i=0;i<taxaDAG[j]->degree();i++){
-					if(i<taxaDAG[j]->degree()-1){
-						out<<"x"<<taxaDAG[j]->neighbors[i]->node->id<<" + ";
-					} else {
-						out<<"x"<<taxaDAG[j]->neighbors[i]->node->id<<" - x"<<taxaDAG[j]->id<<" >= 0"<<endl;
-					}
-				}
-			}
-	}
+	for(j=0;j<nvar;j++)
+		if(taxaDAG[j]->degree()>0){//the ones that have children in the DAG
+			ILPConstraint row('G',0.0);
+			for(i=0;i<taxaDAG[j]->degree();i++)
+				if(weighted)//weighted food web: sum of weights is greater than a given threshold
+					row.addTerm(x[taxaDAG[j]->neighbors[i]->node->id],taxaDAG[j]->neighbors[i]->length);
+				else//for each predator the sum of children in the DAG is >= to its value
+					row.addTerm(x[taxaDAG[j]->neighbors[i]->node->id],1.0);
+			row.addTerm(x[taxaDAG[j]->id],weighted ? -T : -1.0);
+			lp.addConstraint(row);
+		}
 //----------------------------------------------------------------------------------------------------------------
 // 5. constraints for edges in the PhyloTree
-	//cout<<"root "<<tree.root->id<<endl;
+	//constraints: SUM{Xv in T(e)}(Xv)>=Ye -----------------------------------------------
 	vector<int> taxaBelow;
-	for(i=0;i<tree.branchNum;i++)
-		//constraints: SUM{Xv in T(e)}(Xv)>=Ye -----------------------------------------------
+	for(i=0;i<tree.branchNum;i++){
+		ILPConstraint row('G',0.0);
 		if((nodes1[i]->isLeaf()) && (nodes1[i]!=root))
-			out<<"x"<<nodes1[i]->id<<" - y"<<nodes1[i]->findNeighbor(nodes2[i])->id<<" >= 0"<<endl;
+			row.addTerm(x[nodes1[i]->id],1.0);
 		else {
 			tree.getTaxaID(taxaBelow,nodes2[i],nodes1[i]);
 			for(j=0;j<taxaBelow.size();j++)
-				if(j<taxaBelow.size()-1)
-					out<<"x"<<taxaBelow[j]<<" + ";
-				else
-					out<<"x"<<taxaBelow[j];
+				row.addTerm(x[taxaBelow[j]],1.0);
 			taxaBelow.clear();
-			out<<" - y"<<nodes1[i]->findNeighbor(nodes2[i])->id<<" >= 0"<<endl;
 		}
-//----------------------------------------------------------------------------------------------------------------
-// Printing bounds for variables
-//----------------------------------------------------------------------------------------------------------------
-	out<<"Bounds"<<endl;
-	for(j=0;j<nvar;j++)
-			out<<"0 <= x"<<taxaDAG[j]->id<<" <= 1"<<endl;
-	for(i=0;i<tree.branchNum;i++)
-		out<<"0 <= y"<<i<<" <= 1"<<endl;
-//----------------------------------------------------------------------------------------------------------------
-// Printing variables (For IP model)
-//----------------------------------------------------------------------------------------------------------------
-	out<<"Generals"<<endl;
-	for(j=0;j<nvar;j++)
-		out<<"x"<<taxaDAG[j]->id<<" ";
-	for(i=0;i<tree.branchNum;i++)
-		out<<"y"<<i<<" ";
-//----------------------------------------------------------------------------------------------------------------
-	out<<endl<<"End"<<endl;
-	out.close();
+		row.addTerm(y[nodes1[i]->findNeighbor(nodes2[i])->id],-1.0);
+		lp.addConstraint(row);
+	}
 }
 
 /* =========================================================================================================
  *	UNROOTED TREES and d-levels
  * =========================================================================================================*/
-void ECOpd::printECOlpUnrooted(const char* fileOUT,ECOpd &tree){
-	ofstream myfile;
-	string str_out = fileOUT;
-	string str_out_1,str_out_2;
-	//myfile.open(fileOUT);
-
-	int i,m,j,step=0,step_all=0;
+void ECOpd::transformECOlpUnrooted(ILPSolver &lp, ECOpd &tree){
+	int i,m,j;
 	int nspecies=k;
-//---------------------------------------------Dealing with d levels---------------------------------------------
-	{
-//--------------------------------------------------max d level--------------------------------------------------
-	int maxlevel;
-	maxlevel=levelDAG[0];
-// 	cout<<"DAG levels:"<<endl;
-// 	cout<<"LevelDAG[0]:"<<levelDAG[0]<<endl;
-	for(i=1;i<TaxaNUM;i++){
-// 		cout<<"LevelDAG["<<i<<"]:"<<levelDAG[i]<<endl;
-		if(maxlevel<levelDAG[i])
-			maxlevel=levelDAG[i];
-	}
-// 	cout<<"max DAG level:"<<maxlevel+1<<endl;
-//-----------------------------------------------------end-------------------------------------------------------
-
-
-//---------------------------------------generating first vector of d levels-------------------------------------
-	generateFirstMultinorm(dvec, nspecies-1, maxlevel+1); //nspecies-1 - we are saving at least 1 place at d[0] level
-							      //maxlevel+1 - as we start counting levels from 0 one
-// 	cout<<"vector of d levels:"<<endl;
-// 	dvec[0]++;
-// 	for(i=0;i<dvec.size();i++)
-// 		cout<<dvec[i]<<" ";
-// 	cout<<endl;
-// 	dvec[0]--;
-//-----------------------------------------------------end-------------------------------------------------------
-
-
-//------------------------------------------# of species at each d level-----------------------------------------
-	int hit=0;
-	hvec.resize(maxlevel+1,0);
-	while(hit<=maxlevel){
-		for(i=0;i<TaxaNUM;i++)
-			if(levelDAG[i]==hit) hvec[hit]++;
-		hit++;
-	}
-	/*cout<<"# of species at each level"<<endl;
-	for(i=0;i<hvec.size();i++)
-		cout<<hvec[i]<<" ";
-	cout<<endl;
-	*/
-//-----------------------------------------------------end-------------------------------------------------------
-	}
-//-----------------------------------------END:Dealing with d levels---------------------------------------------
-
-	int DAGlevels=1,check_print=1;
-
-//--------------------------------------Printing all cases for different d levels--------------------------------
-	while(DAGlevels==1) {
-		step_all++;
-		//cout<<endl<<"STEP ALL:"<<step_all<<endl;
-// 		cout<<"vector of d levels:"<<endl;
- 		dvec[0]++;
-// 		for(i=0;i<dvec.size();i++)
-// 			cout<<dvec[i]<<" ";
-// 		cout<<endl;
-
-//--------------------------------------CHECKPOINT:is vector d good or we should ignore it?----------------------
-{
-//Print only if d[i] is <= than the # of species on this level, otherwise it's a waste of places for conservation
-		check_print=1;
-		for(i=0;i<hvec.size();i++){
-			//cout<<"dvec["<<i<<"]="<<dvec[i]<<"   hvec["<<i<<"]="<<hvec[i]<<endl;
-			if(dvec[i]>hvec[i])
-				check_print=0;
-		}
-		//cout<<"CHECKPOINT="<<check_print<<endl<<endl;
 
-		check_print=1;//IGNORE checkpoint: when only one model for each run is needed, used together with DAGlevels=0; (below)
-
-		if(check_print==1){
-			step++;
-			//cout<<"Vector d is SUITABLE, step="<<step<<endl;
-			str_out_1 = convertIntToString(step);
-			str_out_2 = str_out  + str_out_1 + ".lp";
-			//myfile.open(str_out_2.c_str());
-
-			//str_out_2 = str_out + "lp";		//IGNORED d levels: only one model for each run
-			str_out_2 = str_out;
-			myfile.open(str_out_2.c_str());
-
-/**----------------------------------------------Printing objective function---------------------------------------*/
-	{
+//----------------------------------------------------------------------------------------------------------------
+// Variables: x for species, y for branches of the PhyloTree
+//----------------------------------------------------------------------------------------------------------------
+	IntVector x(nvar), y(tree.branchNum);
+	for(j=0;j<nvar;j++)
+		x[j]=lp.addVariable("x"+convertIntToString(j),0.0,1.0,true);
+	for(i=0;i<tree.branchNum;i++)
+		y[i]=lp.addVariable("y"+convertIntToString(i),0.0,1.0,true);
 
-			myfile<<"Maximize"<<endl;
-			tree.getBranchOrdered(nodes1,nodes2);
-	{
-			for(i=0;i<tree.branchNum;i++){
-				nodes1[i]->findNeighbor(nodes2[i])->id=i;
-				nodes2[i]->findNeighbor(nodes1[i])->id=i;
-				if(i<tree.branchNum-1)
-					myfile<<nodes1[i]->findNeighbor(nodes2[i])->length<<" "<<"y"<<i<<" + ";
-				else
-					myfile<<nodes1[i]->findNeighbor(nodes2[i])->length<<" "<<"y"<<i<<endl;
-			}
-	}
-			//IDEA: objective**********************************************************************
-	{
-// 			double lambda_sum=0;
-// 			for(i=0;i<tree.branchNum;i++){
-// 				nodes1[i]->findNeighbor(nodes2[i])->id=i;
-// 				nodes2[i]->findNeighbor(nodes1[i])->id=i;
-// 				lambda_sum = lambda_sum + nodes1[i]->findNeighbor(nodes2[i])->length;
-// 				if(i<tree.branchNum-1)
-// 					myfile<<nodes1[i]->findNeighbor(nodes2[i])->length<<" "<<"y"<<i<<" + ";
-// 				else
-// 					myfile<<nodes1[i]->findNeighbor(nodes2[i])->length<<" "<<"y"<<i;
-// 			}
-//
-// 			for(j=0;j<tree.leafNum;j++)
-// 				if(taxaDAG[j]->degree()>0)
-// 					myfile<<" - "<<lambda_sum<<" z"<<j;
-// 			myfile<<endl;
+/**----------------------------------------------Objective function------------------------------------------------*/
+	lp.maximize=true;
+	tree.getBranchOrdered(nodes1,nodes2);
+	for(i=0;i<tree.branchNum;i++){
+		nodes1[i]->findNeighbor(nodes2[i])->id=i;
+		nodes2[i]->findNeighbor(nodes1[i])->id=i;
+		lp.obj_coef[y[i]]+=nodes1[i]->findNeighbor(nodes2[i])->length;
 	}
-			//*************************************************************************************
-}
 
-/**--------------------------------------------------Printing constraints------------------------------------------*/
-	{
-			myfile<<"Subject To"<<endl;
-			int c=0;
+/**--------------------------------------------------Constraints---------------------------------------------------*/
 /**species present in the set-----------------------------------------------*/
-	if(initialTaxa.size()!=0)
-		for(m=0;m<initialTaxa.size();m++)
-			myfile<<"x"<<findSpeciesIDname(&initialTaxa[m])<<" = 1"<<endl;
+	for(m=0;m<initialTaxa.size();m++){
+		ILPConstraint row('E',1.0);
+		row.addTerm(x[findSpeciesIDname(&initialTaxa[m])],1.0);
+		lp.addConstraint(row);
+	}
 /**the sum of all species is <= k-------------------------------------------------------------------*/
 	{
-			NodeVector taxaTree;
-			tree.getTaxa(taxaTree);
-			myfile<<"c"<<c<<": ";
-			c++;
-
-			for(i=0;i<nvar-1;i++)
-				myfile<<"x"<<i<<" + ";
-			myfile<<"x"<<nvar-1<<" <= "<<nspecies<<endl;
-	}
-/**the sum of leaves in the DAG is >= to 1----------------------------------------------------------*/
-	{ //it might be incorrect, so check it out before using...
-// 			myfile<<"c"<<c<<": ";
-// 			c++;
-// 			int nleafDAG=0,nleaf=0;
-// 			for(i=0;i<TaxaNUM;i++)
-// 				if(levelDAG[i]==0)
-// 					nleafDAG++;
-// 			for(j=0;j<TaxaNUM;j++){
-// 				if(taxaDAG[j]->degree()==0){
-// 				nleaf++;
-// 				if(nleaf<nleafDAG)
-// 					myfile<<"x"<<taxaDAG[j]->id<<" + ";
-// 				else
-// 					myfile<<"x"<<taxaDAG[j]->id<<" >= 1"<<endl;
-// 				}
-// 			}
+		ILPConstraint row('L',nspecies);
+		for(i=0;i<nvar;i++)
+			row.addTerm(x[i],1.0);
+		lp.addConstraint(row);
 	}
 
-//constraints: SURVIVAL CONSTRAINT
-
-if(weighted){//weighted food web: sum of weights is greater than a given threshold--------------------------------
-
-	for(j=0;j<nvar;j++){
-		if(taxaDAG[j]->degree()>0){//the ones that have children in the DAG
-			for(i=0;i<taxaDAG[j]->degree();i++)
-				if(i<taxaDAG[j]->degree()-1)
-					myfile<<taxaDAG[j]->neighbors[i]->length<<" x"<<taxaDAG[j]->neighbors[i]->node->id<<" + ";
-				else
-					myfile<<taxaDAG[j]->neighbors[i]->length<<" x"<<taxaDAG[j]->neighbors[i]->node->id<<" - "<<T<<" x"<<taxaDAG[j]->id<<" >= 0"<<endl;
-			}
-
-	}
-}
-else {//for each predator the sum of children in the DAG is >= to its value-----------------------------
-			for(j=0;j<TaxaNUM;j++){
-				if(taxaDAG[j]->degree()>0){//the ones that have children in the DAG
-					myfile<<"c"<<c<<": ";
-					c++;
-					for(i=0;i<taxaDAG[j]->degree();i++)
-						if(i<taxaDAG[j]->degree()-1)
-							myfile<<"x"<<taxaDAG[j]->neighbors[i]->node->id<<" + ";
-						else
-							myfile<<"x"<<taxaDAG[j]->neighbors[i]->node->id<<" - x"<<taxaDAG[j]->id<<" >= 0"<<endl;
-				}
+	if(weighted){//weighted food web: sum of weights is greater than a given threshold--------------------------------
+		for(j=0;j<nvar;j++)
+			if(taxaDAG[j]->degree()>0){//the ones that have children in the DAG
+				ILPConstraint row('G',0.0);
+				for(i=0;i<taxaDAG[j]->degree();i++)
+					row.addTerm(x[taxaDAG[j]->neighbors[i]->node->id],taxaDAG[j]->neighbors[i]->length);
+				row.addTerm(x[taxaDAG[j]->id],-T);
+				lp.addConstraint(row);
 			}
-
-
-}
-			//IDEA:new variables Z'tas*************************************************************
-	{
-
-// 			for(j=0;j<tree.leafNum;j++){
-// 				if(taxaDAG[j]->degree()>0){
-// 					myfile<<"c"<<c<<": ";
-// 					c++;
-// 					myfile<<"z"<<j<<" - x"<<j<<" >= 0"<<endl;
-// 					for(i=0;i<taxaDAG[j]->degree();i++){
-// 						myfile<<"c"<<c<<": ";
-// 						c++;
-// 						myfile<<"z"<<j<<" - x"<<taxaDAG[j]->neighbors[i]->node->id<<" >= 0"<<endl;
-// 					}
-// 				}
-// 			}
-
-}
-			//*************************************************************************************
-
-//d levels----------------------------------------------------------------------------------------
-	{
-
-
-// 			int hit=0;
-// 			int h=0;
-// 			int maxlevel=dvec.size()-1;
-// 			while(hit<=maxlevel){
-// 				myfile<<"c"<<c<<": ";
-// 				c++;
-// 				h=0;
-// 				for(i=0;i<SpeciesNUM;i++)
-// 					if(levelDAG[i]==hit){
-// 						h++;
-// 						if(h<hvec[hit])
-// 							myfile<<"x"<<i<<" + ";
-// 						else {
-// 							//myfile<<"x"<<i<<" = "<<dvec[hit];
-// 							myfile<<"x"<<i<<" - d"<<hit<<" = 0";
-//  							if(step==1)
-//  								cout<<"dvec["<<hit<<"]="<<dvec[hit]<<endl;
-// 						}
-// 					}
-// 				myfile<<endl;
-// 				hit++;
-// 			}
-// 			myfile<<"c"<<c<<": ";
-// 			c++;
-// 			for(i=0;i<=maxlevel;i++){
-// 				if(i<maxlevel)
-// 					myfile<<"d"<<i<<" + ";
-// 				else
-// 					myfile<<"d"<<i<<" = "<<nspecies<<endl;
-// 			}
-
-
-}
-
-//for edges in the PhyloTree--------------------------------------------------------------------------
-	{
-
-			vector<int> taxaBelow;
-			for(i=0;i<tree.branchNum;i++){
-
-		//constraints: SUM{Xv in T(e)}(Xv)>=Ye -----------------------------------------------
-				myfile<<"c"<<c<<": ";
-				c++;
-				tree.getTaxaID(taxaBelow,nodes2[i],nodes1[i]);
-				for(j=0;j<taxaBelow.size();j++)
-					if(j<taxaBelow.size()-1)
-						myfile<<"x"<<taxaBelow[j]<<" + ";
-					else
-						myfile<<"x"<<taxaBelow[j];
-				taxaBelow.clear();
-				myfile<<" - y"<<nodes1[i]->findNeighbor(nodes2[i])->id<<" >= 0"<<endl;
-		//constraints: SUM{Xv not in T(e)}(Xv)>=Ye -------------------------------------------
-				myfile<<"c"<<c<<": ";
-				c++;
-				tree.getTaxaID(taxaBelow,nodes1[i],nodes2[i]);
-				for(j=0;j<taxaBelow.size();j++)
-					if(j<taxaBelow.size()-1)
-						myfile<<"x"<<taxaBelow[j]<<" + ";
-					else
-						myfile<<"x"<<taxaBelow[j];
-				taxaBelow.clear();
-				myfile<<" - y"<<nodes1[i]->findNeighbor(nodes2[i])->id<<" >= 0"<<endl;
+	} else {//for each predator the sum of children in the DAG is >= to its value-----------------------------
+		for(j=0;j<TaxaNUM;j++)
+			if(taxaDAG[j]->degree()>0){//the ones that have children in the DAG
+				ILPConstraint row('G',0.0);
+				for(i=0;i<taxaDAG[j]->degree();i++)
+					row.addTerm(x[taxaDAG[j]->neighbors[i]->node->id],1.0);
+				row.addTerm(x[taxaDAG[j]->id],-1.0);
+				lp.addConstraint(row);
 			}
-
-	}//end printing constraints for edges (PhyloTree)
-
-
-
-}//-------------------------------------END printing constraints ALL--------------------------------------
-	//int maxlevel=dvec.size()-1;
-
-
-//---------------------------------------------Printing bounds for variables--------------------------------------
-	{
-			myfile<<"Bounds"<<endl;
-			for(j=0;j<nvar;j++)
-				myfile<<"0 <= x"<<taxaDAG[j]->id<<" <= 1"<<endl;
-			for(i=0;i<tree.branchNum;i++)
-				myfile<<"0 <= y"<<i<<" <= 1"<<endl;
-	}
-//------------------------------------------Printing variables (For IP model)---------------------------------
-	{
- 			myfile<<"Generals"<<endl;
-			for(j=0;j<nvar;j++)
-				myfile<<"x"<<taxaDAG[j]->id<<" ";
-			for(i=0;i<tree.branchNum;i++)
-				myfile<<"y"<<i<<" ";
-
-//			myfile<<"Generals"<<endl;
-// 			int maxlevel=dvec.size()-1;
-// 			for(j=0;j<=maxlevel;j++)
-// 				myfile<<"d"<<j<<" ";
-// 			if(fractVAR.size()!=0)
-// 				for(i=0;i<fractVAR.size();i++)
-// 					myfile<<fractVAR[i]<<" ";
-			myfile<<endl;
 	}
- 			myfile<<"End"<<endl;
-			myfile.close();
-		}//checkpoint "if" ends here
-}
-//----------------------------------------------CHECKPOINT ENDs here----------------------------------------------
-
 
-//---------------------------------------generating next vector of d levels--------------------------------------
-		dvec[0]--;
-		if(generateNextMultinorm(dvec))
-			DAGlevels=1;
-		else
-			DAGlevels=0;
-//-----------------------------------------------------end-------------------------------------------------------
-
-		DAGlevels=0;//IGNORE d levels: only one model to solve for each run
+/**constraints for edges in the PhyloTree: both sides of the branch----------------------------------------------*/
+	vector<int> taxaBelow;
+	for(i=0;i<tree.branchNum;i++){
+		int ybranch=y[nodes1[i]->findNeighbor(nodes2[i])->id];
+		ILPConstraint row1('G',0.0);
+		tree.getTaxaID(taxaBelow,nodes2[i],nodes1[i]);
+		for(j=0;j<taxaBelow.size();j++)
+			row1.addTerm(x[taxaBelow[j]],1.0);
+		taxaBelow.clear();
+		row1.addTerm(ybranch,-1.0);
+		lp.addConstraint(row1);
+		ILPConstraint row2('G',0.0);
+		tree.getTaxaID(taxaBelow,nodes1[i],nodes2[i]);
+		for(j=0;j<taxaBelow.size();j++)
+			row2.addTerm(x[taxaBelow[j]],1.0);
+		taxaBelow.clear();
+		row2.addTerm(ybranch,-1.0);
+		lp.addConstraint(row2);
 	}
-//----------------------------------END:Printing all cases for different d levels--------------------------------
-
-//cout<<"ALL STEPS:"<<step_all<<endl;
-//cout<<"STEPs:"<<step<<endl;
-
 }
 
 
@@ -894,103 +559,48 @@ else {//for each predator the sum of children in the DAG is >= to its value-----
 /* =========================================================================================================
  * SPLIT systems
  * =========================================================================================================*/
-void ECOpd::printInfDAG (const char* fileOUT,PDNetwork &splitsys, Params &params) {
-	ofstream out;
-	out.exceptions(ios::failbit | ios::badbit);
-	out.open(fileOUT,ios::app);
+void ECOpd::transformInfDAG (ILPSolver &lp,PDNetwork &splitsys, Params &params) {
 	int i,j,nspecies=k;
-	int maxlevel;
-	maxlevel=levelDAG[0];
-	for(i=1;i<TaxaNUM;i++)
-		if(maxlevel<levelDAG[i])
-			maxlevel=levelDAG[i];
-	int hit=0;
-	hvec.resize(maxlevel+1,0);
-	while(hit<=maxlevel){
-		for(i=0;i<TaxaNUM;i++)
-			if(levelDAG[i]==hit) hvec[hit]++;
-		hit++;
-	}
+//Variables: the split system already added x and y by PDNetwork::transformEcoLP, all integer for IP
+	IntVector x(nvar);
+	for(i=0;i<nvar;i++)
+		x[i]=lp.addVariable("x"+convertIntToString(i),0.0,1.0,true);
+	for(i=0;i<splitsys.getNSplits();i++)
+		lp.addVariable("y"+convertIntToString(i),0.0,1.0,true);
 //Constraints----------------------------------------------------------------------
 	//species present in the set-----------------------------------------------
-	if(initialTaxa.size()!=0)
-		for(i=0;i<initialTaxa.size();i++)
-			out<<"x"<<findSpeciesIDname(&initialTaxa[i])<<" = 1"<<endl;
+	for(i=0;i<initialTaxa.size();i++){
+		ILPConstraint row('E',1.0);
+		row.addTerm(x[findSpeciesIDname(&initialTaxa[i])],1.0);
+		lp.addConstraint(row);
+	}
 	//the sum of all species is <= k-------------------------------------------
-			for(i=0;i<nvar-1;i++)
-				out<<"x"<<i<<" + ";
-			out<<"x"<<nvar-1<<" <= "<<nspecies<<endl;
+	{
+		ILPConstraint row('L',nspecies);
+		for(i=0;i<nvar;i++)
+			row.addTerm(x[i],1.0);
+		lp.addConstraint(row);
+	}
 	//the sum of leaves in the DAG is >= to 1----------------------------------
-			int nleafDAG=0,nleaf=0;
-			for(i=0;i<nvar;i++)
-				if(levelDAG[i]==0)
-					nleafDAG++;
-			for(j=0;j<nvar;j++){
-				if(taxaDAG[j]->degree()==0){
-				nleaf++;
-				if(nleaf<nleafDAG)
-					out<<"x"<<taxaDAG[j]->id<<" + ";
-				else
-					out<<"x"<<taxaDAG[j]->id<<" >= 1"<<endl;
-				}
-			}
-	//SURVIVAL CONSTRAINT
-	if(weighted){
-		//constraint: Weighted food web. Sum of weights is greater than a given threshold--------------------------------
-		for(j=0;j<nvar;j++){
-			if(taxaDAG[j]->degree()>0){//the ones that have children in the DAG
-				for(i=0;i<taxaDAG[j]->degree();i++)
-					if(i<taxaDAG[j]->degree()-1)
-						out<<taxaDAG[j]->neighbors[i]->length<<" x"<<taxaDAG[j]->neighbors[i]->node->id<<" + ";
-					else
-						out<<taxaDAG[j]->neighbors[i]->length<<" x"<<taxaDAG[j]->neighbors[i]->node->id<<" - "<<T<<" x"<<taxaDAG[j]->id<<" >= 0"<<endl;
-				}
-		}
-	} else {
-		//for each predator the sum of children in the DAG is >= to its value-------
+	{
+		ILPConstraint row('G',1.0);
 		for(j=0;j<nvar;j++)
-			if(taxaDAG[j]->degree()>0){//the ones that have children in the DAG
-				for(i=0;i<taxaDAG[j]->degree();i++){
-					if(i<taxaDAG[j]->degree()-1){
-						out<<"x"<<taxaDAG[j]->neighbors[i]->node->id<<" + ";
-					} else {
-						out<<"x"<<taxaDAG[j]->neighbors[i]->node->id<<" - x"<<taxaDAG[j]->id<<" >= 0"<<endl;
-					}
-				}
-			}
+			if(taxaDAG[j]->degree()==0)
+				row.addTerm(x[taxaDAG[j]->id],1.0);
+		lp.addConstraint(row);
 	}
-
-//Bounds-----------------------------------------------------------------------------
-	Split included_tax(TaxaNUM);
-	IntVector::iterator it2;
-// 	for (it2 = splitsys.initialset.begin(); it2 != splitsys.initialset.end(); it2++)
-// 		included_tax.addTaxon(*it2);
-	vector<int> y_value;
-	y_value.resize(splitsys.getNSplits(), -1);
-	//splitsys.checkYValue(nspecies, y_value);
-	splitsys.lpVariableBound(out, params, included_tax, y_value);
-
-//Generals for IP or MIP--------------------------------------------------------------
-			out<<"Generals"<<endl;
- 			for(i=0;i<nvar;i++)
- 				out<<"x"<<i<<" ";
- 			for(i=0;i<splitsys.getNSplits();i++)
- 				out<<"y"<<i<<" ";
-// 			for(j=0;j<=maxlevel;j++)
-// 				out<<"d"<<j<<" ";
-/*			if(fractVAR.size()!=0)
-				for(i=0;i<fractVAR.size();i++)
-					out<<fractVAR[i]<<" ";*/
-			out<<endl;
-			out<<"End"<<endl;
-
-	out.close();
-
-//	ofstream out1;
-//	out1.exceptions(ios::failbit | ios::badbit);
-//	out1.open("variablesNUM.data",ios::app);
-//	out1<<this->k<<" "<<nvar<<" "<<splitsys.getNSplits()<<endl;//" "<<maxlevel+1<<endl;
-//	out1.close();
+	//SURVIVAL CONSTRAINT
+	for(j=0;j<nvar;j++)
+		if(taxaDAG[j]->degree()>0){//the ones that have children in the DAG
+			ILPConstraint row('G',0.0);
+			for(i=0;i<taxaDAG[j]->degree();i++)
+				if(weighted)//Weighted food web. Sum of weights is greater than a given threshold
+					row.addTerm(x[taxaDAG[j]->neighbors[i]->node->id],taxaDAG[j]->neighbors[i]->length);
+				else//for each predator the sum of children in the DAG is >= to its value
+					row.addTerm(x[taxaDAG[j]->neighbors[i]->node->id],1.0);
+			row.addTerm(x[taxaDAG[j]->id],weighted ? -T : -1.0);
+			lp.addConstraint(row);
+		}
 }
 
 //Fractional stuff-----------------------------------------------------------------
@@ -43,19 +43,19 @@ public:
    void readDAG(istream &in);
 
    /*
-    * Transform problem into IP problem and print it to .lp file, for rooted trees
+    * Transform problem into IP problem, for rooted trees
     */
-   void printECOlpRooted(const char* fileOUT,ECOpd &tree);
+   void transformECOlpRooted(ILPSolver &lp,ECOpd &tree);
 
    /*
-    * Transform problem into IP problem and print it to .lp file, for UNrooted trees
+    * Transform problem into IP problem, for UNrooted trees
     */
-   void printECOlpUnrooted(const char* fileOUT,ECOpd &tree);
+   void transformECOlpUnrooted(ILPSolver &lp,ECOpd &tree);
 
    /*
-    * Transform problem into IP problem and print it to .lp file, for split system
+    * Add the food web to the IP problem of a split system, built by PDNetwork::transformEcoLP
     */
-	void printInfDAG (const char* fileOUT,PDNetwork &splitsys,Params &params);
+	void transformInfDAG (ILPSolver &lp,PDNetwork &splitsys,Params &params);
 
 	/*
 	 * Synchronization of species in the food web with species on the tree
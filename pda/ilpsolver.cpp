@@ -0,0 +1,687 @@
+/*
+ * ilpsolver.cpp
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#include <cmath>
+#include <queue>
+#include <limits>
+#include "ilpsolver.h"
+#include "gurobiwrapper.h"
+
+const double ILP_INF = numeric_limits<double>::infinity();
+
+/** tolerance for integrality of integer variables, same as the LP wrappers */
+const double ILP_INT_EPS = 1e-6;
+
+/** tolerance for reduced costs in the simplex pricing */
+const double ILP_COST_EPS = 1e-9;
+
+/** smallest absolute tableau entry accepted as pivot */
+const double ILP_PIVOT_EPS = 1e-9;
+
+/** tolerance for primal feasibility */
+const double ILP_FEAS_EPS = 1e-7;
+
+/** relative optimality gap to prune branch-and-bound nodes */
+const double ILP_GAP = 1e-9;
+
+/** number of degenerate simplex steps before switching to Bland's rule */
+const int ILP_BLAND_AFTER = 50;
+
+/**
+	dense simplex tableau of a problem with all columns bounded in [0, width]
+*/
+class SimplexTableau {
+public:
+	int nrow, ncol;
+
+	/** B^-1 A, nrow x ncol row-major */
+	DoubleVector tab;
+
+	/** current value per column */
+	DoubleVector val;
+
+	/** upper bound per column, lower bound is 0 */
+	DoubleVector width;
+
+	/** basic column per row */
+	IntVector basis;
+
+	/** row of a basic column, -1 for non-basic columns */
+	IntVector row_of;
+
+	/** TRUE for non-basic columns at the upper bound */
+	BoolVector at_upper;
+
+	/** TRUE for columns that must not enter the basis */
+	BoolVector blocked;
+
+	/**
+		minimise cost * val by the primal simplex with the bounded-variable ratio test
+		@return ILP_OPTIMAL, ILP_UNBOUNDED or ILP_ITERATION_LIMIT
+	*/
+	int optimize(DoubleVector &cost);
+
+	/** pivot column q into the basis at row r, updating reduced costs dj */
+	void pivot(int r, int q, DoubleVector &dj);
+};
+
+int SimplexTableau::optimize(DoubleVector &cost) {
+	int i, j;
+	DoubleVector dj(cost);
+	for (i = 0; i < nrow; i++) {
+		double cb = cost[basis[i]];
+		if (cb == 0.0) continue;
+		double *row = &tab[(size_t)i*ncol];
+		for (j = 0; j < ncol; j++)
+			dj[j] -= cb * row[j];
+	}
+	int degenerate = 0;
+	int max_iter = 50 * (nrow + ncol) + 1000;
+	for (int iter = 0; iter < max_iter; iter++) {
+		// pricing: Dantzig's rule, Bland's rule after a run of degenerate steps
+		bool bland = degenerate > ILP_BLAND_AFTER;
+		int q = -1;
+		double best = ILP_COST_EPS;
+		for (j = 0; j < ncol; j++) {
+			if (row_of[j] >= 0 || blocked[j]) continue;
+			double score = at_upper[j] ? dj[j] : -dj[j];
+			if (score <= best) continue;
+			q = j;
+			if (bland) break;
+			best = score;
+		}
+		if (q < 0)
+			return ILP_OPTIMAL;
+
+		// ratio test: the entering column moves by step until itself or a basic column hits a bound
+		double dir = at_upper[q] ? -1.0 : 1.0;
+		double step = width[q];
+		double step_alpha = 0.0;
+		int r = -1;
+		bool r_upper = false;
+		for (i = 0; i < nrow; i++) {
+			double delta = -dir * tab[(size_t)i*ncol+q];
+			int b = basis[i];
+			double lim;
+			bool upper;
+			if (delta < -ILP_PIVOT_EPS) {
+				lim = val[b] / (-delta);
+				upper = false;
+			} else if (delta > ILP_PIVOT_EPS && width[b] < ILP_INF) {
+				lim = (width[b] - val[b]) / delta;
+				upper = true;
+			} else
+				continue;
+			if (lim < 0.0) lim = 0.0;
+			bool better = lim < step - 1e-12;
+			if (!better && r >= 0 && lim <= step + 1e-12)
+				better = bland ? (b < basis[r]) : (fabs(delta) > step_alpha);
+			if (better) {
+				step = lim;
+				step_alpha = fabs(delta);
+				r = i;
+				r_upper = upper;
+			}
+		}
+		if (step >= ILP_INF)
+			return ILP_UNBOUNDED;
+		degenerate = (step < ILP_FEAS_EPS) ? degenerate+1 : 0;
+
+		if (step > 0.0) {
+			val[q] += dir * step;
+			for (i = 0; i < nrow; i++)
+				val[basis[i]] -= dir * step * tab[(size_t)i*ncol+q];
+		}
+		if (r < 0) {
+			// bound flip of the entering column
+			at_upper[q] = !at_upper[q];
+			val[q] = at_upper[q] ? width[q] : 0.0;
+			continue;
+		}
+		int leave = basis[r];
+		at_upper[leave] = r_upper;
+		val[leave] = r_upper ? width[leave] : 0.0;
+		pivot(r, q, dj);
+	}
+	return ILP_ITERATION_LIMIT;
+}
+
+void SimplexTableau::pivot(int r, int q, DoubleVector &dj) {
+	int i, j;
+	double *prow = &tab[(size_t)r*ncol];
+	double inv = 1.0 / prow[q];
+	IntVector nonzero;
+	for (j = 0; j < ncol; j++)
+		if (prow[j] != 0.0) {
+			prow[j] *= inv;
+			nonzero.push_back(j);
+		}
+	prow[q] = 1.0;
+	for (i = 0; i < nrow; i++) {
+		if (i == r) continue;
+		double *row = &tab[(size_t)i*ncol];
+		double f = row[q];
+		if (f == 0.0) continue;
+		for (IntVector::iterator it = nonzero.begin(); it != nonzero.end(); it++) {
+			double v = row[*it] - f * prow[*it];
+			row[*it] = (fabs(v) < 1e-13) ? 0.0 : v;
+		}
+		row[q] = 0.0;
+	}
+	double f = dj[q];
+	if (f != 0.0)
+		for (IntVector::iterator it = nonzero.begin(); it != nonzero.end(); it++)
+			dj[*it] -= f * prow[*it];
+	dj[q] = 0.0;
+	row_of[basis[r]] = -1;
+	basis[r] = q;
+	row_of[q] = r;
+	at_upper[q] = false;
+}
+
+/***********************************************
+	ILPSolver
+***********************************************/
+
+ILPSolver::ILPSolver() {
+	maximize = false;
+	objective = 0.0;
+	num_nodes = 0;
+}
+
+int ILPSolver::findVariable(const string &name) {
+	map<string, int>::iterator it = var_index.find(name);
+	if (it == var_index.end())
+		return -1;
+	return it->second;
+}
+
+int ILPSolver::addVariable(const string &name, double lb, double ub, bool integer) {
+	int id = findVariable(name);
+	if (id < 0) {
+		id = var_names.size();
+		var_index[name] = id;
+		var_names.push_back(name);
+		var_lb.push_back(lb);
+		var_ub.push_back(ub);
+		var_int.push_back(integer);
+		obj_coef.push_back(0.0);
+		return id;
+	}
+	var_lb[id] = lb;
+	var_ub[id] = ub;
+	var_int[id] = var_int[id] || integer;
+	return id;
+}
+
+void ILPSolver::addConstraint(const ILPConstraint &row) {
+	map<int, double> coef;
+	for (int i = 0; i < row.var.size(); i++) {
+		ASSERT(row.var[i] >= 0 && row.var[i] < var_names.size());
+		coef[row.var[i]] += row.coef[i];
+	}
+	ILPConstraint merged(row.sense, row.rhs);
+	for (map<int, double>::iterator it = coef.begin(); it != coef.end(); it++)
+		if (it->second != 0.0)
+			merged.addTerm(it->first, it->second);
+	if (!merged.var.empty())
+		rows.push_back(merged);
+}
+
+void ILPSolver::addQuadObjective(int var1, int var2, double coef) {
+	ILPQuadTerm term;
+	term.var1 = var1;
+	term.var2 = var2;
+	term.coef = coef;
+	quad_obj.push_back(term);
+}
+
+/***********************************************
+	writing LP files for gurobi_cl
+***********************************************/
+
+/** number of terms per line in writeLP() */
+const int ILP_TERMS_PER_LINE = 10;
+
+void ILPSolver::writeLP(const char *filename) {
+	try {
+		ofstream out;
+		out.exceptions(ios::failbit | ios::badbit);
+		out.open(filename);
+		writeLP(out);
+		out.close();
+	} catch (ios::failure) {
+		outError(ERR_WRITE_OUTPUT, filename);
+	}
+}
+
+void ILPSolver::writeLP(ostream &out) {
+	int nvar = var_names.size();
+	int i, j, nterms;
+	out.precision(12);
+
+	out << (maximize ? "Maximize" : "Minimize") << endl << " obj:";
+	for (j = 0, nterms = 0; j < nvar; j++) {
+		if (obj_coef[j] == 0.0) continue;
+		if (nterms > 0 && nterms % ILP_TERMS_PER_LINE == 0) out << endl;
+		out << ((obj_coef[j] < 0.0) ? " - " : " + ") << fabs(obj_coef[j]) << " " << var_names[j];
+		nterms++;
+	}
+	if (nterms == 0)
+		out << " 0";
+	if (!quad_obj.empty()) {
+		out << " + [";
+		for (i = 0; i < quad_obj.size(); i++) {
+			if (i > 0 && i % ILP_TERMS_PER_LINE == 0) out << endl;
+			ILPQuadTerm &term = quad_obj[i];
+			out << ((term.coef < 0.0) ? " - " : " + ") << fabs(term.coef) << " "
+				<< var_names[term.var1] << " * " << var_names[term.var2];
+		}
+		out << " ] / 2";
+	}
+	out << endl;
+
+	out << "Subject To" << endl;
+	for (i = 0; i < rows.size(); i++) {
+		ILPConstraint &row = rows[i];
+		out << " c" << i << ":";
+		for (j = 0; j < row.var.size(); j++) {
+			if (j > 0 && j % ILP_TERMS_PER_LINE == 0) out << endl;
+			out << ((row.coef[j] < 0.0) ? " - " : " + ") << fabs(row.coef[j]) << " " << var_names[row.var[j]];
+		}
+		out << ((row.sense == 'L') ? " <= " : ((row.sense == 'G') ? " >= " : " = ")) << row.rhs << endl;
+	}
+
+	out << "Bounds" << endl;
+	for (j = 0; j < nvar; j++) {
+		if (var_lb[j] == var_ub[j])
+			out << " " << var_names[j] << " = " << var_lb[j] << endl;
+		else if (var_ub[j] == ILP_INF) {
+			if (var_lb[j] != 0.0)
+				out << " " << var_names[j] << " >= " << var_lb[j] << endl;
+		} else
+			out << " " << var_lb[j] << " <= " << var_names[j] << " <= " << var_ub[j] << endl;
+	}
+
+	// integer variables within [0,1] are binary, the others general integers
+	for (int binary = 1; binary >= 0; binary--) {
+		nterms = 0;
+		for (j = 0; j < nvar; j++) {
+			if (!var_int[j] || (var_lb[j] >= 0.0 && var_ub[j] <= 1.0) != (binary == 1)) continue;
+			if (nterms == 0)
+				out << (binary ? "Binary" : "Generals") << endl;
+			else if (nterms % ILP_TERMS_PER_LINE == 0)
+				out << endl;
+			out << " " << var_names[j];
+			nterms++;
+		}
+		if (nterms > 0)
+			out << endl;
+	}
+	out << "End" << endl;
+}
+
+/***********************************************
+	LP relaxation
+***********************************************/
+
+int ILPSolver::solveLP(DoubleVector &lb, DoubleVector &ub, DoubleVector &x, double &obj) {
+	int nvar = var_names.size();
+	int i, j;
+	double sense = maximize ? -1.0 : 1.0;
+
+	// columns only for non-fixed variables, shifted to lower bound 0
+	IntVector col_of(nvar, -1), col_var;
+	x.resize(nvar);
+	for (j = 0; j < nvar; j++) {
+		if (lb[j] == -ILP_INF)
+			outError("Built-in ILP solver does not support variables without lower bound: ", var_names[j]);
+		if (lb[j] > ub[j] + ILP_FEAS_EPS)
+			return ILP_INFEASIBLE;
+		x[j] = lb[j];
+		if (ub[j] - lb[j] > ILP_FEAS_EPS) {
+			col_of[j] = col_var.size();
+			col_var.push_back(j);
+		}
+	}
+	int nstruct = col_var.size();
+
+	// reduce constraints by the fixed variables and the lower bounds
+	vector<ILPConstraint> red_rows;
+	int nslack = 0;
+	for (vector<ILPConstraint>::iterator it = rows.begin(); it != rows.end(); it++) {
+		ILPConstraint row;
+		row.sense = it->sense;
+		row.rhs = it->rhs;
+		for (i = 0; i < it->var.size(); i++) {
+			j = it->var[i];
+			row.rhs -= it->coef[i] * lb[j];
+			if (col_of[j] >= 0) {
+				row.var.push_back(col_of[j]);
+				row.coef.push_back(it->coef[i]);
+			}
+		}
+		if (row.var.empty()) {
+			double tol = ILP_FEAS_EPS * (1.0 + fabs(it->rhs));
+			if ((row.sense != 'G' && row.rhs < -tol) || (row.sense != 'L' && row.rhs > tol))
+				return ILP_INFEASIBLE;
+			continue;
+		}
+		if (row.sense != 'E')
+			nslack++;
+		red_rows.push_back(row);
+	}
+	int nrow = red_rows.size();
+
+	// initial basis: slack if feasible at the lower bounds, artificial otherwise
+	IntVector row_factor(nrow, 1), row_art(nrow, -1);
+	int nart = 0;
+	for (i = 0; i < nrow; i++) {
+		ILPConstraint &row = red_rows[i];
+		if ((row.sense == 'L' && row.rhs < 0.0) || (row.sense == 'G' && row.rhs <= 0.0) ||
+			(row.sense == 'E' && row.rhs < 0.0))
+			row_factor[i] = -1;
+		if (!(row.sense == 'L' && row.rhs >= 0.0) && !(row.sense == 'G' && row.rhs <= 0.0))
+			row_art[i] = nart++;
+	}
+
+	SimplexTableau lp;
+	lp.nrow = nrow;
+	lp.ncol = nstruct + nslack + nart;
+	lp.tab.resize((size_t)lp.nrow * lp.ncol, 0.0);
+	lp.val.resize(lp.ncol, 0.0);
+	lp.width.resize(lp.ncol, ILP_INF);
+	lp.basis.resize(nrow);
+	lp.row_of.resize(lp.ncol, -1);
+	lp.at_upper.resize(lp.ncol, false);
+	lp.blocked.resize(lp.ncol, false);
+	for (j = 0; j < nstruct; j++)
+		lp.width[j] = ub[col_var[j]] - lb[col_var[j]];
+	int slack = nstruct;
+	for (i = 0; i < nrow; i++) {
+		ILPConstraint &row = red_rows[i];
+		double *trow = &lp.tab[(size_t)i*lp.ncol];
+		double f = row_factor[i];
+		for (j = 0; j < row.var.size(); j++)
+			trow[row.var[j]] += f * row.coef[j];
+		int basic;
+		if (row.sense != 'E') {
+			trow[slack] = f * ((row.sense == 'L') ? 1.0 : -1.0);
+			basic = slack++;
+		}
+		if (row_art[i] >= 0) {
+			basic = nstruct + nslack + row_art[i];
+			trow[basic] = 1.0;
+		}
+		lp.basis[i] = basic;
+		lp.row_of[basic] = i;
+		lp.val[basic] = f * row.rhs;
+	}
+
+	int status;
+	// phase 1: minimise the sum of artificial variables
+	if (nart > 0) {
+		DoubleVector cost(lp.ncol, 0.0);
+		double infeas = 0.0;
+		for (j = nstruct + nslack; j < lp.ncol; j++)
+			cost[j] = 1.0;
+		for (i = 0; i < nrow; i++)
+			infeas = max(infeas, fabs(red_rows[i].rhs));
+		status = lp.optimize(cost);
+		if (status != ILP_OPTIMAL)
+			return status;
+		double sum = 0.0;
+		for (j = nstruct + nslack; j < lp.ncol; j++)
+			sum += lp.val[j];
+		if (sum > ILP_FEAS_EPS * (1.0 + infeas))
+			return ILP_INFEASIBLE;
+		// artificial variables stay at zero from now on
+		for (j = nstruct + nslack; j < lp.ncol; j++) {
+			lp.width[j] = 0.0;
+			lp.blocked[j] = true;
+			if (lp.row_of[j] < 0) lp.val[j] = 0.0;
+		}
+	}
+
+	// phase 2: minimise the objective
+	DoubleVector cost(lp.ncol, 0.0);
+	for (j = 0; j < nstruct; j++)
+		cost[j] = sense * obj_coef[col_var[j]];
+	status = lp.optimize(cost);
+	if (status != ILP_OPTIMAL)
+		return status;
+
+	obj = 0.0;
+	for (j = 0; j < nstruct; j++) {
+		double v = min(max(lp.val[j], 0.0), lp.width[j]);
+		x[col_var[j]] = lb[col_var[j]] + v;
+	}
+	for (j = 0; j < nvar; j++)
+		obj += sense * obj_coef[j] * x[j];
+	return ILP_OPTIMAL;
+}
+
+/***********************************************
+	branch and bound
+***********************************************/
+
+int ILPSolver::findBranchVariable(DoubleVector &x) {
+	int best_var = -1;
+	double best_frac = ILP_INT_EPS;
+	for (int j = 0; j < x.size(); j++) {
+		if (!var_int[j]) continue;
+		double frac = x[j] - floor(x[j]);
+		frac = min(frac, 1.0 - frac);
+		if (frac > best_frac) {
+			best_frac = frac;
+			best_var = j;
+		}
+	}
+	return best_var;
+}
+
+/**
+	open node of the branch-and-bound tree
+*/
+struct ILPNode {
+	DoubleVector lb, ub;
+
+	/** LP relaxation bound (minimisation) */
+	double bound;
+
+	/** fractional integer variable to branch on */
+	int branch_var;
+
+	/** its value in the LP relaxation */
+	double branch_val;
+};
+
+struct ILPNodeCompare {
+	bool operator()(const ILPNode *a, const ILPNode *b) const {
+		return a->bound > b->bound;
+	}
+};
+
+int ILPSolver::solve(int num_threads, const DoubleVector *start) {
+	int nvar = var_names.size();
+	int i, j;
+	double incumbent = ILP_INF;
+	DoubleVector x;
+	bool proven = true;
+	if (num_threads < 1) num_threads = 1;
+	if (!quad_obj.empty())
+		outError("Built-in ILP solver does not support quadratic terms, please use -gurobi");
+
+	ILPNode *root = new ILPNode;
+	root->lb = var_lb;
+	root->ub = var_ub;
+	int status = solveLP(root->lb, root->ub, x, root->bound);
+	num_nodes = 1;
+	if (status != ILP_OPTIMAL) {
+		delete root;
+		return status;
+	}
+	root->branch_var = findBranchVariable(x);
+	if (root->branch_var < 0) {
+		solution = x;
+		objective = maximize ? -root->bound : root->bound;
+		delete root;
+		return ILP_OPTIMAL;
+	}
+	root->branch_val = x[root->branch_var];
+
+	// initial incumbents: the warm start, and the rounded-down and rounded root relaxation
+	vector<DoubleVector> guesses;
+	if (start && start->size() == nvar)
+		guesses.push_back(*start);
+	DoubleVector guess(nvar);
+	for (j = 0; j < nvar; j++)
+		guess[j] = floor(x[j] + ILP_INT_EPS);
+	guesses.push_back(guess);
+	for (j = 0; j < nvar; j++)
+		guess[j] = floor(x[j] + 0.5);
+	guesses.push_back(guess);
+	for (vector<DoubleVector>::iterator it = guesses.begin(); it != guesses.end(); it++) {
+		DoubleVector lb = var_lb, ub = var_ub, xg;
+		double obj;
+		for (j = 0; j < nvar; j++)
+			if (var_int[j] && !std::isnan((*it)[j])) {
+				double v = min(max(floor((*it)[j] + 0.5), var_lb[j]), var_ub[j]);
+				lb[j] = ub[j] = v;
+			}
+		num_nodes++;
+		if (solveLP(lb, ub, xg, obj) == ILP_OPTIMAL && findBranchVariable(xg) < 0 && obj < incumbent) {
+			incumbent = obj;
+			solution = xg;
+		}
+	}
+
+	priority_queue<ILPNode*, vector<ILPNode*>, ILPNodeCompare> open;
+	open.push(root);
+	while (!open.empty()) {
+		// take up to num_threads most promising nodes and branch them
+		double cutoff = incumbent - ILP_GAP * max(1.0, fabs(incumbent));
+		vector<ILPNode*> children;
+		while (!open.empty() && children.size() < 2*num_threads) {
+			ILPNode *node = open.top();
+			open.pop();
+			if (node->bound >= cutoff) {
+				delete node;
+				continue;
+			}
+			ILPNode *down = new ILPNode(*node);
+			down->ub[node->branch_var] = floor(node->branch_val);
+			ILPNode *up = node;
+			up->lb[node->branch_var] = ceil(node->branch_val);
+			children.push_back(down);
+			children.push_back(up);
+		}
+		int nchildren = children.size();
+		if (nchildren == 0) break;
+
+		// solve the LP relaxations of the children in parallel
+		vector<DoubleVector> child_x(nchildren);
+		IntVector child_status(nchildren);
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(num_threads) schedule(dynamic)
+#endif
+		for (i = 0; i < nchildren; i++) {
+			ILPNode *child = children[i];
+			child_status[i] = solveLP(child->lb, child->ub, child_x[i], child->bound);
+			if (child_status[i] == ILP_OPTIMAL) {
+				child->branch_var = findBranchVariable(child_x[i]);
+				if (child->branch_var >= 0)
+					child->branch_val = child_x[i][child->branch_var];
+			}
+		}
+		num_nodes += nchildren;
+
+		// merge in a fixed order so the result does not depend on thread timing
+		for (i = 0; i < nchildren; i++) {
+			ILPNode *child = children[i];
+			if (child_status[i] == ILP_ITERATION_LIMIT || child_status[i] == ILP_UNBOUNDED)
+				proven = false;
+			if (child_status[i] != ILP_OPTIMAL || child->bound >= incumbent - ILP_GAP * max(1.0, fabs(incumbent))) {
+				delete child;
+				continue;
+			}
+			if (child->branch_var < 0) {
+				incumbent = child->bound;
+				solution = child_x[i];
+				delete child;
+				continue;
+			}
+			open.push(child);
+		}
+	}
+
+	if (incumbent == ILP_INF)
+		return proven ? ILP_INFEASIBLE : ILP_ITERATION_LIMIT;
+	objective = maximize ? -incumbent : incumbent;
+	return proven ? ILP_OPTIMAL : ILP_ITERATION_LIMIT;
+}
+
+/***********************************************
+	interface in the style of the external LP wrappers
+***********************************************/
+
+int ilp_solve(ILPSolver &solver, int ntaxa, double *score, double *variables, int verbose_mode, int num_threads,
+	double *warm_start)
+{
+	int nvar = solver.var_names.size();
+	int j, ret = 0;
+
+	DoubleVector start;
+	if (warm_start) {
+		start.resize(nvar, NAN);
+		for (j = 0; j < nvar; j++) {
+			const string &name = solver.var_names[j];
+			if (name[0] != 'x') continue;
+			int index = atoi(name.c_str()+1);
+			if (index >= 0 && index < ntaxa)
+				start[j] = warm_start[index];
+		}
+	}
+
+	int status = solver.solve(num_threads, warm_start ? &start : NULL);
+	if (verbose_mode >= VB_MED)
+		cout << endl << "ILP solver: " << nvar << " variables, " << solver.rows.size() << " constraints, "
+			<< solver.num_nodes << " LP relaxations, status " << status << endl;
+	*score = -1;
+	if (status != ILP_OPTIMAL)
+		return 5;
+	*score = solver.objective;
+
+	for (j = 0; j < ntaxa; j++)
+		variables[j] = 0.0;
+	for (j = 0; j < nvar; j++) {
+		const string &name = solver.var_names[j];
+		if (name[0] != 'x') continue;
+		int index = atoi(name.c_str()+1);
+		if (index < 0 || index >= ntaxa) {
+			cout << "Index x_" << index << " is not in the range!" << endl;
+			return 6;
+		}
+		double value = solver.solution[j];
+		if (value > ILP_INT_EPS && (1.0 - value) > ILP_INT_EPS) {
+			if (verbose_mode >= VB_MED) cout << endl << name << " = " << value;
+			ret = 7;
+		}
+		variables[index] = value;
+	}
+	return ret;
+}
+
+int solveILP(Params &params, ILPSolver &model, const char *filename, int ntaxa, double *score, double *variables,
+	double *warm_start)
+{
+	if (params.gurobi_solver) {
+		model.writeLP(filename);
+		return gurobi_solve((char*)filename, ntaxa, score, variables, verbose_mode, params.gurobi_threads);
+	}
+	int num_threads = (params.num_threads > 0) ? params.num_threads : countPhysicalCPUCores();
+	return ilp_solve(model, ntaxa, score, variables, verbose_mode, num_threads, warm_start);
+}
@@ -0,0 +1,197 @@
+/*
+ * ilpsolver.h
+ *
+ *  Created on: Oct 18, 2026
+ *
+ *  Built-in branch-and-bound solver for the (mixed) integer linear programs
+ *  formulated by PDNetwork and ECOpd
+ */
+
+#ifndef ILPSOLVER_H
+#define ILPSOLVER_H
+
+#include "utils/tools.h"
+
+/**
+	status codes of ILPSolver::solve() and ILPSolver::solveLP()
+*/
+enum ILPStatus {ILP_OPTIMAL, ILP_INFEASIBLE, ILP_UNBOUNDED, ILP_ITERATION_LIMIT};
+
+/**
+	one linear constraint: sum_i coef[i] * x[var[i]]  (sense)  rhs
+*/
+struct ILPConstraint {
+	ILPConstraint(char sense = 'L', double rhs = 0.0) : sense(sense), rhs(rhs) {}
+
+	/** add the term coef * x[var] */
+	void addTerm(int var, double coef) {
+		this->var.push_back(var);
+		this->coef.push_back(coef);
+	}
+
+	IntVector var;
+	DoubleVector coef;
+	/** 'L' for <=, 'G' for >=, 'E' for = */
+	char sense;
+	double rhs;
+};
+
+/**
+	one quadratic objective term: coef * x[var1] * x[var2]
+*/
+struct ILPQuadTerm {
+	int var1, var2;
+	double coef;
+};
+
+/**
+	Branch-and-bound solver for mixed integer linear programs. Bounds come from
+	the LP relaxation, solved by a dense bounded-variable two-phase simplex.
+	Open nodes are explored best-bound first; each round branches up to
+	num_threads nodes and solves their children in parallel.
+	PDNetwork and ECOpd build the model directly with addVariable(),
+	obj_coef and addConstraint(); writeLP() prints it for gurobi_cl.
+*/
+class ILPSolver {
+public:
+
+	ILPSolver();
+
+	/**
+		add a variable, or reset the bounds of an existing one
+		@param name variable name, as written by writeLP()
+		@param lb lower bound
+		@param ub upper bound
+		@param integer TRUE for an integer variable
+		@return variable index
+	*/
+	int addVariable(const string &name, double lb = 0.0, double ub = 1.0, bool integer = false);
+
+	/**
+		add a linear constraint; repeated variables are merged, zero terms dropped
+		and a constraint without terms is ignored
+		@param row the constraint
+	*/
+	void addConstraint(const ILPConstraint &row);
+
+	/**
+		add a quadratic objective term, only supported by writeLP() for gurobi_cl
+		@param var1 first variable
+		@param var2 second variable
+		@param coef coefficient, written inside "[ ... ] / 2"
+	*/
+	void addQuadObjective(int var1, int var2, double coef);
+
+	/**
+		write the model in CPLEX/Gurobi LP format
+		@param filename name of output lp file
+	*/
+	void writeLP(const char *filename);
+
+	/**
+		write the model in CPLEX/Gurobi LP format
+		@param out output stream
+	*/
+	void writeLP(ostream &out);
+
+	/**
+		@param name variable name
+		@return variable index, -1 if not found
+	*/
+	int findVariable(const string &name);
+
+	/**
+		solve the model to optimality
+		@param num_threads number of threads for node exploration
+		@param start (IN) warm-start values per variable, NAN for unknown; the
+			integer variables with known values are fixed to get an initial incumbent
+		@return ILP_OPTIMAL, ILP_INFEASIBLE, ILP_UNBOUNDED or ILP_ITERATION_LIMIT
+	*/
+	int solve(int num_threads = 1, const DoubleVector *start = NULL);
+
+	/**
+		solve the LP relaxation of the model under given variable bounds
+		@param lb lower bound per variable
+		@param ub upper bound per variable
+		@param[out] x optimal solution
+		@param[out] obj objective value to be minimised (negated for maximisation)
+		@return ILP_OPTIMAL, ILP_INFEASIBLE, ILP_UNBOUNDED or ILP_ITERATION_LIMIT
+	*/
+	int solveLP(DoubleVector &lb, DoubleVector &ub, DoubleVector &x, double &obj);
+
+	/** variable names */
+	StrVector var_names;
+
+	/** variable lower and upper bounds */
+	DoubleVector var_lb, var_ub;
+
+	/** TRUE for integer variables */
+	BoolVector var_int;
+
+	/** objective coefficients */
+	DoubleVector obj_coef;
+
+	/** TRUE to maximise, FALSE to minimise */
+	bool maximize;
+
+	/** constraints */
+	vector<ILPConstraint> rows;
+
+	/** quadratic objective terms (-qp), not supported by solve() */
+	vector<ILPQuadTerm> quad_obj;
+
+	/** optimal solution after solve() */
+	DoubleVector solution;
+
+	/** optimal objective value after solve() */
+	double objective;
+
+	/** number of branch-and-bound nodes explored by solve() */
+	int num_nodes;
+
+protected:
+
+	/** map from variable name to index */
+	map<string, int> var_index;
+
+	/**
+		@return index of the most fractional integer variable in x, -1 if x is integral
+	*/
+	int findBranchVariable(DoubleVector &x);
+};
+
+/**
+	interface to call the built-in ILP solver, with the same contract as gurobi_solve()
+	@param model the model, built by PDNetwork or ECOpd
+	@param ntaxa number of taxa
+	@param score (OUT) returned optimal score
+	@param variables (OUT) array of returned solution
+	@param verbose_mode verbose mode
+	@param num_threads number of threads
+	@param warm_start (IN) solution of a related problem (e.g. the previous budget) or NULL
+	@return
+		0 if everything works fine,
+		5 if solution is not optimal,
+		6 if some variable has wrong name,
+		7 if returned solution is not binary. In this case, one should run the solver
+		again with strict binary variable constraint.
+*/
+int ilp_solve(ILPSolver &model, int ntaxa, double *score, double *variables, int verbose_mode, int num_threads,
+	double *warm_start = NULL);
+
+/**
+	solve the model with the built-in solver using -nt threads, or, with -gurobi or -qp,
+	write it to an LP file and call gurobi_cl using -gthreads threads
+	@param params program parameters
+	@param model the model
+	@param filename name of the lp file for gurobi_cl
+	@param ntaxa number of taxa
+	@param score (OUT) returned optimal score
+	@param variables (OUT) array of returned solution
+	@param warm_start (IN) solution of a related problem or NULL, only used by the built-in solver
+	@return return code of ilp_solve() or gurobi_solve()
+*/
+int solveILP(Params &params, ILPSolver &model, const char *filename, int ntaxa, double *score, double *variables,
+	double *warm_start = NULL);
+
+#endif
@@ -17,6 +17,7 @@
  *   Free Software Foundation, Inc.,                                       *
  *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
  ***************************************************************************/
+#include <limits>
 #include "tree/mtree.h"
 #include "pdnetwork.h"
 #include "ncl/ncl.h"
@@ -24,6 +25,7 @@
 #include "nclextra/myreader.h" 
 #include "lpwrapper.h"
 #include "gurobiwrapper.h"
+#include "ilpsolver.h"
 
 extern void summarizeSplit(Params &params, PDNetwork &sg, vector<SplitSet> &pd_set, PDRelatedMeasures &pd_more, bool full_report);
 
@@ -431,10 +433,11 @@ void PDNetwork::enterFindPD(Params &params) {
 	} 	
 }
 
-void printLPVersion(bool gurobi_format) {
-	if (gurobi_format)
+void printLPVersion(bool gurobi_solver) {
+	if (gurobi_solver)
 		cout << "Using GUROBI" << endl;
 	else {
+		cout << "Using built-in branch-and-bound ILP solver" << endl;
 		//int lp_majorversion, lp_minorversion, lp_release, lp_build;
 		//lp_solve_version_info(&lp_majorversion, &lp_minorversion, &lp_release, &lp_build);
 		//cout << "Using LP_SOLVE " << lp_majorversion << "." << lp_minorversion << "." << lp_release << "." << lp_build << endl;
@@ -460,7 +463,7 @@ void PDNetwork::findPD(Params &params, vector<SplitSet> &taxa_set, vector<int> &
 
 	if (isPDArea()) {
 		params.detected_mode = LINEAR_PROGRAMMING;
-		printLPVersion(params.gurobi_format);
+		printLPVersion(params.gurobi_solver);
 		cout << "Optimizing PD over " << sets->getNSets() << " areas..." << endl;
 		cout << "Linear programming on general split network..." << endl;
 		findPDArea_LP(params, taxa_set);
@@ -473,7 +476,7 @@ void PDNetwork::findPD(Params &params, vector<SplitSet> &taxa_set, vector<int> &
 		taxa_set[0].push_back(new Split(curset));
 	} else if (params.run_mode != EXHAUSTIVE) {
 		params.detected_mode = LINEAR_PROGRAMMING;
-		printLPVersion(params.gurobi_format);
+		printLPVersion(params.gurobi_solver);
 		cout << "Linear programming on general split network..." << endl;
 		findPD_LP(params, taxa_set);
 	} 
@@ -770,47 +773,30 @@ void PDNetwork::calcPDComplementarity(SplitSet &area_set, char *area_names,
 
 }
 
-void PDNetwork::transformLP2(Params &params, const char *outfile, int total_size, bool make_bin) {
+void PDNetwork::transformLP2(Params &params, ILPSolver &lp, int total_size, bool make_bin) {
 	Split included_tax(getNTaxa());
 	IntVector::iterator it2;
 	for (it2 = initialset.begin(); it2 != initialset.end(); it2++)
 		included_tax.addTaxon(*it2);
-	try {
-		ofstream out;
-		out.exceptions(ios::failbit | ios::badbit);
-		out.open(outfile);
-		vector<int> y_value;
-		checkYValue(total_size, y_value);
-
-		lpObjectiveMaxSD(out, params, y_value, total_size);
-		lpSplitConstraint_TS(out, params, y_value, total_size);
-		lpK_BudgetConstraint(out, params, total_size);
-		lpVariableBound(out, params, included_tax, y_value);
-		if (make_bin) 
-			lpVariableBinary(out, params, included_tax);
-
-		out.close();
-		//cout << "Transformed LP problem printed to " << outfile << endl;
-	} catch (ios::failure) {
-		outError(ERR_WRITE_OUTPUT, outfile);
-	}
+	vector<int> y_value;
+	checkYValue(total_size, y_value);
+
+	lpVariableBound(lp, params, included_tax, y_value);
+	lpObjectiveMaxSD(lp, params, y_value, total_size);
+	lpSplitConstraint_TS(lp, params, y_value, total_size);
+	lpK_BudgetConstraint(lp, params, total_size);
+	if (make_bin)
+		lpVariableBinary(lp, params, included_tax);
 }
 
 //Olga:ECOpd split system
-void PDNetwork::transformEcoLP(Params &params, const char *outfile, int total_size) {
-	try {
-		ofstream out;
-		out.exceptions(ios::failbit | ios::badbit);
-		out.open(outfile);
-		vector<int> y_value;
-		y_value.resize(getNSplits(), -1);
-		lpObjectiveMaxSD(out, params, y_value, total_size);
-		lpSplitConstraint_TS(out, params, y_value, total_size);
-		out.close();
-
-	} catch (ios::failure) {
-		outError(ERR_WRITE_OUTPUT, outfile);
-	}
+void PDNetwork::transformEcoLP(Params &params, ILPSolver &lp, int total_size) {
+	Split included_tax(getNTaxa());
+	vector<int> y_value;
+	y_value.resize(getNSplits(), -1);
+	lpVariableBound(lp, params, included_tax, y_value);
+	lpObjectiveMaxSD(lp, params, y_value, total_size);
+	lpSplitConstraint_TS(lp, params, y_value, total_size);
 }
 
 void PDNetwork::findPD_LP(Params &params, vector<SplitSet> &taxa_set) {
@@ -824,6 +810,8 @@ void PDNetwork::findPD_LP(Params &params, vector<SplitSet> &taxa_set) {
 	int k, min_k, max_k, step_k, index;
 
 	double *variables = new double[ntaxa];
+	// optimal set of the previous budget, still feasible for the next one: warm start
+	DoubleVector last_solution;
 
 	if (isBudgetConstraint()) { // non-budget case
 		min_k = params.min_budget;
@@ -843,31 +831,28 @@ void PDNetwork::findPD_LP(Params &params, vector<SplitSet> &taxa_set) {
 		cout << "running k = ";
 	for (k = min_k; k <= max_k; k += step_k) {
 		index = (k - min_k) / step_k;
+		ILPSolver lp;
 		if (!params.binary_programming) {
-			transformLP2(params, ofile.c_str(), k, false);
+			transformLP2(params, lp, k, false);
 			cout << " " << k;
 			cout.flush();
-			if (params.gurobi_format)
-				lp_ret = gurobi_solve((char*)ofile.c_str(), ntaxa, &score, variables, verbose_mode, params.gurobi_threads);
-			else
-				lp_ret = lp_solve((char*)ofile.c_str(), ntaxa, &score, variables, verbose_mode);
+			lp_ret = solveILP(params, lp, ofile.c_str(), ntaxa, &score, variables);
 		} else lp_ret = 7;
 		if (lp_ret != 0 && lp_ret != 7)
 			outError("Something went wrong with LP solver!");
 		if (lp_ret == 7) { // fail with non-binary case, do again with strict binary
 			if (params.binary_programming)
-				transformLP2(params, ofile.c_str(), k, true);
+				transformLP2(params, lp, k, true);
 			else 
-				lpVariableBinary(ofile.c_str(), params, initialset);
+				lpVariableBinary(lp, params, initialset);
 			cout << " " << k << "(bin)";
 			cout.flush();
-			if (params.gurobi_format)
-				lp_ret = gurobi_solve((char*)ofile.c_str(), ntaxa, &score, variables, verbose_mode, params.gurobi_threads);
-			else
-				lp_ret = lp_solve((char*)ofile.c_str(), ntaxa, &score, variables, verbose_mode);
+			lp_ret = solveILP(params, lp, ofile.c_str(), ntaxa, &score, variables,
+				last_solution.empty() ? NULL : &last_solution[0]);
 			if (lp_ret != 0) // check error again without allowing non-binary
 				outError("Something went wrong with LP solver!");
 		}	
+		last_solution.assign(variables, variables + ntaxa);
 
 		Split *pd_set = new Split(ntaxa, score);
 		for (i = 0; i < ntaxa; i++)
@@ -882,63 +867,42 @@ void PDNetwork::findPD_LP(Params &params, vector<SplitSet> &taxa_set) {
 	delete [] variables;	
 }
 
-void PDNetwork::transformLP_Area2(Params &params, const char *outfile, int total_size, bool make_bin) {
+void PDNetwork::transformLP_Area2(Params &params, ILPSolver &lp, int total_size, bool make_bin) {
 	int nareas = getNAreas();
 	Split included_area(nareas);
 	IntVector::iterator it2;
 	for (it2 = initialareas.begin(); it2 != initialareas.end(); it2++)
 		included_area.addTaxon(*it2);
-	try {
-		ofstream out;
-		out.exceptions(ios::failbit | ios::badbit);
-		out.open(outfile);
-		vector<int> y_value, count1, count2;
-		checkYValue_Area(total_size, y_value, count1, count2);
-
-		lpObjectiveMaxSD(out, params, y_value, total_size);
-		lpSplitConstraint_RS(out, params, y_value, count1, count2, total_size);
-		lpInitialArea(out, params);
-		lpK_BudgetConstraint(out, params, total_size);
-		lpBoundaryConstraint(out, params);
-		lpVariableBound(out, params, included_area, y_value);
-		if (make_bin)
-			lpVariableBinary(out, params, included_area);
-
-		out.close();
-		//cout << "Transformed LP problem printed to " << outfile << endl;
-	} catch (ios::failure) {
-		outError(ERR_WRITE_OUTPUT, outfile);
-	}
-
+	vector<int> y_value, count1, count2;
+	checkYValue_Area(total_size, y_value, count1, count2);
+
+	lpVariableBound(lp, params, included_area, y_value);
+	lpObjectiveMaxSD(lp, params, y_value, total_size);
+	lpSplitConstraint_RS(lp, params, y_value, count1, count2, total_size);
+	lpInitialArea(lp, params);
+	lpK_BudgetConstraint(lp, params, total_size);
+	lpBoundaryConstraint(lp, params);
+	if (make_bin)
+		lpVariableBinary(lp, params, included_area);
 }
 
-void PDNetwork::transformMinK_Area2(Params &params, const char *outfile, double pd_proportion, bool make_bin) {
+void PDNetwork::transformMinK_Area2(Params &params, ILPSolver &lp, double pd_proportion, bool make_bin) {
 	int nareas = getNAreas();
 	Split included_area(nareas);
 	IntVector::iterator it2;
 	for (it2 = initialareas.begin(); it2 != initialareas.end(); it2++)
 		included_area.addTaxon(*it2);
-	try {
-		ofstream out;
-		out.exceptions(ios::failbit | ios::badbit);
-		out.open(outfile);
-		vector<int> y_value, count1, count2;
-		checkYValue_Area(0, y_value, count1, count2);
-
-		lpObjectiveMinK(out, params);
-		lpMinSDConstraint(out, params, y_value, pd_proportion);
-		lpSplitConstraint_RS(out, params, y_value, count1, count2, 0);
-		lpInitialArea(out, params);
-		lpBoundaryConstraint(out, params);
-		lpVariableBound(out, params, included_area, y_value);
-		if (make_bin)
-			lpVariableBinary(out, params, included_area);
-
-		out.close();
-		//cout << "Transformed LP problem printed to " << outfile << endl;
-	} catch (ios::failure) {
-		outError(ERR_WRITE_OUTPUT, outfile);
-	}
+	vector<int> y_value, count1, count2;
+	checkYValue_Area(0, y_value, count1, count2);
+
+	lpVariableBound(lp, params, included_area, y_value);
+	lpObjectiveMinK(lp, params);
+	lpMinSDConstraint(lp, params, y_value, pd_proportion);
+	lpSplitConstraint_RS(lp, params, y_value, count1, count2, 0);
+	lpInitialArea(lp, params);
+	lpBoundaryConstraint(lp, params);
+	if (make_bin)
+		lpVariableBinary(lp, params, included_area);
 }
 
 
@@ -949,14 +913,12 @@ double PDNetwork::findMinKArea_LP(Params &params, const char* filename, double p
 	int lp_ret, i;
 
 
+	ILPSolver lp;
 	if (!params.binary_programming) {
 		cout << " " << pd_proportion;
 		cout.flush();
-		transformMinK_Area2(params, filename, pd_proportion, false);
-		if (params.gurobi_format)
-			lp_ret = gurobi_solve((char*)filename, nareas, &score, variables, verbose_mode, params.gurobi_threads);
-		else
-			lp_ret = lp_solve((char*)filename, nareas, &score, variables, verbose_mode);
+		transformMinK_Area2(params, lp, pd_proportion, false);
+		lp_ret = solveILP(params, lp, filename, nareas, &score, variables);
 	} else lp_ret = 7;
 	if (lp_ret != 0 && lp_ret != 7)
 		outError("Something went wrong with LP solver!");
@@ -964,13 +926,10 @@ double PDNetwork::findMinKArea_LP(Params &params, const char* filename, double p
 		cout << " " << pd_proportion << "(bin)";
 		cout.flush();
 		if (params.binary_programming)
-			transformMinK_Area2(params, filename, pd_proportion, true);
+			transformMinK_Area2(params, lp, pd_proportion, true);
 		else
-			lpVariableBinary(filename, params, initialareas);
-		if (params.gurobi_format)
-			lp_ret = gurobi_solve((char*)filename, nareas, &score, variables, verbose_mode, params.gurobi_threads);
-		else
-			lp_ret = lp_solve((char*)filename, nareas, &score, variables, verbose_mode);
+			lpVariableBinary(lp, params, initialareas);
+		lp_ret = solveILP(params, lp, filename, nareas, &score, variables);
 		if (lp_ret != 0) // check error again without allowing non-binary
 			outError("Something went wrong with LP solver!");
 	}	
@@ -1234,6 +1193,8 @@ void PDNetwork::findPDArea_LP(Params &params, vector<SplitSet> &areas_set) {
 	}
 
 	IntVector list_k;
+	// optimal areas of the previous budget, still feasible for the next one: warm start
+	DoubleVector last_solution;
 
 	if (isBudgetConstraint()) { // non-budget case
 		min_k = params.min_budget;
@@ -1257,14 +1218,12 @@ void PDNetwork::findPDArea_LP(Params &params, vector<SplitSet> &areas_set) {
 	for (k = min_k; k <= max_k; k += step_k) {
 		if (!list_k[k]) continue;
 		index = (k - min_k) / step_k;
+		ILPSolver lp;
 		if (!params.binary_programming) {
 			cout << " " << k;
 			cout.flush();
-			transformLP_Area2(params, ofile.c_str(), k, false);
-			if (params.gurobi_format)
-				lp_ret = gurobi_solve((char*)ofile.c_str(), nareas, &score, variables, verbose_mode, params.gurobi_threads);
-			else
-				lp_ret = lp_solve((char*)ofile.c_str(), nareas, &score, variables, verbose_mode);
+			transformLP_Area2(params, lp, k, false);
+			lp_ret = solveILP(params, lp, ofile.c_str(), nareas, &score, variables);
 		} else lp_ret = 7;
 
 		if (lp_ret != 0 && lp_ret != 7)
@@ -1273,16 +1232,15 @@ void PDNetwork::findPDArea_LP(Params &params, vector<SplitSet> &areas_set) {
 			cout << " " << k << "(bin)";
 			cout.flush();
 			if (params.binary_programming)
-				transformLP_Area2(params, ofile.c_str(), k, true);
+				transformLP_Area2(params, lp, k, true);
 			else
-				lpVariableBinary(ofile.c_str(), params, initialareas);
-			if (params.gurobi_format)
-				lp_ret = gurobi_solve((char*)ofile.c_str(), nareas, &score, variables, verbose_mode, params.gurobi_threads);
-			else
-				lp_ret = lp_solve((char*)ofile.c_str(), nareas, &score, variables, verbose_mode);
+				lpVariableBinary(lp, params, initialareas);
+			lp_ret = solveILP(params, lp, ofile.c_str(), nareas, &score, variables,
+				last_solution.empty() ? NULL : &last_solution[0]);
 			if (lp_ret != 0) // check error again without allowing non-binary
 				outError("Something went wrong with LP solver!");
 		}	
+		last_solution.assign(variables, variables + nareas);
 
 		Split *area = new Split(nareas, score);
 		for (i = 0; i < nareas; i++)
@@ -1333,7 +1291,7 @@ bool PDNetwork::isUniquelyCovered(int taxon, int &area) {
 }
 
 
-void PDNetwork::transformLP_Area_Coverage(const char *outfile, Params &params, Split &included_area) {
+void PDNetwork::transformLP_Area_Coverage(ILPSolver &lp, Params &params, Split &included_area) {
 	int ntaxa = getNTaxa();
 	int nareas = getNAreas();
 	int i, j;
@@ -1352,39 +1310,21 @@ void PDNetwork::transformLP_Area_Coverage(const char *outfile, Params &params, S
 			tax_cover.addTaxon(j);
 		}
 	}	
-	try {
-		ofstream out;
-		out.exceptions(ios::failbit | ios::badbit);
-		out.open(outfile);
-		iterator spit;
-
-		lpObjectiveMinK(out, params);
+	// add bound for variable x
+	IntVector y_value;
+	lpVariableBound(lp, params, included_area, y_value);
+	lpObjectiveMinK(lp, params);
 
-		// add constraint: every taxon should be covered by some area
-		for (j = 0; j < ntaxa; j++) {
-			if (tax_cover.containTaxon(j)) continue;
-			bool ok = false;
-			for (i = 0; i < nareas; i++)
-				if (area_taxa[i]->containTaxon(j)) {
-					out << " +x" << i;
-					ok = true;
-				}
-			if (!ok) continue;
-			out << " >= 1";
-			if (params.gurobi_format)
-				out << endl;
-			else
-				out << ";" << endl;
-		}
-		lpBoundaryConstraint(out, params);
-
-		// add bound for variable x
-		IntVector y_value;
-		lpVariableBound(out, params, included_area, y_value);
-		out.close();
-	} catch (ios::failure) {
-		outError(ERR_WRITE_OUTPUT, outfile);
+	// add constraint: every taxon should be covered by some area
+	for (j = 0; j < ntaxa; j++) {
+		if (tax_cover.containTaxon(j)) continue;
+		ILPConstraint row('G', 1.0);
+		for (i = 0; i < nareas; i++)
+			if (area_taxa[i]->containTaxon(j))
+				row.addTerm(i, 1.0);
+		lp.addConstraint(row);
 	}
+	lpBoundaryConstraint(lp, params);
 }
 
 
@@ -1396,22 +1336,15 @@ int PDNetwork::findMinAreas(Params &params, Split &area_id) {
 	double *variables = new double[nareas];
 	double score;
 	Split included_area(nareas);
-	transformLP_Area_Coverage(ofile.c_str(), params, included_area);
-	int lp_ret;
-	if (params.gurobi_format)
-		lp_ret = gurobi_solve((char*)ofile.c_str(), nareas, &score, variables, verbose_mode, params.gurobi_threads);
-	else
-		lp_ret = lp_solve((char*)ofile.c_str(), nareas, &score, variables, verbose_mode);
+	ILPSolver lp;
+	transformLP_Area_Coverage(lp, params, included_area);
+	int lp_ret = solveILP(params, lp, ofile.c_str(), nareas, &score, variables);
 
 	if (lp_ret != 0 && lp_ret != 7)
 		outError("Something went wrong with LP solver!");
 	if (lp_ret == 7) { // fail with non-binary case, do again with strict binary
-		lpVariableBinary(ofile.c_str(), params, included_area);
-				
-		if (params.gurobi_format)
-			lp_ret = gurobi_solve((char*)ofile.c_str(), nareas, &score, variables, verbose_mode, params.gurobi_threads);
-		else
-			lp_ret = lp_solve((char*)ofile.c_str(), nareas, &score, variables, verbose_mode);
+		lpVariableBinary(lp, params, included_area);
+		lp_ret = solveILP(params, lp, ofile.c_str(), nareas, &score, variables);
 		if (lp_ret != 0) // check error again without allowing non-binary
 			outError("Something went wrong with LP solver!");
 	}
@@ -1480,72 +1413,64 @@ bool PDNetwork::checkAreaCoverage() {
 ***********************************************/
 
 
-void PDNetwork::lpObjectiveMaxSD(ostream &out, Params &params, IntVector &y_value, int total_size) {
+/**
+	@return index of the LP variable y<i> for split i
+*/
+static int lpSplitVariable(ILPSolver &lp, int i) {
+	return lp.findVariable("y" + convertIntToString(i));
+}
+
+/**
+	@return index of the LP variable y<i>_<j> for the boundary shared by areas i and j
+*/
+static int lpBoundaryVariable(ILPSolver &lp, int i, int j) {
+	return lp.findVariable("y" + convertIntToString(i) + "_" + convertIntToString(j));
+}
+
+void PDNetwork::lpObjectiveMaxSD(ILPSolver &lp, Params &params, IntVector &y_value, int total_size) {
 	//IntVector y_value, count1, count2;
 	iterator spit;
 	int i;
 	// define the objective function
-	if (params.gurobi_format)
-		out << "Maximize" << endl;
-	else
-		out << "max: ";
+	lp.maximize = true;
 	
 	for (spit = begin(),i=0; spit != end(); spit++,i++)	{
 		if (y_value[i] < 0)
-			out << " +" << (*spit)->getWeight() << " y" << i;
+			lp.obj_coef[lpSplitVariable(lp, i)] += (*spit)->getWeight();
 		else if (y_value[i] >= 2)
-			out << " +" << (*spit)->getWeight() << " x" << y_value[i] - 2;
+			lp.obj_coef[y_value[i] - 2] += (*spit)->getWeight();
 	}
-
-	if (params.gurobi_format)
-		out << endl << "Subject to" << endl;
-	else
-		out << ";" << endl;
 }
 
 ///// TODO FOR taxon selection
-void PDNetwork::lpObjectiveMinK(ostream &out, Params &params) {
+void PDNetwork::lpObjectiveMinK(ILPSolver &lp, Params &params) {
 	iterator spit;
 	int i, j;
 	int nareas = area_taxa.size();
 
 	// define the objective function
-	if (params.gurobi_format)
-		out << "Minimize" << endl;
-	else
-		out << "min: ";
+	lp.maximize = false;
 	
 	for (j = 0; j < nareas; j++) {
 		double coeff = (isBudgetConstraint()) ? getPdaBlock()->getCost(j) : 1.0;
 		if (areas_boundary) coeff += areas_boundary[j*nareas+j] * params.boundary_modifier;
-		out << ((j>0) ? " +" : "") << coeff << " x" << j;
-
-
+		lp.obj_coef[j] += coeff;
 	}
 
 	if (areas_boundary && params.boundary_modifier != 0.0) {
-		if (params.quad_programming)
-			out << " + [";
 		for (i = 0; i < nareas-1; i++) 
 		for (j = i+1; j < nareas; j++) 
 		if (areas_boundary[i*nareas+j] > 0.0) {
 			double coeff = 2*areas_boundary[i*nareas+j] * params.boundary_modifier;
 			if (params.quad_programming)
-				out << " -" << coeff << " x" << i << " * x" << j;
+				lp.addQuadObjective(i, j, -coeff);
 			else
-				out << " -" << coeff << " y" << i << "_" << j;
+				lp.obj_coef[lpBoundaryVariable(lp, i, j)] -= coeff;
 		}
-		if (params.quad_programming)
-			out << " ] / 2";
 	}
-
-	if (params.gurobi_format)
-		out << endl << "Subject to" << endl;
-	else
-		out << ";" << endl;
 }
 
-void PDNetwork::lpK_BudgetConstraint(ostream &out, Params &params, int total_size) {
+void PDNetwork::lpK_BudgetConstraint(ILPSolver &lp, Params &params, int total_size) {
 
 	int nvars;
 	int i, j;
@@ -1554,11 +1479,11 @@ void PDNetwork::lpK_BudgetConstraint(ostream &out, Params &params, int total_siz
 	else
 		nvars = getNTaxa();
 
+	ILPConstraint row('L', total_size);
 	for (j = 0; j < nvars; j++) {
 		double coeff = (isBudgetConstraint()) ? getPdaBlock()->getCost(j) : 1.0;
 		if (areas_boundary) coeff += areas_boundary[j*nvars+j] * params.boundary_modifier;
-		out << ((j>0) ? " +" : "") << coeff << " x" << j;
-		
+		row.addTerm(j, coeff);
 	}
 	
 	if (areas_boundary && params.boundary_modifier != 0.0) {
@@ -1566,31 +1491,17 @@ void PDNetwork::lpK_BudgetConstraint(ostream &out, Params &params, int total_siz
 		for (j = i+1; j < nvars; j++) 
 		if (areas_boundary[i*nvars+j] > 0.0) {
 			double coeff = 2*areas_boundary[i*nvars+j] * params.boundary_modifier;
-				out << " -" << coeff << " y" << i << "_" << j;
+			int y = lpBoundaryVariable(lp, i, j);
+			if (y < 0) // no bound with -qp
+				y = lp.addVariable("y" + convertIntToString(i) + "_" + convertIntToString(j),
+					0.0, numeric_limits<double>::infinity());
+			row.addTerm(y, -coeff);
 		}
 	}
-	out << " <= " << total_size;
-	
-	// constraint for k-set or total budget
-	/*
-	if (isBudgetConstraint()) {
-		for (j = 0; j < nvars; j++) {
-			out << ((j==0)? "" : " +") << getPdaBlock()->getCost(j) << " x" << j;
-		}
-		out << " <= " << total_size;
-	} else {
-		for (j = 0; j < nvars; j++) {
-			out << ((j==0)? "" : " +") << "x" << j;
-		}
-		out  << " = " << total_size;
-	}*/
-	if (params.gurobi_format)
-		out << endl;
-	else
-		out << ";" << endl;
+	lp.addConstraint(row);
 }
 
-void PDNetwork::lpBoundaryConstraint(ostream &out, Params &params) {
+void PDNetwork::lpBoundaryConstraint(ILPSolver &lp, Params &params) {
 	// constraint on the variable for the shared boundary between areas
 	if (!areas_boundary || params.boundary_modifier == 0.0) 
 		return;
@@ -1601,20 +1512,19 @@ void PDNetwork::lpBoundaryConstraint(ostream &out, Params &params) {
 	for (i = 0; i < nareas-1; i++)
 		for (j = i+1; j < nareas; j++)
 			if (areas_boundary[i*nareas+j] > 0.0) {
-				out << "x" << i << " - y" << i << "_" << j << " >= 0";
-				if (params.gurobi_format)
-					out << endl;
-				else
-					out << ";" << endl;
-				out << "x" << j << " - y" << i << "_" << j << " >= 0";
-				if (params.gurobi_format)
-					out << endl;
-				else
-					out << ";" << endl;
+				int y = lpBoundaryVariable(lp, i, j);
+				ILPConstraint row1('G', 0.0);
+				row1.addTerm(i, 1.0);
+				row1.addTerm(y, -1.0);
+				lp.addConstraint(row1);
+				ILPConstraint row2('G', 0.0);
+				row2.addTerm(j, 1.0);
+				row2.addTerm(y, -1.0);
+				lp.addConstraint(row2);
 			}
 }
 
-void PDNetwork::lpSplitConstraint_RS(ostream &out, Params &params, IntVector &y_value, IntVector &count1, IntVector &count2, int total_size) {
+void PDNetwork::lpSplitConstraint_RS(ILPSolver &lp, Params &params, IntVector &y_value, IntVector &count1, IntVector &count2, int total_size) {
 	iterator spit;
 	int i,j;
 	//int root_id = -1;
@@ -1629,47 +1539,29 @@ void PDNetwork::lpSplitConstraint_RS(ostream &out, Params &params, IntVector &y_
 
 		if (count1[i] < nareas && (isBudgetConstraint() || count1[i] <= nareas - total_size))
 		{
-			out << "y" << i;
-			if (!params.gurobi_format)
-				out << " <=";
-			for (j = 0; j < nareas; j++) {
-				if (sp->overlap(*area_taxa[j])) {
-					if (params.gurobi_format)
-						out << " -x" << j;
-					else
-						out << " +x" << j;
-				}
-			}
-			if (params.gurobi_format)
-				out << " <= 0" << endl;
-			else
-				out << ";" << endl;
+			ILPConstraint row('L', 0.0);
+			row.addTerm(lpSplitVariable(lp, i), 1.0);
+			for (j = 0; j < nareas; j++)
+				if (sp->overlap(*area_taxa[j]))
+					row.addTerm(j, -1.0);
+			lp.addConstraint(row);
 		}
 
 		if (count2[i] < nareas && (isBudgetConstraint() || count2[i] <= nareas - total_size))
 		{
 			sp->invert(); // scan the invert
-			out << "y" << i;
-			if (!params.gurobi_format)
-				out << " <=";
-			for (j = 0; j < nareas; j++) {
-				if (sp->overlap(*area_taxa[j])) {
-					if (params.gurobi_format)
-						out << " -x" << j;
-					else
-						out << " +x" << j;
-				}
-			}
-			if (params.gurobi_format)
-				out << " <= 0" << endl;
-			else
-				out << ";" << endl;
+			ILPConstraint row('L', 0.0);
+			row.addTerm(lpSplitVariable(lp, i), 1.0);
+			for (j = 0; j < nareas; j++)
+				if (sp->overlap(*area_taxa[j]))
+					row.addTerm(j, -1.0);
+			lp.addConstraint(row);
 			sp->invert(); // invert back to original
 		}
 	}
 }
 
-void PDNetwork::lpSplitConstraint_TS(ostream &out, Params &params, IntVector &y_value, int total_size) {
+void PDNetwork::lpSplitConstraint_TS(ILPSolver &lp, Params &params, IntVector &y_value, int total_size) {
 	iterator spit;
 	int i,j;
 	int ntaxa = getNTaxa();
@@ -1681,15 +1573,12 @@ void PDNetwork::lpSplitConstraint_TS(ostream &out, Params &params, IntVector &y_
 		bool contain_initset = sp->containAny(initialset);
 
 		if (!contain_initset && (isBudgetConstraint() || sp->countTaxa() <= ntaxa - total_size)) {
-			out << "y" << i;
+			ILPConstraint row('L', 0.0);
+			row.addTerm(lpSplitVariable(lp, i), 1.0);
 			for (j = 0; j < ntaxa; j++)
 				if (sp->containTaxon(j))
-					out << " -x" << j;
-			out << " <= 0";
-			if (params.gurobi_format)
-				out << endl;
-			else
-				out << ";" << endl;
+					row.addTerm(j, -1.0);
+			lp.addConstraint(row);
 		}
 		contain_initset = false;
 		if (initialset.size() > 0) {
@@ -1698,21 +1587,18 @@ void PDNetwork::lpSplitConstraint_TS(ostream &out, Params &params, IntVector &y_
 			sp->invert();
 		}
 		if (!contain_initset && (isBudgetConstraint() || sp->countTaxa() >= total_size)) {
-			out << "y" << i;
+			ILPConstraint row('L', 0.0);
+			row.addTerm(lpSplitVariable(lp, i), 1.0);
 			for (j = 0; j < ntaxa; j++) 
 				if (!sp->containTaxon(j)) 
-					out << " -x" << j;
-			out << " <= 0";
-			if (params.gurobi_format)
-				out << endl;
-			else
-				out << ";" << endl;
+					row.addTerm(j, -1.0);
+			lp.addConstraint(row);
 		}
 	}
 }
 
 
-void PDNetwork::lpMinSDConstraint(ostream &out, Params &params, IntVector &y_value, double pd_proportion) {
+void PDNetwork::lpMinSDConstraint(ILPSolver &lp, Params &params, IntVector &y_value, double pd_proportion) {
 	iterator spit;
 	int i;
 	double total_weight = calcWeight();
@@ -1720,76 +1606,41 @@ void PDNetwork::lpMinSDConstraint(ostream &out, Params &params, IntVector &y_val
 	if (required_sd > total_weight) required_sd = total_weight;
 	required_sd -= 1e-6;
 	// adding constraint for min conserved PD proportion
+	ILPConstraint row('G', 0.0);
 	for (spit = begin(),i=0; spit != end(); spit++,i++)	{
 		if (y_value[i] < 0)
-			out << " +" << (*spit)->getWeight() << " y" << i;
+			row.addTerm(lpSplitVariable(lp, i), (*spit)->getWeight());
 		else if (y_value[i] >= 2)
-			out << " +" << (*spit)->getWeight() << " x" << y_value[i] - 2;
+			row.addTerm(y_value[i] - 2, (*spit)->getWeight());
 		else if (y_value[i] == 1) required_sd -= (*spit)->getWeight();
 	}
-	out.precision(12);
-	out << " >= " << required_sd;
-	out.precision(6);
-
-	if (params.gurobi_format)
-		out << endl;
-	else
-		out << ";" << endl;
+	row.rhs = required_sd;
+	lp.addConstraint(row);
 }
 
-void PDNetwork::lpVariableBound(ostream &out, Params &params, Split &included_vars, IntVector &y_value) {
-	IntVector::iterator it2;
+void PDNetwork::lpVariableBound(ILPSolver &lp, Params &params, Split &included_vars, IntVector &y_value) {
 	int i, j;
-	// define the variable boundary
-
-	if (params.gurobi_format)
-		out << "Bounds" << endl;
+	// define the variables with their boundary, x<j> gets index j
 
-
-	for (j = 0; j < included_vars.getNTaxa(); j++) {
-		if (included_vars.containTaxon(j)) {
-			out << "x" << j << " = 1";
-		} else {
-			if (params.gurobi_format)
-				out << "0 <= ";
-			out << "x" << j << " <= 1";
-		}		
-		if (params.gurobi_format)
-			out << endl;
-		else
-			out << ";" << endl;
-	}
+	for (j = 0; j < included_vars.getNTaxa(); j++)
+		lp.addVariable("x" + convertIntToString(j), included_vars.containTaxon(j) ? 1.0 : 0.0, 1.0);
 
 	if (!y_value.empty()) {
 		for (i = 0; i < getNSplits(); i++) {
 			if (y_value[i] >= 0) continue;
-			if (params.gurobi_format)
-				out << "0 <= ";
-			out << "y" << i << " <= 1";
-			if (params.gurobi_format)
-				out << endl;
-			else
-				out << ";" << endl;
+			lp.addVariable("y" + convertIntToString(i));
 		}
 	}
 	int nvars = included_vars.getNTaxa();
 	if (areas_boundary && params.boundary_modifier != 0.0 && !params.quad_programming) {
 		for (i = 0; i < included_vars.getNTaxa()-1; i++)
 		for (j = i+1; j < included_vars.getNTaxa(); j++) 
-			if (areas_boundary[i*nvars+j] > 0.0) {
-				if (params.gurobi_format)
-					out << "0 <= ";
-				out << "y" << i << "_" << j << " <= 1";
-				if (params.gurobi_format)
-					out << endl;
-				else
-					out << ";" << endl;
-				
-			}
+			if (areas_boundary[i*nvars+j] > 0.0)
+				lp.addVariable("y" + convertIntToString(i) + "_" + convertIntToString(j));
 	}
 }
 
-void PDNetwork::lpVariableBinary(ostream &out, Params &params, Split &included_vars) {
+void PDNetwork::lpVariableBinary(ILPSolver &lp, Params &params, Split &included_vars) {
 	int nvars;
 	int j;
 	if (isPDArea())
@@ -1797,49 +1648,14 @@ void PDNetwork::lpVariableBinary(ostream &out, Params &params, Split &included_v
 	else
 		nvars = getNTaxa();
 
-	bool first = true;
 	for (j = 0; j < nvars; j++) {
 		if (included_vars.containTaxon(j)) continue;
-		if (params.gurobi_format) {
-			if (!first)
-				out << " ";
-			else 
-				out << "Binary" << endl;
-		} else {
-			if (!first) 
-				out << ", ";
-			else
-				out << "bin ";
-		}
-		out << "x" << j;
-		first = false;
+		lp.var_int[j] = true;
 	}
-	if (!first) {
-		if (params.gurobi_format)
-			out << endl;
-		else
-			out << ";" << endl;
-	}
-}
-
-
-/**
-	add binary variables
-*/
-void PDNetwork::lpVariableBinary(const char *outfile, Params &params, Split &included_vars) {
-	try {
-		ofstream out;
-		out.exceptions(ios::failbit | ios::badbit);
-		out.open(outfile, ios::app);
-		lpVariableBinary(out, params, included_vars);
-		out.close();
-	} catch (ios::failure) {
-		outError(ERR_WRITE_OUTPUT, outfile);
-	}	
 }
 
 
-void PDNetwork::lpVariableBinary(const char *outfile, Params &params, IntVector &initialset) {
+void PDNetwork::lpVariableBinary(ILPSolver &lp, Params &params, IntVector &initialset) {
 	int nvars;
 	if (isPDArea())
 		nvars = area_taxa.size();
@@ -1848,10 +1664,10 @@ void PDNetwork::lpVariableBinary(const char *outfile, Params &params, IntVector
 	Split included_vars(nvars);
 	for (IntVector::iterator it2 = initialset.begin(); it2 != initialset.end(); it2++)
 		included_vars.addTaxon(*it2);
-	lpVariableBinary(outfile, params, included_vars);
+	lpVariableBinary(lp, params, included_vars);
 }
 
-void PDNetwork::lpInitialArea(ostream &out, Params &params) {
+void PDNetwork::lpInitialArea(ILPSolver &lp, Params &params) {
 	int nareas = getNAreas();
 	int j;
 
@@ -1859,20 +1675,14 @@ void PDNetwork::lpInitialArea(ostream &out, Params &params) {
 	for (IntVector::iterator it = initialset.begin(); it != initialset.end(); it++) {
 		if (it == initialset.begin() && (params.root || params.is_rooted)) // ignore the root
 			continue;
-		out << "1 <= ";
-		bool ok = false;
+		ILPConstraint row('G', 1.0);
 		for (j = 0; j < nareas; j++)
-			if (area_taxa[j]->containTaxon(*it)) {
-				out << " +x" << j;
-				ok = true;
-			}
-		if (params.gurobi_format)
-			out << endl;
-		else
-			out << ";" << endl;
-		if (!ok) {
+			if (area_taxa[j]->containTaxon(*it))
+				row.addTerm(j, 1.0);
+		if (row.var.empty()) {
 			outError("No area contains taxon ", taxa->GetTaxonLabel(*it));
 		}
+		lp.addConstraint(row);
 	}
 }
 
@@ -21,6 +21,7 @@
 #define PDNETWORK_H
 
 #include "splitgraph.h"
+#include "ilpsolver.h"
 
 /**
 General Split Network for Phylogenetic Diversity Algorithm
@@ -173,35 +174,35 @@ public:
 
 
 	/**
-		transform the problem into an Integer Linear Programming and write to .lp file
+		transform the problem into an Integer Linear Programming
 		@param params program parameters
-		@param outfile name of output file in LP format
+		@param lp (OUT) the model to build
 		@param total_size k for PD_k or total budget
 		@param make_bin TRUE if creating binary programming
 	*/
 	void transformLP(Params &params, const char *outfile, int total_size, bool make_bin);
-	void transformLP2(Params &params, const char *outfile, int total_size, bool make_bin);
-	void transformEcoLP(Params &params, const char *outline, int total_size);
+	void transformLP2(Params &params, ILPSolver &lp, int total_size, bool make_bin);
+	void transformEcoLP(Params &params, ILPSolver &lp, int total_size);
 
 	/**
-		transform the problem into an Integer Linear Programming and write to .lp file
+		transform the problem into an Integer Linear Programming
 		@param params program parameters
-		@param outfile name of output file in LP format
+		@param lp (OUT) the model to build
 		@param total_size k for PD_k or total budget
 		@param make_bin TRUE if creating binary programming
 	*/
 	void transformLP_Area(Params &params, const char *outfile, int total_size, bool make_bin);
-	void transformLP_Area2(Params &params, const char *outfile, int total_size, bool make_bin);
+	void transformLP_Area2(Params &params, ILPSolver &lp, int total_size, bool make_bin);
 
 	/**
-		transform the problem into an Integer Linear Programming and write to .lp file
+		transform the problem into an Integer Linear Programming
 		@param params program parameters
-		@param outfile name of output file in LP format
+		@param lp (OUT) the model to build
 		@param pd_proportion minimum PD proprotion to be conserved
 		@param make_bin TRUE if creating binary programming
 	*/
 	void transformMinK_Area(Params &params, const char *outfile, double pd_proprotion, bool make_bin);
-	void transformMinK_Area2(Params &params, const char *outfile, double pd_proportion, bool make_bin);
+	void transformMinK_Area2(Params &params, ILPSolver &lp, double pd_proportion, bool make_bin);
 
 	/**
 		transform the PD problem into linear programming and solve it
@@ -231,11 +232,11 @@ public:
 	bool checkAreaCoverage();
 
 	/**
-		transform the problem into an Integer Linear Programming and write to .lp file
-		@param outfile name of output file in LP format
+		transform the problem into an Integer Linear Programming
+		@param lp (OUT) the model to build
 		@param included_area (OUT) collection of areas that should always be included
 	*/
-	void transformLP_Area_Coverage(const char *outfile, Params &params, Split &included_area);
+	void transformLP_Area_Coverage(ILPSolver &lp, Params &params, Split &included_area);
 
 
 	/**
@@ -388,26 +389,31 @@ protected:
 	*/
 	bool isUniquelyCovered(int taxon, int &area);
 
-	void lpObjectiveMaxSD(ostream &out, Params &params, IntVector &y_value, int total_size);
+	void lpObjectiveMaxSD(ILPSolver &lp, Params &params, IntVector &y_value, int total_size);
 
-	void lpObjectiveMinK(ostream &out, Params &params);
+	void lpObjectiveMinK(ILPSolver &lp, Params &params);
 
-	void lpSplitConstraint_RS(ostream &out, Params &params, IntVector &y_value, IntVector &count1, IntVector &count2, int total_size);
-	void lpSplitConstraint_TS(ostream &out, Params &params, IntVector &y_value, int total_size);
+	void lpSplitConstraint_RS(ILPSolver &lp, Params &params, IntVector &y_value, IntVector &count1, IntVector &count2, int total_size);
+	void lpSplitConstraint_TS(ILPSolver &lp, Params &params, IntVector &y_value, int total_size);
 
-	void lpK_BudgetConstraint(ostream &out, Params &params, int total_size);
+	void lpK_BudgetConstraint(ILPSolver &lp, Params &params, int total_size);
 
-	void lpMinSDConstraint(ostream &out, Params &params, IntVector &y_value, double pd_proportion);
+	void lpMinSDConstraint(ILPSolver &lp, Params &params, IntVector &y_value, double pd_proportion);
 
-	void lpVariableBound(ostream &out, Params &params, Split &included_vars, IntVector &y_value);
+	/**
+		add the x and y variables with their bounds to the model, must be called first
+		@param lp the model, where variable x<j> gets index j
+		@param included_vars the variables fixed to 1
+		@param y_value as computed by checkYValue(), empty for no y variables
+	*/
+	void lpVariableBound(ILPSolver &lp, Params &params, Split &included_vars, IntVector &y_value);
 
-	void lpBoundaryConstraint(ostream &out, Params &params);
+	void lpBoundaryConstraint(ILPSolver &lp, Params &params);
 
-	void lpVariableBinary(ostream &out, Params &params, Split &included_vars);
+	void lpVariableBinary(ILPSolver &lp, Params &params, Split &included_vars);
+	void lpVariableBinary(ILPSolver &lp, Params &params, IntVector &initialset);
 
-	void lpVariableBinary(const char *outfile, Params &params, Split &included_vars);
-	void lpVariableBinary(const char *outfile, Params &params, IntVector &initialset);
-	void lpInitialArea(ostream &out, Params &params);
+	void lpInitialArea(ILPSolver &lp, Params &params);
 
 	void computeFeasibleBudget(Params &params, IntVector &list_k);
 
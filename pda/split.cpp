@@ -21,6 +21,18 @@
  ***************************************************************************/
 #include "split.h"
 
+#if defined (__GNUC__) || defined(__clang__)
+#define split_popcount __builtin_popcount
+#else
+static inline uint32_t split_popcount (uint32_t a) {
+    uint32_t b = a - ((a >> 1) & 0x55555555);
+    uint32_t c = (b & 0x33333333) + ((b >> 2) & 0x33333333);
+    uint32_t d = (c + (c >> 4)) & 0x0F0F0F0F;
+    uint32_t e = d * 0x01010101;
+    return   e >> 24;
+}
+#endif
+
 Split::Split()
 		: vector<UINT>()
 {
@@ -92,9 +104,10 @@ Split::Split(int antaxa, double aweight, vector<int> taxa_list)
 void Split::invert() {
 	for (iterator uit = begin(); uit != end(); uit++)
 	{
-		int num_bits = (uit+1 == end()) ? ntaxa % UINT_BITS : UINT_BITS;
+		int num_bits = (uit+1 == end() && ntaxa % UINT_BITS != 0) ? ntaxa % UINT_BITS : UINT_BITS;
+		UINT mask = (num_bits == UINT_BITS) ? ~((UINT)0) : (((UINT)1 << num_bits) - 1);
 
-		*uit = (1 << (num_bits-1)) - 1 + (1 << (num_bits-1)) - (*uit);
+		*uit = mask & ~(*uit);
 	}
 }
 
@@ -132,6 +145,14 @@ int Split::countTaxa() const {
 	return count;
 }
 
+int Split::countDiffTaxa(Split &sp) {
+	ASSERT(sp.ntaxa == ntaxa);
+	int count = 0;
+	for (int i = 0; i < size(); i++)
+		count += split_popcount((*this)[i] ^ sp[i]);
+	return count;
+}
+
 void Split::report(ostream &out)
 {
 
@@ -102,6 +102,12 @@ public:
 	*/
 	int countTaxa() const;
 
+	/**
+		@param sp another split on the same taxa
+		@return number of taxa contained in exactly one of the two splits
+	*/
+	int countDiffTaxa(Split &sp);
+
 	/**
 		copy from another split
 	*/
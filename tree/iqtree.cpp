@@ -56,6 +56,8 @@ void IQTree::init() {
     nni_cutoff = -1e6;
     nni_sort = false;
     testNNI = false;
+    subsample_fraction = 1.0;
+    subsample_stalled = 0;
 //    print_tree_lh = false;
 //    write_intermediate_trees = 0;
 //    max_candidate_trees = 0;
@@ -146,6 +148,7 @@ void IQTree::saveCheckpoint() {
     PhyloTree::saveCheckpoint();
     CKP_SAVE(boot_consense_logl);
     CKP_SAVE(contree_rfdist);
+    CKP_SAVE(subsample_fraction);
 }
 
 void IQTree::restoreUFBoot(Checkpoint *checkpoint) {
@@ -215,6 +218,7 @@ void IQTree::restoreCheckpoint() {
 
     CKP_RESTORE(boot_consense_logl);
     CKP_RESTORE(contree_rfdist);
+    CKP_RESTORE(subsample_fraction);
 }
 
 void IQTree::initSettings(Params &params) {
@@ -627,6 +631,17 @@ void IQTree::computeInitialTree(LikelihoodKernel kernel) {
             else
                 fixed_number = wrapperFixNegativeBranch(false);
             break;
+        case STT_BME:
+            // BIONJ tree improved by balanced minimum evolution NNI and SPR moves
+            computeBioNJ(*params, aln, dist_file);
+            optimizeBME(params->bme_spr_radius);
+            cout << getRealTime() - start << " seconds" << endl;
+            params->numInitTrees = 1;
+            if (isSuperTree())
+                wrapperFixNegativeBranch(true);
+            else
+                fixed_number = wrapperFixNegativeBranch(false);
+            break;
         }
         initTree = getTreeString();
         CKP_SAVE(initTree);
@@ -1234,52 +1249,28 @@ int IQTree::assessQuartetParsimony(Node *leaf0, Node *leaf1, Node *leaf2, Node *
     return 1;
 }
 
-void IQTree::initializeBonus(PhyloNode *node, PhyloNode *dad) {
-    if (!node)
-        node = (PhyloNode*) root;
-    if (dad) {
-        PhyloNeighbor *node_nei = (PhyloNeighbor*) node->findNeighbor(dad);
-        PhyloNeighbor *dad_nei = (PhyloNeighbor*) dad->findNeighbor(node);
-        node_nei->lh_scale_factor = 0.0;
-        node_nei->partial_lh_computed = 0;
-        dad_nei->lh_scale_factor = 0.0;
-        dad_nei->partial_lh_computed = 0;
-    }
+double IQTree::computePartialBonus(double *bonus, double *partial_bonus, Node *node, Node* dad) {
+    int id = node->id * 3 + (node->findNeighborIt(dad) - node->neighbors.begin());
+    if (partial_bonus[id] >= 0.0)
+        return partial_bonus[id];
 
+    double sum = bonus[id];
     FOR_NEIGHBOR_IT(node, dad, it){
-    initializeBonus((PhyloNode*) ((*it)->node), node);
-}
-}
-
-void IQTree::raiseBonus(Neighbor *nei, Node *dad, double bonus) {
-    ((PhyloNeighbor*) nei)->lh_scale_factor += bonus;
-    if (verbose_mode >= VB_DEBUG)
-        cout << dad->id << " - " << nei->node->id << " : " << bonus << endl;
-
-    //  FOR_NEIGHBOR_IT(nei->node, dad, it)
-    //	raiseBonus((*it), nei->node, bonus);
-}
-
-double IQTree::computePartialBonus(Node *node, Node* dad) {
-    PhyloNeighbor *node_nei = (PhyloNeighbor*) node->findNeighbor(dad);
-    if (node_nei->partial_lh_computed)
-        return node_nei->lh_scale_factor;
-
-    FOR_NEIGHBOR_IT(node, dad, it){
-    node_nei->lh_scale_factor += computePartialBonus((*it)->node, node);
-}
-    node_nei->partial_lh_computed = 1;
-    return node_nei->lh_scale_factor;
+        sum += computePartialBonus(bonus, partial_bonus, (*it)->node, node);
+    }
+    partial_bonus[id] = sum;
+    return sum;
 }
 
-void IQTree::findBestBonus(double &best_score, NodeVector &best_nodes, NodeVector &best_dads, Node *node, Node *dad) {
+void IQTree::findBestBonus(double *bonus, double *partial_bonus, double &best_score, NodeVector &best_nodes,
+        NodeVector &best_dads, Node *node, Node *dad) {
     double score;
     if (!node)
         node = root;
     if (!dad) {
         best_score = 0;
     } else {
-        score = computePartialBonus(node, dad) + computePartialBonus(dad, node);
+        score = computePartialBonus(bonus, partial_bonus, node, dad) + computePartialBonus(bonus, partial_bonus, dad, node);
         if (score >= best_score) {
             if (score > best_score) {
                 best_score = score;
@@ -1293,15 +1284,16 @@ void IQTree::findBestBonus(double &best_score, NodeVector &best_nodes, NodeVecto
     }
 
     FOR_NEIGHBOR_IT(node, dad, it){
-    findBestBonus(best_score, best_nodes, best_dads, (*it)->node, node);
-}
+        findBestBonus(bonus, partial_bonus, best_score, best_nodes, best_dads, (*it)->node, node);
+    }
 }
 
-void IQTree::assessQuartets(vector<RepresentLeafSet*> &leaves_vec, PhyloNode *cur_root, PhyloNode *del_leaf) {
+void IQTree::assessQuartets(vector<RepresentLeafSet*> &leaves_vec, PhyloNode *cur_root, PhyloNode *del_leaf,
+        double *bonus) {
     const int MAX_DEGREE = 3;
     RepresentLeafSet * leaves[MAX_DEGREE];
-    double bonus[MAX_DEGREE];
-    memset(bonus, 0, MAX_DEGREE * sizeof(double));
+    double cur_bonus[MAX_DEGREE];
+    memset(cur_bonus, 0, MAX_DEGREE * sizeof(double));
     int cnt = 0;
 
     // only work for birfucating tree
@@ -1310,22 +1302,63 @@ void IQTree::assessQuartets(vector<RepresentLeafSet*> &leaves_vec, PhyloNode *cu
     // find the representative leaf set for three subtrees
 
     FOR_NEIGHBOR_IT(cur_root, NULL, it){
-    leaves[cnt] = findRepresentLeaves(leaves_vec, cnt, cur_root);
-    cnt++;
-}
-    for (RepresentLeafSet::iterator i0 = leaves[0]->begin(); i0 != leaves[0]->end(); i0++)
-        for (RepresentLeafSet::iterator i1 = leaves[1]->begin(); i1 != leaves[1]->end(); i1++)
-            for (RepresentLeafSet::iterator i2 = leaves[2]->begin(); i2 != leaves[2]->end(); i2++) {
-                int best_id;
-                if (iqp_assess_quartet == IQP_DISTANCE)
-                    best_id = assessQuartet((*i0)->leaf, (*i1)->leaf, (*i2)->leaf, del_leaf);
-                else
-                    best_id = assessQuartetParsimony((*i0)->leaf, (*i1)->leaf, (*i2)->leaf, del_leaf);
-                bonus[best_id] += 1.0;
-            }
+        leaves[cnt] = findRepresentLeaves(leaves_vec, cnt, cur_root);
+        cnt++;
+    }
+    if (iqp_assess_quartet == IQP_DISTANCE) {
+        // copy the needed distances into small blocks first, so that the triple loop
+        // does not stride through the whole distance matrix
+        ASSERT(dist_matrix);
+        size_t nseq = aln->getNSeq();
+        size_t n0 = leaves[0]->size(), n1 = leaves[1]->size(), n2 = leaves[2]->size();
+        IntVector ids[MAX_DEGREE];
+        for (cnt = 0; cnt < MAX_DEGREE; cnt++)
+            for (RepresentLeafSet::iterator rit = leaves[cnt]->begin(); rit != leaves[cnt]->end(); rit++)
+                ids[cnt].push_back((*rit)->leaf->id);
+        DoubleVector block(n0 + n1 + n2 + n0 * n1 + n0 * n2 + n1 * n2);
+        double *del_dist0 = &block[0], *del_dist1 = del_dist0 + n0, *del_dist2 = del_dist1 + n1;
+        double *dist01 = del_dist2 + n2, *dist02 = dist01 + n0 * n1, *dist12 = dist02 + n0 * n2;
+        size_t i0, i1, i2;
+        for (i0 = 0; i0 < n0; i0++) {
+            double *row = dist_matrix + ids[0][i0] * nseq;
+            del_dist0[i0] = row[del_leaf->id];
+            for (i1 = 0; i1 < n1; i1++)
+                dist01[i0 * n1 + i1] = row[ids[1][i1]];
+            for (i2 = 0; i2 < n2; i2++)
+                dist02[i0 * n2 + i2] = row[ids[2][i2]];
+        }
+        for (i1 = 0; i1 < n1; i1++) {
+            double *row = dist_matrix + ids[1][i1] * nseq;
+            del_dist1[i1] = row[del_leaf->id];
+            for (i2 = 0; i2 < n2; i2++)
+                dist12[i1 * n2 + i2] = row[ids[2][i2]];
+        }
+        for (i2 = 0; i2 < n2; i2++)
+            del_dist2[i2] = dist_matrix[ids[2][i2] * nseq + del_leaf->id];
+        // same decision as assessQuartet()
+        for (i0 = 0; i0 < n0; i0++)
+            for (i1 = 0; i1 < n1; i1++)
+                for (i2 = 0; i2 < n2; i2++) {
+                    double dist0 = del_dist0[i0] + dist12[i1 * n2 + i2];
+                    double dist1 = del_dist1[i1] + dist02[i0 * n2 + i2];
+                    double dist2 = del_dist2[i2] + dist01[i0 * n1 + i1];
+                    if (dist0 < dist1 && dist0 < dist2)
+                        cur_bonus[0] += 1.0;
+                    else if (dist1 < dist2)
+                        cur_bonus[1] += 1.0;
+                    else
+                        cur_bonus[2] += 1.0;
+                }
+    } else {
+        for (RepresentLeafSet::iterator i0 = leaves[0]->begin(); i0 != leaves[0]->end(); i0++)
+            for (RepresentLeafSet::iterator i1 = leaves[1]->begin(); i1 != leaves[1]->end(); i1++)
+                for (RepresentLeafSet::iterator i2 = leaves[2]->begin(); i2 != leaves[2]->end(); i2++) {
+                    int best_id = assessQuartetParsimony((*i0)->leaf, (*i1)->leaf, (*i2)->leaf, del_leaf);
+                    cur_bonus[best_id] += 1.0;
+                }
+    }
     for (cnt = 0; cnt < MAX_DEGREE; cnt++)
-        if (bonus[cnt] > 0.0)
-            raiseBonus(cur_root->neighbors[cnt], cur_root, bonus[cnt]);
+        bonus[cur_root->id * 3 + cnt] += cur_bonus[cnt];
 
 }
 
@@ -1370,37 +1403,93 @@ void IQTree::reinsertLeavesByParsimony(PhyloNodeVector &del_leaves) {
 }
 
 void IQTree::reinsertLeaves(PhyloNodeVector &del_leaves) {
-    PhyloNodeVector::iterator it_leaf;
-
     //int num_del_leaves = del_leaves.size();
     ASSERT(root->isLeaf());
 
-    for (it_leaf = del_leaves.begin(); it_leaf != del_leaves.end(); it_leaf++) {
-        if (verbose_mode >= VB_DEBUG)
-            cout << "Reinserting " << (*it_leaf)->name << " (" << (*it_leaf)->id << ")" << endl;
+    // Leaves are reinserted in batches of num_threads: their bonuses are scored in parallel on
+    // the same tree, and a leaf whose best branch lies within 'radius' nodes of one reinserted
+    // earlier in the batch is postponed to the next batch, as its representative leaf sets may
+    // have changed. With a single thread this is the plain one-by-one reinsertion.
+    int batch_size = max(num_threads, 1);
+    int radius = 2, k;
+    for (k = 1; k < k_represent; k *= 2)
+        radius++;
+    size_t bonus_size = nodeNum * 3;
+    PhyloNodeVector pending = del_leaves;
+
+    while (!pending.empty()) {
+        int num_leaves = min((int)pending.size(), batch_size);
+        int leaf;
         vector<RepresentLeafSet*> leaves_vec;
         leaves_vec.resize(nodeNum * 3, NULL);
-        initializeBonus();
         NodeVector nodes;
         getInternalNodes(nodes);
+        int num_nodes = nodes.size();
         if (verbose_mode >= VB_DEBUG)
             drawTree(cout, WT_BR_SCALE | WT_INT_NODE | WT_TAXON_ID | WT_NEWLINE | WT_BR_ID);
         //printTree(cout, WT_BR_LEN | WT_INT_NODE | WT_TAXON_ID | WT_NEWLINE);
-        for (NodeVector::iterator it = nodes.begin(); it != nodes.end(); it++) {
-            assessQuartets(leaves_vec, (PhyloNode*) (*it), (*it_leaf));
+        DoubleVector bonus(num_leaves * bonus_size, 0.0);
+        if (iqp_assess_quartet == IQP_DISTANCE) {
+            // representative leaf sets break ties at random, so build them serially
+            // in the order assessQuartets() would, then score all (leaf, node) pairs in parallel
+            for (NodeVector::iterator it = nodes.begin(); it != nodes.end(); it++)
+                for (k = 0; k < (*it)->degree(); k++)
+                    findRepresentLeaves(leaves_vec, k, (PhyloNode*) (*it));
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) num_threads(batch_size)
+#endif
+            for (int task = 0; task < num_leaves * num_nodes; task++) {
+                int task_leaf = task / num_nodes;
+                assessQuartets(leaves_vec, (PhyloNode*) nodes[task % num_nodes], pending[task_leaf],
+                        &bonus[task_leaf * bonus_size]);
+            }
+        } else {
+            // parsimony assessment draws random numbers
+            for (leaf = 0; leaf < num_leaves; leaf++)
+                for (NodeVector::iterator it = nodes.begin(); it != nodes.end(); it++)
+                    assessQuartets(leaves_vec, (PhyloNode*) (*it), pending[leaf], &bonus[leaf * bonus_size]);
+        }
+
+        BoolVector changed(nodeNum, false);
+        PhyloNodeVector postponed;
+        for (leaf = 0; leaf < num_leaves; leaf++) {
+            PhyloNode *del_leaf = pending[leaf];
+            if (verbose_mode >= VB_DEBUG)
+                cout << "Reinserting " << del_leaf->name << " (" << del_leaf->id << ")" << endl;
+            DoubleVector partial_bonus(bonus_size, -1.0);
+            NodeVector best_nodes, best_dads;
+            double best_bonus;
+            findBestBonus(&bonus[leaf * bonus_size], &partial_bonus[0], best_bonus, best_nodes, best_dads);
+            if (verbose_mode >= VB_DEBUG)
+                cout << "Best bonus " << best_bonus << " " << best_nodes[0]->id << " " << best_dads[0]->id << endl;
+            ASSERT(best_nodes.size() == best_dads.size());
+            int node_id = random_int(best_nodes.size());
+            if (best_nodes.size() > 1 && verbose_mode >= VB_DEBUG)
+                cout << best_nodes.size() << " branches show the same best bonus, branch nr. " << node_id << " is chosen"
+                        << endl;
+            if (changed[best_nodes[node_id]->id] || changed[best_dads[node_id]->id]) {
+                postponed.push_back(del_leaf);
+                continue;
+            }
+
+            reinsertLeaf(del_leaf, best_nodes[node_id], best_dads[node_id]);
+            if (num_leaves == 1)
+                continue;
+            // mark the neighborhood of the reinserted leaf
+            NodeVector front;
+            front.push_back(del_leaf->neighbors[0]->node);
+            changed[front[0]->id] = true;
+            for (int dist = 0; dist < radius; dist++) {
+                NodeVector next;
+                for (NodeVector::iterator it = front.begin(); it != front.end(); it++)
+                    FOR_NEIGHBOR_IT(*it, NULL, nit)
+                        if (!changed[(*nit)->node->id]) {
+                            changed[(*nit)->node->id] = true;
+                            next.push_back((*nit)->node);
+                        }
+                front = next;
+            }
         }
-        NodeVector best_nodes, best_dads;
-        double best_bonus;
-        findBestBonus(best_bonus, best_nodes, best_dads);
-        if (verbose_mode >= VB_DEBUG)
-            cout << "Best bonus " << best_bonus << " " << best_nodes[0]->id << " " << best_dads[0]->id << endl;
-        ASSERT(best_nodes.size() == best_dads.size());
-        int node_id = random_int(best_nodes.size());
-        if (best_nodes.size() > 1 && verbose_mode >= VB_DEBUG)
-            cout << best_nodes.size() << " branches show the same best bonus, branch nr. " << node_id << " is chosen"
-                    << endl;
-
-        reinsertLeaf(*it_leaf, best_nodes[node_id], best_dads[node_id]);
         //clearRepresentLeaves(leaves_vec, *it_node, *it_leaf);
         /*if (verbose_mode >= VB_DEBUG) {
          printTree(cout);
@@ -1413,6 +1502,8 @@ void IQTree::reinsertLeaves(PhyloNodeVector &del_leaves) {
                     delete (*rlit);
                 delete (*rit);
             }
+        postponed.insert(postponed.end(), pending.begin() + num_leaves, pending.end());
+        pending = postponed;
     }
     initializeTree(); // BQM: re-index nodes and branches s.t. ping-pong neighbors have the same ID
 
@@ -1680,21 +1771,17 @@ void IQTree::doIQP() {
     //double time_begin = getCPUTime();
     PhyloNodeVector del_leaves;
     deleteLeaves(del_leaves);
+    // leaves keep their IDs and PhyloSuperTree::reinsertLeaves() already remaps the partition trees
     reinsertLeaves(del_leaves);
 
-    // just to make sure IQP does it right
-    setAlignment(aln);
     if (params->pll) {
     	pllReadNewick(getTreeString());
     }
 
+    // partial likelihood memory is assigned along the topology, so it has to be redone
     resetCurScore();
 //    lhComputed = false;
 
-    if (isSuperTree()) {
-        ((PhyloSuperTree*) this)->mapTrees();
-    }
-
 //    if (enable_parsimony) {
 //        cur_pars_score = computeParsimony();
 //        if (verbose_mode >= VB_MAX) {
@@ -2181,9 +2268,19 @@ double IQTree::doTreeSearch() {
     if (treesPerProc < 1 && params->numInitTrees > candidateTrees.size())
         treesPerProc = 1;
 
+    /* Start on a pattern subsample, restored from checkpoint when resuming the search */
+    if (canSubsamplePatterns()) {
+        if (!getCheckpoint()->getBool("finishedCandidateSet"))
+            subsample_fraction = params->pattern_subsample;
+        if (subsample_fraction < 1.0)
+            setSearchSubsample(subsample_fraction);
+    }
+
     /* Initialize candidate tree set */
     if (!getCheckpoint()->getBool("finishedCandidateSet")) {
         initCandidateTreeSet(treesPerProc, params->numNNITrees);
+        if (isPatternSubsample())
+            updateSubsampleBest();
         // write best tree to disk
         printBestCandidateTree();
         saveCheckpoint();
@@ -2279,9 +2376,14 @@ double IQTree::doTreeSearch() {
         nniInfos = doNNISearch();
         curTree = getTreeString();
         int pos = addTreeToCandidateSet(curTree, curScore, true, MPIHelper::getInstance().getProcessID());
+        if (stop_rule.isPredicting())
+            stop_rule.addIterationInfo(candidateTrees.getBestScore(), nniInfos.first, pos >= 0);
         if (pos != -2 && pos != -1 && (Params::getInstance().fixStableSplits || Params::getInstance().adaptPertubation))
             candidateTrees.computeSplitOccurences(Params::getInstance().stableSplitThreshold);
 
+        if (isPatternSubsample())
+            checkSearchSubsample();
+
         if (MPIHelper::getInstance().isWorker() || MPIHelper::getInstance().gotMessage())
             syncCurrentTree();
 
@@ -2374,6 +2476,10 @@ double IQTree::doTreeSearch() {
     if (optimization_looped)
         sendStopMessage();
 
+    // stopped before the subsample reached the full data
+    if (isPatternSubsample())
+        setSearchSubsample(1.0);
+
     readTreeString(candidateTrees.getBestTreeStrings()[0]);
 
     if (testNNI)
@@ -2794,6 +2900,8 @@ void IQTree::printIterationInfo(int sourceProcID) {
             if (stop_rule.getCurIt() > 20) {
                 cout << " (" << convert_time(realtime_remaining) << " left)";
             }
+            if (params->stop_improve_prob > 0.0)
+                cout << " / P(better tree): " << stop_rule.getImproveProbability(params->unsuccess_iteration);
             if (MPIHelper::getInstance().getNumProcesses() > 1)
                 cout << " / Process: " << sourceProcID;
             cout << endl;
@@ -2874,6 +2982,112 @@ double IQTree::doTreePerturbation() {
     return curScore;
 }
 
+bool IQTree::canSubsamplePatterns() {
+    if (params->pattern_subsample <= 0.0)
+        return false;
+    string reason;
+    if (isSuperTree())
+        reason = "partition models";
+    else if (params->pll)
+        reason = "-pll";
+    else if (params->gbo_replicates > 0)
+        reason = "ultrafast bootstrap";
+    else if (iqp_assess_quartet == IQP_BOOTSTRAP)
+        reason = "bootstrap quartet assessment";
+    else if (MPIHelper::getInstance().getNumProcesses() > 1)
+        reason = "MPI";
+    else if (!getModel()->isReversible())
+        reason = "non-reversible models";
+    else if (isMixlen())
+        reason = "mixture branch lengths";
+    else if (!getModelFactory()->unobserved_ptns.empty())
+        reason = "ascertainment bias correction";
+    if (!reason.empty()) {
+        outWarning("Pattern subsampling (-psub) is not supported with " + reason + ", use all patterns");
+        return false;
+    }
+    return true;
+}
+
+void IQTree::setSearchSubsample(double fraction) {
+    subsample_fraction = fraction;
+    int num_packets = setPatternSubsample(fraction);
+    if (isPatternSubsample())
+        cout << "Pattern subsample: " << num_packets << " of " << subsample_packets.size()
+             << " pattern blocks" << endl;
+    else
+        cout << "Pattern subsample: switch to all patterns" << endl;
+
+    subsample_stalled = 0;
+    subsample_best_ptn_lh.clear();
+    subsample_best_topo.clear();
+    if (candidateTrees.empty())
+        return;
+
+    vector<string> trees = candidateTrees.getBestTreeStrings();
+    if (!isPatternSubsample()) {
+        // model parameters were kept fixed on the subsamples
+        readTreeString(trees[0]);
+        optimizeModelParameters(false, params->modelEps * 10);
+        getModelFactory()->saveCheckpoint();
+    }
+    candidateTrees.clear();
+    for (vector<string>::iterator it = trees.begin(); it != trees.end(); it++) {
+        readTreeString(*it);
+        double score = optimizeAllBranches(1);
+        candidateTrees.update(getTreeString(), score);
+    }
+    cout << "Re-scored " << trees.size() << " candidate trees, best log-likelihood: "
+         << candidateTrees.getBestScore() << endl;
+    bestcandidate_changed = true;
+    if (isPatternSubsample())
+        updateSubsampleBest();
+}
+
+void IQTree::updateSubsampleBest() {
+    readTreeString(candidateTrees.getBestTreeStrings(1)[0]);
+    computeLogL();
+    subsample_best_ptn_lh.resize(getAlnNPattern());
+    computePatternLikelihood(&subsample_best_ptn_lh[0]);
+    subsample_best_topo = getTopologyString(false);
+}
+
+void IQTree::checkSearchSubsample() {
+    DoubleVector ptn_lh(getAlnNPattern());
+    computeLogL();
+    computePatternLikelihood(&ptn_lh[0]);
+    string topo = getTopologyString(false);
+    // the iteration stalls unless it finds a new best topology beyond the subsampling error
+    bool stalled = true;
+    if (curScore >= candidateTrees.getBestScore() && topo != subsample_best_topo) {
+        if (subsample_best_ptn_lh.empty())
+            stalled = false;
+        else {
+            double diff;
+            double error = computeSubsampleError(&ptn_lh[0], &subsample_best_ptn_lh[0], diff);
+            if (diff > SUBSAMPLE_ERROR_Z * error)
+                stalled = false;
+            else if (verbose_mode >= VB_MED)
+                cout << "Log-likelihood improvement " << diff << " is within subsampling error " << error << endl;
+        }
+        subsample_best_ptn_lh = ptn_lh;
+        subsample_best_topo = topo;
+    }
+    subsample_stalled = stalled ? subsample_stalled + 1 : 0;
+    if (subsample_stalled < max(params->unsuccess_iteration/4, 1))
+        return;
+    cout << "No significant improvement for " << subsample_stalled << " iterations, grow pattern subsample" << endl;
+    double fraction = subsample_fraction * SUBSAMPLE_GROWTH;
+    if (fraction > 1.0 / SUBSAMPLE_GROWTH)
+        fraction = 1.0;
+    setSearchSubsample(fraction);
+    // each subsample starts with a new budget of unsuccessful iterations, the full data
+    // with half of it, as the candidate trees were already optimized on the subsamples
+    int restart_iter = stop_rule.getCurIt() - (isPatternSubsample() ? 0 : params->unsuccess_iteration/2);
+    if (restart_iter > stop_rule.getLastImprovedIteration())
+        stop_rule.addImprovedIteration(restart_iter);
+}
+
 /****************************************************************************
  Fast Nearest Neighbor Interchange by maximum likelihood
  ****************************************************************************/
@@ -2896,6 +3110,15 @@ pair<int, int> IQTree::doNNISearch() {
         readTreeString(string(pllInst->tree_string));
     } else {
         nniInfos = optimizeNNI(Params::getInstance().speednni);
+        // escape the NNI local optimum by lazy SPR moves, then polish by NNI again
+        while (params->lazy_spr_radius > 0 && !isSuperTree()) {
+            double nni_score = curScore;
+            if (optimizeLazySPR(nni_score, params->lazy_spr_radius, params->lazy_spr_moves) <= nni_score + params->loglh_epsilon)
+                break;
+            pair<int, int> spr_nni = optimizeNNI(Params::getInstance().speednni);
+            nniInfos.first += spr_nni.first;
+            nniInfos.second += spr_nni.second;
+        }
         if (isSuperTree()) {
             ((PhyloSuperTree*) this)->computeBranchLengths();
         }
@@ -2903,7 +3126,8 @@ pair<int, int> IQTree::doNNISearch() {
             computePatternCategories();
     }
 
-    if(!on_refine_btree){ // Diep add (IF in Refinement Step, do not optimize model parameters)
+    // model parameters are only re-optimized on the full data, not on a pattern subsample
+    if(!on_refine_btree && !isPatternSubsample()){ // Diep add (IF in Refinement Step, do not optimize model parameters)
 		// Better tree or score is found
 		if (getCurScore() > curBestScore + params->modelEps) {
 			// Re-optimize model parameters (the sNNI algorithm)
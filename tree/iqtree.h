@@ -38,6 +38,18 @@ typedef std::map< string, double > mapString2Double;
 typedef std::multiset< double, std::less< double > > multiSetDB;
 typedef std::multiset< int, std::less< int > > MultiSetInt;
 
+/**
+        a better tree on the pattern subsample only counts as an improvement if its
+        log-likelihood difference exceeds this many standard errors of subsampling
+ */
+const double SUBSAMPLE_ERROR_Z = 2.0;
+
+/**
+        growth factor of the pattern subsample, beyond half of the patterns
+        the full data are used
+ */
+const double SUBSAMPLE_GROWTH = 2.0;
+
 class RepLeaf {
 public:
     Node *leaf;
@@ -829,6 +841,20 @@ protected:
     bool testNNI;
 
     ofstream outNNI;
+
+    /**** pattern subsample of the tree search (-psub) *****/
+
+    /** fraction of patterns in the current pattern subsample, 1.0 for the full data */
+    double subsample_fraction;
+
+    /** number of consecutive iterations without significant improvement on the current subsample */
+    int subsample_stalled;
+
+    /** pattern log-likelihoods of the best candidate tree on the current subsample */
+    DoubleVector subsample_best_ptn_lh;
+
+    /** topology of the best candidate tree on the current subsample */
+    string subsample_best_topo;
 protected:
 
     //bool print_tree_lh;
@@ -914,44 +940,40 @@ protected:
 
     /**
             assess the important quartets around a virtual root of the tree.
-            This function will assign bonus points to branches by updating the variable 'bonus_values'
+            This function will assign bonus points to the three branches around cur_root.
+            The representative leaf sets around cur_root must exist in leaves_vec
+            if this is called from several threads.
+            @param leaves_vec representative leaf sets, indexed by node->id * 3 + neighbor index
             @param cur_root the current virtual root
             @param del_leaf a leaf that was deleted (not in the existing sub-tree)
+            @param[in,out] bonus bonus points, indexed like leaves_vec
      */
-    void assessQuartets(vector<RepresentLeafSet*> &leaves_vec, PhyloNode *cur_root, PhyloNode *del_leaf);
-
-    /**
-            initialize the bonus points to ZERO
-            @param node the root of the sub-tree
-            @param dad dad of 'node', used to direct the recursion
-     */
-    void initializeBonus(PhyloNode *node = NULL, PhyloNode *dad = NULL);
-
-    /**
-            raise the bonus points for all branches in the subtree rooted at a node
-            @param node the root of the sub-tree
-            @param dad dad of 'node', used to direct the recursion
-     */
-    void raiseBonus(Neighbor *nei, Node *dad, double bonus);
+    void assessQuartets(vector<RepresentLeafSet*> &leaves_vec, PhyloNode *cur_root, PhyloNode *del_leaf,
+            double *bonus);
 
     /**
             Bonuses are stored in a partial fashion. This function will propagate the bonus at every branch
             into the subtree at this branch.
+            @param bonus bonus points from assessQuartets()
+            @param[in,out] partial_bonus partial bonus per branch direction, negative if not computed yet
             @param node the root of the sub-tree
             @param dad dad of 'node', used to direct the recursion
             @return the partial bonus of the branch (node -> dad)
      */
-    double computePartialBonus(Node *node, Node* dad);
+    double computePartialBonus(double *bonus, double *partial_bonus, Node *node, Node* dad);
 
     /**
             determine the list of branches with the same best bonus point
+            @param bonus bonus points from assessQuartets()
+            @param partial_bonus partial bonus per branch direction, initialized to negative values
             @param best_bonus the best bonus determined by findBestBonus()
             @param best_nodes (OUT) vector of one ends of the branches with highest bonus point
             @param best_dads (OUT) vector of the other ends of the branches with highest bonus point
             @param node the root of the sub-tree
             @param dad dad of 'node', used to direct the recursion
      */
-    void findBestBonus(double &best_score, NodeVector &best_nodes, NodeVector &best_dads, Node *node = NULL, Node *dad = NULL);
+    void findBestBonus(double *bonus, double *partial_bonus, double &best_score, NodeVector &best_nodes,
+            NodeVector &best_dads, Node *node = NULL, Node *dad = NULL);
 
     void estDeltaMin();
 
@@ -961,6 +983,26 @@ protected:
 
     double doTreePerturbation();
 
+    /** @return TRUE if the tree search can start on a pattern subsample (-psub) */
+    bool canSubsamplePatterns();
+
+    /**
+        draw a pattern subsample for the tree search and re-score the candidate trees on it,
+        as log-likelihoods are not comparable between subsamples
+        @param fraction fraction of patterns, 1.0 to switch to the full data
+    */
+    void setSearchSubsample(double fraction);
+
+    /** store the pattern log-likelihoods of the best candidate tree on the current subsample */
+    void updateSubsampleBest();
+
+    /**
+        compare the tree of the last search iteration with the best candidate on the
+        pattern subsample and grow the subsample once the search has stalled, i.e. no
+        better tree beyond the subsampling error was found for a quarter of -nstop iterations
+    */
+    void checkSearchSubsample();
+
     void estimateLoglCutoffBS();
 
     //void estimateNNICutoff(Params &params);
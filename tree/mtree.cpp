@@ -1940,13 +1940,15 @@ void MTree::getTaxa(Split &taxa, Node *node, Node *dad) {
 }
 
 
-void MTree::extractQuadSubtrees(vector<Split*> &subtrees, Node *node, Node *dad) {
+void MTree::extractQuadSubtrees(vector<Split*> &subtrees, Node *node, Node *dad, vector<Branch> *branches) {
 	if (!node) node = root;
 	FOR_NEIGHBOR_IT(node, dad, it) {
-		extractQuadSubtrees(subtrees, (*it)->node, node);
+		extractQuadSubtrees(subtrees, (*it)->node, node, branches);
 		if ((*it)->node->isLeaf()) continue;
 		// internal branch
 		ASSERT(node->degree() == 3 && (*it)->node->degree() == 3);
+		if (branches)
+			branches->push_back(Branch(node, (*it)->node));
 		int cnt = 0;
 		Node *child = (*it)->node;
 		FOR_NEIGHBOR_DECLARE(child, node, it2) {
@@ -2101,6 +2103,107 @@ void MTree::assignBranchSupport(istream &in) {
 		delete (*it);
 }
 
+int MTree::computeGeneConcordance(const char *trees_file, vector<Split*> &subtrees,
+	IntVector &gcf, IntVector &gdf1, IntVector &gdf2, IntVector &decisive)
+{
+	int nbranches = subtrees.size() / 4;
+	gcf.assign(nbranches, 0);
+	gdf1.assign(nbranches, 0);
+	gdf2.assign(nbranches, 0);
+	decisive.assign(nbranches, 0);
+
+	// taxon ID by name, as used in subtrees
+	NodeVector taxa;
+	getTaxa(taxa);
+	StringIntMap taxon_id;
+	for (NodeVector::iterator it = taxa.begin(); it != taxa.end(); it++)
+		taxon_id[(*it)->name] = (*it)->id;
+
+	int ntrees = 0;
+	cout << "Reading gene trees file " << trees_file << " ..." << endl;
+	try {
+		ifstream in;
+		in.exceptions(ios::failbit | ios::badbit);
+		in.open(trees_file);
+		while (!in.eof()) {
+			MTree tree;
+			bool is_rooted = false;
+			tree.readTree(in, is_rooted);
+			ntrees++;
+
+			// map gene tree taxa onto the taxa of this tree, keeping their order
+			NodeVector gene_taxa;
+			tree.getTaxa(gene_taxa);
+			Split taxa_mask(leafNum);
+			IntVector full_id(gene_taxa.size());
+			int i;
+			for (i = 0; i < gene_taxa.size(); i++) {
+				StringIntMap::iterator tit = taxon_id.find(gene_taxa[i]->name);
+				if (tit == taxon_id.end())
+					outError("Taxon not found in reference tree: ", gene_taxa[i]->name);
+				full_id[i] = tit->second;
+				taxa_mask.addTaxon(tit->second);
+			}
+			IntVector small_id(leafNum, -1);
+			int taxid, smallid;
+			for (taxid = 0, smallid = 0; taxid < leafNum; taxid++)
+				if (taxa_mask.containTaxon(taxid))
+					small_id[taxid] = smallid++;
+			for (i = 0; i < gene_taxa.size(); i++)
+				gene_taxa[i]->id = small_id[full_id[i]];
+
+			SplitGraph sg;
+			tree.convertSplits(sg);
+			SplitIntMap hash_ss;
+			for (SplitGraph::iterator sit = sg.begin(); sit != sg.end(); sit++)
+				hash_ss.insertSplit((*sit), 1);
+
+			// branches only read the hashed splits, so they are looked up in parallel
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 16)
+#endif
+			for (int branch = 0; branch < nbranches; branch++) {
+				Split **quad = &subtrees[branch * 4];
+				if (!taxa_mask.overlap(*quad[0]) || !taxa_mask.overlap(*quad[1]) ||
+					!taxa_mask.overlap(*quad[2]) || !taxa_mask.overlap(*quad[3]))
+					continue;
+				decisive[branch]++;
+				// AB|CD, AC|BD and AD|BC in turn
+				for (int k = 1; k <= 3; k++) {
+					Split sp(*quad[0]);
+					sp += *quad[k];
+					Split *subsp = sp.extractSubSplit(taxa_mask);
+					if (subsp->shouldInvert())
+						subsp->invert();
+					bool found = hash_ss.findSplit(subsp) != NULL;
+					delete subsp;
+					if (!found) continue;
+					if (k == 1)
+						gcf[branch]++;
+					else if (k == 2)
+						gdf1[branch]++;
+					else
+						gdf2[branch]++;
+					break;
+				}
+			}
+
+			char ch;
+			in.exceptions(ios::goodbit);
+			(in) >> ch;
+			if (in.eof()) break;
+			in.unget();
+			in.exceptions(ios::failbit | ios::badbit);
+		}
+		in.clear();
+		in.close();
+	} catch (ios::failure) {
+		outError(ERR_READ_INPUT, trees_file);
+	}
+	cout << ntrees << " gene trees read" << endl;
+	return ntrees;
+}
+
 void MTree::computeRFDist(const char *trees_file, IntVector &dist) {
 	cout << "Reading input trees file " << trees_file << endl;
 	try {
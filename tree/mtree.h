@@ -694,7 +694,32 @@ public:
 	STATISTICS
 ********************************************************/
 
-	void extractQuadSubtrees(vector<Split*> &subtrees, Node *node = NULL, Node *dad = NULL);
+	/**
+	 * for each internal branch, extract the taxa of the four subtrees around it:
+	 * the two subtrees below the child node first, then the two at the other end
+	 * @param[out] subtrees four taxon sets per internal branch
+	 * @param node the root of the sub-tree
+	 * @param dad dad of 'node', used to direct the recursion
+	 * @param[out] branches if not NULL, the internal branches (node, child) in the same order
+	 */
+	void extractQuadSubtrees(vector<Split*> &subtrees, Node *node = NULL, Node *dad = NULL,
+		vector<Branch> *branches = NULL);
+
+	/**
+	 * compute gene concordance factors for the internal branches from extractQuadSubtrees().
+	 * Gene trees are read one by one and hashed into splits, so that the set of trees is never
+	 * kept in memory; they may contain only a subset of taxa. A gene tree is decisive for a
+	 * branch AB|CD if it has taxa in all four subtrees A, B, C and D.
+	 * @param trees_file gene trees in NEWICK
+	 * @param subtrees four subtrees per internal branch from extractQuadSubtrees()
+	 * @param[out] gcf number of gene trees containing the branch AB|CD
+	 * @param[out] gdf1 number of gene trees containing the NNI alternative AC|BD
+	 * @param[out] gdf2 number of gene trees containing the NNI alternative AD|BC
+	 * @param[out] decisive number of decisive gene trees
+	 * @return number of gene trees read
+	 */
+	int computeGeneConcordance(const char *trees_file, vector<Split*> &subtrees,
+		IntVector &gcf, IntVector &gdf1, IntVector &gdf2, IntVector &decisive);
 
 	/**
 	 * for each branch, assign how many times this branch appears in the input set of trees.
@@ -715,6 +740,23 @@ public:
 
 	void computeRFDist(istream &in, IntVector &dist);
 
+	/**
+	 * compute the quartet distance to another bifurcating tree on the same taxa, i.e.
+	 * the number of quartets resolved differently, in O(n^2) time and O(n) memory.
+	 * Leaves share taxon IDs between the trees (see MTreeSet::checkConsistency)
+	 * @param tree2 the other tree
+	 * @return quartet distance
+	 */
+	double computeQuartetDist(MTree *tree2);
+
+	/**
+	 * compute the triplet distance to another rooted bifurcating tree on the same taxa,
+	 * i.e. the number of triplets resolved differently, in O(n^2) time and O(n) memory
+	 * @param tree2 the other tree
+	 * @return triplet distance
+	 */
+	double computeTripletDist(MTree *tree2);
+
 	/**
 	 * insert new taxa next to the existing taxa in the tree
 	 * @param new_taxa name of new taxa to be inserted
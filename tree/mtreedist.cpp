@@ -0,0 +1,419 @@
+/*
+ * mtreedist.cpp
+ *
+ * Quartet, triplet, matching split and Kuhner-Felsenstein branch score
+ * distances between trees on the same taxon set
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#include "mtreeset.h"
+#include "pda/hashsplitset.h"
+#include <limits>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/**
+        bifurcating tree rooted at a leaf and flattened in postorder, so that
+        every subtree covers a consecutive range of leaf_order
+ */
+struct PostorderTree {
+    /** taxon ID of counted leaves, -1 for internal nodes and the __root__ leaf */
+    IntVector taxon;
+
+    /** the two children of internal nodes, -1 for leaves */
+    IntVector child1, child2;
+
+    /** the subtree of a node covers leaf_order[leaf_begin, leaf_end) */
+    IntVector leaf_begin, leaf_end;
+
+    /** counted taxa in postorder, followed by the root leaf if counted */
+    IntVector leaf_order;
+};
+
+static int flattenSubtree(PostorderTree &tree, Node *node, Node *dad, const char *dist_name) {
+    int child[2] = {-1, -1};
+    int num_child = 0;
+    int leaf_begin = tree.leaf_order.size();
+    FOR_NEIGHBOR_IT(node, dad, it) {
+        if (num_child == 2)
+            outError((string)dist_name + " distance requires bifurcating trees");
+        child[num_child++] = flattenSubtree(tree, (*it)->node, node, dist_name);
+    }
+    if (num_child == 1)
+        outError((string)dist_name + " distance requires bifurcating trees");
+    int taxon = -1;
+    if (num_child == 0 && node->name != ROOT_NAME) {
+        taxon = node->id;
+        tree.leaf_order.push_back(taxon);
+    }
+    tree.taxon.push_back(taxon);
+    tree.child1.push_back(child[0]);
+    tree.child2.push_back(child[1]);
+    tree.leaf_begin.push_back(leaf_begin);
+    tree.leaf_end.push_back(tree.leaf_order.size());
+    return tree.taxon.size()-1;
+}
+
+/**
+        flatten a tree rooted at its root leaf, the __root__ leaf of rooted trees
+ */
+static void flattenTree(PostorderTree &tree, MTree *mtree, const char *dist_name) {
+    Node *root_leaf = mtree->root;
+    if (!root_leaf->isLeaf()) {
+        NodeVector taxa;
+        mtree->getTaxa(taxa);
+        root_leaf = taxa[0];
+    }
+    flattenSubtree(tree, root_leaf->neighbors[0]->node, root_leaf, dist_name);
+    if (root_leaf->name != ROOT_NAME)
+        tree.leaf_order.push_back(root_leaf->id);
+}
+
+/**
+        label taxa below the two children of node as 0 and 1, all others stay 2
+        @param size (OUT) number of taxa of each label
+ */
+static void labelSubtrees(PostorderTree &tree, int node, IntVector &label, int64_t *size) {
+    int child[2] = {tree.child1[node], tree.child2[node]};
+    for (int i = 0; i < 2; i++) {
+        for (int pos = tree.leaf_begin[child[i]]; pos < tree.leaf_end[child[i]]; pos++)
+            label[tree.leaf_order[pos]] = i;
+        size[i] = tree.leaf_end[child[i]] - tree.leaf_begin[child[i]];
+    }
+    size[2] = tree.leaf_order.size() - size[0] - size[1];
+}
+
+static void unlabelSubtrees(PostorderTree &tree, int node, IntVector &label) {
+    for (int pos = tree.leaf_begin[node]; pos < tree.leaf_end[node]; pos++)
+        label[tree.leaf_order[pos]] = 2;
+}
+
+/**
+        initialize the label counts of leaf v, internal nodes sum up their children
+        @param count (OUT) count[i] is 1 if v is a taxon labelled i, 0 otherwise
+ */
+static inline void countLabelsAtLeaf(PostorderTree &tree, int v, IntVector &label, int64_t *count) {
+    count[0] = count[1] = count[2] = 0;
+    if (tree.taxon[v] >= 0)
+        count[label[tree.taxon[v]]] = 1;
+}
+
+/**
+        A butterfly ab|cd is claimed by the internal node where the paths from a and b
+        meet, with a and b below two of its subtrees and c, d both below the third.
+        Every butterfly has exactly two claims, one for ab and one for cd.
+        @param m m[i][j] taxa shared by subtree i of a node in tree 1 and subtree j of a node in tree 2
+        @return number of claims shared by the two nodes
+ */
+static inline int64_t countSharedClaims(int64_t m[3][3]) {
+    int64_t claims = 0;
+    for (int c1 = 0; c1 < 3; c1++) {
+        int a1 = (c1+1) % 3, b1 = (c1+2) % 3;
+        for (int c2 = 0; c2 < 3; c2++) {
+            int64_t x = m[c1][c2];
+            if (x < 2)
+                continue;
+            int a2 = (c2+1) % 3, b2 = (c2+2) % 3;
+            claims += x*(x-1)/2 * (m[a1][a2]*m[b1][b2] + m[a1][b2]*m[b1][a2]);
+        }
+    }
+    return claims;
+}
+
+double MTree::computeQuartetDist(MTree *tree2) {
+    PostorderTree t1, t2;
+    flattenTree(t1, this, "Quartet");
+    flattenTree(t2, tree2, "Quartet");
+    if (t1.leaf_order.size() != t2.leaf_order.size())
+        outError("Trees have different numbers of taxa");
+    int64_t ntaxa = t1.leaf_order.size();
+    int nnodes1 = t1.taxon.size(), nnodes2 = t2.taxon.size();
+    int64_t shared_claims = 0;
+
+    // for each internal node of tree 1, count the taxa of its three subtrees
+    // below every node of tree 2 in one postorder pass
+#ifdef _OPENMP
+#pragma omp parallel reduction(+: shared_claims)
+#endif
+    {
+        IntVector label(leafNum, 2);
+        vector<int64_t> count(nnodes2*3);
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 16)
+#endif
+        for (int p1 = 0; p1 < nnodes1; p1++) {
+            if (t1.child1[p1] < 0)
+                continue;
+            int64_t size[3];
+            labelSubtrees(t1, p1, label, size);
+            for (int v = 0; v < nnodes2; v++) {
+                int64_t *cv = &count[v*3];
+                if (t2.child1[v] < 0) {
+                    countLabelsAtLeaf(t2, v, label, cv);
+                    continue;
+                }
+                int64_t *ca = &count[t2.child1[v]*3], *cb = &count[t2.child2[v]*3];
+                int64_t m[3][3];
+                for (int i = 0; i < 3; i++) {
+                    cv[i] = ca[i] + cb[i];
+                    m[i][0] = ca[i];
+                    m[i][1] = cb[i];
+                    m[i][2] = size[i] - cv[i];
+                }
+                shared_claims += countSharedClaims(m);
+            }
+            unlabelSubtrees(t1, p1, label);
+        }
+    }
+
+    double num_quartets = (double)ntaxa*(ntaxa-1)/2 * (ntaxa-2)*(ntaxa-3)/12;
+    return num_quartets - shared_claims/2;
+}
+
+double MTree::computeTripletDist(MTree *tree2) {
+    // trees read from a tree set only carry the __root__ leaf, not the rooted flag
+    if (root->name != ROOT_NAME || tree2->root->name != ROOT_NAME)
+        outError("Triplet distance requires rooted trees (use -rooted)");
+    PostorderTree t1, t2;
+    flattenTree(t1, this, "Triplet");
+    flattenTree(t2, tree2, "Triplet");
+    if (t1.leaf_order.size() != t2.leaf_order.size())
+        outError("Trees have different numbers of taxa");
+    int64_t ntaxa = t1.leaf_order.size();
+    int nnodes1 = t1.taxon.size(), nnodes2 = t2.taxon.size();
+    int64_t shared = 0;
+
+    // triplet ab|c is resolved at the lowest common ancestor of a and b,
+    // with c outside its subtree
+#ifdef _OPENMP
+#pragma omp parallel reduction(+: shared)
+#endif
+    {
+        IntVector label(leafNum, 2);
+        vector<int64_t> count(nnodes2*3);
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 16)
+#endif
+        for (int u = 0; u < nnodes1; u++) {
+            if (t1.child1[u] < 0)
+                continue;
+            int64_t size[3];
+            labelSubtrees(t1, u, label, size);
+            for (int v = 0; v < nnodes2; v++) {
+                int64_t *cv = &count[v*3];
+                if (t2.child1[v] < 0) {
+                    countLabelsAtLeaf(t2, v, label, cv);
+                    continue;
+                }
+                int64_t *ca = &count[t2.child1[v]*3], *cb = &count[t2.child2[v]*3];
+                for (int i = 0; i < 3; i++)
+                    cv[i] = ca[i] + cb[i];
+                shared += (ca[0]*cb[1] + ca[1]*cb[0]) * (size[2] - cv[2]);
+            }
+            unlabelSubtrees(t1, u, label);
+        }
+    }
+
+    double num_triplets = (double)ntaxa*(ntaxa-1)/2 * (ntaxa-2)/3;
+    return num_triplets - shared;
+}
+
+/**
+        splits of a tree, each containing taxon 0, and their hash map
+ */
+struct TreeSplits {
+    SplitGraph sg;
+    SplitIntMap hs;
+};
+
+static void convertTreeSplits(MTreeSet &trees, vector<string> &taxname, vector<TreeSplits*> &splits) {
+    for (MTreeSet::iterator it = trees.begin(); it != trees.end(); it++) {
+        TreeSplits *ts = new TreeSplits;
+        (*it)->convertSplits(taxname, ts->sg);
+        for (SplitGraph::iterator sit = ts->sg.begin(); sit != ts->sg.end(); sit++) {
+            if (!(*sit)->containTaxon(0)) (*sit)->invert();
+            ts->hs.insertSplit((*sit), 1);
+        }
+        splits.push_back(ts);
+    }
+}
+
+/**
+        Hungarian algorithm for the minimum cost perfect matching, O(k^3)
+        @param cost k x k cost matrix, row-major
+        @param k number of rows and columns
+        @return minimum total cost
+ */
+static int64_t solveAssignment(IntVector &cost, int k) {
+    const int64_t inf = numeric_limits<int64_t>::max();
+    vector<int64_t> u(k+1, 0), v(k+1, 0);
+    IntVector match(k+1, 0), way(k+1, 0);
+    for (int i = 1; i <= k; i++) {
+        match[0] = i;
+        int j0 = 0;
+        vector<int64_t> minv(k+1, inf);
+        BoolVector used(k+1, false);
+        do {
+            used[j0] = true;
+            int i0 = match[j0], j1 = 0;
+            int64_t delta = inf;
+            for (int j = 1; j <= k; j++)
+                if (!used[j]) {
+                    int64_t cur = cost[(i0-1)*k + j-1] - u[i0] - v[j];
+                    if (cur < minv[j]) {
+                        minv[j] = cur;
+                        way[j] = j0;
+                    }
+                    if (minv[j] < delta) {
+                        delta = minv[j];
+                        j1 = j;
+                    }
+                }
+            for (int j = 0; j <= k; j++)
+                if (used[j]) {
+                    u[match[j]] += delta;
+                    v[j] -= delta;
+                } else
+                    minv[j] -= delta;
+            j0 = j1;
+        } while (match[j0] != 0);
+        do {
+            int j1 = way[j0];
+            match[j0] = match[j1];
+            j0 = j1;
+        } while (j0);
+    }
+    int64_t total = 0;
+    for (int j = 1; j <= k; j++)
+        total += cost[(match[j]-1)*k + j-1];
+    return total;
+}
+
+/**
+        Matching split distance (Bogdanowicz & Giaro 2012): minimum cost matching of
+        the non-trivial splits, a pair of splits costing the number of taxa to move
+        to turn one into the other. The cost is a metric, so identical splits can be
+        matched to each other and only the splits not shared enter the matching.
+        Unmatched splits of non-bifurcating trees are matched to a trivial split.
+ */
+static double computeMatchingSplitDist(TreeSplits *s1, TreeSplits *s2) {
+    vector<Split*> diff1, diff2;
+    SplitGraph::iterator it;
+    for (it = s1->sg.begin(); it != s1->sg.end(); it++)
+        if ((*it)->trivial() < 0 && !s2->hs.findSplit(*it))
+            diff1.push_back(*it);
+    for (it = s2->sg.begin(); it != s2->sg.end(); it++)
+        if ((*it)->trivial() < 0 && !s1->hs.findSplit(*it))
+            diff2.push_back(*it);
+    int k = max(diff1.size(), diff2.size());
+    if (k == 0)
+        return 0.0;
+    int ntaxa = s1->sg.getNTaxa();
+    IntVector cost(k*k);
+    for (int i = 0; i < k; i++)
+        for (int j = 0; j < k; j++) {
+            int diff;
+            if (i < diff1.size() && j < diff2.size())
+                diff = diff1[i]->countDiffTaxa(*diff2[j]);
+            else
+                diff = (i < diff1.size()) ? diff1[i]->countTaxa() : diff2[j]->countTaxa();
+            cost[i*k+j] = min(diff, ntaxa - diff);
+        }
+    return solveAssignment(cost, k);
+}
+
+/**
+        Kuhner-Felsenstein branch score: square root of the sum of squared branch
+        length differences over all splits, a missing split having length 0
+ */
+static double computeKFDist(TreeSplits *s1, TreeSplits *s2) {
+    double sum = 0.0;
+    SplitGraph::iterator it;
+    for (it = s1->sg.begin(); it != s1->sg.end(); it++) {
+        Split *sp = s2->hs.findSplit(*it);
+        double diff = (*it)->getWeight() - (sp ? sp->getWeight() : 0.0);
+        sum += diff*diff;
+    }
+    for (it = s2->sg.begin(); it != s2->sg.end(); it++)
+        if (!s1->hs.findSplit(*it))
+            sum += (*it)->getWeight() * (*it)->getWeight();
+    return sqrt(sum);
+}
+
+void MTreeSet::computeTreeDist(double *dist, int metric, int mode, MTreeSet *treeset2) {
+    if (mode != RF_TWO_TREE_SETS)
+        treeset2 = this;
+    if (empty() || treeset2->empty())
+        return;
+    if (front()->leafNum != treeset2->front()->leafNum)
+        outError("Trees have different numbers of taxa");
+
+    int n = size(), m = treeset2->size();
+    vector<pair<int,int> > pairs;
+    int i, j;
+    if (mode == RF_TWO_TREE_SETS) {
+        for (i = 0; i < n; i++)
+            for (j = 0; j < m; j++)
+                pairs.push_back(make_pair(i, j));
+    } else if (mode == RF_ADJACENT_PAIR) {
+        for (i = 0; i < n-1; i++)
+            pairs.push_back(make_pair(i, i+1));
+    } else {
+        for (i = 0; i < n; i++)
+            for (j = i+1; j < n; j++)
+                pairs.push_back(make_pair(i, j));
+    }
+
+    vector<TreeSplits*> splits1, splits2;
+    if (metric == TREE_DIST_MATCHING_SPLIT || metric == TREE_DIST_KF) {
+        vector<string> taxname(front()->leafNum);
+        front()->getTaxaName(taxname);
+        convertTreeSplits(*this, taxname, splits1);
+        if (treeset2 != this)
+            convertTreeSplits(*treeset2, taxname, splits2);
+        else
+            splits2 = splits1;
+    }
+
+    // parallel over pairs if there are enough of them, otherwise inside
+    // the quartet and triplet computation of each pair
+    int num_pairs = pairs.size();
+#ifdef _OPENMP
+    int num_threads = omp_get_max_threads();
+#pragma omp parallel for schedule(dynamic) if(num_pairs >= num_threads)
+#endif
+    for (int k = 0; k < num_pairs; k++) {
+        int id = pairs[k].first, id2 = pairs[k].second;
+        double d = 0.0;
+        switch (metric) {
+        case TREE_DIST_QUARTET:
+            d = at(id)->computeQuartetDist(treeset2->at(id2));
+            break;
+        case TREE_DIST_TRIPLET:
+            d = at(id)->computeTripletDist(treeset2->at(id2));
+            break;
+        case TREE_DIST_MATCHING_SPLIT:
+            d = computeMatchingSplitDist(splits1[id], splits2[id2]);
+            break;
+        case TREE_DIST_KF:
+            d = computeKFDist(splits1[id], splits2[id2]);
+            break;
+        default:
+            ASSERT(0 && "unsupported tree distance");
+        }
+        if (mode == RF_TWO_TREE_SETS)
+            dist[id*m + id2] = d;
+        else if (mode == RF_ADJACENT_PAIR)
+            dist[id] = d;
+        else
+            dist[id*n + id2] = dist[id2*n + id] = d;
+    }
+
+    for (i = splits1.size()-1; i >= 0; i--)
+        delete splits1[i];
+    if (treeset2 != this)
+        for (i = splits2.size()-1; i >= 0; i--)
+            delete splits2[i];
+}
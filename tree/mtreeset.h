@@ -161,6 +161,15 @@ public:
 	void computeRFDist(int *rfdist, MTreeSet *treeset2, 
 		const char* info_file = NULL, const char *tree_file = NULL, int *incomp_splits = NULL);
 
+	/**
+		compute a tree distance other than RF between trees, in parallel over pairs of trees
+		@param dist (OUT) distance, laid out as rfdist of computeRFDist()
+		@param metric TREE_DIST_QUARTET, TREE_DIST_TRIPLET, TREE_DIST_MATCHING_SPLIT or TREE_DIST_KF
+		@param mode RF_ALL_PAIR, RF_ADJACENT_PAIR or RF_TWO_TREE_SETS
+		@param treeset2 second set of trees for RF_TWO_TREE_SETS
+	*/
+	void computeTreeDist(double *dist, int metric, int mode, MTreeSet *treeset2 = NULL);
+
 	int categorizeDistinctTrees(IntVector &category);
 
 	int sumTreeWeights();
@@ -448,6 +448,13 @@ void ParsTree::initLeafSiteParsForAmbiguousState(char state, UINT * site_partial
         		return;
         	}
         default:
+            if (aln->seq_type == SEQ_CODON && state < aln->STATE_UNKNOWN) {
+                // partially ambiguous codon
+                for (i = 0; i < nstates; i++)
+                    if (aln->codon_ambiguity[state-nstates] & ((uint64_t)1 << i))
+                        site_partial_pars[i] = 0;
+                return;
+            }
         	// unknown
         	cout << "nstates = " << nstates << "; state = " << (int) state << endl;
         	outError("Alignment contains invalid state. Please check your data!");
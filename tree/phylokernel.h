@@ -1436,6 +1436,23 @@ inline UINT fast_popcount(Vec8ui &x) {
 
 }
 
+#if INSTRSET >= 9
+inline UINT fast_popcount(Vec16ui &x) {
+    // AVX-512F without VPOPCNTDQ: scalar popcnt on the eight 64-bit lanes
+    uint64_t vec[8];
+    x.store(vec);
+    UINT res = 0;
+    for (int i = 0; i < 8; i++)
+        res += _mm_popcnt_u64(vec[i]);
+    return res;
+}
+#endif
+
+#ifdef __AVX512VPOPCNTDQ__
+inline UINT fast_popcount(Vec8uq &x) {
+    return _mm512_reduce_add_epi64(_mm512_popcnt_epi64(x));
+}
+#endif
 
 inline void horizontal_popcount(Vec4ui &x) {
     MEM_ALIGN_BEGIN UINT vec[4] MEM_ALIGN_END;
@@ -1468,8 +1485,9 @@ void PhyloTree::computePartialParsimonyFastSIMD(PhyloNeighbor *dad_branch, Phylo
     Node *node = dad_branch->node;
     int nstates = aln->getMaxNumStates();
     int site = 0;
-    const int VCSIZE = VectorClass::size();
-    const int NUM_BITS = VectorClass::size() * UINT_BITS;
+    // number of 32-bit words per vector, also for vectors of 64-bit lanes
+    const int VCSIZE = sizeof(VectorClass) / sizeof(UINT);
+    const int NUM_BITS = VCSIZE * UINT_BITS;
 
     dad_branch->partial_lh_computed |= 2;
 
@@ -1651,6 +1669,20 @@ void PhyloTree::computePartialParsimonyFastSIMD(PhyloNeighbor *dad_branch, Phylo
                         for (int i = 0; i < (*alnit)->num_states; i++)
                             p[i*VCSIZE] |= bit1;
                     }
+                } else if ((*alnit)->seq_type == SEQ_CODON && state < (*alnit)->STATE_UNKNOWN) {
+                    // partially ambiguous codon
+                    uint64_t cstate = (*alnit)->codon_ambiguity[state-(*alnit)->num_states];
+                    for (int j = 0; j < freq; j++, site++) {
+                        if (site == NUM_BITS) {
+                            x += nstates*VCSIZE;
+                            site = 0;
+                        }
+                        UINT bit1 = (1 << (site%UINT_BITS));
+                        UINT *p = x+(site/UINT_BITS);
+                        for (int i = 0; i < (*alnit)->num_states; i++)
+                            if (cstate & ((uint64_t)1 << i))
+                                p[i*VCSIZE] |= bit1;
+                    }
                 } else {
                     ASSERT(0);
                 }
@@ -1772,9 +1804,10 @@ int PhyloTree::computeParsimonyBranchFastSIMD(PhyloNeighbor *dad_branch, PhyloNo
 //    VectorClass score = 0;
 //    VectorClass w;
 
-    const int NUM_BITS = VectorClass::size() * UINT_BITS;
+    const int VCSIZE = sizeof(VectorClass) / sizeof(UINT);
+    const int NUM_BITS = VCSIZE * UINT_BITS;
     int nsites = (aln->num_parsimony_sites + NUM_BITS - 1)/NUM_BITS;
-    int entry_size = nstates * VectorClass::size();
+    int entry_size = nstates * VCSIZE;
     
     int scoreid = nsites*entry_size;
     UINT sum_end_node = (dad_branch->partial_pars[scoreid] + node_branch->partial_pars[scoreid]);
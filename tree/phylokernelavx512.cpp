@@ -27,6 +27,17 @@
 #error "You must compile this file with AVX512 enabled!"
 #endif
 
+void PhyloTree::setParsimonyKernelAVX512() {
+#ifdef __AVX512POPCNT
+    if (hasAVX512VPOPCNTDQ()) {
+        setParsimonyKernelAVX512Popcnt();
+        return;
+    }
+#endif
+    computeParsimonyBranchPointer = &PhyloTree::computeParsimonyBranchFastSIMD<Vec16ui>;
+    computePartialParsimonyPointer = &PhyloTree::computePartialParsimonyFastSIMD<Vec16ui>;
+}
+
 void PhyloTree::setDotProductAVX512() {
 #ifdef BOOT_VAL_FLOAT
 		dotProduct = &PhyloTree::dotProductSIMD<float, Vec16f>;
@@ -39,12 +50,18 @@ void PhyloTree::setDotProductAVX512() {
 void PhyloTree::setLikelihoodKernelAVX512() {
     vector_size = 8;
     bool site_model = model_factory && model_factory->model->isSiteSpecificModel();
-//    setParsimonyKernelAVX();
+    setParsimonyKernelAVX512();
     computeLikelihoodDervMixlenPointer = NULL;
 
     if (site_model && safe_numeric) {
     	// safe site-specific model
         switch (aln->num_states) {
+        case 2:
+            computeLikelihoodBranchPointer     = &PhyloTree::computeLikelihoodBranchSIMD    <Vec8d, SAFE_LH, 2, true, true>;
+            computeLikelihoodDervPointer       = &PhyloTree::computeLikelihoodDervSIMD      <Vec8d, SAFE_LH, 2, true, true>;
+            computePartialLikelihoodPointer    =  &PhyloTree::computePartialLikelihoodSIMD  <Vec8d, SAFE_LH, 2, true, true>;
+            computeLikelihoodFromBufferPointer = &PhyloTree::computeLikelihoodFromBufferSIMD<Vec8d, 2, true, true>;
+            break;
         case 4:
             computeLikelihoodBranchPointer     = &PhyloTree::computeLikelihoodBranchSIMD    <Vec8d, SAFE_LH, 4, true, true>;
             computeLikelihoodDervPointer       = &PhyloTree::computeLikelihoodDervSIMD      <Vec8d, SAFE_LH, 4, true, true>;
@@ -69,6 +86,12 @@ void PhyloTree::setLikelihoodKernelAVX512() {
 
     if (site_model) {
         switch (aln->num_states) {
+        case 2:
+            computeLikelihoodBranchPointer     = &PhyloTree::computeLikelihoodBranchSIMD    <Vec8d, NORM_LH, 2, true, true>;
+            computeLikelihoodDervPointer       = &PhyloTree::computeLikelihoodDervSIMD      <Vec8d, NORM_LH, 2, true, true>;
+            computePartialLikelihoodPointer    =  &PhyloTree::computePartialLikelihoodSIMD  <Vec8d, NORM_LH, 2, true, true>;
+            computeLikelihoodFromBufferPointer = &PhyloTree::computeLikelihoodFromBufferSIMD<Vec8d, 2, true, true>;
+            break;
         case 4:
             computeLikelihoodBranchPointer     = &PhyloTree::computeLikelihoodBranchSIMD    <Vec8d, NORM_LH, 4, true, true>;
             computeLikelihoodDervPointer       = &PhyloTree::computeLikelihoodDervSIMD      <Vec8d, NORM_LH, 4, true, true>;
@@ -91,6 +114,11 @@ void PhyloTree::setLikelihoodKernelAVX512() {
     if ((model_factory && !model_factory->model->isReversible()) || params->kernel_nonrev) {
         // if nonreversible model
         switch (aln->num_states) {
+        case 2:
+            computeLikelihoodBranchPointer  = &PhyloTree::computeNonrevLikelihoodBranchSIMD <Vec8d, 2, true>;
+            computeLikelihoodDervPointer    = &PhyloTree::computeNonrevLikelihoodDervSIMD   <Vec8d, 2, true>;
+            computePartialLikelihoodPointer = &PhyloTree::computeNonrevPartialLikelihoodSIMD<Vec8d, 2, true>;
+            break;
         case 4:
             computeLikelihoodBranchPointer  = &PhyloTree::computeNonrevLikelihoodBranchSIMD <Vec8d, 4, true>;
             computeLikelihoodDervPointer    = &PhyloTree::computeNonrevLikelihoodDervSIMD   <Vec8d, 4, true>;
@@ -108,6 +136,13 @@ void PhyloTree::setLikelihoodKernelAVX512() {
 
     if (safe_numeric) {
         switch(aln->num_states) {
+        case 2:
+            computeLikelihoodBranchPointer     = &PhyloTree::computeLikelihoodBranchSIMD    <Vec8d, SAFE_LH, 2, true>;
+            computeLikelihoodDervPointer       = &PhyloTree::computeLikelihoodDervSIMD      <Vec8d, SAFE_LH, 2, true>;
+            computeLikelihoodDervMixlenPointer = &PhyloTree::computeLikelihoodDervMixlenSIMD<Vec8d, SAFE_LH, 2, true>;
+            computePartialLikelihoodPointer    = &PhyloTree::computePartialLikelihoodSIMD   <Vec8d, SAFE_LH, 2, true>;
+            computeLikelihoodFromBufferPointer = &PhyloTree::computeLikelihoodFromBufferSIMD<Vec8d, 2, true>;
+            break;
         case 4:
             computeLikelihoodBranchPointer     = &PhyloTree::computeLikelihoodBranchSIMD    <Vec8d, SAFE_LH, 4, true>;
             computeLikelihoodDervPointer       = &PhyloTree::computeLikelihoodDervSIMD      <Vec8d, SAFE_LH, 4, true>;
@@ -134,6 +169,13 @@ void PhyloTree::setLikelihoodKernelAVX512() {
     }
 
 	switch(aln->num_states) {
+	case 2:
+        computeLikelihoodBranchPointer     = &PhyloTree::computeLikelihoodBranchSIMD    <Vec8d, NORM_LH, 2, true>;
+        computeLikelihoodDervPointer       = &PhyloTree::computeLikelihoodDervSIMD      <Vec8d, NORM_LH, 2, true>;
+        computeLikelihoodDervMixlenPointer = &PhyloTree::computeLikelihoodDervMixlenSIMD<Vec8d, NORM_LH, 2, true>;
+        computePartialLikelihoodPointer    = &PhyloTree::computePartialLikelihoodSIMD   <Vec8d, NORM_LH, 2, true>;
+        computeLikelihoodFromBufferPointer = &PhyloTree::computeLikelihoodFromBufferSIMD<Vec8d, 2, true>;
+		break;
 	case 4:
         computeLikelihoodBranchPointer     = &PhyloTree::computeLikelihoodBranchSIMD    <Vec8d, NORM_LH, 4, true>;
         computeLikelihoodDervPointer       = &PhyloTree::computeLikelihoodDervSIMD      <Vec8d, NORM_LH, 4, true>;
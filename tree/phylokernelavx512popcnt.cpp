@@ -0,0 +1,26 @@
+/*
+ * phylokernelavx512popcnt.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *
+ *  AVX-512 parsimony kernel counting with VPOPCNTDQ, kept apart from
+ *  phylokernelavx512.cpp so that CPUs with AVX-512F but without VPOPCNTDQ
+ *  never run code compiled with -mavx512vpopcntdq
+ */
+
+
+#define MAX_VECTOR_SIZE 512 // for VectorClass
+
+#include "vectorclass/vectorclass.h"
+#include "vectorclass/vectormath_exp.h"
+#include "phylokernel.h"
+
+#if !defined ( __AVX512VPOPCNTDQ__ )
+#error "You must compile this file with AVX512 VPOPCNTDQ enabled!"
+#endif
+
+void PhyloTree::setParsimonyKernelAVX512Popcnt() {
+    // 64-bit lanes for VPOPCNTQ; same bit layout as Vec16ui
+    computeParsimonyBranchPointer = &PhyloTree::computeParsimonyBranchFastSIMD<Vec8uq>;
+    computePartialParsimonyPointer = &PhyloTree::computePartialParsimonyFastSIMD<Vec8uq>;
+}
@@ -1102,6 +1102,91 @@ inline void computeBounds(int threads, size_t elements, vector<size_t> &limits)
             outError("Too many threads may slow down analysis [-nt option]. Reduce threads or use -nt AUTO to automatically determine it");
     }
 }
+
+/**
+    compute pattern bounds for threads over the observed patterns only.
+    The unobserved constant patterns of ascertainment bias correction (+ASC),
+    stored compactly after the observed patterns, form one extra small packet
+    so that they no longer unbalance the work of the last thread.
+    @param threads number of threads
+    @param orig_nptn number of observed patterns
+    @param nptn number of patterns including unobserved ones
+    @param[out] limits packet bounds: threads+1 entries, plus one more for the +ASC packet
+*/
+template<class VectorClass>
+inline void computeBoundsASC(int threads, size_t orig_nptn, size_t nptn, vector<size_t> &limits) {
+    computeBounds<VectorClass>(threads, orig_nptn, limits);
+    nptn = ((nptn+VectorClass::size()-1)/VectorClass::size())*VectorClass::size();
+    if (nptn > limits.back())
+        limits.push_back(nptn);
+}
+
+/**
+    compute pattern bounds for kernels that sum over patterns (log-likelihood and derivatives).
+    Unlike computeBounds(), the packets depend only on the number of patterns, not on the
+    number of threads. Each packet keeps its own sums, which sumPackets() adds up in packet
+    order, so that the result is bit-identical for any number of threads.
+    @param orig_nptn number of observed patterns
+    @param nptn number of patterns including unobserved ones
+    @param[out] limits packet bounds, plus one more for the +ASC packet
+*/
+template<class VectorClass>
+inline void computeReductionBoundsASC(size_t orig_nptn, size_t nptn, vector<size_t> &limits) {
+    size_t vsize = VectorClass::size();
+    orig_nptn = ((orig_nptn+vsize-1)/vsize)*vsize;
+    size_t packet_size = computeReductionPacketSize(orig_nptn, vsize);
+    limits.clear();
+    for (size_t ptn = 0; ptn < orig_nptn; ptn += packet_size)
+        limits.push_back(ptn);
+    limits.push_back(orig_nptn);
+    nptn = ((nptn+vsize-1)/vsize)*vsize;
+    if (nptn > limits.back())
+        limits.push_back(nptn);
+}
+
+/**
+    add up the sums of packets in packet order
+    @param packet_sum num_sums consecutive values per packet
+    @param num_sums number of sums per packet
+    @param[out] sum the num_sums totals
+*/
+inline void sumPackets(DoubleVector &packet_sum, size_t num_sums, double *sum) {
+    size_t num_packets = packet_sum.size()/num_sums;
+    for (size_t j = 0; j < num_sums; j++)
+        sum[j] = 0.0;
+    for (size_t packet = 0; packet < num_packets; packet++)
+        for (size_t j = 0; j < num_sums; j++)
+            sum[j] += packet_sum[packet*num_sums+j];
+}
+
+/**
+    rescale the patterns of a pattern vector whose partial likelihoods underflow.
+    The factor SCALING_THRESHOLD_INVER, a power of two so the result is exact, is selected
+    per lane and multiplied onto whole vectors, without per-lane branches or scalar loops
+    @param lh_max maximal absolute partial likelihood per pattern
+    @param invar invariant-site likelihood per pattern, patterns with nonzero value are not scaled;
+        NULL to test all patterns
+    @param partial_lh partial likelihood vectors to rescale
+    @param size number of vectors in partial_lh
+    @param scale_num scaling counter of the first pattern
+    @param scale_step distance between the scaling counters of consecutive patterns
+*/
+template <class VectorClass>
+inline void scaleUnderflown(VectorClass &lh_max, double *invar, VectorClass *partial_lh, size_t size,
+    UBYTE *scale_num, size_t scale_step)
+{
+    auto underflown = (lh_max < SCALING_THRESHOLD);
+    if (invar)
+        underflown &= (VectorClass().load_a(invar) == 0.0);
+    // one test per pattern vector, so that the common case without underflow costs no extra pass
+    if (!horizontal_or(underflown))
+        return;
+    VectorClass factor = select(underflown, VectorClass(SCALING_THRESHOLD_INVER), VectorClass(1.0));
+    for (size_t i = 0; i < size; i++)
+        partial_lh[i] *= factor;
+    for (size_t x = 0; x < VectorClass::size(); x++)
+        scale_num[x*scale_step] += underflown[x];
+}
 #endif
 
 #ifdef KERNEL_FIX_STATES
@@ -1224,14 +1309,19 @@ void PhyloTree::computeTraversalInfo(PhyloNode *node, PhyloNode *dad, bool compu
         vector<size_t> limits;
         size_t orig_nptn = ((aln->size()+VectorClass::size()-1)/VectorClass::size())*VectorClass::size();
         size_t nptn = ((orig_nptn+model_factory->unobserved_ptns.size()+VectorClass::size()-1)/VectorClass::size())*VectorClass::size();
-        computeBounds<VectorClass>(num_threads, nptn, limits);
+        computeBoundsASC<VectorClass>(num_threads, orig_nptn, nptn, limits);
+        int num_packets = limits.size()-1;
 
         #ifdef _OPENMP
         #pragma omp parallel for schedule(static, 1) num_threads(num_threads)
         #endif
-        for (int thread_id = 0; thread_id < num_threads; thread_id++) {
-            for (vector<TraversalInfo>::iterator it = traversal_info.begin(); it != traversal_info.end(); it++)
-                computePartialLikelihood(*it, limits[thread_id], limits[thread_id+1], thread_id);
+        for (int packet_id = 0; packet_id < num_packets; packet_id++) {
+#ifdef _OPENMP
+            int thread_id = omp_get_thread_num();
+#else
+            int thread_id = 0;
+#endif
+            computeTraversalPartialLikelihood(limits[packet_id], limits[packet_id+1], thread_id);
         }
         traversal_info.clear();
     }
@@ -1504,18 +1594,9 @@ void PhyloTree::computePartialLikelihoodGenericSIMD(TraversalInfo &info, size_t
                         for (x = 0; x < nstates; x++)
                             lh_max = max(lh_max,abs(partial_lh_tmp[x]));
                         // check if one should scale partial likelihoods
-                        auto underflown = ((lh_max < SCALING_THRESHOLD) & (VectorClass().load_a(&ptn_invar[ptn]) == 0.0));
-                        if (horizontal_or(underflown)) { // at least one site has numerical underflown
-                            for (x = 0; x < VectorClass::size(); x++)
-                            if (underflown[x]) {
-                                // BQM 2016-05-03: only scale for non-constant sites
-                                // now do the likelihood scaling
-                                double *partial_lh = (double*)partial_lh_tmp + (x);
-                                for (i = 0; i < nstates; i++)
-                                    partial_lh[i*VectorClass::size()] *= SCALING_THRESHOLD_INVER;
-                                dad_branch->scale_num[(ptn+x)*ncat_mix+c] += 1;
-                            }
-                        }
+                        // BQM 2016-05-03: only scale for non-constant sites
+                        scaleUnderflown(lh_max, &ptn_invar[ptn], partial_lh_tmp, nstates,
+                            dad_branch->scale_num + ptn*ncat_mix + c, ncat_mix);
                         partial_lh_tmp += nstates;
                     }
                 } else {
@@ -1523,19 +1604,7 @@ void PhyloTree::computePartialLikelihoodGenericSIMD(TraversalInfo &info, size_t
                     VectorClass lh_max = 0.0;
                     for (x = 0; x < block; x++)
                         lh_max = max(lh_max,abs(partial_lh_all[x]));
-                    auto underflown = (lh_max < SCALING_THRESHOLD) & (VectorClass().load_a(&ptn_invar[ptn]) == 0.0);
-                    if (horizontal_or(underflown)) { // at least one site has numerical underflown
-                        for (x = 0; x < VectorClass::size(); x++)
-                        if (underflown[x]) {
-                            double *partial_lh = (double*)partial_lh_all + (x);
-                            // now do the likelihood scaling
-                            for (i = 0; i < block; i++) {
-                                partial_lh[i*VectorClass::size()] *= SCALING_THRESHOLD_INVER;
-                            }
-    //                        sum_scale += LOG_SCALING_THRESHOLD * ptn_freq[ptn+x];
-                            dad_branch->scale_num[ptn+x] += 1;
-                        }
-                    }
+                    scaleUnderflown(lh_max, &ptn_invar[ptn], partial_lh_all, block, dad_branch->scale_num + ptn, 1);
                 } // if-else
 
             } // FOR_NEIGHBOR
@@ -1721,18 +1790,10 @@ void PhyloTree::computePartialLikelihoodGenericSIMD(TraversalInfo &info, size_t
 #endif
                     // check if one should scale partial likelihoods
                     if (SAFE_NUMERIC) {
-                        auto underflown = ((lh_max < SCALING_THRESHOLD) & (VectorClass().load_a(&ptn_invar[ptn]) == 0.0));
-                        if (horizontal_or(underflown)) { // at least one site has numerical underflown
-                            for (x = 0; x < VectorClass::size(); x++)
-                            if (underflown[x]) {
-                                // BQM 2016-05-03: only scale for non-constant sites
-                                // now do the likelihood scaling
-                                double *partial_lh = dad_branch->partial_lh + (ptn*block + c*nstates*VectorClass::size() + x);
-                                for (i = 0; i < nstates; i++)
-                                    partial_lh[i*VectorClass::size()] *= SCALING_THRESHOLD_INVER;
-                                dad_branch->scale_num[(ptn+x)*ncat_mix+c] += 1;
-                            }
-                        }
+                        // BQM 2016-05-03: only scale for non-constant sites
+                        scaleUnderflown(lh_max, &ptn_invar[ptn],
+                            (VectorClass*)(dad_branch->partial_lh + ptn*block + c*nstates*VectorClass::size()), nstates,
+                            dad_branch->scale_num + ptn*ncat_mix + c, ncat_mix);
                     }
                     partial_lh_right += nstates;
                     partial_lh += nstates;
@@ -1784,18 +1845,10 @@ void PhyloTree::computePartialLikelihoodGenericSIMD(TraversalInfo &info, size_t
     #endif
                     // check if one should scale partial likelihoods
                     if (SAFE_NUMERIC) {
-                        auto underflown = ((lh_max < SCALING_THRESHOLD) & (VectorClass().load_a(&ptn_invar[ptn]) == 0.0));
-                        if (horizontal_or(underflown)) { // at least one site has numerical underflown
-                            for (x = 0; x < VectorClass::size(); x++)
-                            if (underflown[x]) {
-                                // BQM 2016-05-03: only scale for non-constant sites
-                                // now do the likelihood scaling
-                                double *partial_lh = dad_branch->partial_lh + (ptn*block + c*nstates*VectorClass::size() + x);
-                                for (i = 0; i < nstates; i++)
-                                    partial_lh[i*VectorClass::size()] *= SCALING_THRESHOLD_INVER;
-                                dad_branch->scale_num[(ptn+x)*ncat_mix+c] += 1;
-                            }
-                        }
+                        // BQM 2016-05-03: only scale for non-constant sites
+                        scaleUnderflown(lh_max, &ptn_invar[ptn],
+                            (VectorClass*)(dad_branch->partial_lh + ptn*block + c*nstates*VectorClass::size()), nstates,
+                            dad_branch->scale_num + ptn*ncat_mix + c, ncat_mix);
                     }
                     vleft += nstates;
                     partial_lh_right += nstates;
@@ -1803,21 +1856,9 @@ void PhyloTree::computePartialLikelihoodGenericSIMD(TraversalInfo &info, size_t
                 } // FOR category
             } // IF SITE_MODEL
 
-            if (!SAFE_NUMERIC) {
-                auto underflown = (lh_max < SCALING_THRESHOLD) & (VectorClass().load_a(&ptn_invar[ptn]) == 0.0);
-                if (horizontal_or(underflown)) { // at least one site has numerical underflown
-                    for (x = 0; x < VectorClass::size(); x++)
-                    if (underflown[x]) {
-                        double *partial_lh = dad_branch->partial_lh + (ptn*block + x);
-                        // now do the likelihood scaling
-                        for (i = 0; i < block; i++) {
-                            partial_lh[i*VectorClass::size()] *= SCALING_THRESHOLD_INVER;
-                        }
-//                        sum_scale += LOG_SCALING_THRESHOLD * ptn_freq[ptn+x];
-                        dad_branch->scale_num[ptn+x] += 1;
-                    }
-                }
-            }
+            if (!SAFE_NUMERIC)
+                scaleUnderflown(lh_max, &ptn_invar[ptn], (VectorClass*)(dad_branch->partial_lh + ptn*block), block,
+                    dad_branch->scale_num + ptn, 1);
 
 		} // big for loop over ptn
 
@@ -1907,17 +1948,10 @@ void PhyloTree::computePartialLikelihoodGenericSIMD(TraversalInfo &info, size_t
 
                 // check if one should scale partial likelihoods
                 if (SAFE_NUMERIC) {
-                    auto underflown = ((lh_max < SCALING_THRESHOLD) & (VectorClass().load_a(&ptn_invar[ptn]) == 0.0));
-                    if (horizontal_or(underflown))
-                        for (x = 0; x < VectorClass::size(); x++)
-                        if (underflown[x]) {
-                            // BQM 2016-05-03: only scale for non-constant sites
-                            // now do the likelihood scaling
-                            double *partial_lh = dad_branch->partial_lh + (ptn*block + c*nstates*VectorClass::size() + x);
-                            for (i = 0; i < nstates; i++)
-                                partial_lh[i*VectorClass::size()] *= SCALING_THRESHOLD_INVER;
-                            scale_dad[x*ncat_mix] += 1;
-                        }
+                    // BQM 2016-05-03: only scale for non-constant sites
+                    scaleUnderflown(lh_max, &ptn_invar[ptn],
+                        (VectorClass*)(dad_branch->partial_lh + ptn*block + c*nstates*VectorClass::size()), nstates,
+                        scale_dad, ncat_mix);
                     scale_dad++;
                     scale_left++;
                     scale_right++;
@@ -1929,19 +1963,8 @@ void PhyloTree::computePartialLikelihoodGenericSIMD(TraversalInfo &info, size_t
 
             if (!SAFE_NUMERIC) {
                 // check if one should scale partial likelihoods
-                auto underflown = (lh_max < SCALING_THRESHOLD) & (VectorClass().load_a(&ptn_invar[ptn]) == 0.0);
-                if (horizontal_or(underflown)) { // at least one site has numerical underflown
-                    for (x = 0; x < VectorClass::size(); x++)
-                    if (underflown[x]) {
-                        double *partial_lh = dad_branch->partial_lh + (ptn*block + x);
-                        // now do the likelihood scaling
-                        for (i = 0; i < block; i++) {
-                            partial_lh[i*VectorClass::size()] *= SCALING_THRESHOLD_INVER;
-                        }
-//                        sum_scale += LOG_SCALING_THRESHOLD * ptn_freq[ptn+x];
-                        dad_branch->scale_num[ptn+x] += 1;
-                    }
-                }
+                scaleUnderflown(lh_max, &ptn_invar[ptn], (VectorClass*)(dad_branch->partial_lh + ptn*block), block,
+                    dad_branch->scale_num + ptn, 1);
             }
 
 		} // big for loop over ptn
@@ -1995,8 +2018,7 @@ void PhyloTree::computeLikelihoodBufferGenericSIMD(PhyloNeighbor *dad_branch, Ph
     }
 
     // first compute partial_lh
-    for (vector<TraversalInfo>::iterator it = traversal_info.begin(); it != traversal_info.end(); it++)
-        computePartialLikelihood(*it, ptn_lower, ptn_upper, thread_id);
+    computeTraversalPartialLikelihood(ptn_lower, ptn_upper, thread_id);
 
     if (dad->isLeaf()) {
         // special treatment for TIP-INTERNAL NODE case
@@ -2191,7 +2213,8 @@ void PhyloTree::computeLikelihoodDervGenericSIMD(PhyloNeighbor *dad_branch, Phyl
 
     double *buffer_partial_lh_ptr = buffer_partial_lh;
     vector<size_t> limits;
-    computeBounds<VectorClass>(num_threads, nptn, limits);
+    computeReductionBoundsASC<VectorClass>(orig_nptn, nptn, limits);
+    int num_packets = limits.size()-1;
 
 	ASSERT(theta_all);
 
@@ -2259,29 +2282,31 @@ void PhyloTree::computeLikelihoodDervGenericSIMD(PhyloNeighbor *dad_branch, Phyl
 
     double dad_length = dad_branch->length;
 
-    VectorClass all_lh(0.0), all_df(0.0), all_ddf(0.0), all_prob_const(0.0), all_df_const(0.0), all_ddf_const(0.0);
-    VectorClass *all_dfvec = NULL;
-    VectorClass *all_ddfvec = NULL;
-
     size_t nmixlen = getMixlen(), nmixlen2 = nmixlen*nmixlen;
-    if (isMixlen()) {
+    if (isMixlen())
         ASSERT(nmixlen == ncat);
-        all_dfvec = (VectorClass*)buffer_partial_lh_ptr;
-        all_ddfvec = all_dfvec + nmixlen;
-        buffer_partial_lh_ptr += nmixlen*(nmixlen+1)*VectorClass::size();
-        for (i = 0; i < nmixlen; i++) all_dfvec[i] = 0.0;
-        for (i = 0; i < nmixlen2; i++) all_ddfvec[i] = 0.0;
-    }
+
+    // sums per packet: df, ddf and the +ASC terms, or for mixed branch lengths
+    // the df vector, the ddf matrix and the log-likelihood
+    size_t num_sums = isMixlen() ? nmixlen+nmixlen2+1 : 5;
+    DoubleVector packet_sum(num_packets*num_sums, 0.0);
 
 //    double tree_lh = node_branch->lh_scale_factor + dad_branch->lh_scale_factor;
 
 #ifdef _OPENMP
 #pragma omp parallel for schedule(static, 1) private(ptn, i, c) num_threads(num_threads)
 #endif
-    for (int thread_id = 0; thread_id < num_threads; thread_id++) {
+    for (int packet_id = 0; packet_id < num_packets; packet_id++) {
+#ifdef _OPENMP
+        int thread_id = omp_get_thread_num();
+#else
+        int thread_id = 0;
+#endif
+        if (!isSubsampledPacket(packet_id))
+            continue;
         VectorClass my_df(0.0), my_ddf(0.0), vc_prob_const(0.0), vc_df_const(0.0), vc_ddf_const(0.0);
-        size_t ptn_lower = limits[thread_id];
-        size_t ptn_upper = limits[thread_id+1];
+        size_t ptn_lower = limits[packet_id];
+        size_t ptn_upper = limits[packet_id+1];
 
         if (!theta_computed)
         #ifdef KERNEL_FIX_STATES
@@ -2354,21 +2379,12 @@ void PhyloTree::computeLikelihoodDervGenericSIMD(PhyloNeighbor *dad_branch, Phyl
                 }
             } // FOR ptn
 
-        #ifdef _OPENMP
-        #pragma omp critical
-        #endif
-            {
-                for (i = 0; i < nmixlen; i++)
-                    all_dfvec[i] += my_df[i];
-                for (i = 0; i < nmixlen2; i++)
-                    all_ddfvec[i] += my_ddf[i];
-                all_lh += my_lh;
-//                if (isASC) {
-//                    all_prob_const += vc_prob_const;
-//                    all_df_const += vc_df_const;
-//                    all_ddf_const += vc_ddf_const;
-//                }
-            }
+            double *my_sum = &packet_sum[packet_id*num_sums];
+            for (i = 0; i < nmixlen; i++)
+                my_sum[i] = horizontal_add(my_df[i]);
+            for (i = 0; i < nmixlen2; i++)
+                my_sum[nmixlen+i] = horizontal_add(my_ddf[i]);
+            my_sum[nmixlen+nmixlen2] = horizontal_add(my_lh);
 
         } else {
             // normal joint branch length model
@@ -2442,40 +2458,37 @@ void PhyloTree::computeLikelihoodDervGenericSIMD(PhyloNeighbor *dad_branch, Phyl
                     vc_ddf_const += ddf_ptn;
                 }
             } // FOR ptn
-        #ifdef _OPENMP
-        #pragma omp critical
-        #endif
-            {
-                all_df += my_df;
-                all_ddf += my_ddf;
-                if (isASC) {
-                    all_prob_const += vc_prob_const;
-                    all_df_const += vc_df_const;
-                    all_ddf_const += vc_ddf_const;
-                }
-            }
+            double *my_sum = &packet_sum[packet_id*num_sums];
+            my_sum[0] = horizontal_add(my_df);
+            my_sum[1] = horizontal_add(my_ddf);
+            my_sum[2] = horizontal_add(vc_prob_const);
+            my_sum[3] = horizontal_add(vc_df_const);
+            my_sum[4] = horizontal_add(vc_ddf_const);
         } // else isMixlen()
     } // FOR thread
 
     // mark buffer as computed
     theta_computed = true;
 
+    DoubleVector all_sum(num_sums);
+    sumPackets(packet_sum, num_sums, &all_sum[0]);
+
     if (isMixlen()) {
         // mixed branch length model
         for (i = 0; i < nmixlen; i++) {
-            df[i] = horizontal_add(all_dfvec[i]);
+            df[i] = all_sum[i];
             ASSERT(!std::isnan(df[i]) && !std::isinf(df[i]) && "Numerical underflow for lh-derivative");
         }
         for (i = 0; i < nmixlen2; i++)
-            ddf[i] = horizontal_add(all_ddfvec[i]);
+            ddf[i] = all_sum[nmixlen+i];
         // NOTE: last entry of df now store log-likelihood!
-        df[nmixlen] = horizontal_add(all_lh);
+        df[nmixlen] = all_sum[nmixlen+nmixlen2];
         return;
     }
 
     // normal joint branch length model
-    *df = horizontal_add(all_df);
-    *ddf = horizontal_add(all_ddf);
+    *df = all_sum[0];
+    *ddf = all_sum[1];
     if (std::isnan(*df) || std::isinf(*df)) {
         getModel()->writeInfo(cout);
         getRate()->writeInfo(cout);
@@ -2488,9 +2501,9 @@ void PhyloTree::computeLikelihoodDervGenericSIMD(PhyloNeighbor *dad_branch, Phyl
 
 	if (isASC) {
         double prob_const = 0.0, df_const = 0.0, ddf_const = 0.0;
-        prob_const = horizontal_add(all_prob_const);
-        df_const = horizontal_add(all_df_const);
-        ddf_const = horizontal_add(all_ddf_const);
+        prob_const = all_sum[2];
+        df_const = all_sum[3];
+        ddf_const = all_sum[4];
         // ascertainment bias correction
         prob_const = 1.0 - prob_const;
         double df_frac = df_const / prob_const;
@@ -2614,11 +2627,12 @@ double PhyloTree::computeLikelihoodBranchGenericSIMD(PhyloNeighbor *dad_branch,
         }
     }
 
-    VectorClass all_tree_lh(0.0);
-    VectorClass all_prob_const(0.0);
-
     vector<size_t> limits;
-    computeBounds<VectorClass>(num_threads, nptn, limits);
+    computeReductionBoundsASC<VectorClass>(orig_nptn, nptn, limits);
+    int num_packets = limits.size()-1;
+
+    // log-likelihood and +ASC probability per packet
+    DoubleVector packet_sum(num_packets*2, 0.0);
 
     if (dad->isLeaf()) {
     	// special treatment for TIP-INTERNAL NODE case
@@ -2672,19 +2686,25 @@ double PhyloTree::computeLikelihoodBranchGenericSIMD(PhyloNeighbor *dad_branch,
 #ifdef _OPENMP
 #pragma omp parallel for private(ptn, i, c) schedule(static, 1) num_threads(num_threads)
 #endif
-        for (int thread_id = 0; thread_id < num_threads; thread_id++) {
+        for (int packet_id = 0; packet_id < num_packets; packet_id++) {
+#ifdef _OPENMP
+            int thread_id = omp_get_thread_num();
+#else
+            int thread_id = 0;
+#endif
+            if (!isSubsampledPacket(packet_id))
+                continue;
 
             VectorClass vc_tree_lh(0.0), vc_prob_const(0.0);
 
-            size_t ptn_lower = limits[thread_id];
-            size_t ptn_upper = limits[thread_id+1];
+            size_t ptn_lower = limits[packet_id];
+            size_t ptn_upper = limits[packet_id+1];
 
             // reset memory for _pattern_lh_cat
             memset(_pattern_lh_cat + ptn_lower*ncat_mix, 0, sizeof(double)*(ptn_upper-ptn_lower)*ncat_mix);
 
             // first compute partial_lh
-            for (vector<TraversalInfo>::iterator it = traversal_info.begin(); it != traversal_info.end(); it++)
-                computePartialLikelihood(*it, ptn_lower, ptn_upper, thread_id);
+            computeTraversalPartialLikelihood(ptn_lower, ptn_upper, thread_id);
 
             double *vec_tip = buffer_partial_lh_ptr + block*VectorClass::size()*thread_id;
 
@@ -2804,14 +2824,8 @@ double PhyloTree::computeLikelihoodBranchGenericSIMD(PhyloNeighbor *dad_branch,
                     vc_prob_const += lh_ptn;
                 }
             } // FOR PTN
-#ifdef _OPENMP
-#pragma omp critical
-#endif
-            {
-                all_tree_lh += vc_tree_lh;
-                if (isASC)
-                    all_prob_const += vc_prob_const;
-            }
+            packet_sum[packet_id*2] = horizontal_add(vc_tree_lh);
+            packet_sum[packet_id*2+1] = horizontal_add(vc_prob_const);
         } // FOR thread
 
     } else {
@@ -2822,10 +2836,17 @@ double PhyloTree::computeLikelihoodBranchGenericSIMD(PhyloNeighbor *dad_branch,
 #ifdef _OPENMP
 #pragma omp parallel for private(ptn, i, c) schedule(static, 1) num_threads(num_threads)
 #endif
-        for (int thread_id = 0; thread_id < num_threads; thread_id++) {
+        for (int packet_id = 0; packet_id < num_packets; packet_id++) {
+#ifdef _OPENMP
+            int thread_id = omp_get_thread_num();
+#else
+            int thread_id = 0;
+#endif
+            if (!isSubsampledPacket(packet_id))
+                continue;
 
-            size_t ptn_lower = limits[thread_id];
-            size_t ptn_upper = limits[thread_id+1];
+            size_t ptn_lower = limits[packet_id];
+            size_t ptn_upper = limits[packet_id+1];
 
             VectorClass vc_tree_lh(0.0), vc_prob_const(0.0);
 
@@ -2833,8 +2854,7 @@ double PhyloTree::computeLikelihoodBranchGenericSIMD(PhyloNeighbor *dad_branch,
             memset(_pattern_lh_cat + ptn_lower*ncat_mix, 0, sizeof(double)*(ptn_upper-ptn_lower)*ncat_mix);
 
             // first compute partial_lh
-            for (vector<TraversalInfo>::iterator it = traversal_info.begin(); it != traversal_info.end(); it++)
-                computePartialLikelihood(*it, ptn_lower, ptn_upper, thread_id);
+            computeTraversalPartialLikelihood(ptn_lower, ptn_upper, thread_id);
 
             for (ptn = ptn_lower; ptn < ptn_upper; ptn+=VectorClass::size()) {
                 VectorClass lh_ptn(0.0);
@@ -2936,18 +2956,14 @@ double PhyloTree::computeLikelihoodBranchGenericSIMD(PhyloNeighbor *dad_branch,
                     vc_prob_const += lh_ptn;
                 }
             } // FOR LOOP ptn
-#ifdef _OPENMP
-#pragma omp critical
-#endif
-            {
-                all_tree_lh += vc_tree_lh;
-                if (isASC)
-                    all_prob_const += vc_prob_const;
-            }
+            packet_sum[packet_id*2] = horizontal_add(vc_tree_lh);
+            packet_sum[packet_id*2+1] = horizontal_add(vc_prob_const);
         } // FOR thread
     } // else
 
-    tree_lh += horizontal_add(all_tree_lh);
+    double all_sum[2];
+    sumPackets(packet_sum, 2, all_sum);
+    tree_lh += all_sum[0];
 
     if (!SAFE_NUMERIC && (std::isnan(tree_lh)))
         outError("Numerical underflow (lh-branch). Run again with the safe likelihood kernel via `-safe` option");
@@ -2968,7 +2984,7 @@ double PhyloTree::computeLikelihoodBranchGenericSIMD(PhyloNeighbor *dad_branch,
 
     if (isASC) {
     	// ascertainment bias correction
-        double prob_const = horizontal_add(all_prob_const);
+        double prob_const = all_sum[1];
         if (prob_const >= 1.0 || prob_const < 0.0) {
             printTree(cout, WT_TAXON_ID + WT_BR_LEN + WT_NEWLINE);
             model->writeInfo(cout);
@@ -3081,77 +3097,74 @@ double PhyloTree::computeLikelihoodFromBufferGenericSIMD()
 
 //    double tree_lh = node_branch->lh_scale_factor + dad_branch->lh_scale_factor;
 
-    VectorClass all_tree_lh(0.0), all_prob_const(0.0);
+    vector<size_t> limits;
+    computeReductionBoundsASC<VectorClass>(orig_nptn, nptn, limits);
+    int num_packets = limits.size()-1;
+
+    // log-likelihood and +ASC probability per packet
+    DoubleVector packet_sum(num_packets*2, 0.0);
 
 #ifdef _OPENMP
-#pragma omp parallel private(ptn, i, c) num_threads(num_threads)
-    {
+#pragma omp parallel for schedule(static, 1) private(ptn, i, c) num_threads(num_threads)
 #endif
+    for (int packet_id = 0; packet_id < num_packets; packet_id++) {
+        if (!isSubsampledPacket(packet_id))
+            continue;
         VectorClass vc_tree_lh(0.0), vc_prob_const(0.0);
-#ifdef _OPENMP
-#pragma omp for schedule(static) nowait
-#endif
-    for (ptn = 0; ptn < nptn; ptn+=VectorClass::size()) {
-		VectorClass lh_ptn(0.0);
-		VectorClass *theta = (VectorClass*)(theta_all + ptn*block);
-        if (SITE_MODEL) {
-            VectorClass *eval_ptr = (VectorClass*)&eval[ptn*nstates];
-//            lh_ptn.load_a(&ptn_invar[ptn]);
-            for (c = 0; c < ncat; c++) {
-                VectorClass lh_cat;
-#ifdef KERNEL_FIX_STATES
-                dotProductExp<VectorClass, double, nstates, FMA>(eval_ptr, theta, cat_length[c], lh_cat);
-#else
-                dotProductExp<VectorClass, double, FMA>(eval_ptr, theta, cat_length[c], lh_cat, nstates);
-#endif
-                lh_ptn = mul_add(lh_cat, cat_prop[c], lh_ptn);
-                theta += nstates;
+        for (ptn = limits[packet_id]; ptn < limits[packet_id+1]; ptn+=VectorClass::size()) {
+    		VectorClass lh_ptn(0.0);
+    		VectorClass *theta = (VectorClass*)(theta_all + ptn*block);
+            if (SITE_MODEL) {
+                VectorClass *eval_ptr = (VectorClass*)&eval[ptn*nstates];
+    //            lh_ptn.load_a(&ptn_invar[ptn]);
+                for (c = 0; c < ncat; c++) {
+                    VectorClass lh_cat;
+    #ifdef KERNEL_FIX_STATES
+                    dotProductExp<VectorClass, double, nstates, FMA>(eval_ptr, theta, cat_length[c], lh_cat);
+    #else
+                    dotProductExp<VectorClass, double, FMA>(eval_ptr, theta, cat_length[c], lh_cat, nstates);
+    #endif
+                    lh_ptn = mul_add(lh_cat, cat_prop[c], lh_ptn);
+                    theta += nstates;
+                }
+            } else {
+                dotProductVec<VectorClass, double, FMA>(val0, theta, lh_ptn, block);
             }
-        } else {
-            dotProductVec<VectorClass, double, FMA>(val0, theta, lh_ptn, block);
-        }
 
-        // Sum later to avoid underflow of invariant sites
-        lh_ptn = abs(lh_ptn) + VectorClass().load_a(&ptn_invar[ptn]);
+            // Sum later to avoid underflow of invariant sites
+            lh_ptn = abs(lh_ptn) + VectorClass().load_a(&ptn_invar[ptn]);
 
-        if (ptn < orig_nptn) {
-            lh_ptn = log(abs(lh_ptn)) + VectorClass().load_a(&buffer_scale_all[ptn]);
-            lh_ptn.store_a(&_pattern_lh[ptn]);
-            vc_tree_lh = mul_add(lh_ptn, VectorClass().load_a(&ptn_freq[ptn]), vc_tree_lh);
-        } else {
-            // bugfix 2016-01-21, prob_const can be rescaled
-//                if (min_scale >= 1)
-//                    lh_ptn *= SCALING_THRESHOLD;
-//				_pattern_lh[ptn] = lh_ptn;
-			// ascertainment bias correction
-            if (ptn+VectorClass::size() > nptn) {
-                // cutoff the last entries if going beyond
-                lh_ptn.cutoff(nptn-ptn);
-            }
-            if (horizontal_or(VectorClass().load_a(&buffer_scale_all[ptn]) != 0.0)) {
-                // some entries are rescaled
-                double *lh_ptn_dbl = (double*)&lh_ptn;
-                for (i = 0; i < VectorClass::size(); i++)
-                    if (buffer_scale_all[ptn+i] != 0.0)
-                        lh_ptn_dbl[i] *= SCALING_THRESHOLD;
+            if (ptn < orig_nptn) {
+                lh_ptn = log(abs(lh_ptn)) + VectorClass().load_a(&buffer_scale_all[ptn]);
+                lh_ptn.store_a(&_pattern_lh[ptn]);
+                vc_tree_lh = mul_add(lh_ptn, VectorClass().load_a(&ptn_freq[ptn]), vc_tree_lh);
+            } else {
+                // bugfix 2016-01-21, prob_const can be rescaled
+    //                if (min_scale >= 1)
+    //                    lh_ptn *= SCALING_THRESHOLD;
+    //				_pattern_lh[ptn] = lh_ptn;
+    			// ascertainment bias correction
+                if (ptn+VectorClass::size() > nptn) {
+                    // cutoff the last entries if going beyond
+                    lh_ptn.cutoff(nptn-ptn);
+                }
+                if (horizontal_or(VectorClass().load_a(&buffer_scale_all[ptn]) != 0.0)) {
+                    // some entries are rescaled
+                    double *lh_ptn_dbl = (double*)&lh_ptn;
+                    for (i = 0; i < VectorClass::size(); i++)
+                        if (buffer_scale_all[ptn+i] != 0.0)
+                            lh_ptn_dbl[i] *= SCALING_THRESHOLD;
+                }
+                vc_prob_const += lh_ptn;
             }
-            vc_prob_const += lh_ptn;
         }
+        packet_sum[packet_id*2] = horizontal_add(vc_tree_lh);
+        packet_sum[packet_id*2+1] = horizontal_add(vc_prob_const);
     }
-#ifdef _OPENMP
-#pragma omp critical
-        {
-            all_tree_lh += vc_tree_lh;
-            if (isASC)
-                all_prob_const += vc_prob_const;
-        }
-    }
-#else
-    all_tree_lh = vc_tree_lh;
-    all_prob_const = vc_prob_const;
-#endif
 
-    double tree_lh = horizontal_add(all_tree_lh);
+    double all_sum[2];
+    sumPackets(packet_sum, 2, all_sum);
+    double tree_lh = all_sum[0];
 
     if (!safe_numeric && (std::isnan(tree_lh) || std::isinf(tree_lh)))
         outError("Numerical underflow (lh-from-buffer). Run again with the safe likelihood kernel via `-safe` option");
@@ -3171,7 +3184,7 @@ double PhyloTree::computeLikelihoodFromBufferGenericSIMD()
 
     if (isASC) {
     	// ascertainment bias correction
-        double prob_const = horizontal_add(all_prob_const);
+        double prob_const = all_sum[1];
         if (prob_const >= 1.0 || prob_const < 0.0) {
             printTree(cout, WT_TAXON_ID + WT_BR_LEN + WT_NEWLINE);
             model->writeInfo(cout);
@@ -3261,7 +3274,8 @@ void PhyloTree::computeLikelihoodDervMixlenGenericSIMD(PhyloNeighbor *dad_branch
 
     double *buffer_partial_lh_ptr = buffer_partial_lh;
     vector<size_t> limits;
-    computeBounds<VectorClass>(num_threads, nptn, limits);
+    computeReductionBoundsASC<VectorClass>(orig_nptn, nptn, limits);
+    int num_packets = limits.size()-1;
 
 	ASSERT(theta_all);
 
@@ -3303,7 +3317,8 @@ void PhyloTree::computeLikelihoodDervMixlenGenericSIMD(PhyloNeighbor *dad_branch
 
 //    double dad_length = dad_branch->length;
 
-    VectorClass all_df(0.0), all_ddf(0.0), all_prob_const(0.0), all_df_const(0.0), all_ddf_const(0.0);
+    // df, ddf and the +ASC terms per packet
+    DoubleVector packet_sum(num_packets*5, 0.0);
 
 //    size_t nmixlen = getMixlen(), nmixlen2 = nmixlen*nmixlen;
 //    ASSERT(nmixlen == ncat);
@@ -3313,10 +3328,17 @@ void PhyloTree::computeLikelihoodDervMixlenGenericSIMD(PhyloNeighbor *dad_branch
 #ifdef _OPENMP
 #pragma omp parallel for schedule(static, 1) private(ptn, i, c) num_threads(num_threads)
 #endif
-    for (int thread_id = 0; thread_id < num_threads; thread_id++) {
+    for (int packet_id = 0; packet_id < num_packets; packet_id++) {
+#ifdef _OPENMP
+        int thread_id = omp_get_thread_num();
+#else
+        int thread_id = 0;
+#endif
+        if (!isSubsampledPacket(packet_id))
+            continue;
         VectorClass my_df(0.0), my_ddf(0.0), vc_prob_const(0.0), vc_df_const(0.0), vc_ddf_const(0.0);
-        size_t ptn_lower = limits[thread_id];
-        size_t ptn_upper = limits[thread_id+1];
+        size_t ptn_lower = limits[packet_id];
+        size_t ptn_upper = limits[packet_id+1];
 
         if (!theta_computed)
         #ifdef KERNEL_FIX_STATES
@@ -3366,35 +3388,31 @@ void PhyloTree::computeLikelihoodDervMixlenGenericSIMD(PhyloNeighbor *dad_branch
             }
         } // FOR ptn
 
-    #ifdef _OPENMP
-    #pragma omp critical
-    #endif
-        {
-            all_df += my_df;
-            all_ddf += my_ddf;
-            if (isASC) {
-                all_prob_const += vc_prob_const;
-                all_df_const += vc_df_const;
-                all_ddf_const += vc_ddf_const;
-            }
-        }
+        double *my_sum = &packet_sum[packet_id*5];
+        my_sum[0] = horizontal_add(my_df);
+        my_sum[1] = horizontal_add(my_ddf);
+        my_sum[2] = horizontal_add(vc_prob_const);
+        my_sum[3] = horizontal_add(vc_df_const);
+        my_sum[4] = horizontal_add(vc_ddf_const);
 
     } // FOR thread
 
     // mark buffer as computed
     theta_computed = true;
 
-    df = horizontal_add(all_df);
-    ddf = horizontal_add(all_ddf);
+    double all_sum[5];
+    sumPackets(packet_sum, 5, all_sum);
+    df = all_sum[0];
+    ddf = all_sum[1];
 
     if (!SAFE_NUMERIC && (std::isnan(df) || std::isinf(df)))
         outError("Numerical underflow (lh-derivative-mixlen). Run again with the safe likelihood kernel via `-safe` option");
 
 	if (isASC) {
         double prob_const = 0.0, df_const = 0.0, ddf_const = 0.0;
-        prob_const = 1.0/(1.0 - horizontal_add(all_prob_const));
-        df_const = horizontal_add(all_df_const);
-        ddf_const = horizontal_add(all_ddf_const);
+        prob_const = 1.0/(1.0 - all_sum[2]);
+        df_const = all_sum[3];
+        ddf_const = all_sum[4];
         // ascertainment bias correction
         df_const *= prob_const;
         ddf_const *= prob_const;
@@ -164,19 +164,8 @@ void PhyloTree::computeNonrevPartialLikelihoodGenericSIMD(TraversalInfo &info, s
                 lh_max = max(lh_max, partial_lh_all[i]);
 
             // check if one should scale partial likelihoods
-            auto underflown = (lh_max < SCALING_THRESHOLD);
-            if (horizontal_or(underflown)) {
-                // now do the likelihood scaling
-                for (x = 0; x < VectorClass::size(); x++)
-                if (underflown[x]) {
-                    double *partial_lh = dad_branch->partial_lh + (ptn*block + x);
-                    // now do the likelihood scaling
-                    for (i = 0; i < block; i++) {
-                        partial_lh[i*VectorClass::size()] *= SCALING_THRESHOLD_INVER;
-                    }
-                    dad_branch->scale_num[ptn+x] += 1;
-                }
-            }
+            scaleUnderflown(lh_max, (double*)NULL, (VectorClass*)(dad_branch->partial_lh + ptn*block), block,
+                dad_branch->scale_num + ptn, 1);
 
         } // for ptn
 
@@ -352,19 +341,8 @@ void PhyloTree::computeNonrevPartialLikelihoodGenericSIMD(TraversalInfo &info, s
                 partial_lh += nstates;
 			}
             // check if one should scale partial likelihoods
-            auto underflown = (lh_max < SCALING_THRESHOLD);
-            if (horizontal_or(underflown)) {
-                // now do the likelihood scaling
-                for (x = 0; x < VectorClass::size(); x++)
-                if (underflown[x]) {
-                    double *partial_lh = dad_branch->partial_lh + (ptn*block + x);
-                    // now do the likelihood scaling
-                    for (i = 0; i < block; i++) {
-                        partial_lh[i*VectorClass::size()] *= SCALING_THRESHOLD_INVER;
-                    }
-                    dad_branch->scale_num[ptn+x] += 1;
-                }
-            }
+            scaleUnderflown(lh_max, (double*)NULL, (VectorClass*)(dad_branch->partial_lh + ptn*block), block,
+                dad_branch->scale_num + ptn, 1);
 		}
 
 	} else {
@@ -400,19 +378,8 @@ void PhyloTree::computeNonrevPartialLikelihoodGenericSIMD(TraversalInfo &info, s
             }
 
             // check if one should scale partial likelihoods
-            auto underflown = (lh_max < SCALING_THRESHOLD);
-            if (horizontal_or(underflown)) {
-                // now do the likelihood scaling
-                for (x = 0; x < VectorClass::size(); x++)
-                if (underflown[x]) {
-                    double *partial_lh = dad_branch->partial_lh + (ptn*block + x);
-                    // now do the likelihood scaling
-                    for (i = 0; i < block; i++) {
-                        partial_lh[i*VectorClass::size()] *= SCALING_THRESHOLD_INVER;
-                    }
-                    dad_branch->scale_num[ptn+x] += 1;
-                }
-            }
+            scaleUnderflown(lh_max, (double*)NULL, (VectorClass*)(dad_branch->partial_lh + ptn*block), block,
+                dad_branch->scale_num + ptn, 1);
 
 		}
 
@@ -504,11 +471,12 @@ void PhyloTree::computeNonrevLikelihoodDervGenericSIMD(PhyloNeighbor *dad_branch
         }
 	}
 
-    VectorClass all_df(0.0), all_ddf(0.0);
-    VectorClass all_prob_const(0.0), all_df_const(0.0), all_ddf_const(0.0);
-
     vector<size_t> limits;
-    computeBounds<VectorClass>(num_threads, nptn, limits);
+    computeReductionBoundsASC<VectorClass>(orig_nptn, nptn, limits);
+    int num_packets = limits.size()-1;
+
+    // df, ddf and the +ASC terms per packet
+    DoubleVector packet_sum(num_packets*5, 0.0);
 //    double *buffer_partial_lh_ptr = buffer_partial_lh;
 
     if (dad->isLeaf()) {
@@ -555,13 +523,17 @@ void PhyloTree::computeNonrevLikelihoodDervGenericSIMD(PhyloNeighbor *dad_branch
 #ifdef _OPENMP
 #pragma omp parallel for private(ptn, i, c) schedule(static,1) num_threads(num_threads)
 #endif
-        for (int thread_id = 0; thread_id < num_threads; thread_id++) {
+        for (int packet_id = 0; packet_id < num_packets; packet_id++) {
+#ifdef _OPENMP
+            int thread_id = omp_get_thread_num();
+#else
+            int thread_id = 0;
+#endif
             VectorClass my_df(0.0), my_ddf(0.0), vc_prob_const(0.0), vc_df_const(0.0), vc_ddf_const(0.0);
-            size_t ptn_lower = limits[thread_id];
-            size_t ptn_upper = limits[thread_id+1];
+            size_t ptn_lower = limits[packet_id];
+            size_t ptn_upper = limits[packet_id+1];
             // first compute partial_lh
-            for (vector<TraversalInfo>::iterator it = traversal_info.begin(); it != traversal_info.end(); it++)
-                computePartialLikelihood(*it, ptn_lower, ptn_upper, thread_id);
+            computeTraversalPartialLikelihood(ptn_lower, ptn_upper, thread_id);
 
             double *vec_tip = buffer_partial_lh_ptr + block*3*VectorClass::size()*thread_id;
 
@@ -636,18 +608,12 @@ void PhyloTree::computeNonrevLikelihoodDervGenericSIMD(PhyloNeighbor *dad_branch
                     vc_ddf_const += ddf_ptn;
                 }
             } // FOR ptn
-        #ifdef _OPENMP
-        #pragma omp critical
-        #endif
-            {
-                all_df += my_df;
-                all_ddf += my_ddf;
-                if (isASC) {
-                    all_prob_const += vc_prob_const;
-                    all_df_const += vc_df_const;
-                    all_ddf_const += vc_ddf_const;
-                }
-            }
+            double *my_sum = &packet_sum[packet_id*5];
+            my_sum[0] = horizontal_add(my_df);
+            my_sum[1] = horizontal_add(my_ddf);
+            my_sum[2] = horizontal_add(vc_prob_const);
+            my_sum[3] = horizontal_add(vc_df_const);
+            my_sum[4] = horizontal_add(vc_ddf_const);
         } // FOR thread_id
 
 //		delete [] partial_lh_node;
@@ -657,13 +623,17 @@ void PhyloTree::computeNonrevLikelihoodDervGenericSIMD(PhyloNeighbor *dad_branch
 #ifdef _OPENMP
 #pragma omp parallel for private(ptn, i, c) schedule(static,1) num_threads(num_threads)
 #endif
-        for (int thread_id = 0; thread_id < num_threads; thread_id++) {
+        for (int packet_id = 0; packet_id < num_packets; packet_id++) {
+#ifdef _OPENMP
+            int thread_id = omp_get_thread_num();
+#else
+            int thread_id = 0;
+#endif
             VectorClass my_df(0.0), my_ddf(0.0), vc_prob_const(0.0), vc_df_const(0.0), vc_ddf_const(0.0);
-            size_t ptn_lower = limits[thread_id];
-            size_t ptn_upper = limits[thread_id+1];
+            size_t ptn_lower = limits[packet_id];
+            size_t ptn_upper = limits[packet_id+1];
             // first compute partial_lh
-            for (vector<TraversalInfo>::iterator it = traversal_info.begin(); it != traversal_info.end(); it++)
-                computePartialLikelihood(*it, ptn_lower, ptn_upper, thread_id);
+            computeTraversalPartialLikelihood(ptn_lower, ptn_upper, thread_id);
 
             for (ptn = ptn_lower; ptn < ptn_upper; ptn+=VectorClass::size()) {
                 VectorClass lh_ptn(0.0), df_ptn(0.0), ddf_ptn(0.0);
@@ -721,30 +691,26 @@ void PhyloTree::computeNonrevLikelihoodDervGenericSIMD(PhyloNeighbor *dad_branch
                     vc_ddf_const += ddf_ptn;
                 }
             } // FOR ptn
-        #ifdef _OPENMP
-        #pragma omp critical
-        #endif
-            {
-                all_df += my_df;
-                all_ddf += my_ddf;
-                if (isASC) {
-                    all_prob_const += vc_prob_const;
-                    all_df_const += vc_df_const;
-                    all_ddf_const += vc_ddf_const;
-                }
-            }
+            double *my_sum = &packet_sum[packet_id*5];
+            my_sum[0] = horizontal_add(my_df);
+            my_sum[1] = horizontal_add(my_ddf);
+            my_sum[2] = horizontal_add(vc_prob_const);
+            my_sum[3] = horizontal_add(vc_df_const);
+            my_sum[4] = horizontal_add(vc_ddf_const);
         } // FOR thread
     }
 
-	*df = horizontal_add(all_df);
-	*ddf = horizontal_add(all_ddf);
+    double all_sum[5];
+    sumPackets(packet_sum, 5, all_sum);
+	*df = all_sum[0];
+	*ddf = all_sum[1];
     ASSERT(!std::isnan(*df) && !std::isinf(*df) && "Numerical underflow for non-rev lh-derivative");
 
 	if (isASC) {
         double prob_const = 0.0, df_const = 0.0, ddf_const = 0.0;
-        prob_const = horizontal_add(all_prob_const);
-        df_const = horizontal_add(all_df_const);
-        ddf_const = horizontal_add(all_ddf_const);
+        prob_const = all_sum[2];
+        df_const = all_sum[3];
+        ddf_const = all_sum[4];
     	// ascertainment bias correction
     	prob_const = 1.0 - prob_const;
     	double df_frac = df_const / prob_const;
@@ -802,7 +768,11 @@ double PhyloTree::computeNonrevLikelihoodBranchGenericSIMD(PhyloNeighbor *dad_br
     bool isASC = model_factory->unobserved_ptns.size() > 0;
 
     vector<size_t> limits;
-    computeBounds<VectorClass>(num_threads, nptn, limits);
+    computeReductionBoundsASC<VectorClass>(orig_nptn, nptn, limits);
+    int num_packets = limits.size()-1;
+
+    // log-likelihood and +ASC probability per packet
+    DoubleVector packet_sum(num_packets*2, 0.0);
 
 //    double *trans_mat = new double[block*nstates];
     double *trans_mat = buffer_partial_lh;
@@ -828,9 +798,6 @@ double PhyloTree::computeNonrevLikelihoodBranchGenericSIMD(PhyloNeighbor *dad_br
         }
 	}
 
-    VectorClass all_tree_lh(0.0);
-    VectorClass all_prob_const(0.0);
-
     if (dad->isLeaf()) {
     	// special treatment for TIP-INTERNAL NODE case
 //    	double *partial_lh_node = new double[(aln->STATE_UNKNOWN+1)*block];
@@ -870,13 +837,17 @@ double PhyloTree::computeNonrevLikelihoodBranchGenericSIMD(PhyloNeighbor *dad_br
 #ifdef _OPENMP
 #pragma omp parallel for private(ptn, i, c) schedule(static,1) num_threads(num_threads)
 #endif
-        for (int thread_id = 0; thread_id < num_threads; thread_id++) {
+        for (int packet_id = 0; packet_id < num_packets; packet_id++) {
+#ifdef _OPENMP
+            int thread_id = omp_get_thread_num();
+#else
+            int thread_id = 0;
+#endif
             VectorClass vc_tree_lh(0.0), vc_prob_const(0.0);
-            size_t ptn_lower = limits[thread_id];
-            size_t ptn_upper = limits[thread_id+1];
+            size_t ptn_lower = limits[packet_id];
+            size_t ptn_upper = limits[packet_id+1];
             // first compute partial_lh
-            for (vector<TraversalInfo>::iterator it = traversal_info.begin(); it != traversal_info.end(); it++)
-                computePartialLikelihood(*it, ptn_lower, ptn_upper, thread_id);
+            computeTraversalPartialLikelihood(ptn_lower, ptn_upper, thread_id);
 
             // reset memory for _pattern_lh_cat
 //            memset(_pattern_lh_cat+ptn_lower*ncat_mix, 0, (ptn_upper-ptn_lower)*ncat_mix*sizeof(double));
@@ -966,14 +937,8 @@ double PhyloTree::computeNonrevLikelihoodBranchGenericSIMD(PhyloNeighbor *dad_br
                     vc_prob_const += lh_ptn;
                 }
             } // FOR ptn
-            #ifdef _OPENMP
-            #pragma omp critical
-            #endif
-            {
-                all_tree_lh += vc_tree_lh;
-                if (isASC)
-                    all_prob_const += vc_prob_const;
-            }
+            packet_sum[packet_id*2] = horizontal_add(vc_tree_lh);
+            packet_sum[packet_id*2+1] = horizontal_add(vc_prob_const);
         } // FOR thread_id
     } else {
 
@@ -981,13 +946,17 @@ double PhyloTree::computeNonrevLikelihoodBranchGenericSIMD(PhyloNeighbor *dad_br
 #ifdef _OPENMP
 #pragma omp parallel for private(ptn, i, c) schedule(static,1) num_threads(num_threads)
 #endif
-        for (int thread_id = 0; thread_id < num_threads; thread_id++) {
+        for (int packet_id = 0; packet_id < num_packets; packet_id++) {
+#ifdef _OPENMP
+            int thread_id = omp_get_thread_num();
+#else
+            int thread_id = 0;
+#endif
             VectorClass vc_tree_lh(0.0), vc_prob_const(0.0);
-            size_t ptn_lower = limits[thread_id];
-            size_t ptn_upper = limits[thread_id+1];
+            size_t ptn_lower = limits[packet_id];
+            size_t ptn_upper = limits[packet_id+1];
             // first compute partial_lh
-            for (vector<TraversalInfo>::iterator it = traversal_info.begin(); it != traversal_info.end(); it++)
-                computePartialLikelihood(*it, ptn_lower, ptn_upper, thread_id);
+            computeTraversalPartialLikelihood(ptn_lower, ptn_upper, thread_id);
 
             // reset memory for _pattern_lh_cat
             memset(_pattern_lh_cat+ptn_lower*ncat_mix, 0, (ptn_upper-ptn_lower)*ncat_mix*sizeof(double));
@@ -1062,18 +1031,14 @@ double PhyloTree::computeNonrevLikelihoodBranchGenericSIMD(PhyloNeighbor *dad_br
                     vc_prob_const += lh_ptn;
                 }
             } // FOR ptn
-            #ifdef _OPENMP
-            #pragma omp critical
-            #endif
-            {
-                all_tree_lh += vc_tree_lh;
-                if (isASC)
-                    all_prob_const += vc_prob_const;
-            }
+            packet_sum[packet_id*2] = horizontal_add(vc_tree_lh);
+            packet_sum[packet_id*2+1] = horizontal_add(vc_prob_const);
         } // FOR thread_id
     }
 
-    tree_lh = horizontal_add(all_tree_lh);
+    double all_sum[2];
+    sumPackets(packet_sum, 2, all_sum);
+    tree_lh = all_sum[0];
 
     if (std::isnan(tree_lh) || std::isinf(tree_lh)) {
         model->writeInfo(cout);
@@ -1083,7 +1048,7 @@ double PhyloTree::computeNonrevLikelihoodBranchGenericSIMD(PhyloNeighbor *dad_br
 
     if (isASC) {
     	// ascertainment bias correction
-        double prob_const = horizontal_add(all_prob_const);
+        double prob_const = all_sum[1];
         if (prob_const >= 1.0 || prob_const < 0.0) {
             printTree(cout, WT_TAXON_ID + WT_BR_LEN + WT_NEWLINE);
             model->writeInfo(cout);
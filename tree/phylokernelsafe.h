@@ -1597,6 +1597,20 @@ void PhyloTree::computePartialParsimonyFastSIMD(PhyloNeighbor *dad_branch, Phylo
                             for (int i = 0; i < (*alnit)->num_states; i++)
                                 p[i*VCSIZE] |= bit1;
                         }
+                    } else if ((*alnit)->seq_type == SEQ_CODON && state < (*alnit)->STATE_UNKNOWN) {
+                        // partially ambiguous codon
+                        uint64_t cstate = (*alnit)->codon_ambiguity[state-(*alnit)->num_states];
+                        for (int j = 0; j < freq; j++, site++) {
+                            if (site == NUM_BITS) {
+                                x += nstates*VCSIZE;
+                                site = 0;
+                            }
+                            UINT bit1 = (1 << (site%UINT_BITS));
+                            UINT *p = x+(site/UINT_BITS);
+                            for (int i = 0; i < (*alnit)->num_states; i++)
+                                if (cstate & ((uint64_t)1 << i))
+                                    p[i*VCSIZE] |= bit1;
+                        }
                     } else {
                         ASSERT(0);
                     }
@@ -585,13 +585,15 @@ double PhyloSuperTree::computeLikelihood(double *pattern_lh) {
 	} else {
         if (part_order.empty()) computePartitionOrder();
 		#ifdef _OPENMP
-		#pragma omp parallel for reduction(+: tree_lh) schedule(dynamic) if(num_threads > 1)
+		#pragma omp parallel for schedule(dynamic) if(num_threads > 1)
 		#endif
 		for (int j = 0; j < ntrees; j++) {
             int i = part_order[j];
 			part_info[i].cur_score = at(i)->computeLikelihood();
-			tree_lh += part_info[i].cur_score;
 		}
+        // sum in partition order, independent of the thread schedule
+		for (int i = 0; i < ntrees; i++)
+			tree_lh += part_info[i].cur_score;
 	}
 	return tree_lh;
 }
@@ -646,15 +648,16 @@ double PhyloSuperTree::optimizeAllBranches(int my_iterations, double tolerance,
 	int ntrees = size();
     if (part_order.empty()) computePartitionOrder();
 	#ifdef _OPENMP
-	#pragma omp parallel for reduction(+: tree_lh) schedule(dynamic) if(num_threads > 1)
+	#pragma omp parallel for schedule(dynamic) if(num_threads > 1)
 	#endif
 	for (int j = 0; j < ntrees; j++) {
         int i = part_order[j];
 		part_info[i].cur_score = at(i)->optimizeAllBranches(my_iterations, tolerance/min(ntrees,10), maxNRStep);
-		tree_lh += part_info[i].cur_score;
 		if (verbose_mode >= VB_MAX)
 			at(i)->printTree(cout, WT_BR_LEN + WT_NEWLINE);
 	}
+	for (int i = 0; i < ntrees; i++)
+		tree_lh += part_info[i].cur_score;
 
 	if (my_iterations >= 100) computeBranchLengths();
 	return tree_lh;
@@ -773,10 +776,12 @@ NNIMove PhyloSuperTree::getBestNNIForBran(PhyloNode *node1, PhyloNode *node2, NN
 	int ntrees = size(), part;
 	double nni_score1 = 0.0, nni_score2 = 0.0;
 	int local_totalNNIs = 0, local_evalNNIs = 0;
+	// NNI scores per partition, summed in partition order so that ties break the same for any number of threads
+	DoubleVector part_score1(ntrees, 0.0), part_score2(ntrees, 0.0);
 
     if (part_order.empty()) computePartitionOrder();
 	#ifdef _OPENMP
-	#pragma omp parallel for reduction(+: nni_score1, nni_score2, local_totalNNIs, local_evalNNIs) private(part) schedule(dynamic) if(num_threads>1)
+	#pragma omp parallel for reduction(+: local_totalNNIs, local_evalNNIs) private(part) schedule(dynamic) if(num_threads>1)
 	#endif
 	for (int treeid = 0; treeid < ntrees; treeid++) {
         part = part_order_by_nptn[treeid];
@@ -794,8 +799,7 @@ NNIMove PhyloSuperTree::getBestNNIForBran(PhyloNode *node1, PhyloNode *node2, NN
 				if (save_all_trees == 2 || nniMoves)
 					at(part)->computePatternLikelihood(part_info[part].cur_ptnlh, &part_info[part].cur_score);
 			}
-			nni_score1 += part_info[part].cur_score;
-			nni_score2 += part_info[part].cur_score;
+			part_score1[part] = part_score2[part] = part_info[part].cur_score;
 			continue;
 		}
 
@@ -833,8 +837,8 @@ NNIMove PhyloSuperTree::getBestNNIForBran(PhyloNode *node1, PhyloNode *node2, NN
 			part_info[part].nniMoves[0] = part_info[part].nniMoves[1];
 			part_info[part].nniMoves[1] = tmp;
 		}
-		nni_score1 += part_info[part].nniMoves[0].newloglh;
-		nni_score2 += part_info[part].nniMoves[1].newloglh;
+		part_score1[part] = part_info[part].nniMoves[0].newloglh;
+		part_score2[part] = part_info[part].nniMoves[1].newloglh;
 		int numlen = 1;
 		if (params->nni5) numlen = 5;
 		for (int i = 0; i < numlen; i++) {
@@ -843,6 +847,10 @@ NNIMove PhyloSuperTree::getBestNNIForBran(PhyloNode *node1, PhyloNode *node2, NN
 		}
 
 	}
+	for (part = 0; part < ntrees; part++) {
+		nni_score1 += part_score1[part];
+		nni_score2 += part_score2[part];
+	}
 	totalNNIs += local_totalNNIs;
 	evalNNIs += local_evalNNIs;
 	double nni_scores[2] = {nni_score1, nni_score2};
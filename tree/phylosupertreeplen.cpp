@@ -255,7 +255,7 @@ double PhyloSuperTreePlen::computeFunction(double value) {
 
     if (part_order.empty()) computePartitionOrder();
     #ifdef _OPENMP
-    #pragma omp parallel for reduction(+: tree_lh) schedule(dynamic) if(num_threads > 1)
+    #pragma omp parallel for schedule(dynamic) if(num_threads > 1)
     #endif    
 	for (int partid = 0; partid < ntrees; partid++) {
             int part = part_order_by_nptn[partid];
@@ -267,13 +267,14 @@ double PhyloSuperTreePlen::computeFunction(double value) {
 				nei1_part->length += lambda*part_info[part].part_rate;
 				nei2_part->length += lambda*part_info[part].part_rate;
 				part_info[part].cur_score = at(part)->computeLikelihoodBranch(nei2_part,(PhyloNode*)nei1_part->node);
-				tree_lh += part_info[part].cur_score;
 			} else {
 				if (part_info[part].cur_score == 0.0)
 					part_info[part].cur_score = at(part)->computeLikelihood();
-				tree_lh += part_info[part].cur_score;
 			}
 		}
+    // sum in partition order, independent of the thread schedule
+	for (int part = 0; part < ntrees; part++)
+		tree_lh += part_info[part].cur_score;
     return -tree_lh;
 }
 
@@ -300,6 +301,7 @@ void PhyloSuperTreePlen::computeFuncDerv(double value, double &df_ret, double &d
 	double ddf = 0.0;
 
 	int ntrees = size();
+	DoubleVector part_df(ntrees, 0.0), part_ddf(ntrees, 0.0);
 
 	if (!central_partial_lh) initializeAllPartialLh();
 
@@ -313,7 +315,7 @@ void PhyloSuperTreePlen::computeFuncDerv(double value, double &df_ret, double &d
 
     if (part_order.empty()) computePartitionOrder();
     #ifdef _OPENMP
-    #pragma omp parallel for reduction(+: df, ddf) schedule(dynamic) if(num_threads > 1)
+    #pragma omp parallel for schedule(dynamic) if(num_threads > 1)
     #endif    
 	for (int partid = 0; partid < ntrees; partid++) {
         int part = part_order_by_nptn[partid];
@@ -333,14 +335,18 @@ void PhyloSuperTreePlen::computeFuncDerv(double value, double &df_ret, double &d
 					outError("shit!!   ",__func__);
 				}
 				at(part)->computeLikelihoodDerv(nei2_part,(PhyloNode*)nei1_part->node, &df_aux, &ddf_aux);
-				df += part_info[part].part_rate*df_aux;
-				ddf += part_info[part].part_rate*part_info[part].part_rate*ddf_aux;
+				part_df[part] = part_info[part].part_rate*df_aux;
+				part_ddf[part] = part_info[part].part_rate*part_info[part].part_rate*ddf_aux;
 			}
 			else {
 				if (part_info[part].cur_score == 0.0)
 					part_info[part].cur_score = at(part)->computeLikelihood();
 			}
 		}
+	for (int part = 0; part < ntrees; part++) {
+		df += part_df[part];
+		ddf += part_ddf[part];
+	}
     df_ret = -df;
     ddf_ret = -ddf;
 }
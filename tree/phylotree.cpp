@@ -45,10 +45,10 @@ const int LH_MIN_CONST = 1;
  ****************************************************************************/
 
 void SPRMoves::add(PhyloNode *prune_node, PhyloNode *prune_dad, PhyloNode *regraft_node, PhyloNode *regraft_dad,
-        double score) {
-    if (size() >= MAX_SPR_MOVES && score <= rbegin()->score)
+        double score, int max_moves) {
+    if (size() >= max_moves && score <= rbegin()->score)
         return;
-    if (size() >= MAX_SPR_MOVES) {
+    if (size() >= max_moves) {
         iterator it = end();
         it--;
         erase(it);
@@ -125,6 +125,8 @@ void PhyloTree::init() {
     num_partial_lh_computations = 0;
     vector_size = 0;
     safe_numeric = false;
+    subsample_packet_size = 0;
+    subsample_freq_scale = 1.0;
 }
 
 PhyloTree::PhyloTree(Alignment *aln) : MTree(), CheckpointFactory() {
@@ -713,13 +715,14 @@ void PhyloTree::initializeAllPartialPars(int &index, PhyloNode *node, PhyloNode
     FOR_NEIGHBOR_IT(node, dad, it)initializeAllPartialPars(index, (PhyloNode*) (*it)->node, node);
 }
 
-#define SIMD_BITS 256
+#define SIMD_BITS 512
 
 size_t PhyloTree::getBitsBlockSize() {
     // reserve the last entry for parsimony score
 //    return (aln->num_states * aln->size() + UINT_BITS - 1) / UINT_BITS + 1;
     size_t len = aln->getMaxNumStates() * ((max(aln->size(), (size_t)aln->num_variant_sites) + SIMD_BITS - 1) / UINT_BITS) + 4;
-    len = ((len+7)/8)*8;
+    // multiple of 64 bytes to keep partial_pars aligned for AVX-512
+    len = ((len+15)/16)*16;
     return len;
 }
 
@@ -4174,6 +4177,276 @@ void PhyloTree::regraftSubtree(PruningInfo &info, PhyloNode *in_node, PhyloNode
 
 }
 
+/****************************************************************************
+ Lazy SPR
+ ****************************************************************************/
+
+/**
+    @return TRUE if target is in the subtree rooted at node and directed away from dad
+*/
+static bool subtreeContains(Node *node, Node *dad, Node *target) {
+    if (node == target)
+        return true;
+    FOR_NEIGHBOR_IT(node, dad, it)
+        if (subtreeContains((*it)->node, node, target))
+            return true;
+    return false;
+}
+
+void PhyloTree::swapPartialLh(PhyloNeighbor *nei1, PhyloNeighbor *nei2) {
+    std::swap(nei1->partial_lh, nei2->partial_lh);
+    std::swap(nei1->scale_num, nei2->scale_num);
+    std::swap(nei1->partial_pars, nei2->partial_pars);
+    std::swap(nei1->lh_scale_factor, nei2->lh_scale_factor);
+    std::swap(nei1->partial_lh_computed, nei2->partial_lh_computed);
+    std::swap(nei1->size, nei2->size);
+}
+
+void PhyloTree::pruneSubtreeLazy(PhyloNode *node, PhyloNode *dad, PhyloNode *&sibling1, PhyloNode *&sibling2) {
+    PhyloNeighbor *dad_nei[2];
+    int i = 0;
+    FOR_NEIGHBOR_IT(dad, node, it)
+        dad_nei[i++] = (PhyloNeighbor*) (*it);
+    ASSERT(i == 2);
+    sibling1 = (PhyloNode*) dad_nei[0]->node;
+    sibling2 = (PhyloNode*) dad_nei[1]->node;
+    PhyloNeighbor *sibling1_nei = (PhyloNeighbor*) sibling1->findNeighbor(dad);
+    PhyloNeighbor *sibling2_nei = (PhyloNeighbor*) sibling2->findNeighbor(dad);
+    double sum_len = dad_nei[0]->length + dad_nei[1]->length;
+
+    // sibling1 now sees the subtree that dad saw toward sibling2 and vice versa
+    swapPartialLh(sibling1_nei, dad_nei[1]);
+    swapPartialLh(sibling2_nei, dad_nei[0]);
+    sibling1_nei->node = sibling2;
+    sibling2_nei->node = sibling1;
+    sibling1_nei->length = sibling2_nei->length = sum_len;
+    sibling2_nei->id = sibling1_nei->id;
+
+    dad_nei[0]->clearPartialLh();
+    dad_nei[1]->clearPartialLh();
+    ((PhyloNeighbor*) node->findNeighbor(dad))->clearPartialLh();
+    // vectors pointing toward the pruning point still include the subtree
+    sibling1->clearReversePartialLh(sibling2);
+    sibling2->clearReversePartialLh(sibling1);
+}
+
+void PhyloTree::unpruneSubtreeLazy(PhyloNode *node, PhyloNode *dad, PhyloNode *sibling1, PhyloNode *sibling2,
+        double sibling1_len, double sibling2_len) {
+    PhyloNeighbor *dad_nei[2];
+    int i = 0;
+    FOR_NEIGHBOR_IT(dad, node, it)
+        dad_nei[i++] = (PhyloNeighbor*) (*it);
+    ASSERT(i == 2);
+    PhyloNeighbor *sibling1_nei = (PhyloNeighbor*) sibling1->findNeighbor(sibling2);
+    PhyloNeighbor *sibling2_nei = (PhyloNeighbor*) sibling2->findNeighbor(sibling1);
+
+    dad_nei[0]->node = sibling1;
+    dad_nei[1]->node = sibling2;
+    sibling1_nei->node = sibling2_nei->node = dad;
+    dad_nei[0]->length = sibling1_nei->length = sibling1_len;
+    dad_nei[1]->length = sibling2_nei->length = sibling2_len;
+    dad_nei[0]->id = sibling1_nei->id;
+    sibling2_nei->id = dad_nei[1]->id;
+    swapPartialLh(sibling1_nei, dad_nei[1]);
+    swapPartialLh(sibling2_nei, dad_nei[0]);
+
+    sibling1_nei->clearPartialLh();
+    sibling2_nei->clearPartialLh();
+    ((PhyloNeighbor*) node->findNeighbor(dad))->clearPartialLh();
+    sibling1->clearReversePartialLh(dad);
+    sibling2->clearReversePartialLh(dad);
+}
+
+void PhyloTree::regraftSubtreeLazy(PhyloNode *node, PhyloNode *dad, PhyloNode *node2, PhyloNode *dad2) {
+    PhyloNeighbor *dad_nei[2];
+    int i = 0;
+    FOR_NEIGHBOR_IT(dad, node, it)
+        dad_nei[i++] = (PhyloNeighbor*) (*it);
+    ASSERT(i == 2);
+    PhyloNeighbor *node2_nei = (PhyloNeighbor*) node2->findNeighbor(dad2);
+    PhyloNeighbor *dad2_nei = (PhyloNeighbor*) dad2->findNeighbor(node2);
+    double half_len = node2_nei->length / 2;
+
+    // dad now sees the two subtrees previously seen across (node2-dad2)
+    swapPartialLh(dad_nei[0], node2_nei);
+    swapPartialLh(dad_nei[1], dad2_nei);
+    dad_nei[0]->node = dad2;
+    dad_nei[1]->node = node2;
+    node2_nei->node = dad2_nei->node = dad;
+    dad_nei[0]->length = dad_nei[1]->length = node2_nei->length = dad2_nei->length = half_len;
+    dad_nei[0]->id = dad2_nei->id;
+    node2_nei->id = dad_nei[1]->id;
+
+    node2_nei->clearPartialLh();
+    dad2_nei->clearPartialLh();
+    ((PhyloNeighbor*) node->findNeighbor(dad))->clearPartialLh();
+}
+
+void PhyloTree::unregraftSubtreeLazy(PhyloNode *node, PhyloNode *dad, PhyloNode *node2, PhyloNode *dad2, double len2) {
+    PhyloNeighbor *dad_nei1 = (PhyloNeighbor*) dad->findNeighbor(dad2);
+    PhyloNeighbor *dad_nei2 = (PhyloNeighbor*) dad->findNeighbor(node2);
+    PhyloNeighbor *node2_nei = (PhyloNeighbor*) node2->findNeighbor(dad);
+    PhyloNeighbor *dad2_nei = (PhyloNeighbor*) dad2->findNeighbor(dad);
+
+    node2_nei->node = dad2;
+    dad2_nei->node = node2;
+    node2_nei->length = dad2_nei->length = len2;
+    node2_nei->id = dad2_nei->id;
+    swapPartialLh(dad_nei1, node2_nei);
+    swapPartialLh(dad_nei2, dad2_nei);
+
+    dad_nei1->clearPartialLh();
+    dad_nei2->clearPartialLh();
+    ((PhyloNeighbor*) node->findNeighbor(dad))->clearPartialLh();
+}
+
+void PhyloTree::evaluateLazyRegraft(PhyloNode *node, PhyloNode *dad, PhyloNode *node2, PhyloNode *dad2,
+        int depth, int min_radius, int max_radius, SPRMoves &moves, int max_moves) {
+    if (depth < min_radius) {
+        FOR_NEIGHBOR_IT(node2, dad2, it)
+            evaluateLazyRegraft(node, dad, (PhyloNode*) (*it)->node, node2, depth + 1, min_radius, max_radius, moves, max_moves);
+        return;
+    }
+
+    PhyloNeighbor *node_nei = (PhyloNeighbor*) node->findNeighbor(dad);
+    PhyloNeighbor *dad_nei = (PhyloNeighbor*) dad->findNeighbor(node);
+    double node_len = node_nei->length;
+    double len2 = node2->findNeighbor(dad2)->length;
+
+    regraftSubtreeLazy(node, dad, node2, dad2);
+
+    // only optimize the three branches adjacent to the insertion point
+    PhyloNode *adjacent[3] = {node2, dad2, node};
+    for (int i = 0; i < 3; i++) {
+        ((PhyloNeighbor*) adjacent[i]->findNeighbor(dad))->clearPartialLh();
+        optimizeOneBranch(dad, adjacent[i], false, LAZY_SPR_MAX_NR_STEP);
+    }
+    double score = computeLikelihoodFromBuffer();
+    if (verbose_mode >= VB_DEBUG)
+        cout << "Lazy SPR " << node->id << "-" << dad->id << " to " << node2->id << "-" << dad2->id
+             << ": " << score << endl;
+    moves.add(node, dad, node2, dad2, score, max_moves);
+
+    unregraftSubtreeLazy(node, dad, node2, dad2, len2);
+    node_nei->length = dad_nei->length = node_len;
+
+    if (depth >= max_radius)
+        return;
+    FOR_NEIGHBOR_IT(node2, dad2, it)
+        evaluateLazyRegraft(node, dad, (PhyloNode*) (*it)->node, node2, depth + 1, min_radius, max_radius, moves, max_moves);
+}
+
+void PhyloTree::evaluateLazySPR(PhyloNode *node, PhyloNode *dad, int min_radius, int max_radius,
+        SPRMoves &moves, int max_moves) {
+    double sibling_len[2];
+    int i = 0;
+    FOR_NEIGHBOR_IT(dad, node, it)
+        sibling_len[i++] = (*it)->length;
+    PhyloNode *sibling1, *sibling2;
+    pruneSubtreeLazy(node, dad, sibling1, sibling2);
+
+    // regrafting positions are visited depth-first from the pruning point, so that
+    // each position only needs the partial likelihoods next to the previous one
+    FOR_NEIGHBOR_IT(sibling1, sibling2, it)
+        evaluateLazyRegraft(node, dad, (PhyloNode*) (*it)->node, sibling1, 1, min_radius, max_radius, moves, max_moves);
+    FOR_NEIGHBOR_IT(sibling2, sibling1, it)
+        evaluateLazyRegraft(node, dad, (PhyloNode*) (*it)->node, sibling2, 1, min_radius, max_radius, moves, max_moves);
+
+    unpruneSubtreeLazy(node, dad, sibling1, sibling2, sibling_len[0], sibling_len[1]);
+}
+
+double PhyloTree::applyLazySPRMove(double cur_score, const SPRMove &spr) {
+    PhyloNode *node = spr.prune_node;
+    PhyloNode *dad = spr.prune_dad;
+    PhyloNode *node2 = spr.regraft_node;
+    PhyloNode *dad2 = spr.regraft_dad;
+
+    // the move was scored on the tree before previously accepted moves
+    if (!node->isNeighbor(dad) || !node2->isNeighbor(dad2) || node2 == dad || dad2 == dad ||
+            subtreeContains(node, dad, dad2))
+        return cur_score;
+
+    DoubleVector lenvec;
+    saveBranchLengths(lenvec);
+    double sibling_len[2];
+    int i = 0;
+    FOR_NEIGHBOR_IT(dad, node, it)
+        sibling_len[i++] = (*it)->length;
+    double len2 = node2->findNeighbor(dad2)->length;
+    PhyloNode *sibling1, *sibling2;
+
+    pruneSubtreeLazy(node, dad, sibling1, sibling2);
+    regraftSubtreeLazy(node, dad, node2, dad2);
+    clearAllPartialLH();
+
+    double score = -DBL_MAX;
+    if (constraintTree.empty() || constraintTree.isCompatible(this))
+        score = optimizeAllBranches(1, params->loglh_epsilon, PLL_NEWZPERCYCLE);
+    if (score > cur_score + params->loglh_epsilon) {
+        if (verbose_mode >= VB_MED)
+            cout << "Lazy SPR move " << node->id << "-" << dad->id << " to " << node2->id << "-" << dad2->id
+                 << ": " << score << endl;
+        return score;
+    }
+
+    // revert the move
+    unregraftSubtreeLazy(node, dad, node2, dad2, len2);
+    unpruneSubtreeLazy(node, dad, sibling1, sibling2, sibling_len[0], sibling_len[1]);
+    restoreBranchLengths(lenvec);
+    clearAllPartialLH();
+    return cur_score;
+}
+
+double PhyloTree::optimizeLazySPR(double cur_score, int max_radius, int max_moves) {
+    if (leafNum < 5 || rooted || isSuperTree() || isMixlen() || params->lh_mem_save == LM_MEM_SAVE)
+        return cur_score;
+
+    double orig_score = cur_score;
+    // start with a small radius and only widen it when no improvement is found;
+    // a widened scan skips the positions already scored without success
+    int min_radius = 1;
+    int radius = min(LAZY_SPR_INIT_RADIUS, max_radius);
+    while (true) {
+        NodeVector nodes1, nodes2;
+        getBranches(nodes1, nodes2);
+        SPRMoves moves;
+        clearAllPartialLH();
+        for (int i = 0; i < nodes1.size(); i++) {
+            if (!nodes2[i]->isLeaf())
+                evaluateLazySPR((PhyloNode*) nodes1[i], (PhyloNode*) nodes2[i], min_radius, radius, moves, max_moves);
+            if (!nodes1[i]->isLeaf())
+                evaluateLazySPR((PhyloNode*) nodes2[i], (PhyloNode*) nodes1[i], min_radius, radius, moves, max_moves);
+        }
+
+        // fully re-evaluate the best lazy moves
+        double new_score = cur_score;
+        for (SPRMoves::iterator it = moves.begin(); it != moves.end(); it++) {
+            if (it->score < cur_score - LAZY_SPR_LOGL_DROP)
+                break;
+            new_score = applyLazySPRMove(new_score, *it);
+        }
+        if (verbose_mode >= VB_MED)
+            cout << "Lazy SPR radius " << radius << ": " << moves.size() << " candidates, logL "
+                 << new_score << endl;
+
+        if (new_score > cur_score + params->loglh_epsilon) {
+            cur_score = new_score;
+            min_radius = 1;
+        } else if (radius < max_radius) {
+            min_radius = radius + 1;
+            radius = min(radius * 2, max_radius);
+        } else {
+            break;
+        }
+    }
+
+    if (cur_score > orig_score && root->neighbors[0]->split)
+        buildNodeSplit();
+    // rejected moves left the score of their own tree behind
+    curScore = cur_score;
+    return cur_score;
+}
+
 /****************************************************************************
  Approximate Likelihood Ratio Test with SH-like interpretation
  ****************************************************************************/
@@ -5247,6 +5520,94 @@ bool PhyloTree::computeTraversalInfo(PhyloNeighbor *dad_branch, PhyloNode *dad,
     return mem_slots.lock(dad_branch);
 }
 
+size_t PhyloTree::getTraversalTileSize() {
+    size_t ncat_mix = (model_factory->fused_mix_rate) ? site_rate->getNRate() : site_rate->getNRate()*model->getNMixtures();
+    size_t bytes_per_ptn = aln->num_states * ncat_mix * sizeof(double);
+    size_t vsize = max(vector_size, (size_t)1);
+    size_t tile = getL2CacheSize() / (6*bytes_per_ptn);
+    tile = max(tile, 4*vsize);
+    return (tile/vsize)*vsize;
+}
+
+void PhyloTree::computeTraversalPartialLikelihood(size_t ptn_lower, size_t ptn_upper, int thread_id) {
+    size_t tile = getTraversalTileSize();
+    for (size_t lower = ptn_lower; lower < ptn_upper; ) {
+        size_t upper = min(lower+tile, ptn_upper);
+        if (!subsample_packets.empty()) {
+            // tiles do not cross packets, packets outside the pattern subsample are skipped
+            size_t packet_id = lower/subsample_packet_size;
+            size_t packet_upper = (packet_id+1)*subsample_packet_size;
+            if (!isSubsampledPacket(packet_id)) {
+                lower = packet_upper;
+                continue;
+            }
+            upper = min(upper, packet_upper);
+        }
+        for (vector<TraversalInfo>::iterator it = traversal_info.begin(); it != traversal_info.end(); it++)
+            computePartialLikelihood(*it, lower, upper, thread_id);
+        lower = upper;
+    }
+}
+
+int PhyloTree::setPatternSubsample(double fraction) {
+    subsample_packets.clear();
+    subsample_freq_scale = 1.0;
+    if (fraction < 1.0) {
+        ASSERT(vector_size > 0);
+        size_t orig_nptn = ((aln->size()+vector_size-1)/vector_size)*vector_size;
+        subsample_packet_size = computeReductionPacketSize(orig_nptn, vector_size);
+        size_t num_packets = (orig_nptn+subsample_packet_size-1)/subsample_packet_size;
+        size_t num_sampled = max((size_t)round(fraction*num_packets), min(num_packets, (size_t)2));
+        // random packets without replacement, each weighted by num_packets/num_sampled
+        IntVector packets(num_packets);
+        for (size_t packet_id = 0; packet_id < num_packets; packet_id++)
+            packets[packet_id] = packet_id;
+        my_random_shuffle(packets.begin(), packets.end());
+        subsample_packets.resize(num_packets, false);
+        for (size_t i = 0; i < num_sampled; i++)
+            subsample_packets[packets[i]] = true;
+        subsample_freq_scale = (double)num_packets / num_sampled;
+    }
+    // kernels must recompute everything for the new set of patterns
+    ptn_freq_computed = false;
+    computePtnFreq();
+    theta_computed = false;
+    clearAllPartialLH();
+    if (subsample_packets.empty())
+        return 0;
+    return count(subsample_packets.begin(), subsample_packets.end(), true);
+}
+
+double PhyloTree::computeSubsampleError(double *ptn_lh, double *ref_ptn_lh, double &diff) {
+    diff = 0.0;
+    if (subsample_packets.empty()) {
+        for (size_t ptn = 0; ptn < aln->size(); ptn++)
+            diff += (ptn_lh[ptn] - ref_ptn_lh[ptn]) * aln->at(ptn).frequency;
+        return 0.0;
+    }
+    size_t num_packets = subsample_packets.size();
+    DoubleVector packet_diff;
+    for (size_t packet_id = 0; packet_id < num_packets; packet_id++) {
+        if (!subsample_packets[packet_id])
+            continue;
+        double sum = 0.0;
+        size_t ptn_upper = min((packet_id+1)*subsample_packet_size, aln->size());
+        for (size_t ptn = packet_id*subsample_packet_size; ptn < ptn_upper; ptn++)
+            sum += (ptn_lh[ptn] - ref_ptn_lh[ptn]) * aln->at(ptn).frequency;
+        packet_diff.push_back(sum);
+        diff += sum;
+    }
+    diff *= subsample_freq_scale;
+    size_t k = packet_diff.size();
+    if (k < 2)
+        return 0.0;
+    double mean = diff / subsample_freq_scale / k, var = 0.0;
+    for (size_t i = 0; i < k; i++)
+        var += (packet_diff[i] - mean) * (packet_diff[i] - mean);
+    var /= (k-1);
+    return num_packets * sqrt((1.0 - (double)k/num_packets) * var / k);
+}
+
 void PhyloTree::writeSiteLh(ostream &out, SiteLoglType wsl, int partid) {
     // error checking
     if (!getModel()->isMixture()) {
@@ -163,6 +163,39 @@ typedef std::map< int, PhyloNode* > IntPhyloNodeMap;
 
 const int MAX_SPR_MOVES = 20;
 
+/**
+        initial regrafting radius of the lazy SPR search
+ */
+const int LAZY_SPR_INIT_RADIUS = 3;
+
+/**
+        maximum Newton-Raphson steps per branch when scoring a lazy SPR move
+ */
+const int LAZY_SPR_MAX_NR_STEP = 2;
+
+/**
+        lazy SPR moves scoring below the current log-likelihood by more than this
+        are not fully re-evaluated
+ */
+const double LAZY_SPR_LOGL_DROP = 1.0;
+
+/** maximal number of packets of computeReductionBoundsASC() */
+const size_t MAX_REDUCTION_PACKETS = 256;
+
+/** minimal number of patterns per packet of computeReductionBoundsASC() */
+const size_t MIN_REDUCTION_PACKET_SIZE = 64;
+
+/**
+        @param orig_nptn number of observed patterns, padded to the vector size
+        @param vsize SIMD vector size
+        @return number of patterns per packet of computeReductionBoundsASC(), all
+        packets have this size except the last one
+ */
+inline size_t computeReductionPacketSize(size_t orig_nptn, size_t vsize) {
+    size_t packet_size = max((orig_nptn+MAX_REDUCTION_PACKETS-1)/MAX_REDUCTION_PACKETS, MIN_REDUCTION_PACKET_SIZE);
+    return ((packet_size+vsize-1)/vsize)*vsize;
+}
+
 struct NNIMove {
 
     // Two nodes representing the central branch
@@ -208,7 +241,70 @@ struct SPR_compare {
 class SPRMoves : public set<SPRMove, SPR_compare> {
 public:
     void add(PhyloNode *prune_node, PhyloNode *prune_dad,
-            PhyloNode *regraft_node, PhyloNode *regraft_dad, double score);
+            PhyloNode *regraft_node, PhyloNode *regraft_dad, double score,
+            int max_moves = MAX_SPR_MOVES);
+};
+
+/**
+        relative decrease of the balanced tree length below which a BME move
+        is not considered an improvement
+ */
+const double BME_EPSILON = 1e-10;
+
+/**
+        balanced average distances between pairs of disjoint subtrees for the
+        balanced minimum evolution (BME) search. The tree is rooted at its root leaf;
+        D(u) denotes the subtree below node u and U(u) the rest of the tree.
+        Entry (u,v) holds the average between D(u) and D(v) if neither node is an
+        ancestor of the other, and between U(u) and D(v) if u is an ancestor of v
+        (u == v gives D(u) against U(u)). The row of the root leaf equals the row
+        of its neighbor, as U(neighbor) is the root leaf alone.
+        The matrix takes 8*nodeNum^2 bytes, i.e. about 32*n^2 bytes for n taxa.
+ */
+struct BMEAverages {
+    /** number of nodes */
+    int size;
+    /** size*size matrix of averages indexed by node IDs */
+    vector<double> avg;
+    /** nodes indexed by ID */
+    vector<PhyloNode*> nodes;
+    /** parent node ID, -1 for the root leaf */
+    IntVector parent;
+    /** depth of each node, the root leaf has depth 0 */
+    IntVector depth;
+    /** node IDs in preorder from the root leaf, every subtree is contiguous in it */
+    IntVector preorder;
+    /** position of each node in preorder */
+    IntVector pre_index;
+    /** position of the last node of the subtree below each node in preorder */
+    IntVector last_index;
+
+    inline double &at(int u, int v) {
+        return avg[(size_t)u*size + v];
+    }
+
+    /**
+            @return matrix index of the subtree rooted at node looking away from dad
+     */
+    inline int index(PhyloNode *node, PhyloNode *dad) {
+        return (parent[node->id] == dad->id) ? node->id : dad->id;
+    }
+};
+
+/**
+        placement of a query sequence on the branch between node and dad,
+        where dad lies towards the root of the tree
+ */
+struct PlacementInfo {
+    PhyloNode *node, *dad;
+    /** log-likelihood of the tree with the query inserted */
+    double logl;
+    /** likelihood weight ratio among the placements of the same query */
+    double lwr;
+    /** distance of the insertion point from node */
+    double distal_length;
+    /** length of the new branch leading to the query */
+    double pendant_length;
 };
 
 /*
@@ -655,6 +751,16 @@ public:
 
     virtual void setParsimonyKernelSSE();
 
+#ifdef __AVX512KNL
+    /** AVX-512 parsimony kernel, using VPOPCNTDQ if the CPU supports it */
+    virtual void setParsimonyKernelAVX512();
+#endif
+
+#ifdef __AVX512POPCNT
+    /** AVX-512 parsimony kernel with VPOPCNTDQ vector popcount */
+    virtual void setParsimonyKernelAVX512Popcnt();
+#endif
+
     /****************************************************************************
             likelihood function
      ****************************************************************************/
@@ -732,6 +838,19 @@ public:
     /** number of threads used for likelihood kernel */
     int num_threads;
 
+    /**
+        pattern subsample of the tree search (-psub): for each packet of
+        computeReductionBoundsASC() whether it is in the subsample,
+        empty if the likelihood kernels use all patterns
+    */
+    BoolVector subsample_packets;
+
+    /** number of patterns per packet of subsample_packets */
+    size_t subsample_packet_size;
+
+    /** factor of the pattern frequencies in the subsample, so that the log-likelihood estimates the full one */
+    double subsample_freq_scale;
+
 
     /****************************************************************************
             helper functions for computing tree traversal
@@ -760,6 +879,57 @@ public:
     template<class VectorClass>
     void computePartialInfo(TraversalInfo &info, VectorClass* buffer);
 
+    /**
+        compute partial likelihoods of all nodes in traversal_info for a pattern range.
+        The range is split into tiles of getTraversalTileSize() patterns and the whole
+        traversal is done per tile, so that the partial likelihoods of the children are
+        still in cache when their parent is computed
+        @param ptn_lower first pattern
+        @param ptn_upper last pattern (exclusive)
+        @param thread_id thread ID
+    */
+    void computeTraversalPartialLikelihood(size_t ptn_lower, size_t ptn_upper, int thread_id);
+
+    /**
+        @return number of patterns per tile of computeTraversalPartialLikelihood(), such that
+        the partial likelihoods of a node and its two children fill half of the L2 cache
+    */
+    size_t getTraversalTileSize();
+
+    /**
+        @param packet_id packet ID of computeReductionBoundsASC()
+        @return TRUE if the packet is in the pattern subsample or there is no subsample
+    */
+    inline bool isSubsampledPacket(size_t packet_id) {
+        return subsample_packets.empty() || packet_id >= subsample_packets.size() || subsample_packets[packet_id];
+    }
+
+    /**
+        restrict the likelihood kernels to a weighted random subsample of the patterns.
+        Packets of computeReductionBoundsASC() are drawn uniformly without replacement.
+        ptn_freq of the drawn patterns is scaled by the inverse sampling fraction, so that
+        the log-likelihood is an unbiased estimate of the one of the whole alignment.
+        The other packets are skipped by the kernels, the alignment itself is not changed.
+        @param fraction fraction of packets in the subsample, 1.0 to use all patterns again
+        @return number of drawn packets
+    */
+    int setPatternSubsample(double fraction);
+
+    /** @return TRUE if the likelihood kernels run on a pattern subsample */
+    bool isPatternSubsample() {
+        return !subsample_packets.empty();
+    }
+
+    /**
+        compare two trees on the pattern subsample
+        @param ptn_lh pattern log-likelihoods of the first tree
+        @param ref_ptn_lh pattern log-likelihoods of the second tree
+        @param[out] diff estimated log-likelihood difference on the whole alignment
+        @return standard error of diff due to subsampling, estimated from the variation
+        between the drawn packets with finite population correction
+    */
+    double computeSubsampleError(double *ptn_lh, double *ref_ptn_lh, double &diff);
+
     /** 
         sort neighbor in descending order of subtree size (number of leaves within subree)
         @param node the starting node, NULL to start from the root
@@ -983,28 +1153,64 @@ public:
     virtual void endMarginalAncestralState(bool orig_kernel_nonrev, double* &ptn_ancestral_prob, int* &ptn_ancestral_seq);
 
     /**
-     	 compute the joint ancestral states at a pattern (Pupko et al. 2000)
+        compute the joint maximum-likelihood ancestral states of all internal nodes by the
+        dynamic programming algorithm of Pupko et al. 2000, MBE 17:890-896.
+        With rate heterogeneity or mixture models each pattern is conditioned on its most likely category.
+        @param[out] ancestral_seqs array of size (nodeNum-leafNum)*nptn, the state of internal node
+            with ID id at pattern ptn is at (id-leafNum)*nptn+ptn
+        @return joint log-likelihood of the reconstruction given the pattern categories
      */
-    void computeJointAncestralSequences(int *ancestral_seqs);
+    double computeJointAncestralSequences(int *ancestral_seqs);
 
     /**
-     * compute max ancestral likelihood according to
-     *  step 1-3 of the dynamic programming algorithm of Pupko et al. 2000, MBE 17:890-896
-     *  @param dad_branch branch leading to an internal node where to obtain ancestral sequence
-     *  @param dad dad of the target internal node
-     *  @param[out] C array storing all information about max ancestral states
+        used internally by computeJointAncestralSequences() to compute the number of leaves below each node
+        @param node the current node
+        @param dad dad of the node, used to direct the search
+        @param[out] subtree_size number of leaves of the subtree below node, indexed by node ID
+        @return number of leaves of the subtree below node
      */
-    void computeAncestralLikelihood(PhyloNeighbor *dad_branch, PhyloNode *dad, int *C);
+    int computeSubtreeSize(PhyloNode *node, PhyloNode *dad, IntVector &subtree_size);
 
     /**
-     * compute max ancestral states according to
-     *  step 4-5 of the dynamic programming algorithm of Pupko et al. 2000, MBE 17:890-896
-     *  @param dad_branch branch leading to an internal node where to obtain ancestral sequence
-     *  @param dad dad of the target internal node
-     *  @param C array storing all information about max ancestral states
-     *  @param[out] ancestral_seqs array of size nptn*nnode for ancestral sequences at all internal nodes
+        used internally by computeJointAncestralSequences() to get internal nodes in postorder,
+        larger subtrees first so that few subtree likelihood vectors are kept at the same time
+        @param node the current node
+        @param dad dad of the node, used to direct the search
+        @param subtree_size number of leaves below each node from computeSubtreeSize()
+        @param[out] nodes internal nodes in postorder
+        @param[out] dads dads of nodes, NULL for the top node
      */
-    void computeAncestralState(PhyloNeighbor *dad_branch, PhyloNode *dad, int *C, int *ancestral_seqs);
+    void getJointAncestralOrder(PhyloNode *node, PhyloNode *dad, IntVector &subtree_size,
+        NodeVector &nodes, NodeVector &dads);
+
+    /****************************************************************************
+            substitution mapping
+     ****************************************************************************/
+
+    /**
+        initialize computing expected substitution counts, switch to the nonrev kernel
+        that keeps partial likelihoods in the state space
+        @param[out] orig_kernel_nonrev original kernel_nonrev parameter
+    */
+    void initSubstitutionCounts(bool &orig_kernel_nonrev);
+
+    /**
+        compute the expected number of substitutions on a branch for every pattern given the data.
+        The endpoint-conditioned expectations are computed in closed form from the eigen
+        decomposition of the rate matrix (Minin and Suchard 2008, J Math Biol 56:391-412)
+        @param dad_branch branch leading to node
+        @param dad dad of node
+        @param by_type TRUE to count each substitution type i->j, otherwise all substitutions
+        @param[out] ptn_count expected counts of size nptn*ntypes with ntypes = 1 or nstates*(nstates-1),
+            types ordered as i->j for each i and then each j != i
+    */
+    void computeSubstitutionCounts(PhyloNeighbor *dad_branch, PhyloNode *dad, bool by_type, double *ptn_count);
+
+    /**
+        end computing expected substitution counts, switch back to the original kernel
+        @param orig_kernel_nonrev original kernel_nonrev parameter from initSubstitutionCounts()
+    */
+    void endSubstitutionCounts(bool orig_kernel_nonrev);
 
     /**
             compute pattern likelihoods only if the accumulated scaling factor is non-zero.
@@ -1489,6 +1695,46 @@ public:
      */
     double addTaxonML(Node *added_node, Node* &target_node, Node* &target_dad, Node *node, Node *dad);
 
+    /****************************************************************************
+            Placement of query sequences onto the fixed tree
+     ****************************************************************************/
+
+    /**
+            place query sequences onto the branches of this tree, keeping the tree and the model fixed.
+            Every query is scored on every branch at the middle of the branch with an optimized
+            pendant length. The best placements are then refined by also optimizing the
+            insertion point along the branch, like addTaxonML() does for a new taxon.
+            Queries are processed in parallel
+            @param query_aln alignment with the query sequences, with the same sites as aln
+            @param query_ids IDs of the query sequences in query_aln
+            @param keep maximum number of placements kept per query
+            @param refine TRUE to refine the insertion point, FALSE to keep the middle of the branch
+            @param[out] placements placements of each query, best first
+     */
+    void placeQueries(Alignment *query_aln, IntVector &query_ids, int keep, bool refine,
+            vector<vector<PlacementInfo> > &placements);
+
+    /**
+            insert every query as a new leaf at its best placement. The new leaves get the ids
+            following the reference leaves and the internal nodes are renumbered behind them.
+            Afterwards the tree no longer matches the alignment and can only be printed
+            @param query_names names of the query sequences
+            @param placements placements from placeQueries()
+     */
+    void insertQueries(StrVector &query_names, vector<vector<PlacementInfo> > &placements);
+
+    /**
+            compute the partial likelihoods on both sides of a branch with the nonrev kernel
+            and copy them out in the state space, one pattern after another
+            @param dad_branch branch leading to node
+            @param dad dad of node
+            @param[out] lh_dad partial likelihoods of the dad side, of size nptn*ncat_mix*nstates
+            @param[out] lh_node partial likelihoods of the node side, of the same size
+            @param[out] log_scale log scaling factor of both sides together, per pattern
+     */
+    void getBranchPartialLh(PhyloNeighbor *dad_branch, PhyloNode *dad, double *lh_dad, double *lh_node,
+            double *log_scale);
+
     /****************************************************************************
             Distance function
      ****************************************************************************/
@@ -1659,6 +1905,150 @@ public:
     void regraftSubtree(PruningInfo &info,
             PhyloNode *in_node, PhyloNode *in_dad);
 
+    /****************************************************************************
+            Lazy SPR: regrafting positions are scored with only the three branches
+            adjacent to the insertion point optimized, the best moves are then
+            fully re-evaluated
+     ****************************************************************************/
+
+    /**
+            search by lazy subtree pruning and regrafting with adaptive radius
+            @param cur_score current likelihood score
+            @param max_radius maximum regrafting distance from the pruning point
+            @param max_moves number of best lazy moves to fully re-evaluate per round
+            @return the likelihood of the tree
+     */
+    double optimizeLazySPR(double cur_score, int max_radius, int max_moves = MAX_SPR_MOVES);
+
+    /**
+            score all regrafting positions of the subtree (dad-node) within a distance range
+            @param node root of the pruned subtree
+            @param dad node attaching the subtree to the rest of the tree
+            @param min_radius minimum regrafting distance
+            @param max_radius maximum regrafting distance
+            @param[out] moves best moves found
+            @param max_moves maximum number of moves kept
+     */
+    void evaluateLazySPR(PhyloNode *node, PhyloNode *dad, int min_radius, int max_radius,
+            SPRMoves &moves, int max_moves);
+
+    /**
+            recursively score regrafting the subtree (dad-node) onto (node2-dad2) and
+            onto branches further away from the pruning point
+            @param depth distance of (node2-dad2) from the pruning point
+     */
+    void evaluateLazyRegraft(PhyloNode *node, PhyloNode *dad, PhyloNode *node2, PhyloNode *dad2,
+            int depth, int min_radius, int max_radius, SPRMoves &moves, int max_moves);
+
+    /**
+            fully evaluate an SPR move: apply it and optimize all branch lengths.
+            The move is kept if it improves the likelihood, otherwise reverted.
+            @param cur_score current likelihood score
+            @return new likelihood score if the move was kept, cur_score otherwise
+     */
+    double applyLazySPRMove(double cur_score, const SPRMove &spr);
+
+    /**
+            swap partial likelihood vectors together with their status between two
+            neighbors, so that cached vectors follow the subtree they belong to
+            when neighbors are relinked by a topology move
+     */
+    void swapPartialLh(PhyloNeighbor *nei1, PhyloNeighbor *nei2);
+
+    /**
+            detach the subtree (dad-node) by joining the two other neighbors of dad.
+            Partial likelihoods not affected by the pruning are kept.
+            @param[out] sibling1 first neighbor of dad other than node
+            @param[out] sibling2 second neighbor of dad other than node
+     */
+    void pruneSubtreeLazy(PhyloNode *node, PhyloNode *dad, PhyloNode *&sibling1, PhyloNode *&sibling2);
+
+    /**
+            undo pruneSubtreeLazy()
+            @param sibling1_len original length of branch (dad-sibling1)
+            @param sibling2_len original length of branch (dad-sibling2)
+     */
+    void unpruneSubtreeLazy(PhyloNode *node, PhyloNode *dad, PhyloNode *sibling1, PhyloNode *sibling2,
+            double sibling1_len, double sibling2_len);
+
+    /**
+            insert the pruned subtree (dad-node) into the branch (node2-dad2),
+            halving its length. Partial likelihoods pointing away from dad are kept.
+     */
+    void regraftSubtreeLazy(PhyloNode *node, PhyloNode *dad, PhyloNode *node2, PhyloNode *dad2);
+
+    /**
+            undo regraftSubtreeLazy()
+            @param len2 original length of branch (node2-dad2)
+     */
+    void unregraftSubtreeLazy(PhyloNode *node, PhyloNode *dad, PhyloNode *node2, PhyloNode *dad2, double len2);
+
+    /****************************************************************************
+            Balanced minimum evolution (BME) search on the distance matrix,
+            FastME-style NNI and SPR moves scored from balanced subtree averages
+     ****************************************************************************/
+
+    /**
+            improve the current topology by BME NNI and SPR moves on dist_matrix
+            and assign BME branch lengths. If the matrix of balanced averages (see BMEAverages)
+            needs more than half of the RAM, optimizeBMENNI() is used instead
+            @param spr_radius maximum regrafting distance of SPR moves, 1 for NNI only
+            @return balanced tree length of the final tree
+     */
+    double optimizeBME(int spr_radius);
+
+    /**
+            bounded-memory BME search with NNI moves only: keeps O(n) averages around the
+            branches, recomputed from dist_matrix in O(n^2) time after each round of moves
+            @return balanced tree length of the final tree
+     */
+    double optimizeBMENNI();
+
+    /**
+            compute balanced averages between all pairs of disjoint subtrees in O(n^2),
+            parallel over nodes of the same height (down averages) and depth (up averages)
+            @param[out] bme balanced averages
+            @return balanced tree length
+     */
+    double computeBMEAverages(BMEAverages &bme);
+
+    /**
+            NNI swapping subtree sub1 next to node1 with subtree sub2 next to node2, followed by
+            an incremental update of the balanced averages as in FastME: only the rows of the
+            nodes from the branch (node1-node2) up to the root change between disjoint subtrees,
+            the averages against the rest of the tree are then recomputed in O(n*depth)
+            @param bme balanced averages of the current tree, updated
+            @return balanced tree length after the NNI
+     */
+    double doBMENNI(BMEAverages &bme, PhyloNode *node1, PhyloNode *node2, PhyloNode *sub1, PhyloNode *sub2);
+
+    /**
+            find the best BME regrafting position of the subtree (dad-node) within a radius
+            @param bme balanced averages of the current tree
+            @param[out] best best move found, score is the decrease of the tree length
+     */
+    void evaluateBMESPR(BMEAverages &bme, PhyloNode *node, PhyloNode *dad, int radius, SPRMove &best);
+
+    /**
+            recursively score regrafting subtree X onto branches beyond node w, reached
+            from prev. Each step is an NNI moving X one branch further away from its
+            original position; Q is the subtree behind X, given as weighted sum of
+            subtrees of the current tree.
+            @param x_idx matrix index of subtree X
+            @param dist_xq balanced average between X and Q
+            @param q_subtrees matrix index and weight of each part of Q
+            @param gain decrease of the tree length of moving X onto (w-prev)
+     */
+    void evaluateBMERegraft(BMEAverages &bme, PhyloNode *node, PhyloNode *dad, int x_idx,
+            PhyloNode *w, PhyloNode *prev, double dist_xq, vector<pair<int,double> > &q_subtrees,
+            double gain, int depth, int radius, SPRMove &best);
+
+    /**
+            set branch lengths to the BME estimates
+            @param bme balanced averages of the current tree
+     */
+    void assignBMEBranchLengths(BMEAverages &bme);
+
     /****************************************************************************
             Approximate Likelihood Ratio Test with SH-like interpretation
      ****************************************************************************/
@@ -1722,6 +2112,20 @@ public:
     /** read clusters for likelihood mapping analysis */
     void readLikelihoodMappingGroups(char *filename, QuartetGroups &LMGroups);
 
+    /**
+        compute site concordance factors for the internal branches from extractQuadSubtrees().
+        For each branch AB|CD, quartets with one taxon from each of A, B, C and D are drawn,
+        and the sites with a pattern xxyy, xyxy or xyyx (x != y) are counted for the quartet.
+        @param subtrees four subtrees per internal branch from extractQuadSubtrees()
+        @param num_quartets number of quartets drawn per branch
+        @param[out] scf mean fraction of sites supporting AB|CD over quartets with such sites
+        @param[out] sdf1 mean fraction of sites supporting AC|BD
+        @param[out] sdf2 mean fraction of sites supporting AD|BC
+        @param[out] sites mean number of sites supporting any of the three per quartet
+    */
+    void computeSiteConcordance(vector<Split*> &subtrees, int num_quartets,
+        DoubleVector &scf, DoubleVector &sdf1, DoubleVector &sdf2, DoubleVector &sites);
+
     /****************************************************************************
             Collapse stable (highly supported) clades by one representative
      ****************************************************************************/
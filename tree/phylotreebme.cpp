@@ -0,0 +1,676 @@
+/*
+ * phylotreebme.cpp
+ *
+ * Balanced minimum evolution (BME) tree search with NNI and SPR moves,
+ * following Desper & Gascuel (2002) and FastME
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#include "phylotree.h"
+#include "utils/timeutil.h"
+
+/**
+        an applied BME NNI swapping sub1 next to node1 with sub2 next to node2
+ */
+struct BMEAppliedNNI {
+    PhyloNode *node1, *node2, *sub1, *sub2;
+};
+
+/**
+        balanced averages of the bounded-memory BME search (see PhyloTree::optimizeBMENNI),
+        which keeps for every internal node the averages between its three neighbor subtrees
+        and for every internal branch the four averages across it, O(nodeNum) in total
+ */
+struct BMEBranchAverages {
+    /** nodes indexed by ID */
+    vector<PhyloNode*> nodes;
+    /** the three neighbor IDs of internal node u at 3*u, 3*u+1, 3*u+2 */
+    IntVector nei;
+    /** entry 3*u+k: average between the subtrees at the two neighbors of u other than nei[3*u+k] */
+    DoubleVector pair;
+    /** entry 4*(3*u+k)+2*i+j for u < v = nei[3*u+k]: average between the i-th other subtree
+        next to u and the j-th other subtree next to v, both counted from their slot of the branch */
+    DoubleVector cross;
+
+    /** @return slot of neighbor v in the neighbor list of u */
+    inline int slot(int u, int v) {
+        return (nei[3*u] == v) ? 0 : ((nei[3*u+1] == v) ? 1 : 2);
+    }
+};
+
+/**
+        swap subtree sub1 next to node1 with subtree sub2 next to node2
+ */
+static void swapBMESubtrees(PhyloNode *node1, PhyloNode *node2, PhyloNode *sub1, PhyloNode *sub2) {
+    double len1 = node1->findNeighbor(sub1)->length;
+    double len2 = node2->findNeighbor(sub2)->length;
+    node1->updateNeighbor(sub1, sub2, len2);
+    sub2->updateNeighbor(node2, node1, len2);
+    node2->updateNeighbor(sub2, sub1, len1);
+    sub1->updateNeighbor(node1, node2, len1);
+}
+
+/**
+        @return BME length of the branch between internal node u and its k-th neighbor
+ */
+static double computeBMEBranchLength(BMEBranchAverages &bme, int u, int k) {
+    int v = bme.nei[3*u+k];
+    if (bme.nodes[v]->isLeaf())
+        return 0.5 * (bme.pair[3*u+(k+1)%3] + bme.pair[3*u+(k+2)%3] - bme.pair[3*u+k]);
+    int kv = bme.slot(v, u);
+    if (v < u)
+        return computeBMEBranchLength(bme, v, kv);
+    double *c = &bme.cross[4*(3*u+k)];
+    return 0.25 * (c[0] + c[1] + c[2] + c[3]) - 0.5 * (bme.pair[3*u+k] + bme.pair[3*v+kv]);
+}
+
+/**
+        compute the branch averages from the distance matrix in O(n^2) time and O(n) memory per thread.
+        Each leaf a contributes its averages against the subtrees looking away from it, weighted
+        by its share in the subtree containing it, to every pair with that subtree; as both sides
+        of a pair contribute, the sums are halved at the end.
+        @return balanced tree length
+ */
+static double computeBMEBranchAverages(BMEBranchAverages &bme, double *dist_matrix, int nseq) {
+    int n = bme.nodes.size();
+    bme.nei.assign(3*n, -1);
+    for (int u = 0; u < n; u++) {
+        if (bme.nodes[u]->isLeaf())
+            continue;
+        int k = 0;
+        FOR_NEIGHBOR_IT(bme.nodes[u], NULL, it)
+            bme.nei[3*u + k++] = (*it)->node->id;
+    }
+    bme.pair.assign(3*n, 0.0);
+    bme.cross.assign(12*n, 0.0);
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+    {
+        DoubleVector pair(3*n, 0.0), cross(12*n, 0.0), down(n), weight(n);
+        IntVector order, dad(n);
+        order.reserve(n);
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+        for (int a = 0; a < n; a++) {
+            if (!bme.nodes[a]->isLeaf())
+                continue;
+            // breadth-first order of the tree rooted at leaf a, weight 2^-depth
+            order.clear();
+            order.push_back(a);
+            dad[a] = -1;
+            weight[a] = 1.0;
+            for (int i = 0; i < order.size(); i++) {
+                int u = order[i];
+                FOR_NEIGHBOR_IT(bme.nodes[u], NULL, it) {
+                    int v = (*it)->node->id;
+                    if (v == dad[u])
+                        continue;
+                    dad[v] = u;
+                    weight[v] = 0.5 * weight[u];
+                    order.push_back(v);
+                }
+            }
+            // averages between a and the subtree below each node
+            for (int i = n-1; i > 0; i--) {
+                int v = order[i];
+                if (bme.nodes[v]->isLeaf()) {
+                    down[v] = dist_matrix[a*nseq + v];
+                } else {
+                    int kp = bme.slot(v, dad[v]);
+                    down[v] = 0.5 * (down[bme.nei[3*v+(kp+1)%3]] + down[bme.nei[3*v+(kp+2)%3]]);
+                }
+            }
+            // a lies in the subtree at dad[u] as seen from u
+            for (int i = 1; i < n; i++) {
+                int u = order[i];
+                if (bme.nodes[u]->isLeaf())
+                    continue;
+                int kp = bme.slot(u, dad[u]);
+                double w = weight[dad[u]];
+                for (int c = 1; c <= 2; c++) {
+                    int k = (kp+c) % 3, x = bme.nei[3*u+k];
+                    pair[3*u + (kp+3-c)%3] += w * down[x];
+                    if (bme.nodes[x]->isLeaf())
+                        continue;
+                    int kx = bme.slot(x, u);
+                    int ip = (kp == (k+1)%3) ? 0 : 1;
+                    for (int j = 0; j < 2; j++) {
+                        double val = w * down[bme.nei[3*x+(kx+j+1)%3]];
+                        if (u < x)
+                            cross[4*(3*u+k) + 2*ip + j] += val;
+                        else
+                            cross[4*(3*x+kx) + 2*j + ip] += val;
+                    }
+                }
+            }
+        }
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+        {
+            for (int i = 0; i < 3*n; i++)
+                bme.pair[i] += 0.5 * pair[i];
+            for (int i = 0; i < 12*n; i++)
+                bme.cross[i] += 0.5 * cross[i];
+        }
+    }
+
+    double tree_len = 0.0;
+    for (int u = 0; u < n; u++)
+        if (!bme.nodes[u]->isLeaf())
+            for (int k = 0; k < 3; k++)
+                if (bme.nodes[bme.nei[3*u+k]]->isLeaf() || u < bme.nei[3*u+k])
+                    tree_len += computeBMEBranchLength(bme, u, k);
+    return tree_len;
+}
+
+/**
+        @return BME length of the branch between node and its parent
+ */
+static double computeBMEBranchLength(BMEAverages &bme, PhyloNode *node) {
+    int u = node->id;
+    int p = bme.parent[u];
+    PhyloNode *dad = bme.nodes[p];
+    if (bme.parent[p] < 0) {
+        // branch to the root leaf, whose subtree is stored in the row of node
+        int c[2], i = 0;
+        FOR_NEIGHBOR_IT(node, dad, it)
+            c[i++] = (*it)->node->id;
+        return 0.5 * (bme.at(u, c[0]) + bme.at(u, c[1]) - bme.at(c[0], c[1]));
+    }
+    int s = -1;
+    FOR_NEIGHBOR_IT(dad, node, it)
+        if ((*it)->node->id != bme.parent[p])
+            s = (*it)->node->id;
+    ASSERT(s >= 0);
+    if (node->isLeaf())
+        return 0.5 * (bme.at(u, s) + bme.at(p, u) - bme.at(p, s));
+    int c[2], i = 0;
+    FOR_NEIGHBOR_IT(node, dad, it)
+        c[i++] = (*it)->node->id;
+    return 0.25 * (bme.at(c[0], s) + bme.at(p, c[0]) + bme.at(c[1], s) + bme.at(p, c[1]))
+            - 0.5 * (bme.at(c[0], c[1]) + bme.at(p, s));
+}
+
+/**
+        collect the nodes on the path from node1 to node2, both included
+ */
+static void getBMEPath(BMEAverages &bme, int node1, int node2, IntVector &path) {
+    IntVector down;
+    while (node1 != node2) {
+        if (bme.depth[node1] >= bme.depth[node2]) {
+            path.push_back(node1);
+            node1 = bme.parent[node1];
+        } else {
+            down.push_back(node2);
+            node2 = bme.parent[node2];
+        }
+    }
+    path.push_back(node1);
+    path.insert(path.end(), down.rbegin(), down.rend());
+}
+
+/**
+        compute parent, depth and preorder of the tree rooted at its root leaf
+ */
+static void computeBMEStructure(BMEAverages &bme, PhyloNode *root) {
+    int n = bme.size;
+    bme.nodes.assign(n, NULL);
+    bme.parent.assign(n, -1);
+    bme.depth.assign(n, 0);
+    bme.preorder.clear();
+    bme.preorder.reserve(n);
+    bme.pre_index.resize(n);
+    bme.last_index.assign(n, 0);
+    PhyloNodeVector stack;
+    stack.push_back(root);
+    while (!stack.empty()) {
+        PhyloNode *node = stack.back();
+        stack.pop_back();
+        bme.pre_index[node->id] = bme.preorder.size();
+        bme.preorder.push_back(node->id);
+        bme.nodes[node->id] = node;
+        Node *dad = (bme.parent[node->id] < 0) ? NULL : bme.nodes[bme.parent[node->id]];
+        FOR_NEIGHBOR_IT(node, dad, it) {
+            bme.parent[(*it)->node->id] = node->id;
+            bme.depth[(*it)->node->id] = bme.depth[node->id] + 1;
+            stack.push_back((PhyloNode*)(*it)->node);
+        }
+    }
+    ASSERT(bme.preorder.size() == n);
+    for (int i = n-1; i >= 0; i--) {
+        int u = bme.preorder[i];
+        if (bme.last_index[u] < i)
+            bme.last_index[u] = i;
+        int p = bme.parent[u];
+        if (p >= 0)
+            bme.last_index[p] = max(bme.last_index[p], bme.last_index[u]);
+    }
+}
+
+/**
+        compute the averages between D(u) and every subtree disjoint from it,
+        from the leaves upwards within the row of u
+ */
+static void computeBMEDownRow(BMEAverages &bme, int u, double *dist_matrix, int nseq) {
+    int n = bme.size;
+    int root_id = bme.preorder[0];
+    PhyloNode *node = bme.nodes[u];
+    int uc[2] = {-1, -1}, k = 0;
+    if (!node->isLeaf()) {
+        FOR_NEIGHBOR_IT(node, bme.nodes[bme.parent[u]], it)
+            uc[k++] = (*it)->node->id;
+    }
+    double *row = &bme.at(u, 0);
+    for (int i = n-1; i >= 1; i--) {
+        int v = bme.preorder[i];
+        if ((bme.pre_index[u] <= i && i <= bme.last_index[u]) ||
+            (bme.pre_index[v] <= bme.pre_index[u] && bme.pre_index[u] <= bme.last_index[v]))
+            continue;
+        PhyloNode *node2 = bme.nodes[v];
+        if (!node2->isLeaf()) {
+            int vc[2], l = 0;
+            FOR_NEIGHBOR_IT(node2, bme.nodes[bme.parent[v]], it)
+                vc[l++] = (*it)->node->id;
+            row[v] = 0.5 * (row[vc[0]] + row[vc[1]]);
+        } else if (uc[0] < 0) {
+            row[v] = dist_matrix[u*nseq + v];
+        } else {
+            row[v] = 0.5 * (bme.at(uc[0], v) + bme.at(uc[1], v));
+        }
+    }
+    if (uc[0] < 0)
+        row[root_id] = dist_matrix[u*nseq + root_id];
+    else
+        row[root_id] = 0.5 * (bme.at(uc[0], root_id) + bme.at(uc[1], root_id));
+}
+
+/**
+        compute the averages between U(u) and the subtrees below u from the root downwards,
+        given all averages between disjoint subtrees. This takes O(n*depth) time.
+        @return balanced tree length
+ */
+static double computeBMEUpAverages(BMEAverages &bme) {
+    int n = bme.size;
+    int root_id = bme.preorder[0];
+    int top_id = bme.preorder[1];
+    // U(top) is the root leaf
+    for (int u = 0; u < n; u++)
+        if (u != root_id && u != top_id)
+            bme.at(top_id, u) = bme.at(u, top_id) = bme.at(u, root_id);
+    bme.at(top_id, top_id) = bme.at(top_id, root_id);
+
+    int max_depth = 0;
+    for (int u = 0; u < n; u++)
+        max_depth = max(max_depth, bme.depth[u]);
+    vector<IntVector> depth_nodes(max_depth+1);
+    for (int i = 1; i < n; i++)
+        depth_nodes[bme.depth[bme.preorder[i]]].push_back(bme.preorder[i]);
+    for (int d = 2; d <= max_depth; d++) {
+        IntVector &level = depth_nodes[d];
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+        for (int j = 0; j < level.size(); j++) {
+            int u = level[j];
+            int p = bme.parent[u];
+            int s = -1;
+            FOR_NEIGHBOR_IT(bme.nodes[p], bme.nodes[u], it)
+                if ((*it)->node->id != bme.parent[p])
+                    s = (*it)->node->id;
+            ASSERT(s >= 0);
+            // U(u) is made of D(s) and U(p)
+            for (int i = bme.pre_index[u]; i <= bme.last_index[u]; i++) {
+                int v = bme.preorder[i];
+                bme.at(u, v) = bme.at(v, u) = 0.5 * (bme.at(s, v) + bme.at(p, v));
+            }
+        }
+    }
+
+    double tree_len = 0.0;
+    for (int i = 1; i < n; i++)
+        tree_len += computeBMEBranchLength(bme, bme.nodes[bme.preorder[i]]);
+    return tree_len;
+}
+
+double PhyloTree::computeBMEAverages(BMEAverages &bme) {
+    ASSERT(dist_matrix);
+    ASSERT(root->isLeaf());
+    int nseq = aln->getNSeq();
+    int n = nodeNum;
+    bme.size = n;
+    if (bme.avg.size() != (size_t)n*n)
+        bme.avg.resize((size_t)n*n);
+    computeBMEStructure(bme, (PhyloNode*)root);
+
+    IntVector height(n, 0);
+    int max_height = 0;
+    for (int i = n-1; i >= 1; i--) {
+        int u = bme.preorder[i];
+        int p = bme.parent[u];
+        height[p] = max(height[p], height[u] + 1);
+        max_height = max(max_height, height[p]);
+    }
+    vector<IntVector> height_nodes(max_height+1);
+    for (int i = 1; i < n; i++)
+        height_nodes[height[bme.preorder[i]]].push_back(bme.preorder[i]);
+
+    // averages between disjoint subtrees below two nodes, from leaves upwards.
+    // The root leaf is disjoint from every subtree below its neighbor.
+    for (int h = 0; h <= max_height; h++) {
+        IntVector &level = height_nodes[h];
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+        for (int j = 0; j < level.size(); j++)
+            computeBMEDownRow(bme, level[j], dist_matrix, nseq);
+    }
+    int root_id = root->id;
+    for (int u = 0; u < n; u++)
+        if (u != root_id)
+            bme.at(root_id, u) = bme.at(u, root_id);
+
+    return computeBMEUpAverages(bme);
+}
+
+double PhyloTree::doBMENNI(BMEAverages &bme, PhyloNode *node1, PhyloNode *node2, PhyloNode *sub1, PhyloNode *sub2) {
+    double len1 = node1->findNeighbor(sub1)->length;
+    double len2 = node2->findNeighbor(sub2)->length;
+    node1->updateNeighbor(sub1, sub2, len2);
+    sub2->updateNeighbor(node2, node1, len2);
+    node2->updateNeighbor(sub2, sub1, len1);
+    sub1->updateNeighbor(node1, node2, len1);
+    computeBMEStructure(bme, (PhyloNode*)root);
+
+    // D(u) changes for the lower node of the branch and for all nodes above it,
+    // the averages between other disjoint subtrees stay the same
+    int nseq = aln->getNSeq();
+    int root_id = root->id;
+    int u = (bme.parent[node1->id] == node2->id) ? node1->id : node2->id;
+    for (; u != root_id; u = bme.parent[u]) {
+        computeBMEDownRow(bme, u, dist_matrix, nseq);
+        for (int i = 0; i < bme.size; i++) {
+            int v = bme.preorder[i];
+            if ((bme.pre_index[u] <= i && i <= bme.last_index[u]) ||
+                (bme.pre_index[v] < bme.pre_index[u] && bme.pre_index[u] <= bme.last_index[v]))
+                continue;
+            bme.at(v, u) = bme.at(u, v);
+        }
+        bme.at(root_id, u) = bme.at(u, root_id);
+    }
+    return computeBMEUpAverages(bme);
+}
+
+void PhyloTree::evaluateBMERegraft(BMEAverages &bme, PhyloNode *node, PhyloNode *dad, int x_idx,
+        PhyloNode *w, PhyloNode *prev, double dist_xq, vector<pair<int,double> > &q_subtrees,
+        double gain, int depth, int radius, SPRMove &best) {
+    PhyloNode *sub[2];
+    int sub_idx[2], i = 0;
+    FOR_NEIGHBOR_IT(w, prev, it) {
+        sub[i] = (PhyloNode*)(*it)->node;
+        sub_idx[i] = bme.index(sub[i], w);
+        i++;
+    }
+    double dist_w = bme.at(sub_idx[0], sub_idx[1]);
+    for (int k = 0; k < 2; k++) {
+        int w1 = sub_idx[k], w2 = sub_idx[1-k];
+        double dist_qw2 = 0.0;
+        for (vector<pair<int,double> >::iterator qit = q_subtrees.begin(); qit != q_subtrees.end(); qit++)
+            dist_qw2 += qit->second * bme.at(qit->first, w2);
+        // NNI turning (X,Q | W1,W2) into (X,W1 | Q,W2)
+        double new_gain = gain + 0.25 * ((dist_xq + dist_w) - (bme.at(x_idx, w1) + dist_qw2));
+        if (new_gain > best.score) {
+            best.score = new_gain;
+            best.prune_node = node;
+            best.prune_dad = dad;
+            best.regraft_node = sub[k];
+            best.regraft_dad = w;
+        }
+        if (depth >= radius || sub[k]->isLeaf())
+            continue;
+        // X moves on into W1, W2 joins the subtree behind X
+        vector<pair<int,double> > next_q;
+        next_q.reserve(q_subtrees.size() + 1);
+        for (vector<pair<int,double> >::iterator qit = q_subtrees.begin(); qit != q_subtrees.end(); qit++)
+            next_q.push_back(make_pair(qit->first, 0.5 * qit->second));
+        next_q.push_back(make_pair(w2, 0.5));
+        evaluateBMERegraft(bme, node, dad, x_idx, sub[k], w, 0.5 * (dist_xq + bme.at(x_idx, w2)),
+                next_q, new_gain, depth + 1, radius, best);
+    }
+}
+
+void PhyloTree::evaluateBMESPR(BMEAverages &bme, PhyloNode *node, PhyloNode *dad, int radius, SPRMove &best) {
+    int x_idx = bme.index(node, dad);
+    PhyloNode *sibling[2];
+    int i = 0;
+    FOR_NEIGHBOR_IT(dad, node, it)
+        sibling[i++] = (PhyloNode*)(*it)->node;
+    for (int k = 0; k < 2; k++) {
+        PhyloNode *ahead = sibling[1-k];
+        if (ahead->isLeaf())
+            continue;
+        vector<pair<int,double> > q_subtrees(1, make_pair(bme.index(sibling[k], dad), 1.0));
+        evaluateBMERegraft(bme, node, dad, x_idx, ahead, dad, bme.at(x_idx, q_subtrees[0].first),
+                q_subtrees, 0.0, 1, radius, best);
+    }
+}
+
+void PhyloTree::assignBMEBranchLengths(BMEAverages &bme) {
+    for (int u = 0; u < bme.size; u++) {
+        if (bme.parent[u] < 0)
+            continue;
+        PhyloNode *node = bme.nodes[u];
+        PhyloNode *dad = bme.nodes[bme.parent[u]];
+        double len = computeBMEBranchLength(bme, node);
+        node->findNeighbor(dad)->length = len;
+        dad->findNeighbor(node)->length = len;
+    }
+}
+
+double PhyloTree::optimizeBME(int spr_radius) {
+    if (!dist_matrix)
+        outError("Distance matrix is required for the BME search");
+    if (leafNum < 4)
+        return 0.0;
+    uint64_t mem_required = (uint64_t)nodeNum * nodeNum * sizeof(double);
+    if (mem_required > getMemorySize() / 2) {
+        outWarning("BME search with SPR moves needs " + convertDoubleToString(mem_required / 1073741824.0) +
+            " GB RAM for " + convertIntToString(leafNum) + " sequences, using NNI moves with less memory instead");
+        return optimizeBMENNI();
+    }
+    BMEAverages bme;
+    double cur_len = computeBMEAverages(bme);
+    double start_len = cur_len;
+    int radius = 1;
+    int num_rounds = 0, num_moves = 0;
+
+    while (true) {
+        // all subtrees attached to an internal node
+        vector<pair<PhyloNode*, PhyloNode*> > subtrees;
+        for (int u = 0; u < bme.size; u++)
+            if (!bme.nodes[u]->isLeaf())
+                FOR_NEIGHBOR_IT(bme.nodes[u], NULL, it)
+                    subtrees.push_back(make_pair((PhyloNode*)(*it)->node, bme.nodes[u]));
+        vector<SPRMove> moves(subtrees.size());
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+        for (int i = 0; i < subtrees.size(); i++) {
+            moves[i].score = BME_EPSILON * cur_len;
+            moves[i].regraft_node = NULL;
+            evaluateBMESPR(bme, subtrees[i].first, subtrees[i].second, radius, moves[i]);
+        }
+        vector<SPRMove> improved;
+        for (vector<SPRMove>::iterator it = moves.begin(); it != moves.end(); it++)
+            if (it->regraft_node)
+                improved.push_back(*it);
+        if (improved.empty()) {
+            // NNI optimum reached, try SPR before stopping
+            if (radius >= spr_radius)
+                break;
+            radius = spr_radius;
+            continue;
+        }
+        std::sort(improved.begin(), improved.end(), SPR_compare());
+
+        // apply the best moves that do not touch the same part of the tree, each as the chain
+        // of NNIs it was scored with. A move that no longer shortens the tree is undone.
+        int num_applied = 0;
+        vector<bool> marked(nodeNum, false);
+        for (vector<SPRMove>::iterator it = improved.begin(); it != improved.end(); it++) {
+            IntVector path;
+            getBMEPath(bme, it->prune_dad->id, it->regraft_node->id, path);
+            IntVector touched = path;
+            touched.push_back(it->prune_node->id);
+            FOR_NEIGHBOR_IT(it->prune_dad, NULL, nit)
+                touched.push_back((*nit)->node->id);
+            bool conflict = false;
+            for (IntVector::iterator pit = touched.begin(); pit != touched.end(); pit++)
+                conflict |= marked[*pit];
+            if (conflict)
+                continue;
+            for (IntVector::iterator pit = touched.begin(); pit != touched.end(); pit++)
+                marked[*pit] = true;
+
+            ASSERT(path.size() >= 3 && path[path.size()-2] == it->regraft_dad->id);
+            vector<BMEAppliedNNI> nnis;
+            double new_len = cur_len;
+            PhyloNode *dad = it->prune_dad;
+            for (size_t i = 1; i+1 < path.size(); i++) {
+                BMEAppliedNNI nni;
+                nni.node1 = dad;
+                nni.node2 = bme.nodes[path[i]];
+                nni.sub1 = NULL;
+                nni.sub2 = bme.nodes[path[i+1]];
+                FOR_NEIGHBOR_IT(dad, NULL, nit)
+                    if ((*nit)->node != it->prune_node && (*nit)->node != nni.node2)
+                        nni.sub1 = (PhyloNode*)(*nit)->node;
+                new_len = doBMENNI(bme, nni.node1, nni.node2, nni.sub1, nni.sub2);
+                nnis.push_back(nni);
+            }
+            if (new_len < cur_len) {
+                cur_len = new_len;
+                num_applied++;
+                continue;
+            }
+            // the move interfered with the moves applied before
+            for (vector<BMEAppliedNNI>::reverse_iterator nit = nnis.rbegin(); nit != nnis.rend(); nit++)
+                cur_len = doBMENNI(bme, nit->node1, nit->node2, nit->sub2, nit->sub1);
+        }
+        if (num_applied == 0)
+            break;
+        num_rounds++;
+        num_moves += num_applied;
+        if (verbose_mode >= VB_MED)
+            cout << "BME round " << num_rounds << " (radius " << radius << "): " << num_applied
+                << " moves, tree length " << cur_len << endl;
+        radius = 1;
+    }
+
+    assignBMEBranchLengths(bme);
+    clearAllPartialLH();
+    cout << "BME search: " << num_moves << " moves in " << num_rounds << " rounds, balanced tree length "
+        << start_len << " -> " << cur_len << endl;
+    return cur_len;
+}
+
+double PhyloTree::optimizeBMENNI() {
+    BMEBranchAverages bme;
+    NodeVector all_nodes;
+    getTaxa(all_nodes);
+    getInternalNodes(all_nodes);
+    bme.nodes.assign(nodeNum, NULL);
+    for (NodeVector::iterator it = all_nodes.begin(); it != all_nodes.end(); it++)
+        bme.nodes[(*it)->id] = (PhyloNode*)(*it);
+    int nseq = aln->getNSeq();
+    double cur_len = computeBMEBranchAverages(bme, dist_matrix, nseq);
+    double start_len = cur_len;
+    int num_rounds = 0, num_moves = 0;
+
+    while (true) {
+        // the two NNIs of every internal branch (A,B | C,D), swapping B with C or D
+        vector<BMEAppliedNNI> nnis;
+        vector<pair<double,int> > gains;
+        for (int u = 0; u < bme.nodes.size(); u++) {
+            if (bme.nodes[u]->isLeaf())
+                continue;
+            for (int k = 0; k < 3; k++) {
+                int v = bme.nei[3*u+k];
+                if (v < u || bme.nodes[v]->isLeaf())
+                    continue;
+                int kv = bme.slot(v, u);
+                double *c = &bme.cross[4*(3*u+k)];
+                double dist_ab_cd = bme.pair[3*u+k] + bme.pair[3*v+kv];
+                for (int j = 0; j < 2; j++) {
+                    double gain = 0.25 * (dist_ab_cd - (c[j] + c[3-j]));
+                    if (gain <= BME_EPSILON * cur_len)
+                        continue;
+                    BMEAppliedNNI nni;
+                    nni.node1 = bme.nodes[u];
+                    nni.node2 = bme.nodes[v];
+                    nni.sub1 = bme.nodes[bme.nei[3*u+(k+2)%3]];
+                    nni.sub2 = bme.nodes[bme.nei[3*v+(kv+j+1)%3]];
+                    gains.push_back(make_pair(-gain, nnis.size()));
+                    nnis.push_back(nni);
+                }
+            }
+        }
+        if (nnis.empty())
+            break;
+        std::sort(gains.begin(), gains.end());
+
+        // apply the best NNIs whose branches and neighbor nodes do not overlap; if together
+        // they do not shorten the tree, keep only the best one
+        vector<BMEAppliedNNI> applied;
+        vector<bool> marked(nodeNum, false);
+        for (vector<pair<double,int> >::iterator it = gains.begin(); it != gains.end(); it++) {
+            BMEAppliedNNI &nni = nnis[it->second];
+            int u = nni.node1->id, v = nni.node2->id;
+            bool conflict = false;
+            for (int k = 0; k < 3; k++)
+                conflict |= marked[bme.nei[3*u+k]] || marked[bme.nei[3*v+k]];
+            if (conflict)
+                continue;
+            for (int k = 0; k < 3; k++)
+                marked[bme.nei[3*u+k]] = marked[bme.nei[3*v+k]] = true;
+            swapBMESubtrees(nni.node1, nni.node2, nni.sub1, nni.sub2);
+            applied.push_back(nni);
+        }
+        double new_len = computeBMEBranchAverages(bme, dist_matrix, nseq);
+        if (new_len >= cur_len && applied.size() > 1) {
+            for (vector<BMEAppliedNNI>::reverse_iterator nit = applied.rbegin(); nit+1 != applied.rend(); nit++)
+                swapBMESubtrees(nit->node1, nit->node2, nit->sub2, nit->sub1);
+            applied.resize(1);
+            new_len = computeBMEBranchAverages(bme, dist_matrix, nseq);
+        }
+        if (new_len >= cur_len) {
+            swapBMESubtrees(applied[0].node1, applied[0].node2, applied[0].sub2, applied[0].sub1);
+            cur_len = computeBMEBranchAverages(bme, dist_matrix, nseq);
+            break;
+        }
+        cur_len = new_len;
+        num_rounds++;
+        num_moves += applied.size();
+        if (verbose_mode >= VB_MED)
+            cout << "BME round " << num_rounds << " (NNI): " << applied.size()
+                << " moves, tree length " << cur_len << endl;
+    }
+
+    for (int u = 0; u < bme.nodes.size(); u++) {
+        if (bme.nodes[u]->isLeaf())
+            continue;
+        for (int k = 0; k < 3; k++) {
+            PhyloNode *node = bme.nodes[bme.nei[3*u+k]];
+            double len = computeBMEBranchLength(bme, u, k);
+            node->findNeighbor(bme.nodes[u])->length = len;
+            bme.nodes[u]->findNeighbor(node)->length = len;
+        }
+    }
+    clearAllPartialLH();
+    cout << "BME search (NNI only): " << num_moves << " moves in " << num_rounds << " rounds, balanced tree length "
+        << start_len << " -> " << cur_len << endl;
+    return cur_len;
+}
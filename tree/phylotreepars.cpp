@@ -145,6 +145,16 @@ void PhyloTree::computePartialParsimonyFast(PhyloNeighbor *dad_branch, PhyloNode
                             for (int i = 0; i < (*alnit)->num_states; i++)
                                     p[i] |= bit1;
                         }
+                    } else if ((*alnit)->seq_type == SEQ_CODON && state < (*alnit)->STATE_UNKNOWN) {
+                        // partially ambiguous codon
+                        uint64_t cstate = (*alnit)->codon_ambiguity[state-(*alnit)->num_states];
+                        for (int j = 0; j < freq; j++, site++) {
+                            UINT *p = dad_branch->partial_pars+((site/UINT_BITS)*nstates);
+                            UINT bit1 = (1 << (site%UINT_BITS));
+                            for (int i = 0; i < (*alnit)->num_states; i++)
+                                if (cstate & ((uint64_t)1 << i))
+                                    p[i] |= bit1;
+                        }
                     } else {
                         ASSERT(0);
                     }
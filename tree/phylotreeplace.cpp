@@ -0,0 +1,521 @@
+/*
+ * phylotreeplace.cpp
+ *
+ * Placement of query sequences onto the branches of a fixed reference tree,
+ * scored from the partial likelihoods on both sides of every branch
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#include "phylotree.h"
+#include "model/modelmixture.h"
+
+/**
+        sites of a query with the same reference pattern and the same query state
+ */
+struct PlacementPattern {
+    /** pattern of the reference alignment */
+    int ptn;
+    /** state of the query */
+    int state;
+    /** number of sites */
+    double freq;
+    /** unscaled likelihood of the invariant sites class */
+    double invar_lh;
+};
+
+/**
+        model quantities per category (rate category and mixture class) shared by all branches.
+        With the eigen decomposition P(t) = U exp(D t) V of the rate matrix, the likelihood of a
+        query state x at pendant length p is sum_k g_k exp(d_k p) (V app_x)_k, where g is the
+        vector at the insertion point projected onto the eigenvectors U
+ */
+struct PlacementModel {
+    ModelSubst *model;
+    size_t nstates, ncat_mix, block;
+    /** mixture class and rate of each category */
+    IntVector cat_mixture;
+    DoubleVector cat_rate;
+    /** category weight times state frequency, block entries */
+    DoubleVector prop_freq;
+    /** eigenvectors U, ncat_mix*nstates*nstates entries */
+    DoubleVector evec;
+    /** eigenvalues times the category rate per unit branch length, block entries */
+    DoubleVector eval;
+    /** V times the appearance vector of every observed state, (nobserved*ncat_mix*nstates) entries */
+    DoubleVector tip_evec;
+};
+
+/**
+        partial likelihoods on both sides of a branch and the projected vectors at its middle
+ */
+struct PlacementBranch {
+    double length;
+    DoubleVector lh_dad, lh_node, log_scale;
+    /** projected vectors at the middle of the branch, nptn*block entries */
+    DoubleVector mid_proj;
+};
+
+/**
+        compute the transition matrices of all categories for a branch length
+        @param[out] trans ncat_mix*nstates*nstates entries
+ */
+static void computePlacementTrans(PlacementModel &pm, double len, double *trans) {
+    for (size_t c = 0; c < pm.ncat_mix; c++)
+        pm.model->computeTransMatrix(len*pm.cat_rate[c], trans + c*pm.nstates*pm.nstates, pm.cat_mixture[c]);
+}
+
+/**
+        compute the projected vector of a pattern at an insertion point
+        @param trans_dad transition matrices from the insertion point to the dad side
+        @param trans_node transition matrices from the insertion point to the node side
+        @param lh_dad partial likelihoods of the dad side of the pattern
+        @param lh_node partial likelihoods of the node side of the pattern
+        @param[out] proj projected vector, block entries
+ */
+static void computePlacementProjection(PlacementModel &pm, double *trans_dad, double *trans_node,
+    double *lh_dad, double *lh_node, double *proj)
+{
+    size_t nstates = pm.nstates, nstatesqr = nstates*nstates;
+    double lh_insert[nstates];
+    for (size_t c = 0; c < pm.ncat_mix; c++) {
+        double *this_trans_dad = trans_dad + c*nstatesqr, *this_trans_node = trans_node + c*nstatesqr;
+        double *this_lh_dad = lh_dad + c*nstates, *this_lh_node = lh_node + c*nstates;
+        for (size_t w = 0; w < nstates; w++) {
+            double lh_w_dad = 0.0, lh_w_node = 0.0;
+            for (size_t y = 0; y < nstates; y++) {
+                lh_w_dad += this_trans_dad[w*nstates+y] * this_lh_dad[y];
+                lh_w_node += this_trans_node[w*nstates+y] * this_lh_node[y];
+            }
+            lh_insert[w] = pm.prop_freq[c*nstates+w] * lh_w_dad * lh_w_node;
+        }
+        double *evec = &pm.evec[c*nstatesqr];
+        for (size_t k = 0; k < nstates; k++) {
+            double sum = 0.0;
+            for (size_t w = 0; w < nstates; w++)
+                sum += lh_insert[w] * evec[w*nstates+k];
+            proj[c*nstates+k] = sum;
+        }
+    }
+}
+
+/**
+        log-likelihood of a query inserted on a branch, as a function of the pendant length
+        (Newton-Raphson) and of the distance of the insertion point from node (Brent)
+ */
+class PlacementOptimizer : public Optimization {
+public:
+
+    PlacementOptimizer(PlacementModel &pm, PlacementBranch &branch, vector<PlacementPattern> &patterns,
+        double const_logl, Params *params)
+        : pm(pm), branch(branch), patterns(patterns), const_logl(const_logl), params(params)
+    {
+        distal_length = branch.length/2;
+        pendant_length = 0.1;
+        exp_eval.resize(pm.block);
+    }
+
+    /**
+            @param pendant pendant length
+            @param[out] df first derivative by the pendant length, if not NULL
+            @param[out] ddf second derivative by the pendant length, if not NULL
+            @return log-likelihood of the tree with the query inserted
+     */
+    double computeLogL(double pendant, double *df = NULL, double *ddf = NULL) {
+        size_t block = pm.block;
+        for (size_t j = 0; j < block; j++)
+            exp_eval[j] = exp(pm.eval[j]*pendant);
+        double logl = const_logl, logl_d1 = 0.0, logl_d2 = 0.0;
+        for (size_t i = 0; i < patterns.size(); i++) {
+            PlacementPattern &pat = patterns[i];
+            double *proj = proj_at_distal.empty() ? &branch.mid_proj[pat.ptn*block] : &proj_at_distal[i*block];
+            double *tip = &pm.tip_evec[pat.state*block];
+            double lh = 0.0, lh_d1 = 0.0, lh_d2 = 0.0;
+            for (size_t j = 0; j < block; j++) {
+                double val = proj[j] * tip[j] * exp_eval[j];
+                lh += val;
+                lh_d1 += val * pm.eval[j];
+                lh_d2 += val * pm.eval[j] * pm.eval[j];
+            }
+            double log_scale = branch.log_scale[pat.ptn];
+            if (pat.invar_lh > 0.0)
+                lh += pat.invar_lh * exp(min(-log_scale, 700.0));
+            if (lh <= 0.0) {
+                lh = DBL_MIN;
+                lh_d1 = lh_d2 = 0.0;
+            }
+            lh_d1 /= lh;
+            lh_d2 /= lh;
+            logl += pat.freq * (log(lh) + log_scale);
+            logl_d1 += pat.freq * lh_d1;
+            logl_d2 += pat.freq * (lh_d2 - lh_d1*lh_d1);
+        }
+        if (df) *df = logl_d1;
+        if (ddf) *ddf = logl_d2;
+        return logl;
+    }
+
+    virtual void computeFuncDerv(double value, double &df, double &ddf) {
+        computeLogL(value, &df, &ddf);
+        df = -df;
+        ddf = -ddf;
+    }
+
+    /**
+            optimize the pendant length at the current insertion point
+            @return best log-likelihood
+     */
+    double optimizePendant(int max_steps) {
+        pendant_length = minimizeNewton(params->min_branch_length, pendant_length, params->max_branch_length,
+            params->min_branch_length, max_steps);
+        return computeLogL(pendant_length);
+    }
+
+    /**
+            move the insertion point to a distance from node and optimize the pendant length
+            @return negative log-likelihood
+     */
+    virtual double computeFunction(double value) {
+        distal_length = value;
+        size_t nstatesqr = pm.nstates*pm.nstates;
+        DoubleVector trans_dad(pm.ncat_mix*nstatesqr), trans_node(pm.ncat_mix*nstatesqr);
+        computePlacementTrans(pm, branch.length - value, &trans_dad[0]);
+        computePlacementTrans(pm, value, &trans_node[0]);
+        proj_at_distal.resize(patterns.size()*pm.block);
+        for (size_t i = 0; i < patterns.size(); i++) {
+            size_t offset = patterns[i].ptn*pm.block;
+            computePlacementProjection(pm, &trans_dad[0], &trans_node[0], &branch.lh_dad[offset],
+                &branch.lh_node[offset], &proj_at_distal[i*pm.block]);
+        }
+        return -optimizePendant(100);
+    }
+
+    double distal_length, pendant_length;
+
+protected:
+    PlacementModel &pm;
+    PlacementBranch &branch;
+    vector<PlacementPattern> &patterns;
+    double const_logl;
+    Params *params;
+
+    /** projected vectors at distal_length, empty to use the middle of the branch */
+    DoubleVector proj_at_distal;
+    DoubleVector exp_eval;
+};
+
+static bool comparePlacement(const PlacementInfo &a, const PlacementInfo &b) {
+    return a.logl > b.logl;
+}
+
+/**
+        insert a placement into the placements of a query, kept sorted by log-likelihood
+ */
+static void addPlacement(vector<PlacementInfo> &placements, PlacementInfo &info, int keep) {
+    if (placements.size() == keep && info.logl <= placements.back().logl)
+        return;
+    vector<PlacementInfo>::iterator it = placements.begin();
+    while (it != placements.end() && it->logl >= info.logl)
+        it++;
+    placements.insert(it, info);
+    if (placements.size() > keep)
+        placements.pop_back();
+}
+
+void PhyloTree::getBranchPartialLh(PhyloNeighbor *dad_branch, PhyloNode *dad, double *lh_dad, double *lh_node,
+    double *log_scale)
+{
+    ASSERT(params->kernel_nonrev);
+    PhyloNode *node = (PhyloNode*)dad_branch->node;
+    PhyloNeighbor *node_branch = (PhyloNeighbor*)node->findNeighbor(dad);
+    computeLikelihoodBranch(dad_branch, dad);
+
+    size_t nptn = aln->getNPattern();
+    size_t nstates = model->num_states;
+    size_t ncat_mix = (model_factory->fused_mix_rate) ? site_rate->getNRate() : site_rate->getNRate()*model->getNMixtures();
+    size_t block = ncat_mix*nstates;
+    size_t nobserved = aln->STATE_UNKNOWN+1;
+    double *state_app = new double[nobserved*nstates];
+    for (size_t x = 0; x < nobserved; x++)
+        aln->getAppearance(x, state_app + x*nstates);
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) num_threads(num_threads)
+#endif
+    for (size_t ptn = 0; ptn < nptn; ptn++) {
+        size_t ptn_lane = ptn % vector_size;
+        size_t ptn_offset = (ptn-ptn_lane)*block + ptn_lane;
+        double *this_lh_dad = lh_dad + ptn*block, *this_lh_node = lh_node + ptn*block;
+        double scale = 0.0;
+        if (dad->isLeaf()) {
+            for (size_t c = 0; c < ncat_mix; c++)
+                memcpy(this_lh_dad + c*nstates, state_app + aln->at(ptn)[dad->id]*nstates, sizeof(double)*nstates);
+        } else {
+            for (size_t i = 0; i < block; i++)
+                this_lh_dad[i] = node_branch->partial_lh[ptn_offset + i*vector_size];
+            scale += node_branch->scale_num[ptn];
+        }
+        if (node->isLeaf()) {
+            for (size_t c = 0; c < ncat_mix; c++)
+                memcpy(this_lh_node + c*nstates, state_app + aln->at(ptn)[node->id]*nstates, sizeof(double)*nstates);
+        } else {
+            for (size_t i = 0; i < block; i++)
+                this_lh_node[i] = dad_branch->partial_lh[ptn_offset + i*vector_size];
+            scale += dad_branch->scale_num[ptn];
+        }
+        log_scale[ptn] = scale*LOG_SCALING_THRESHOLD;
+    }
+    delete[] state_app;
+}
+
+void PhyloTree::placeQueries(Alignment *query_aln, IntVector &query_ids, int keep, bool refine,
+    vector<vector<PlacementInfo> > &placements)
+{
+    ASSERT(!isSuperTree() && !isMixlen() && !model->isSiteSpecificModel() && model->isReversible());
+    ASSERT(query_aln->getNSite() == aln->getNSite());
+    size_t nptn = aln->getNPattern();
+    size_t nsites = aln->getNSite();
+    size_t nstates = model->num_states;
+    size_t nstatesqr = nstates*nstates;
+    size_t nquery = query_ids.size();
+    size_t ncat = site_rate->getNRate();
+    bool fused = model_factory->fused_mix_rate;
+    size_t ncat_mix = fused ? ncat : ncat*model->getNMixtures();
+    size_t denom = fused ? 1 : ncat;
+    size_t nobserved = aln->STATE_UNKNOWN+1;
+    size_t c, i, k, x, y;
+
+    // switch to nonrev kernel to get partial likelihoods in the state space
+    bool orig_kernel_nonrev = params->kernel_nonrev;
+    if (!orig_kernel_nonrev) {
+        params->kernel_nonrev = true;
+        setLikelihoodKernel(sse);
+        clearAllPartialLH();
+    }
+    computeLikelihood();
+    DoubleVector ref_ptn_lh(_pattern_lh, _pattern_lh + nptn);
+
+    PlacementModel pm;
+    pm.model = model;
+    pm.nstates = nstates;
+    pm.ncat_mix = ncat_mix;
+    pm.block = ncat_mix*nstates;
+    pm.cat_mixture.resize(ncat_mix);
+    pm.cat_rate.resize(ncat_mix);
+    pm.prop_freq.resize(pm.block);
+    pm.evec.resize(ncat_mix*nstatesqr);
+    pm.eval.resize(pm.block);
+    pm.tip_evec.resize(nobserved*pm.block);
+    DoubleVector state_app(nobserved*nstates);
+    for (x = 0; x < nobserved; x++)
+        aln->getAppearance(x, &state_app[x*nstates]);
+    for (c = 0; c < ncat_mix; c++) {
+        size_t m = c/denom;
+        ModelMarkov *class_model = model->isMixture() ? dynamic_cast<ModelMixture*>(model)->at(m) : dynamic_cast<ModelMarkov*>(model);
+        ASSERT(class_model);
+        pm.cat_mixture[c] = m;
+        pm.cat_rate[c] = site_rate->getRate(c%ncat);
+        double prop = site_rate->getProp(c%ncat) * model->getMixtureWeight(m);
+        model->getStateFrequency(&pm.prop_freq[c*nstates], m);
+        for (i = 0; i < nstates; i++)
+            pm.prop_freq[c*nstates+i] *= prop;
+        double *eval = class_model->getEigenvalues();
+        double *evec = class_model->getEigenvectors();
+        double *inv_evec = class_model->getInverseEigenvectors();
+        memcpy(&pm.evec[c*nstatesqr], evec, sizeof(double)*nstatesqr);
+        for (k = 0; k < nstates; k++)
+            pm.eval[c*nstates+k] = eval[k] * pm.cat_rate[c] / class_model->total_num_subst;
+        for (x = 0; x < nobserved; x++)
+            for (k = 0; k < nstates; k++) {
+                double sum = 0.0;
+                for (y = 0; y < nstates; y++)
+                    sum += inv_evec[k*nstates+y] * state_app[x*nstates+y];
+                pm.tip_evec[(x*ncat_mix+c)*nstates+k] = sum;
+            }
+    }
+
+    // group the sites of each query by reference pattern and query state; sites where the
+    // query has no data contribute the same reference pattern likelihood to every placement
+    double p_invar = site_rate->getPInvar();
+    double state_freq[nstates];
+    model->getStateFrequency(state_freq, -1);
+    vector<vector<PlacementPattern> > query_ptns(nquery);
+    DoubleVector const_logl(nquery, 0.0);
+    for (size_t q = 0; q < nquery; q++) {
+        vector<int64_t> keys;
+        for (size_t site = 0; site < nsites; site++) {
+            int ptn = aln->getPatternID(site);
+            int state = query_aln->at(query_aln->getPatternID(site))[query_ids[q]];
+            if (state == aln->STATE_UNKNOWN)
+                const_logl[q] += ref_ptn_lh[ptn];
+            else
+                keys.push_back((int64_t)ptn*nobserved + state);
+        }
+        sort(keys.begin(), keys.end());
+        for (i = 0; i < keys.size(); i++) {
+            if (i > 0 && keys[i] == keys[i-1]) {
+                query_ptns[q].back().freq += 1.0;
+                continue;
+            }
+            PlacementPattern pat;
+            pat.ptn = keys[i] / nobserved;
+            pat.state = keys[i] % nobserved;
+            pat.freq = 1.0;
+            pat.invar_lh = 0.0;
+            int const_char = aln->at(pat.ptn).const_char;
+            if (p_invar > 0.0 && const_char <= aln->STATE_UNKNOWN) {
+                for (y = 0; y < nstates; y++)
+                    pat.invar_lh += state_freq[y] * state_app[const_char*nstates+y] * state_app[pat.state*nstates+y];
+                pat.invar_lh *= p_invar;
+            }
+            query_ptns[q].push_back(pat);
+        }
+    }
+
+    NodeVector nodes, dads;
+    getPreOrderBranches(nodes, dads, root);
+    size_t nbranches = nodes.size();
+    PlacementBranch branch;
+    branch.lh_dad.resize(nptn*pm.block);
+    branch.lh_node.resize(nptn*pm.block);
+    branch.log_scale.resize(nptn);
+    branch.mid_proj.resize(nptn*pm.block);
+    double *trans_half = new double[ncat_mix*nstatesqr];
+
+    // prescoring: every query on every branch at the middle of the branch
+    placements.clear();
+    placements.resize(nquery);
+    for (size_t b = 0; b < nbranches; b++) {
+        PhyloNode *node = (PhyloNode*)nodes[b], *dad = (PhyloNode*)dads[b];
+        PhyloNeighbor *dad_branch = (PhyloNeighbor*)dad->findNeighbor(node);
+        branch.length = dad_branch->length;
+        getBranchPartialLh(dad_branch, dad, &branch.lh_dad[0], &branch.lh_node[0], &branch.log_scale[0]);
+        computePlacementTrans(pm, branch.length/2, trans_half);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) num_threads(num_threads)
+#endif
+        for (size_t ptn = 0; ptn < nptn; ptn++)
+            computePlacementProjection(pm, trans_half, trans_half, &branch.lh_dad[ptn*pm.block],
+                &branch.lh_node[ptn*pm.block], &branch.mid_proj[ptn*pm.block]);
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) num_threads(num_threads)
+#endif
+        for (size_t q = 0; q < nquery; q++) {
+            PlacementOptimizer opt(pm, branch, query_ptns[q], const_logl[q], params);
+            PlacementInfo info;
+            info.node = node;
+            info.dad = dad;
+            info.logl = opt.optimizePendant(10);
+            info.lwr = 0.0;
+            info.distal_length = opt.distal_length;
+            info.pendant_length = opt.pendant_length;
+            addPlacement(placements[q], info, keep);
+        }
+    }
+    delete[] trans_half;
+
+    // refine the insertion point of the best placements, branch by branch in pre-order
+    if (refine) {
+        vector<vector<pair<int,int> > > branch_placements(nbranches);
+        IntVector branch_id(nodeNum, -1);
+        for (size_t b = 0; b < nbranches; b++)
+            branch_id[nodes[b]->id] = b;
+        for (size_t q = 0; q < nquery; q++)
+            for (i = 0; i < placements[q].size(); i++)
+                branch_placements[branch_id[placements[q][i].node->id]].push_back(make_pair(q, i));
+        for (size_t b = 0; b < nbranches; b++) {
+            if (branch_placements[b].empty())
+                continue;
+            PhyloNode *node = (PhyloNode*)nodes[b], *dad = (PhyloNode*)dads[b];
+            PhyloNeighbor *dad_branch = (PhyloNeighbor*)dad->findNeighbor(node);
+            branch.length = dad_branch->length;
+            if (branch.length < 2*params->min_branch_length)
+                continue;
+            getBranchPartialLh(dad_branch, dad, &branch.lh_dad[0], &branch.lh_node[0], &branch.log_scale[0]);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) num_threads(num_threads)
+#endif
+            for (i = 0; i < branch_placements[b].size(); i++) {
+                int q = branch_placements[b][i].first;
+                PlacementInfo &info = placements[q][branch_placements[b][i].second];
+                PlacementOptimizer opt(pm, branch, query_ptns[q], const_logl[q], params);
+                opt.pendant_length = info.pendant_length;
+                double negative_lh, ferror;
+                // relative tolerance, so that the initial bracket is wider than the noise of the pendant length
+                double distal = opt.minimizeOneDimen(0.0, info.distal_length, branch.length, 1e-3,
+                    &negative_lh, &ferror);
+                double logl = -opt.computeFunction(distal);
+                if (logl > info.logl) {
+                    info.logl = logl;
+                    info.distal_length = distal;
+                    info.pendant_length = opt.pendant_length;
+                }
+            }
+        }
+    }
+
+    // likelihood weight ratios
+    for (size_t q = 0; q < nquery; q++) {
+        vector<PlacementInfo> &query_placements = placements[q];
+        stable_sort(query_placements.begin(), query_placements.end(), comparePlacement);
+        double sum = 0.0;
+        for (i = 0; i < query_placements.size(); i++)
+            sum += (query_placements[i].lwr = exp(query_placements[i].logl - query_placements[0].logl));
+        for (i = 0; i < query_placements.size(); i++)
+            query_placements[i].lwr /= sum;
+    }
+
+    if (!orig_kernel_nonrev) {
+        // switch back to REV kernel
+        params->kernel_nonrev = orig_kernel_nonrev;
+        setLikelihoodKernel(sse);
+        clearAllPartialLH();
+    }
+}
+
+void PhyloTree::insertQueries(StrVector &query_names, vector<vector<PlacementInfo> > &placements) {
+    ASSERT(query_names.size() == placements.size());
+    // queries on the same branch are inserted in the order of their insertion points from node
+    map<int, vector<pair<double,int> > > branch_queries;
+    for (size_t q = 0; q < placements.size(); q++) {
+        if (placements[q].empty())
+            continue;
+        branch_queries[placements[q][0].node->id].push_back(make_pair(placements[q][0].distal_length, q));
+    }
+    // keep the leaf ids below the internal node ids: the new leaves take the ids following
+    // the reference leaves, and the internal nodes are shifted behind them
+    int num_queries = 0;
+    for (auto it = branch_queries.begin(); it != branch_queries.end(); it++)
+        num_queries += it->second.size();
+    NodeVector internal_nodes;
+    getInternalNodes(internal_nodes);
+    for (auto node : internal_nodes)
+        node->id += num_queries;
+    nodeNum += num_queries;
+    int num_inserted = 0;
+    for (auto it = branch_queries.begin(); it != branch_queries.end(); it++) {
+        sort(it->second.begin(), it->second.end());
+        PlacementInfo &first = placements[it->second[0].second][0];
+        PhyloNode *node = first.node, *dad = first.dad;
+        double len = node->findNeighbor(dad)->length;
+        Node *lower = node;
+        double lower_pos = 0.0;
+        for (auto query : it->second) {
+            PlacementInfo &info = placements[query.second][0];
+            double pos = min(max(info.distal_length, lower_pos), len);
+            Node *added_node = newNode(nodeNum++);
+            Node *new_taxon = newNode(leafNum + num_inserted, query_names[query.second].c_str());
+            lower->updateNeighbor(dad, added_node, pos - lower_pos);
+            dad->updateNeighbor(lower, added_node, len - pos);
+            added_node->addNeighbor(lower, pos - lower_pos);
+            added_node->addNeighbor(dad, len - pos);
+            added_node->addNeighbor(new_taxon, info.pendant_length);
+            new_taxon->addNeighbor(added_node, info.pendant_length);
+            lower = added_node;
+            lower_pos = pos;
+            num_inserted++;
+        }
+    }
+    leafNum += num_inserted;
+}
@@ -33,6 +33,7 @@
 //#include "phylokernelsitemodel.h"
 
 #include "model/modelmarkov.h"
+#include "model/modelmixture.h"
 #include "model/modelset.h"
 
 /* BQM: to ignore all-gapp subtree at an alignment site */
@@ -56,6 +57,12 @@ void PhyloTree::setParsimonyKernel(LikelihoodKernel lk) {
         computePartialParsimonyPointer = &PhyloTree::computePartialParsimonyFast;
     	return;
     }
+#ifdef __AVX512KNL
+    if (lk >= LK_AVX512) {
+        setParsimonyKernelAVX512();
+        return;
+    }
+#endif
     if (lk >= LK_AVX) {
         setParsimonyKernelAVX();
         return;
@@ -72,7 +79,7 @@ void PhyloTree::setLikelihoodKernel(LikelihoodKernel lk) {
 	sse = lk;
     vector_size = 1;
     safe_numeric = (params && (params->lk_safe_scaling || leafNum >= params->numseq_safe_scaling)) ||
-        (aln && aln->num_states != 4 && aln->num_states != 20);
+        (aln && aln->num_states != 2 && aln->num_states != 4 && aln->num_states != 20);
 
     //--- parsimony kernel ---
     setParsimonyKernel(lk);
@@ -413,6 +420,18 @@ void PhyloTree::computeTipPartialLikelihood() {
                                 }
                             }
                             break;
+                        case SEQ_CODON:
+                            {
+                                uint64_t cstate = aln->codon_ambiguity[state-nstates];
+                                for (i = 0; i < nstates; i++) {
+                                    lh_ambiguous = 0.0;
+                                    for (x = 0; x < nstates; x++)
+                                        if (cstate & ((uint64_t)1 << x))
+                                            lh_ambiguous += inv_evec[(i*nstates+x)*vector_size+v];
+                                    partial_lh[i*vector_size+v] = lh_ambiguous;
+                                }
+                            }
+                            break;
                         default:
                             ASSERT(0);
                             break;
@@ -478,6 +497,15 @@ void PhyloTree::computeTipPartialLikelihood() {
                 }
             }
             break;
+        case SEQ_CODON:
+            for (state = nstates; state < aln->STATE_UNKNOWN; state++) {
+                this_tip_partial_lh = &tip_partial_lh[state*nstates];
+                for (i = 0; i < nstates; i++) {
+                    if (aln->codon_ambiguity[state-nstates] & ((uint64_t)1 << i))
+                        this_tip_partial_lh[i] = 1.0;
+                }
+            }
+            break;
         case SEQ_POMO: {
           if (aln->pomo_sampling_method != SAMPLING_WEIGHTED_BINOM &&
               aln->pomo_sampling_method != SAMPLING_WEIGHTED_HYPER)
@@ -566,6 +594,23 @@ void PhyloTree::computeTipPartialLikelihood() {
 			}
 		}
 		break;
+	case SEQ_CODON:
+		// partially ambiguous codons
+		for (state = nstates; state < aln->STATE_UNKNOWN; state++) {
+			uint64_t cstate = aln->codon_ambiguity[state-nstates];
+			double *this_tip_partial_lh = &tip_partial_lh[state*nstates*nmixtures];
+			for (m = 0; m < nmixtures; m++) {
+				double *inv_evec = &all_inv_evec[m*nstates*nstates];
+				for (i = 0; i < nstates; i++) {
+					lh_ambiguous = 0.0;
+					for (x = 0; x < nstates; x++)
+						if (cstate & ((uint64_t)1 << x))
+							lh_ambiguous += inv_evec[i*nstates+x];
+					this_tip_partial_lh[m*nstates+i] = lh_ambiguous;
+				}
+			}
+		}
+		break;
   case SEQ_POMO: {
     if (aln->pomo_sampling_method != SAMPLING_WEIGHTED_BINOM &&
         aln->pomo_sampling_method != SAMPLING_WEIGHTED_HYPER)
@@ -606,6 +651,11 @@ void PhyloTree::computePtnFreq() {
 		ptn_freq[ptn] = (*aln)[ptn].frequency;
 	for (ptn = nptn; ptn < maxptn; ptn++)
 		ptn_freq[ptn] = 0.0;
+	if (!subsample_packets.empty()) {
+		// pattern subsample of the tree search
+		for (ptn = 0; ptn < nptn; ptn++)
+			ptn_freq[ptn] = isSubsampledPacket(ptn/subsample_packet_size) ? ptn_freq[ptn]*subsample_freq_scale : 0.0;
+	}
 }
 
 void PhyloTree::computePtnInvar() {
@@ -660,6 +710,13 @@ void PhyloTree::computePtnInvar() {
                     if (ambi_aa[cstate] & (1 << x))
                         ptn_invar[ptn] += state_freq[x];
                 ptn_invar[ptn] *= p_invar;
+            } else if (aln->seq_type == SEQ_CODON) {
+                ptn_invar[ptn] = 0.0;
+                uint64_t cstate = aln->codon_ambiguity[(*aln)[ptn].const_char-nstates];
+                for (x = 0; x < nstates; x++)
+                    if (cstate & ((uint64_t)1 << x))
+                        ptn_invar[ptn] += state_freq[x];
+                ptn_invar[ptn] *= p_invar;
             } else ASSERT(0);
 		}
 //		// ascertmain bias correction
@@ -1746,226 +1803,444 @@ void PhyloTree::computeMarginalAncestralProbability(PhyloNeighbor *dad_branch, P
 }
 */
 
-void PhyloTree::computeJointAncestralSequences(int *ancestral_seqs) {
+/**
+    @return the state stored at an entry of a bit-packed argmax table of the joint reconstruction
+    @param table argmax table of an internal node
+    @param index entry index, pattern*nstates + state of the dad
+    @param state_bits number of bits per entry
+*/
+inline int getJointAncestralEntry(uint64_t *table, size_t index, int state_bits) {
+    size_t pos = index*state_bits;
+    size_t word = pos >> 6, offset = pos & 63;
+    uint64_t value = table[word] >> offset;
+    if (offset + state_bits > 64)
+        value |= table[word+1] << (64-offset);
+    return (int)(value & ((UINT64_C(1) << state_bits) - 1));
+}
 
-    // step 1-3 of the dynamic programming algorithm of Pupko et al. 2000, MBE 17:890-896
-    ASSERT(root->isLeaf());
-    int *C = new int[(size_t)getAlnNPattern()*model->num_states*leafNum];
-    computeAncestralLikelihood((PhyloNeighbor*)root->neighbors[0], NULL, C);
-    
-    // step 4-5 of the dynamic programming algorithm of Pupko et al. 2000, MBE 17:890-896
-    computeAncestralState((PhyloNeighbor*)root->neighbors[0], NULL, C, ancestral_seqs);
-    
-    clearAllPartialLH();
-    
-    delete[] C;
+/**
+    store a state at an entry of a bit-packed argmax table, the entry must be zero before
+*/
+inline void setJointAncestralEntry(uint64_t *table, size_t index, int state_bits, int state) {
+    size_t pos = index*state_bits;
+    size_t word = pos >> 6, offset = pos & 63;
+    table[word] |= (uint64_t)state << offset;
+    if (offset + state_bits > 64)
+        table[word+1] |= (uint64_t)state >> (64-offset);
 }
 
-void PhyloTree::computeAncestralLikelihood(PhyloNeighbor *dad_branch, PhyloNode *dad, int *C) {
-    PhyloNode *node = (PhyloNode*)dad_branch->node;
+void PhyloTree::getJointAncestralOrder(PhyloNode *node, PhyloNode *dad, IntVector &subtree_size,
+    NodeVector &nodes, NodeVector &dads)
+{
     if (node->isLeaf())
         return;
-    
-    int num_leaves = 0;
-    
-    // recursive into subtree
-    FOR_NEIGHBOR_DECLARE(node, dad, it) {
-        if ((*it)->node->isLeaf()) {
-            num_leaves++;
-        } else {
-            computeAncestralLikelihood((PhyloNeighbor*)(*it), node, C);
-        }
-    }
+    // larger subtrees first, so that fewer subtree vectors wait for their siblings
+    vector<pair<int, PhyloNode*> > children;
+    FOR_NEIGHBOR_IT(node, dad, it)
+        children.push_back(make_pair(-subtree_size[(*it)->node->id], (PhyloNode*)(*it)->node));
+    stable_sort(children.begin(), children.end());
+    for (auto child : children)
+        getJointAncestralOrder(child.second, node, subtree_size, nodes, dads);
+    nodes.push_back(node);
+    dads.push_back(dad);
+}
 
-    // TODO mem save
-    if (params->lh_mem_save == LM_PER_NODE && !dad_branch->partial_lh) {
-        // re-orient partial_lh
-        bool done = false;
-        FOR_NEIGHBOR_IT(node, dad, it2) {
-            PhyloNeighbor *backnei = ((PhyloNeighbor*)(*it2)->node->findNeighbor(node));
-            if (backnei->partial_lh) {
-                dad_branch->partial_lh = backnei->partial_lh;
-                dad_branch->scale_num = backnei->scale_num;
-                backnei->partial_lh = NULL;
-                backnei->scale_num = NULL;
-                backnei->partial_lh_computed &= ~1; // clear bit
-                done = true;
-                break;
-            }
-        }
-        ASSERT(done && "partial_lh is not re-oriented");
-    }
-    
+int PhyloTree::computeSubtreeSize(PhyloNode *node, PhyloNode *dad, IntVector &subtree_size) {
+    int size = node->isLeaf() ? 1 : 0;
+    FOR_NEIGHBOR_IT(node, dad, it)
+        size += computeSubtreeSize((PhyloNode*)(*it)->node, node, subtree_size);
+    subtree_size[node->id] = size;
+    return size;
+}
+
+double PhyloTree::computeJointAncestralSequences(int *ancestral_seqs) {
+    // dynamic programming algorithm of Pupko et al. 2000, MBE 17:890-896
+    ASSERT(root->isLeaf());
+    ASSERT(!isSuperTree() && !isMixlen() && !model->isSiteSpecificModel());
     size_t nptn = aln->getNPattern();
-    size_t ptn;
     size_t nstates = model->num_states;
-    size_t nstatesqr = nstates*nstates;
-    size_t parent, child;
-    double *trans_mat = new double[nstatesqr];
-    double *lh_leaves = NULL;
-    if (num_leaves > 0) {
-        lh_leaves = new double[(aln->STATE_UNKNOWN+1)*nstates*num_leaves];
-    }
-    if (dad) {
-        model->computeTransMatrix(dad_branch->length, trans_mat);
-        for (parent = 0; parent < nstatesqr; parent++)
-            trans_mat[parent] = log(trans_mat[parent]);
-    } else {
-        model->getStateFrequency(trans_mat);
-        for (parent = 0; parent < nstates; parent++)
-            trans_mat[parent] = log(trans_mat[parent]);
-        for (parent = 1; parent < nstates; parent++)
-            memcpy(trans_mat+parent*nstates, trans_mat, sizeof(double)*nstates);
-    }
-    
-    // compute information buffer for leaves
-	int ambi_aa[] = {
-        4+8, // B = N or D
-        32+64, // Z = Q or E
-        512+1024 // U = I or L
-    };
-    int leafid = 0; 
-    FOR_NEIGHBOR(node, dad, it) {
-        if ((*it)->node->isLeaf()) {
-            double trans_leaf[nstatesqr];
-            model->computeTransMatrix((*it)->length, trans_leaf);
-            double *lh_leaf = lh_leaves+leafid*nstates*(aln->STATE_UNKNOWN+1);
-            
-            // assign lh_leaf for normal states
-            for (parent = 0; parent < nstates; parent++)
-                for (child = 0; child < nstates; child++)
-                    lh_leaf[child*nstates+parent] = log(trans_leaf[parent*nstates+child]);
-            
-            // for unknown state
-            double *this_lh_leaf = lh_leaf + (aln->STATE_UNKNOWN*nstates);
-            for (parent = 0; parent < nstates; parent++)
-                this_lh_leaf[parent] = 0.0;
-            
-            // special treatment for ambiguous characters
-            switch (aln->seq_type) {
-            case SEQ_DNA:
-                for (int state = 4; state < 18; state++) {
-                    this_lh_leaf = lh_leaf + (state*nstates);
-                    int cstate = state-nstates+1;
-                    for (parent = 0; parent < nstates; parent++) {
-                        double sumlh = 0.0;
-                        for (child = 0; child < nstates; child++) {
-                            if ((cstate) & (1 << child))
-                                sumlh += trans_leaf[parent*nstates+child];
-                        }
-                        this_lh_leaf[parent] = log(sumlh);
-                    }
-                }
-                break;
-            case SEQ_PROTEIN:
-                for (int state = 0; state < sizeof(ambi_aa)/sizeof(int); state++) {
-                    this_lh_leaf = lh_leaf + ((state+20)*nstates);
-                    for (parent = 0; parent < nstates; parent++) {
-                        double sumlh = 0.0;                
-                        for (child = 0; child < nstates; child++) {
-                            if (ambi_aa[state] & (1 << child))
-                                sumlh += trans_leaf[parent*nstates+child];
-                        }
-                        this_lh_leaf[parent] = log(sumlh);
-                    }
-                }
-                break;
-            default:
-                break;
-            }
-            leafid++;
+    size_t ninternal = nodeNum - leafNum;
+    size_t ncat = site_rate->getNRate();
+    bool mixture = model->isMixture();
+    bool fused = model_factory->fused_mix_rate;
+    size_t ncat_mix = (mixture && !fused) ? ncat*model->getNMixtures() : ncat;
+    size_t c, x;
+
+    // condition each pattern on its most likely rate category or mixture class
+    IntVector ptn_cat(nptn, 0);
+    if (ncat_mix > 1) {
+        computePatternLhCat(WSL_MIXTURE_RATECAT);
+        for (size_t ptn = 0; ptn < nptn; ptn++) {
+            double *lh_cat = _pattern_lh_cat + ptn*ncat_mix;
+            for (c = 1; c < ncat_mix; c++)
+                if (lh_cat[c] > lh_cat[ptn_cat[ptn]])
+                    ptn_cat[ptn] = c;
         }
     }
+    computePtnFreq();
+    IntVector cat_mixture(ncat_mix, 0);
+    DoubleVector cat_rate(ncat_mix);
+    for (c = 0; c < ncat_mix; c++) {
+        if (mixture)
+            cat_mixture[c] = fused ? c : c/ncat;
+        cat_rate[c] = site_rate->getRate(c % ncat);
+    }
 
-    // initialize L_y(i) and C_y(i)
-//    memset(dad_branch->partial_lh, 0, nptn*nstates*sizeof(double));
-
-    int *C_node = C + (node->id-leafNum)*nptn*nstates;
+    // log state frequencies at the root, per category
+    double *log_freq = new double[ncat_mix*nstates];
+    for (c = 0; c < ncat_mix; c++) {
+        model->getStateFrequency(log_freq + c*nstates, cat_mixture[c]);
+        for (x = 0; x < nstates; x++)
+            log_freq[c*nstates+x] = log(max(log_freq[c*nstates+x], DBL_MIN));
+    }
 
-    for (ptn = 0; ptn < nptn; ptn++) {
-        double *lh_dad = dad_branch->partial_lh+ptn*nstates;
-        int *this_C_node = C_node + (ptn*nstates);
-        leafid = 0;
-        double sumlh[nstates];
-        memset(sumlh, 0, sizeof(double)*nstates);
-        FOR_NEIGHBOR(node, dad, it) {
-            PhyloNeighbor *childnei = (PhyloNeighbor*)(*it);
-            if ((*it)->node->isLeaf()) {
-                double *lh_leaf = lh_leaves+leafid*nstates*(aln->STATE_UNKNOWN+1); 
-                // external node
-                int state_child;
-                state_child = (aln->at(ptn))[(*it)->node->id];
-                double *child_lh = lh_leaf + state_child*nstates;
-                for (child = 0; child < nstates; child++)
-                    sumlh[child] += child_lh[child];
-                leafid++;
-            } else {
-                double *child_lh = childnei->partial_lh + ptn*nstates;
-                for (child = 0; child < nstates; child++)
-                    sumlh[child] += child_lh[child];
+    // observed (possibly ambiguous) states of the leaves
+    size_t nobserved = aln->STATE_UNKNOWN+1;
+    double *state_app = new double[nobserved*nstates];
+    for (x = 0; x < nobserved; x++)
+        aln->getAppearance(x, state_app + x*nstates);
+
+    // argmax tables, bit-packed, patterns padded to 64 so that the blocks do not share words
+    int state_bits = 1;
+    while ((UINT64_C(1) << state_bits) < nstates)
+        state_bits++;
+    size_t block_size = computeReductionPacketSize(nptn, 64);
+    size_t num_blocks = (nptn+block_size-1)/block_size;
+    size_t table_words = num_blocks*block_size*nstates*state_bits/64;
+    uint64_t *C = new uint64_t[ninternal*table_words];
+    memset(C, 0, sizeof(uint64_t)*ninternal*table_words);
+
+    IntVector subtree_size(nodeNum, 0);
+    PhyloNode *top = (PhyloNode*)root->neighbors[0]->node;
+    computeSubtreeSize(top, NULL, subtree_size);
+    NodeVector nodes, dads;
+    getJointAncestralOrder(top, NULL, subtree_size, nodes, dads);
+
+    // step 1-3: subtree likelihoods from the leaves towards the top node
+    vector<double*> node_lh(ninternal, NULL);
+    double *trans_mat = new double[ncat_mix*nstates*nstates];
+    double *top_lh = new double[nptn];
+    for (size_t i = 0; i < nodes.size(); i++) {
+        PhyloNode *node = (PhyloNode*)nodes[i], *dad = (PhyloNode*)dads[i];
+        uint64_t *C_node = C + (node->id-leafNum)*table_words;
+        double *lh_node = NULL;
+        if (dad) {
+            double len = node->findNeighbor(dad)->length;
+            for (c = 0; c < ncat_mix; c++) {
+                double *this_trans = trans_mat + c*nstates*nstates;
+                model->computeTransMatrix(len*cat_rate[c], this_trans, cat_mixture[c]);
+                for (x = 0; x < nstates*nstates; x++)
+                    this_trans[x] = log(max(this_trans[x], DBL_MIN));
             }
+            lh_node = node_lh[node->id-leafNum] = aligned_alloc<double>(nptn*nstates);
         }
-        
-        
-        if (dad) {
-            // internal node
-            for (parent = 0; parent < nstates; parent++) {
-                lh_dad[parent] = trans_mat[parent*nstates] + sumlh[0];
-                this_C_node[parent] = 0;
-                for (child = 1; child < nstates; child++) {
-                    double lh = trans_mat[parent*nstates+child] + sumlh[child];
-                    if (lh > lh_dad[parent]) {
-                        lh_dad[parent] = lh;
-                        this_C_node[parent] = child;
+
+        // log-likelihoods of the observed states at the leaves below node, per state of node
+        vector<PhyloNode*> leaves, children;
+        FOR_NEIGHBOR_IT(node, dad, it)
+            ((*it)->node->isLeaf() ? leaves : children).push_back((PhyloNode*)(*it)->node);
+        double *leaf_lh = new double[leaves.size()*ncat_mix*nobserved*nstates];
+        double *leaf_trans = new double[nstates*nstates];
+        for (size_t j = 0; j < leaves.size(); j++) {
+            double len = leaves[j]->findNeighbor(node)->length;
+            for (c = 0; c < ncat_mix; c++) {
+                model->computeTransMatrix(len*cat_rate[c], leaf_trans, cat_mixture[c]);
+                double *this_leaf_lh = leaf_lh + (j*ncat_mix+c)*nobserved*nstates;
+                for (size_t state = 0; state < nobserved; state++)
+                    for (x = 0; x < nstates; x++) {
+                        double lh = 0.0;
+                        for (size_t y = 0; y < nstates; y++)
+                            lh += leaf_trans[x*nstates+y] * state_app[state*nstates+y];
+                        this_leaf_lh[state*nstates+x] = log(max(lh, DBL_MIN));
                     }
-                }
             }
-        } else {
-            // at the root
-            lh_dad[0] = trans_mat[0] + sumlh[0];
-            this_C_node[0] = 0;
-            for (parent = 1; parent < nstates; parent++) {
-                double lh = trans_mat[parent] + sumlh[parent];
-                if (lh > lh_dad[0]) {
-                    lh_dad[0] = lh;
-                    this_C_node[0] = parent;
+        }
+        delete[] leaf_trans;
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) num_threads(num_threads) if (num_blocks > 1)
+#endif
+        for (size_t block = 0; block < num_blocks; block++) {
+            double sumlh[nstates];
+            size_t ptn_upper = min(nptn, (block+1)*block_size);
+            for (size_t ptn = block*block_size; ptn < ptn_upper; ptn++) {
+                int cat = ptn_cat[ptn];
+                memset(sumlh, 0, sizeof(double)*nstates);
+                for (size_t j = 0; j < leaves.size(); j++) {
+                    double *this_leaf_lh = leaf_lh + ((j*ncat_mix+cat)*nobserved + aln->at(ptn)[leaves[j]->id])*nstates;
+                    for (size_t y = 0; y < nstates; y++)
+                        sumlh[y] += this_leaf_lh[y];
+                }
+                for (auto child : children) {
+                    double *child_lh = node_lh[child->id-leafNum] + ptn*nstates;
+                    for (size_t y = 0; y < nstates; y++)
+                        sumlh[y] += child_lh[y];
+                }
+                if (!lh_node) {
+                    // at the top node
+                    double *this_freq = log_freq + cat*nstates;
+                    int best = 0;
+                    for (size_t y = 1; y < nstates; y++)
+                        if (this_freq[y] + sumlh[y] > this_freq[best] + sumlh[best])
+                            best = y;
+                    top_lh[ptn] = this_freq[best] + sumlh[best];
+                    setJointAncestralEntry(C_node, ptn*nstates, state_bits, best);
+                    continue;
+                }
+                double *this_trans = trans_mat + cat*nstates*nstates;
+                for (size_t parent = 0; parent < nstates; parent++, this_trans += nstates) {
+                    int best = 0;
+                    for (size_t y = 1; y < nstates; y++)
+                        if (this_trans[y] + sumlh[y] > this_trans[best] + sumlh[best])
+                            best = y;
+                    lh_node[ptn*nstates+parent] = this_trans[best] + sumlh[best];
+                    setJointAncestralEntry(C_node, ptn*nstates+parent, state_bits, best);
                 }
             }
         }
+        delete[] leaf_lh;
+
+        // subtree vectors of the children are no longer needed
+        for (auto child : children) {
+            aligned_free(node_lh[child->id-leafNum]);
+            node_lh[child->id-leafNum] = NULL;
+        }
     }
-    
 
-    if (lh_leaves)
-        delete[] lh_leaves;
+    // step 4-5: trace back the best states from the top node towards the leaves
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) num_threads(num_threads) if (num_blocks > 1)
+#endif
+    for (size_t block = 0; block < num_blocks; block++) {
+        size_t ptn_lower = block*block_size, ptn_upper = min(nptn, (block+1)*block_size);
+        for (int i = nodes.size()-1; i >= 0; i--) {
+            PhyloNode *node = (PhyloNode*)nodes[i], *dad = (PhyloNode*)dads[i];
+            uint64_t *C_node = C + (node->id-leafNum)*table_words;
+            int *seq_node = ancestral_seqs + (node->id-leafNum)*nptn;
+            int *seq_dad = dad ? ancestral_seqs + (dad->id-leafNum)*nptn : NULL;
+            for (size_t ptn = ptn_lower; ptn < ptn_upper; ptn++)
+                seq_node[ptn] = getJointAncestralEntry(C_node, ptn*nstates + (seq_dad ? seq_dad[ptn] : 0), state_bits);
+        }
+    }
+
+    double joint_lh = 0.0;
+    for (size_t ptn = 0; ptn < nptn; ptn++)
+        joint_lh += top_lh[ptn] * ptn_freq[ptn];
+
+    delete[] top_lh;
     delete[] trans_mat;
+    delete[] C;
+    delete[] state_app;
+    delete[] log_freq;
+    return joint_lh;
 }
 
+void PhyloTree::initSubstitutionCounts(bool &orig_kernel_nonrev) {
+    orig_kernel_nonrev = params->kernel_nonrev;
+    if (!orig_kernel_nonrev) {
+        // switch to nonrev kernel to get partial likelihoods in the state space
+        params->kernel_nonrev = true;
+        setLikelihoodKernel(sse);
+        clearAllPartialLH();
+    }
+}
 
-void PhyloTree::computeAncestralState(PhyloNeighbor *dad_branch, PhyloNode *dad, int *C, int *ancestral_seqs) {
+void PhyloTree::computeSubstitutionCounts(PhyloNeighbor *dad_branch, PhyloNode *dad, bool by_type, double *ptn_count) {
+    ASSERT(params->kernel_nonrev && model->isReversible());
+    ASSERT(!isMixlen() && !model->isSiteSpecificModel());
     PhyloNode *node = (PhyloNode*)dad_branch->node;
-    if (node->isLeaf())
-        return;
+    PhyloNeighbor *node_branch = (PhyloNeighbor*)node->findNeighbor(dad);
+
+    // partial likelihoods on both sides of the branch and the pattern log-likelihoods
+    computeLikelihoodBranch(dad_branch, dad);
 
     size_t nptn = aln->getNPattern();
-    size_t ptn;
     size_t nstates = model->num_states;
+    size_t nstatesqr = nstates*nstates;
+    size_t ncat = site_rate->getNRate();
+    size_t ncat_mix = (model_factory->fused_mix_rate) ? ncat : ncat*model->getNMixtures();
+    size_t denom = (model_factory->fused_mix_rate) ? 1 : ncat;
+    size_t block = ncat_mix*nstates;
+    size_t ntypes = by_type ? nstates*(nstates-1) : 1;
+    size_t c, i, j, k, l;
+
+    // per category: rate matrix, eigen system, integrals of exp(eval_k*s + eval_l*(t-s)) over [0,t]
+    // and the category weight times the state frequencies at the dad
+    double *rate_mat = new double[ncat_mix*nstatesqr];
+    double *integral = new double[ncat_mix*nstatesqr];
+    double *count_mat = new double[ncat_mix*nstatesqr];
+    double *weight_freq = new double[block];
+    vector<double*> cat_evec(ncat_mix), cat_inv_evec(ncat_mix);
+    for (c = 0; c < ncat_mix; c++) {
+        size_t m = c/denom;
+        ModelMarkov *class_model = model->isMixture() ? dynamic_cast<ModelMixture*>(model)->at(m) : dynamic_cast<ModelMarkov*>(model);
+        ASSERT(class_model);
+        double *eval = class_model->getEigenvalues();
+        double *evec = cat_evec[c] = class_model->getEigenvectors();
+        double *inv_evec = cat_inv_evec[c] = class_model->getInverseEigenvectors();
+        double time = site_rate->getRate(c%ncat) * dad_branch->length;
+        double eval_scale = 1.0/class_model->total_num_subst;
+        double prop = site_rate->getProp(c%ncat) * model->getMixtureWeight(m);
+
+        double *this_freq = weight_freq + c*nstates;
+        model->getStateFrequency(this_freq, m);
+        for (i = 0; i < nstates; i++)
+            this_freq[i] *= prop;
+
+        double *this_rate = rate_mat + c*nstatesqr;
+        for (i = 0; i < nstates; i++)
+            for (j = 0; j < nstates; j++) {
+                double q = 0.0;
+                for (k = 0; k < nstates; k++)
+                    q += evec[i*nstates+k] * eval[k] * inv_evec[k*nstates+j];
+                this_rate[i*nstates+j] = (i == j) ? 0.0 : q * eval_scale;
+            }
 
-    int *C_node = C + (node->id-leafNum)*nptn*nstates;
-    int *ancestral_seqs_node = ancestral_seqs + (node->id-leafNum)*nptn; 
-    if (dad) {
-        // at an internal node
-        int *ancestral_seqs_dad = ancestral_seqs + (dad->id-leafNum)*nptn;
-        for (ptn = 0; ptn < nptn; ptn++)
-            ancestral_seqs_node[ptn] = C_node[ptn*nstates+ancestral_seqs_dad[ptn]];
-        
-    } else {
-        // at the root
-        for (ptn = 0; ptn < nptn; ptn++)
-            ancestral_seqs_node[ptn] = C_node[ptn*nstates];
+        double *this_integral = integral + c*nstatesqr;
+        for (k = 0; k < nstates; k++)
+            for (l = 0; l < nstates; l++) {
+                double eval_k = eval[k]*eval_scale, eval_l = eval[l]*eval_scale;
+                if (fabs(eval_k - eval_l) < 1e-8 * max(1.0, fabs(eval_k)))
+                    this_integral[k*nstates+l] = time * exp(eval_k*time);
+                else
+                    this_integral[k*nstates+l] = (exp(eval_k*time) - exp(eval_l*time)) / (eval_k - eval_l);
+            }
+
+        if (by_type)
+            continue;
+        // all substitutions: sum over i != j of the endpoint-conditioned integrals,
+        // count_mat = evec * ((inv_evec * rate * evec) .* integral) * inv_evec
+        double *tmp = new double[nstatesqr];
+        double *tmp2 = new double[nstatesqr];
+        for (k = 0; k < nstates; k++)
+            for (j = 0; j < nstates; j++) {
+                double sum = 0.0;
+                for (i = 0; i < nstates; i++)
+                    sum += inv_evec[k*nstates+i] * this_rate[i*nstates+j];
+                tmp[k*nstates+j] = sum;
+            }
+        for (k = 0; k < nstates; k++)
+            for (l = 0; l < nstates; l++) {
+                double sum = 0.0;
+                for (j = 0; j < nstates; j++)
+                    sum += tmp[k*nstates+j] * evec[j*nstates+l];
+                tmp2[k*nstates+l] = sum * this_integral[k*nstates+l];
+            }
+        for (i = 0; i < nstates; i++)
+            for (l = 0; l < nstates; l++) {
+                double sum = 0.0;
+                for (k = 0; k < nstates; k++)
+                    sum += evec[i*nstates+k] * tmp2[k*nstates+l];
+                tmp[i*nstates+l] = sum;
+            }
+        double *this_count = count_mat + c*nstatesqr;
+        for (i = 0; i < nstates; i++)
+            for (j = 0; j < nstates; j++) {
+                double sum = 0.0;
+                for (l = 0; l < nstates; l++)
+                    sum += tmp[i*nstates+l] * inv_evec[l*nstates+j];
+                this_count[i*nstates+j] = sum;
+            }
+        delete[] tmp2;
+        delete[] tmp;
     }
-    FOR_NEIGHBOR_IT(node, dad, it)
-        computeAncestralState((PhyloNeighbor*)(*it), node, C, ancestral_seqs);
-}
 
+    // observed (possibly ambiguous) states at the leaves
+    size_t nobserved = aln->STATE_UNKNOWN+1;
+    double *state_app = new double[nobserved*nstates];
+    for (i = 0; i < nobserved; i++)
+        aln->getAppearance(i, state_app + i*nstates);
+
+#ifdef _OPENMP
+#pragma omp parallel for private(c, i, j, k, l) schedule(static) num_threads(num_threads)
+#endif
+    for (size_t ptn = 0; ptn < nptn; ptn++) {
+        // partial likelihoods of the dad side (lh_dad) and of the node side (lh_node)
+        double lh_dad[block], lh_node[block];
+        size_t ptn_lane = ptn % vector_size;
+        size_t ptn_offset = (ptn-ptn_lane)*block + ptn_lane;
+        double scale = 0.0;
+        if (dad->isLeaf()) {
+            for (c = 0; c < ncat_mix; c++)
+                memcpy(lh_dad + c*nstates, state_app + aln->at(ptn)[dad->id]*nstates, sizeof(double)*nstates);
+        } else {
+            for (i = 0; i < block; i++)
+                lh_dad[i] = node_branch->partial_lh[ptn_offset + i*vector_size];
+            scale += node_branch->scale_num[ptn];
+        }
+        if (node->isLeaf()) {
+            for (c = 0; c < ncat_mix; c++)
+                memcpy(lh_node + c*nstates, state_app + aln->at(ptn)[node->id]*nstates, sizeof(double)*nstates);
+        } else {
+            for (i = 0; i < block; i++)
+                lh_node[i] = dad_branch->partial_lh[ptn_offset + i*vector_size];
+            scale += dad_branch->scale_num[ptn];
+        }
+        // divide by the pattern likelihood, scaled like the partial likelihoods
+        double inv_lh = exp(scale*LOG_SCALING_THRESHOLD - _pattern_lh[ptn]);
+
+        double *this_count = ptn_count + ptn*ntypes;
+        memset(this_count, 0, sizeof(double)*ntypes);
+        for (c = 0; c < ncat_mix; c++) {
+            double *this_lh_dad = lh_dad + c*nstates, *this_lh_node = lh_node + c*nstates;
+            double *this_freq = weight_freq + c*nstates;
+            if (!by_type) {
+                double *this_count_mat = count_mat + c*nstatesqr;
+                for (i = 0; i < nstates; i++) {
+                    double sum = 0.0;
+                    for (j = 0; j < nstates; j++)
+                        sum += this_count_mat[i*nstates+j] * this_lh_node[j];
+                    this_count[0] += this_freq[i] * this_lh_dad[i] * sum;
+                }
+                continue;
+            }
+            // per type: project both sides onto the eigenvectors, then
+            // count(i->j) = rate(i,j) * sum_kl x_k inv_evec(k,i) integral(k,l) evec(j,l) y_l
+            double *evec = cat_evec[c], *inv_evec = cat_inv_evec[c];
+            double *this_rate = rate_mat + c*nstatesqr;
+            double *this_integral = integral + c*nstatesqr;
+            double x[nstates], y[nstates], z[nstates];
+            for (k = 0; k < nstates; k++) {
+                x[k] = y[k] = 0.0;
+                for (i = 0; i < nstates; i++) {
+                    x[k] += this_freq[i] * this_lh_dad[i] * evec[i*nstates+k];
+                    y[k] += inv_evec[k*nstates+i] * this_lh_node[i];
+                }
+            }
+            size_t type = 0;
+            for (i = 0; i < nstates; i++) {
+                for (l = 0; l < nstates; l++) {
+                    z[l] = 0.0;
+                    for (k = 0; k < nstates; k++)
+                        z[l] += x[k] * inv_evec[k*nstates+i] * this_integral[k*nstates+l];
+                    z[l] *= y[l];
+                }
+                for (j = 0; j < nstates; j++) {
+                    if (j == i)
+                        continue;
+                    double sum = 0.0;
+                    for (l = 0; l < nstates; l++)
+                        sum += z[l] * evec[j*nstates+l];
+                    this_count[type++] += this_rate[i*nstates+j] * sum;
+                }
+            }
+        }
+        for (i = 0; i < ntypes; i++)
+            this_count[i] *= inv_lh;
+    }
 
+    delete[] state_app;
+    delete[] weight_freq;
+    delete[] count_mat;
+    delete[] integral;
+    delete[] rate_mat;
+}
 
+void PhyloTree::endSubstitutionCounts(bool orig_kernel_nonrev) {
+    if (!orig_kernel_nonrev) {
+        // switch back to REV kernel
+        params->kernel_nonrev = orig_kernel_nonrev;
+        setLikelihoodKernel(sse);
+        clearAllPartialLH();
+    }
+}
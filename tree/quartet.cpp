@@ -1820,3 +1820,92 @@ void PhyloTree::reportLikelihoodMapping(ofstream &out) {
 
 } // end PhyloTree::reportLikelihoodMapping
 
+
+
+/***************************************
+*  Site concordance factor             *
+***************************************/
+
+void PhyloTree::computeSiteConcordance(vector<Split*> &subtrees, int num_quartets,
+    DoubleVector &scf, DoubleVector &sdf1, DoubleVector &sdf2, DoubleVector &sites)
+{
+    ASSERT(aln);
+    int nbranches = subtrees.size() / 4;
+    size_t nseq = aln->getNSeq(), nptn = aln->getNPattern();
+    size_t i, ptn;
+    ASSERT(aln->num_states < 255);
+
+    // states packed taxon by taxon, ambiguous and gap characters as 255,
+    // so that a quartet only scans four contiguous rows
+    vector<unsigned char> states(nseq * nptn);
+    IntVector freq(nptn);
+    for (ptn = 0; ptn < nptn; ptn++) {
+        Pattern &pat = aln->at(ptn);
+        freq[ptn] = pat.frequency;
+        for (i = 0; i < nseq; i++)
+            states[i * nptn + ptn] = (pat[i] < aln->num_states) ? pat[i] : 255;
+    }
+
+    // draw all quartets beforehand, so that the result does not depend on the number of threads
+    IntVector quartets(nbranches * num_quartets * 4);
+    int branch, q, k;
+    for (branch = 0; branch < nbranches; branch++) {
+        IntVector taxa[4];
+        for (k = 0; k < 4; k++) {
+            for (int taxid = 0; taxid < subtrees[branch * 4 + k]->getNTaxa(); taxid++)
+                if (subtrees[branch * 4 + k]->containTaxon(taxid))
+                    taxa[k].push_back(taxid);
+            ASSERT(!taxa[k].empty());
+        }
+        for (q = 0; q < num_quartets; q++)
+            for (k = 0; k < 4; k++)
+                quartets[(branch * num_quartets + q) * 4 + k] = taxa[k][random_int(taxa[k].size())];
+    }
+
+    scf.assign(nbranches, 0.0);
+    sdf1.assign(nbranches, 0.0);
+    sdf2.assign(nbranches, 0.0);
+    sites.assign(nbranches, 0.0);
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) private(q, ptn)
+#endif
+    for (branch = 0; branch < nbranches; branch++) {
+        int num_decisive_quartets = 0;
+        for (q = 0; q < num_quartets; q++) {
+            int *quartet = &quartets[(branch * num_quartets + q) * 4];
+            unsigned char *a = &states[quartet[0] * nptn], *b = &states[quartet[1] * nptn];
+            unsigned char *c = &states[quartet[2] * nptn], *d = &states[quartet[3] * nptn];
+            // sites supporting AB|CD, AC|BD and AD|BC
+            int support[3] = {0, 0, 0};
+            for (ptn = 0; ptn < nptn; ptn++) {
+                if (a[ptn] == 255 || b[ptn] == 255 || c[ptn] == 255 || d[ptn] == 255)
+                    continue;
+                if (a[ptn] == b[ptn]) {
+                    if (c[ptn] == d[ptn] && a[ptn] != c[ptn])
+                        support[0] += freq[ptn];
+                } else if (a[ptn] == c[ptn]) {
+                    if (b[ptn] == d[ptn])
+                        support[1] += freq[ptn];
+                } else if (a[ptn] == d[ptn]) {
+                    if (b[ptn] == c[ptn])
+                        support[2] += freq[ptn];
+                }
+            }
+            int sum = support[0] + support[1] + support[2];
+            sites[branch] += sum;
+            if (sum == 0)
+                continue;
+            num_decisive_quartets++;
+            scf[branch] += (double)support[0] / sum;
+            sdf1[branch] += (double)support[1] / sum;
+            sdf2[branch] += (double)support[2] / sum;
+        }
+        sites[branch] /= num_quartets;
+        if (num_decisive_quartets > 0) {
+            scf[branch] /= num_decisive_quartets;
+            sdf1[branch] /= num_decisive_quartets;
+            sdf2[branch] /= num_decisive_quartets;
+        }
+    }
+}
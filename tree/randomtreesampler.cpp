@@ -0,0 +1,278 @@
+/*
+ * randomtreesampler.cpp
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#include "randomtreesampler.h"
+
+RandomTreeSampler::RandomTreeSampler(int antaxa, TreeGenType atree_type, Params &params) {
+	if (antaxa < 3)
+		outError(ERR_FEW_TAXA);
+	ntaxa = antaxa;
+	num_nodes = 2*ntaxa - 2;
+	tree_type = atree_type;
+	seed = params.ran_seed;
+	min_len = params.min_len;
+	mean_len = params.mean_len;
+	max_len = params.max_len;
+	num_trees = 0;
+	for (int i = 0; i < ntaxa; i++)
+		taxon_names.push_back("T" + convertIntToString(i));
+}
+
+void RandomTreeSampler::setTaxonNames(StrVector &names) {
+	ASSERT(names.size() == ntaxa);
+	taxon_names = names;
+}
+
+int RandomTreeSampler::getBatchSize(int ntaxa, size_t max_mem) {
+	size_t tree_mem = (size_t)(2*ntaxa - 2) * (sizeof(int) + sizeof(double));
+	return max((size_t)1, min(max_mem / tree_mem, (size_t)INT_MAX));
+}
+
+void RandomTreeSampler::generate(int64_t first, int count, int num_threads) {
+	num_trees = count;
+	parent.resize((size_t)count * num_nodes);
+	length.resize((size_t)count * num_nodes);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 16) num_threads(num_threads)
+#endif
+	for (int tree = 0; tree < count; tree++) {
+		CounterRandom rnd(seed, first + tree);
+		generateTree(tree, rnd);
+	}
+}
+
+double RandomTreeSampler::randomLength(CounterRandom &rnd) {
+	if (tree_type != YULE_HARDING)
+		return rnd.random_double();
+	// same as randomLen()
+	double ran = static_cast<double> (rnd.random_int(999) + 1) / 1000;
+	double len = -mean_len * log(ran);
+	if (len < min_len)
+		len = min_len + static_cast<double> (rnd.random_int(1000)) / 1000000.0;
+	if (len > max_len)
+		len = max_len - static_cast<double> (rnd.random_int(1000)) / 1000000.0;
+	return len;
+}
+
+void RandomTreeSampler::buildBalanced(int size, int dad, int *par, int &next_leaf, int &next_node) {
+	if (size == 1) {
+		par[next_leaf++] = dad;
+		return;
+	}
+	int node = next_node++;
+	par[node] = dad;
+	buildBalanced((size+1)/2, node, par, next_leaf, next_node);
+	buildBalanced(size/2, node, par, next_leaf, next_node);
+}
+
+void RandomTreeSampler::generateTree(int tree, CounterRandom &rnd) {
+	int *par = getParents(tree);
+	double *len = getLengths(tree);
+	int root = ntaxa;
+	int i;
+	par[root] = -1;
+	len[root] = 0.0;
+
+	switch (tree_type) {
+	case YULE_HARDING:
+	case UNIFORM:
+		// start with a star tree of 3 taxa
+		for (i = 0; i < 3; i++) {
+			par[i] = root;
+			len[i] = randomLength(rnd);
+		}
+		for (i = 3; i < ntaxa; i++) {
+			int node, inner = root + i - 2;
+			if (tree_type == YULE_HARDING) {
+				// split a random leaf
+				node = rnd.random_int(i);
+				len[inner] = len[node];
+			} else {
+				// subdivide a random branch; branch above a leaf or an existing non-root inner node
+				node = rnd.random_int(2*i-3);
+				if (node >= i)
+					node = root + 1 + (node - i);
+				len[inner] = randomLength(rnd);
+			}
+			par[inner] = par[node];
+			par[node] = inner;
+			len[node] = randomLength(rnd);
+			par[i] = inner;
+			len[i] = randomLength(rnd);
+		}
+		break;
+	case CATERPILLAR: {
+		int node = root;
+		par[0] = par[1] = root;
+		for (i = 2; i < ntaxa-1; i++) {
+			int inner = root + i - 1;
+			par[inner] = node;
+			par[i] = inner;
+			node = inner;
+		}
+		par[ntaxa-1] = node;
+		for (i = 0; i < num_nodes; i++)
+			if (i != root)
+				len[i] = randomLength(rnd);
+		break;
+	}
+	case BALANCED: {
+		// unrooted version of the balanced rooted tree: the root edge is suppressed
+		int next_leaf = 0, next_node = root + 1;
+		int half = (ntaxa+1)/2;
+		buildBalanced((half+1)/2, root, par, next_leaf, next_node);
+		buildBalanced(half/2, root, par, next_leaf, next_node);
+		buildBalanced(ntaxa/2, root, par, next_leaf, next_node);
+		ASSERT(next_leaf == ntaxa && next_node == num_nodes);
+		for (i = 0; i < num_nodes; i++)
+			if (i != root)
+				len[i] = randomLength(rnd);
+		break;
+	}
+	default:
+		outError("Unsupported random tree type");
+	}
+
+	// assign taxa to leaves in random order; caterpillar and balanced trees
+	// keep the taxa in leaf order as MExtTree does
+	if (tree_type == CATERPILLAR || tree_type == BALANCED)
+		return;
+	for (i = ntaxa-1; i > 0; i--) {
+		int j = rnd.random_int(i+1);
+		swap(par[i], par[j]);
+		swap(len[i], len[j]);
+	}
+}
+
+void RandomTreeSampler::getChildren(int *par, IntVector &first_child, IntVector &next_sibling) {
+	first_child.assign(num_nodes, -1);
+	next_sibling.assign(num_nodes, -1);
+	// insert in reverse so that children are listed in increasing slot order
+	for (int node = num_nodes-1; node >= 0; node--)
+		if (par[node] >= 0) {
+			next_sibling[node] = first_child[par[node]];
+			first_child[par[node]] = node;
+		}
+}
+
+void RandomTreeSampler::printSubtree(int node, int *par, double *len, IntVector &first_child, IntVector &next_sibling, string &out) {
+	if (node < ntaxa) {
+		out += taxon_names[node];
+	} else {
+		out += '(';
+		for (int child = first_child[node]; child >= 0; child = next_sibling[child]) {
+			if (child != first_child[node])
+				out += ',';
+			printSubtree(child, par, len, first_child, next_sibling, out);
+		}
+		out += ')';
+	}
+	if (par[node] >= 0) {
+		char buf[32];
+		snprintf(buf, sizeof(buf), ":%.10f", len[node]);
+		out += buf;
+	}
+}
+
+void RandomTreeSampler::printTree(int tree, string &out) {
+	int *par = getParents(tree);
+	IntVector first_child, next_sibling;
+	getChildren(par, first_child, next_sibling);
+	printSubtree(ntaxa, par, getLengths(tree), first_child, next_sibling, out);
+	out += ';';
+}
+
+void RandomTreeSampler::printTrees(ostream &out, int num_threads) {
+	StrVector lines(num_trees);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 16) num_threads(num_threads)
+#endif
+	for (int tree = 0; tree < num_trees; tree++) {
+		printTree(tree, lines[tree]);
+		lines[tree] += '\n';
+	}
+	for (StrVector::iterator it = lines.begin(); it != lines.end(); it++)
+		out << (*it);
+}
+
+/** lexicographic order of split bit vectors, used to merge sorted split lists */
+static bool splitLess(const Split &sp1, const Split &sp2) {
+	return (const vector<UINT>&)sp1 < (const vector<UINT>&)sp2;
+}
+
+void RandomTreeSampler::getSplits(int tree, vector<Split> &splits) {
+	int *par = getParents(tree);
+	IntVector first_child, next_sibling;
+	getChildren(par, first_child, next_sibling);
+
+	// pre-order of inner nodes, reversed below for a post-order pass
+	IntVector order;
+	order.reserve(ntaxa-2);
+	order.push_back(ntaxa);
+	for (int i = 0; i < order.size(); i++)
+		for (int child = first_child[order[i]]; child >= 0; child = next_sibling[child])
+			if (child >= ntaxa)
+				order.push_back(child);
+
+	vector<Split> node_split(num_nodes - ntaxa);
+	splits.clear();
+	splits.reserve(ntaxa-3);
+	for (IntVector::reverse_iterator it = order.rbegin(); it != order.rend(); it++) {
+		int node = *it;
+		if (node == ntaxa)
+			break;
+		Split &sp = node_split[node - ntaxa];
+		sp.setNTaxa(ntaxa);
+		for (int child = first_child[node]; child >= 0; child = next_sibling[child])
+			if (child < ntaxa)
+				sp.addTaxon(child);
+			else
+				sp += node_split[child - ntaxa];
+		splits.push_back(sp);
+		if (splits.back().containTaxon(0))
+			splits.back().invert();
+	}
+	sort(splits.begin(), splits.end(), splitLess);
+}
+
+/**
+	@return number of splits shared by two sorted split lists
+*/
+static int countCommonSplits(vector<Split> &splits1, vector<Split> &splits2) {
+	int common = 0;
+	vector<Split>::iterator it1 = splits1.begin(), it2 = splits2.begin();
+	while (it1 != splits1.end() && it2 != splits2.end()) {
+		if (splitLess(*it1, *it2))
+			it1++;
+		else if (splitLess(*it2, *it1))
+			it2++;
+		else {
+			common++;
+			it1++;
+			it2++;
+		}
+	}
+	return common;
+}
+
+int RandomTreeSampler::computeRFDist(int tree1, int tree2) {
+	vector<Split> splits1, splits2;
+	getSplits(tree1, splits1);
+	getSplits(tree2, splits2);
+	return splits1.size() + splits2.size() - 2*countCommonSplits(splits1, splits2);
+}
+
+void RandomTreeSampler::computeRFDist(vector<Split> &ref_splits, IntVector &dist, int num_threads) {
+	dist.resize(num_trees);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 16) num_threads(num_threads)
+#endif
+	for (int tree = 0; tree < num_trees; tree++) {
+		vector<Split> splits;
+		getSplits(tree, splits);
+		dist[tree] = ref_splits.size() + splits.size() - 2*countCommonSplits(ref_splits, splits);
+	}
+}
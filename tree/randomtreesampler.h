@@ -0,0 +1,235 @@
+/*
+ * randomtreesampler.h
+ *
+ *  Created on: Oct 18, 2026
+ *
+ *  Parallel generation of random trees in compact node arrays, used for
+ *  -r/-ru/-rcat/-rbal with -rbatch and for in-memory null distributions of tree distances
+ */
+
+#ifndef RANDOMTREESAMPLER_H
+#define RANDOMTREESAMPLER_H
+
+#include "utils/tools.h"
+#include "pda/split.h"
+
+/**
+	Counter-based random number stream: every number is a hash of (key, counter),
+	so the stream of a tree depends only on the seed and the tree index and not
+	on which thread generates it
+*/
+class CounterRandom {
+public:
+
+	/**
+		@param seed random number seed
+		@param stream_id index of the stream (e.g. tree index)
+	*/
+	CounterRandom(int seed, int64_t stream_id) {
+		key = mix((uint64_t)seed ^ mix((uint64_t)stream_id + 0x9E3779B97F4A7C15ULL));
+		counter = 0;
+	}
+
+	/** @return random double in [0,1) */
+	inline double random_double() {
+		counter++;
+		return (mix(key + counter * 0x9E3779B97F4A7C15ULL) >> 11) * (1.0 / 9007199254740992.0);
+	}
+
+	/** @return random integer in [0,n) */
+	inline int random_int(int n) {
+		return (int)(random_double() * n);
+	}
+
+protected:
+
+	/** SplitMix64 finaliser */
+	static inline uint64_t mix(uint64_t z) {
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+		return z ^ (z >> 31);
+	}
+
+	uint64_t key;
+
+	uint64_t counter;
+};
+
+/**
+	Generates batches of random binary unrooted trees in parallel.
+	Every tree of a batch occupies 2n-2 consecutive slots of one node array:
+	slots 0..n-1 are the taxa, slot n is the root (an internal node of degree 3)
+	and each slot stores the parent slot and the length of the branch above it.
+	Tree i of the whole sequence always uses random stream i, so the output is
+	reproducible for a given seed independently of batch size and thread count.
+*/
+class RandomTreeSampler {
+public:
+
+	/**
+		constructor
+		@param antaxa number of taxa
+		@param atree_type YULE_HARDING, UNIFORM, CATERPILLAR or BALANCED
+		@param params program parameters (seed and branch length distribution)
+	*/
+	RandomTreeSampler(int antaxa, TreeGenType atree_type, Params &params);
+
+	/**
+		set taxon names used by printTree(), default T0..T(n-1)
+		@param names taxon names
+	*/
+	void setTaxonNames(StrVector &names);
+
+	/**
+		generate a batch of trees, replacing the previous batch
+		@param first index of the first tree in the whole sequence
+		@param count number of trees
+		@param num_threads number of threads
+	*/
+	void generate(int64_t first, int count, int num_threads = 1);
+
+	/** @return number of trees in the current batch */
+	inline int getNumTrees() {
+		return num_trees;
+	}
+
+	/** @return number of taxa */
+	inline int getNTaxa() {
+		return ntaxa;
+	}
+
+	/**
+		@param tree tree index in the current batch
+		@return parent slot per node, -1 for the root
+	*/
+	inline int *getParents(int tree) {
+		return &parent[(size_t)tree * num_nodes];
+	}
+
+	/**
+		@param tree tree index in the current batch
+		@return length of the branch above each node
+	*/
+	inline double *getLengths(int tree) {
+		return &length[(size_t)tree * num_nodes];
+	}
+
+	/**
+		print one tree in NEWICK format
+		@param tree tree index in the current batch
+		@param out output string, appended
+	*/
+	void printTree(int tree, string &out);
+
+	/**
+		print all trees of the current batch, one per line; formatting is done in parallel
+		@param out output stream
+		@param num_threads number of threads
+	*/
+	void printTrees(ostream &out, int num_threads = 1);
+
+	/**
+		get the non-trivial splits of a tree, each oriented to exclude taxon 0 and
+		sorted, so that two split lists can be compared by merging
+		@param tree tree index in the current batch
+		@param[out] splits sorted splits
+	*/
+	void getSplits(int tree, vector<Split> &splits);
+
+	/**
+		Robinson-Foulds distance between two trees of the current batch
+		@param tree1 first tree index
+		@param tree2 second tree index
+		@return RF distance
+	*/
+	int computeRFDist(int tree1, int tree2);
+
+	/**
+		Robinson-Foulds distance from each tree of the current batch to a reference
+		@param ref_splits reference splits in the format of getSplits()
+		@param[out] dist RF distance per tree
+		@param num_threads number of threads
+	*/
+	void computeRFDist(vector<Split> &ref_splits, IntVector &dist, int num_threads = 1);
+
+	/**
+		@param ntaxa number of taxa
+		@param max_mem memory limit in bytes
+		@return number of trees whose node arrays fit into max_mem bytes, at least 1
+	*/
+	static int getBatchSize(int ntaxa, size_t max_mem);
+
+protected:
+
+	/** number of taxa */
+	int ntaxa;
+
+	/** number of nodes per tree, 2*ntaxa-2 */
+	int num_nodes;
+
+	/** tree generation model */
+	TreeGenType tree_type;
+
+	/** random number seed */
+	int seed;
+
+	/** branch length distribution for YULE_HARDING, see randomLen() */
+	double min_len, mean_len, max_len;
+
+	/** taxon names */
+	StrVector taxon_names;
+
+	/** number of trees in the current batch */
+	int num_trees;
+
+	/** node array of the current batch: parent slot per node */
+	IntVector parent;
+
+	/** node array of the current batch: branch length per node */
+	DoubleVector length;
+
+	/**
+		generate one tree into its node slots
+		@param tree tree index in the current batch
+		@param rnd random stream of the tree
+	*/
+	void generateTree(int tree, CounterRandom &rnd);
+
+	/**
+		@return random branch length: for YULE_HARDING the same distribution as randomLen(),
+			otherwise uniform in [0,1) like the MExtTree generators
+	*/
+	double randomLength(CounterRandom &rnd);
+
+	/**
+		build a balanced rooted subtree below a node
+		@param size number of taxa in the subtree
+		@param dad parent slot
+		@param par parent array of the tree
+		@param[in,out] next_leaf next free taxon slot
+		@param[in,out] next_node next free internal slot
+	*/
+	void buildBalanced(int size, int dad, int *par, int &next_leaf, int &next_node);
+
+	/**
+		build child lists of a tree
+		@param par parent array of the tree
+		@param[out] first_child first child per node, -1 if none
+		@param[out] next_sibling next sibling per node, -1 if none
+	*/
+	void getChildren(int *par, IntVector &first_child, IntVector &next_sibling);
+
+	/**
+		print the subtree below a node in NEWICK format
+		@param node node slot
+		@param par parent array of the tree
+		@param len branch length array of the tree
+		@param first_child first child per node
+		@param next_sibling next sibling per node
+		@param out output string, appended
+	*/
+	void printSubtree(int node, int *par, double *len, IntVector &first_child, IntVector &next_sibling, string &out);
+
+};
+
+#endif
@@ -21,6 +21,15 @@
 #include "timeutil.h"
 #include "MPIHelper.h"
 
+/** minimum number of search iterations before predicting further improvements */
+const int MIN_PREDICT_ITERATIONS = 20;
+
+/** number of recent iterations to predict the time of the next iteration */
+const int NUM_TIMING_ITERATIONS = 20;
+
+/** fraction of the wall-clock budget kept for the final model optimization and output */
+const double WALL_TIME_RESERVE = 0.05;
+
 StopRule::StopRule() : CheckpointFactory()
 {
 //	nTime_ = 0;
@@ -37,6 +46,12 @@ StopRule::StopRule() : CheckpointFactory()
 	max_run_time = -1.0;
 	curIteration = 0;
     should_stop = false;
+    stop_improve_prob = 0.0;
+    wall_time_budget = 0.0;
+    run_start_time = start_real_time;
+    last_iteration_time = start_real_time;
+    search_start_iteration = -1;
+    num_candidate_changes = 0;
 }
 
 void StopRule::initialize(Params &params) {
@@ -49,6 +64,10 @@ void StopRule::initialize(Params &params) {
 	step_iteration = params.step_iterations;
 	start_real_time = getRealTime();
 	max_run_time = params.maxtime * 60; // maxtime is in minutes
+	stop_improve_prob = params.stop_improve_prob;
+	wall_time_budget = params.wall_time_budget;
+	run_start_time = params.start_real_time;
+	last_iteration_time = start_real_time;
 }
 
 void StopRule::getUFBootCountCheck(int &ufboot_count, int &ufboot_count_check) {
@@ -68,6 +87,15 @@ void StopRule::saveCheckpoint() {
     CKP_SAVE(curIteration);
     CKP_SAVE(start_real_time);
     CKP_VECTOR_SAVE(time_vec);
+    if (!iteration_times.empty()) {
+        CKP_SAVE(search_start_iteration);
+        CKP_SAVE(num_candidate_changes);
+        CKP_VECTOR_SAVE(iteration_times);
+        CKP_VECTOR_SAVE(iteration_scores);
+        CKP_VECTOR_SAVE(iteration_nnis);
+    }
+    if (!stop_reason.empty())
+        CKP_SAVE(stop_reason);
     checkpoint->endStruct();
     CheckpointFactory::saveCheckpoint();
 }
@@ -78,7 +106,15 @@ void StopRule::restoreCheckpoint() {
     CKP_RESTORE(curIteration);
     CKP_RESTORE(start_real_time);
     CKP_VECTOR_RESTORE(time_vec);
+    CKP_RESTORE(search_start_iteration);
+    CKP_RESTORE(num_candidate_changes);
+    CKP_VECTOR_RESTORE(iteration_times);
+    CKP_VECTOR_RESTORE(iteration_scores);
+    CKP_VECTOR_RESTORE(iteration_nnis);
+    CKP_RESTORE_STRING(stop_reason);
     checkpoint->endStruct();
+    // time spent before the restart does not belong to the next iteration
+    last_iteration_time = getRealTime();
 }
 
 
@@ -114,6 +150,8 @@ void StopRule::restoreCheckpoint() {
 bool StopRule::meetStopCondition(int cur_iteration, double cur_correlation) {
     if (should_stop)
         return true;
+    if (isPredicting() && meetPredictedStop(cur_iteration))
+        return true;
 	switch (stop_condition) {
 		case SC_FIXED_ITERATION:
 			return cur_iteration >= min_iteration;
@@ -154,7 +192,95 @@ double StopRule::getRemainingTime(int cur_iteration) {
 //			niterations = getLastImprovedIteration() + unsuccess_iteration;
 		break;
 	}
-	return (niterations - cur_iteration) * realtime_secs / (cur_iteration - 1);
+	double remaining = (niterations - cur_iteration) * realtime_secs / (cur_iteration - 1);
+	if (wall_time_budget > 0.0)
+		remaining = min(remaining, wall_time_budget - (getRealTime() - run_start_time));
+	return remaining;
+}
+
+void StopRule::addIterationInfo(double best_score, int num_nnis, bool candidate_changed) {
+	double now = getRealTime();
+	if (iteration_times.empty())
+		search_start_iteration = curIteration - 1;
+	iteration_times.push_back(now - last_iteration_time);
+	iteration_scores.push_back(best_score);
+	iteration_nnis.push_back(num_nnis);
+	if (candidate_changed)
+		num_candidate_changes++;
+	last_iteration_time = now;
+}
+
+double StopRule::getImproveProbability(int num_iterations) {
+	if (search_start_iteration < 0)
+		return 1.0;
+	double span = curIteration - search_start_iteration;
+	if (span < MIN_PREDICT_ITERATIONS)
+		return 1.0;
+	// maximum likelihood fit of the intensity a*b*t^(b-1) to the improved iterations in (0, span]
+	int num_events = 0;
+	double sum_log = 0.0;
+	for (auto it = time_vec.begin(); it != time_vec.end() && *it > search_start_iteration; it++) {
+		num_events++;
+		sum_log += log(span / (*it - search_start_iteration));
+	}
+	// constant rate (b = 1) if the history does not determine the shape
+	double shape = (num_events >= 2 && sum_log > 0.0) ? num_events / sum_log : 1.0;
+	// predictive probability of no event with a Gamma(1/2) prior on a
+	return 1.0 - pow(1.0 + num_iterations / span, -shape * (num_events + 0.5));
+}
+
+double StopRule::getNextIterationTime() {
+	int num = min((int)iteration_times.size(), NUM_TIMING_ITERATIONS);
+	if (num == 0)
+		return 0.0;
+	double sum = 0.0, sum_sqr = 0.0;
+	for (auto it = iteration_times.end() - num; it != iteration_times.end(); it++) {
+		sum += *it;
+		sum_sqr += (*it) * (*it);
+	}
+	double mean = sum / num;
+	double sd = sqrt(max(sum_sqr / num - mean * mean, 0.0));
+	return mean + 2.0 * sd;
+}
+
+bool StopRule::meetPredictedStop(int cur_iteration) {
+	if (!stop_reason.empty())
+		return true;
+	if (iteration_times.empty()) {
+		// the first search iteration starts after this check
+		last_iteration_time = getRealTime();
+		return false;
+	}
+	stringstream reason;
+	if (wall_time_budget > 0.0) {
+		double next_time = getNextIterationTime();
+		double remaining = wall_time_budget * (1.0 - WALL_TIME_RESERVE) - (getRealTime() - run_start_time);
+		if (next_time > remaining)
+			reason << "next iteration (" << next_time << " sec predicted) would exceed the wall-clock budget ("
+				<< max(remaining, 0.0) << " sec left)";
+	}
+	// only shorten the default search, which is not tied to a fixed number of iterations or UFBoot convergence
+	if (reason.str().empty() && stop_improve_prob > 0.0 && stop_condition == SC_UNSUCCESS_ITERATION) {
+		double prob = getImproveProbability(unsuccess_iteration);
+		if (prob < stop_improve_prob)
+			reason << "probability to find a better tree in the next " << unsuccess_iteration
+				<< " iterations is " << prob << " < " << stop_improve_prob;
+	}
+	if (reason.str().empty())
+		return false;
+	stop_reason = reason.str();
+
+	int num_iterations = iteration_times.size();
+	double sum_time = 0.0, sum_nnis = 0.0;
+	for (int i = 0; i < num_iterations; i++) {
+		sum_time += iteration_times[i];
+		sum_nnis += iteration_nnis[i];
+	}
+	cout << "NOTE: Stop tree search at iteration " << cur_iteration << " because " << stop_reason << endl;
+	cout << "NOTE: " << num_iterations << " search iterations, " << num_candidate_changes
+		<< " entered the candidate set, " << sum_nnis / num_iterations << " NNIs and "
+		<< sum_time / num_iterations << " sec per iteration, best score " << iteration_scores.back() << endl;
+	return true;
 }
 
 //void StopRule::setStopCondition(STOP_CONDITION sc) {
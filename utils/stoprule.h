@@ -91,6 +91,34 @@ public:
 	/** get the remaining time to converge, in seconds */
 	double getRemainingTime(int cur_iteration);
 
+	/**
+		record one finished search iteration for the progress predictor
+		@param best_score best score in the candidate set after the iteration
+		@param num_nnis number of NNIs applied in the iteration
+		@param candidate_changed TRUE if the new tree entered the candidate set
+	*/
+	void addIterationInfo(double best_score, int num_nnis, bool candidate_changed);
+
+	/**
+		probability to improve the best tree within the next iterations, from a power-law
+		(Crow-AMSAA) process fitted to the improved iterations of the search phase
+		@param num_iterations number of further iterations
+		@return predicted probability, 1.0 during the first search iterations
+	*/
+	double getImproveProbability(int num_iterations);
+
+	/**
+		@return predicted wall-clock time of the next iteration in seconds, 0 if unknown
+	*/
+	double getNextIterationTime();
+
+	/**
+		@return TRUE if the progress predictor (-stop_prob or -walltime) is active
+	*/
+	bool isPredicting() {
+		return stop_improve_prob > 0.0 || wall_time_budget > 0.0;
+	}
+
 	/**
 		@return the number of iterations required to stop the search
 	*/
@@ -123,6 +151,13 @@ private:
 
 	double predict (double &upperTime);
 
+	/**
+		stop decision of the progress predictor, logged once when met
+		@param cur_iteration current iteration number
+		@return TRUE if the search should stop
+	*/
+	bool meetPredictedStop(int cur_iteration);
+
 	/**
 		stop condition 
 	*/
@@ -166,6 +201,36 @@ private:
     /** TRUE to override stop condition */
     bool should_stop;
 
+    /** stop if the probability of a better tree drops below this value, 0 to disable */
+    double stop_improve_prob;
+
+    /** wall-clock budget of the run in seconds, 0 to disable */
+    double wall_time_budget;
+
+    /** starting real time of the run, against which the budget is measured */
+    double run_start_time;
+
+    /** real time when the last iteration finished */
+    double last_iteration_time;
+
+    /** last iteration before the search phase started */
+    int search_start_iteration;
+
+    /** wall-clock time per search iteration */
+    DoubleVector iteration_times;
+
+    /** best candidate score after each search iteration */
+    DoubleVector iteration_scores;
+
+    /** number of applied NNIs per search iteration */
+    IntVector iteration_nnis;
+
+    /** number of search iterations whose tree entered the candidate set */
+    int num_candidate_changes;
+
+    /** reason why the progress predictor stopped the search, empty if it did not */
+    string stop_reason;
+
 	/* FOLLOWING CODES ARE FROM IQPNNI version 3 */	
 
 //	int nTime_;
@@ -693,6 +693,7 @@ void parseArg(int argc, char *argv[], Params &params) {
     int cnt;
     verbose_mode = VB_MIN;
     params.tree_gen = NONE;
+    params.random_tree_batch = false;
     params.user_file = NULL;
     params.constraint_tree_file = NULL;
     params.opt_gammai = true;
@@ -747,6 +748,8 @@ void parseArg(int argc, char *argv[], Params &params) {
     params.calc_pdgain = false;
     params.multi_tree = false;
     params.second_tree = NULL;
+    params.gene_trees_file = NULL;
+    params.site_concordance = 0;
     params.tree_weight_file = NULL;
     params.consensus_type = CT_NONE;
     params.find_pd_min = false;
@@ -768,6 +771,7 @@ void parseArg(int argc, char *argv[], Params &params) {
     params.collapse_zero_branch = false;
     params.split_weight_summary = SW_SUM;
     params.gurobi_format = true;
+    params.gurobi_solver = false;
     params.gurobi_threads = 1;
     params.num_bootstrap_samples = 0;
     params.bootstrap_spec = NULL;
@@ -805,6 +809,10 @@ void parseArg(int argc, char *argv[], Params &params) {
     params.nni5 = true;
     params.nni5_num_eval = 1;
     params.brlen_num_traversal = 2;
+    params.lazy_spr_radius = 0;
+    params.lazy_spr_moves = 20;
+    params.bme_spr_radius = 5;
+    params.pattern_subsample = 0.0;
     params.leastSquareBranch = false;
     params.pars_branch_length = false;
     params.bayes_branch_length = false;
@@ -860,6 +868,7 @@ void parseArg(int argc, char *argv[], Params &params) {
 //    params.avoid_duplicated_trees = false;
     params.writeDistImdTrees = false;
     params.rf_dist_mode = 0;
+    params.tree_dist = TREE_DIST_RF;
     params.mvh_site_rate = false;
     params.rate_mh_type = true;
     params.discard_saturated_site = false;
@@ -885,6 +894,7 @@ void parseArg(int argc, char *argv[], Params &params) {
     params.print_trees_site_posterior = 0;
     params.print_ancestral_sequence = AST_NONE;
     params.min_ancestral_prob = 0.0;
+    params.print_subst_count = SCT_NONE;
     params.print_tree_lh = false;
     params.lambda = 1;
     params.speed_conf = 1.0;
@@ -959,6 +969,8 @@ void parseArg(int argc, char *argv[], Params &params) {
     params.snni = true; // turn on sNNI default now
 //    params.autostop = true; // turn on auto stopping rule by default now
     params.unsuccess_iteration = 100;
+    params.stop_improve_prob = 0.0;
+    params.wall_time_budget = 0.0;
     params.speednni = true; // turn on reduced hill-climbing NNI by default now
     params.numInitTrees = 100;
     params.fixStableSplits = false;
@@ -978,6 +990,11 @@ void parseArg(int argc, char *argv[], Params &params) {
     params.tree_freq_file = NULL;
     params.num_threads = 1;
     params.num_threads_max = 10000;
+    params.jobs_file = NULL;
+    params.num_jobs = 1;
+    params.place_ref = NULL;
+    params.place_keep = 7;
+    params.place_fast = false;
     params.model_test_criterion = MTC_BIC;
 //    params.model_test_stop_rule = MTC_ALL;
     params.model_test_sample_size = 0;
@@ -1307,6 +1324,10 @@ void parseArg(int argc, char *argv[], Params &params) {
 				params.tree_gen = BALANCED;
 				continue;
 			}
+			if (strcmp(argv[cnt], "-rbatch") == 0) {
+				params.random_tree_batch = true;
+				continue;
+			}
             if (strcmp(argv[cnt], "-keep_ident") == 0 || strcmp(argv[cnt], "-keep-ident") == 0) {
                 params.ignore_identical_seqs = false;
                 continue;
@@ -1423,6 +1444,22 @@ void parseArg(int argc, char *argv[], Params &params) {
 				params.consensus_type = CT_ASSIGN_SUPPORT_EXTENDED;
 				continue;
 			}
+			if (strcmp(argv[cnt], "-gcf") == 0) {
+				cnt++;
+				if (cnt >= argc)
+					throw "Use -gcf <gene_trees_file>";
+				params.gene_trees_file = argv[cnt];
+				continue;
+			}
+			if (strcmp(argv[cnt], "-scf") == 0) {
+				cnt++;
+				if (cnt >= argc)
+					throw "Use -scf <num_quartets>";
+				params.site_concordance = convert_int(argv[cnt]);
+				if (params.site_concordance < 1)
+					throw "Positive -scf please";
+				continue;
+			}
 			if (strcmp(argv[cnt], "-treew") == 0) {
 				cnt++;
 				if (cnt >= argc)
@@ -1553,6 +1590,7 @@ void parseArg(int argc, char *argv[], Params &params) {
 			}
 			if (strcmp(argv[cnt], "-qp") == 0) {
 				params.gurobi_format = true;
+				params.gurobi_solver = true;
 				params.quad_programming = true;
 				continue;
 			}
@@ -1778,15 +1816,17 @@ void parseArg(int argc, char *argv[], Params &params) {
 			if (strcmp(argv[cnt], "-starttree") == 0) {
 				cnt++;
 				if (cnt >= argc)
-					throw "Use -starttree BIONJ|PARS|PLLPARS";
+					throw "Use -starttree BIONJ|BME|PARS|PLLPARS";
 				if (strcmp(argv[cnt], "BIONJ") == 0)
 					params.start_tree = STT_BIONJ;
+				else if (strcmp(argv[cnt], "BME") == 0)
+					params.start_tree = STT_BME;
 				else if (strcmp(argv[cnt], "PARS") == 0)
 					params.start_tree = STT_PARSIMONY;
 				else if (strcmp(argv[cnt], "PLLPARS") == 0)
 					params.start_tree = STT_PLL_PARSIMONY;
 				else
-					throw "Invalid option, please use -starttree with BIONJ or PARS or PLLPARS";
+					throw "Invalid option, please use -starttree with BIONJ or BME or PARS or PLLPARS";
 				continue;
 			}
 
@@ -2312,6 +2352,7 @@ void parseArg(int argc, char *argv[], Params &params) {
             }
 			if (strcmp(argv[cnt], "-gurobi") == 0) {
 				params.gurobi_format = true;
+				params.gurobi_solver = true;
 				continue;
 			}
 			if (strcmp(argv[cnt], "-gthreads") == 0) {
@@ -2437,6 +2478,26 @@ void parseArg(int argc, char *argv[], Params &params) {
 				params.second_tree = argv[cnt];
 				continue;
 			}
+			if (strcmp(argv[cnt], "-tdist") == 0) {
+				cnt++;
+				if (cnt >= argc)
+					throw "Use -tdist RF|QD|TD|MSD|KF";
+				if (strcmp(argv[cnt], "RF") == 0)
+					params.tree_dist = TREE_DIST_RF;
+				else if (strcmp(argv[cnt], "QD") == 0)
+					params.tree_dist = TREE_DIST_QUARTET;
+				else if (strcmp(argv[cnt], "TD") == 0)
+					params.tree_dist = TREE_DIST_TRIPLET;
+				else if (strcmp(argv[cnt], "MSD") == 0)
+					params.tree_dist = TREE_DIST_MATCHING_SPLIT;
+				else if (strcmp(argv[cnt], "KF") == 0)
+					params.tree_dist = TREE_DIST_KF;
+				else
+					throw "Use -tdist RF|QD|TD|MSD|KF";
+				if (params.rf_dist_mode == 0)
+					params.rf_dist_mode = RF_ALL_PAIR;
+				continue;
+			}
 			if (strcmp(argv[cnt], "-rf2") == 0) {
 				params.rf_dist_mode = RF_TWO_TREE_SETS_EXTENDED;
 				cnt++;
@@ -2548,6 +2609,18 @@ void parseArg(int argc, char *argv[], Params &params) {
 				continue;
 			}
 
+			if (strcmp(argv[cnt], "-wsc") == 0) {
+				params.print_subst_count = SCT_TOTAL;
+                params.ignore_identical_seqs = false;
+				continue;
+			}
+
+			if (strcmp(argv[cnt], "-wsct") == 0) {
+				params.print_subst_count = SCT_TYPE;
+                params.ignore_identical_seqs = false;
+				continue;
+			}
+
 			if (strcmp(argv[cnt], "-wsr") == 0) {
 				params.print_site_rate = true;
 				continue;
@@ -3111,6 +3184,24 @@ void parseArg(int argc, char *argv[], Params &params) {
                 params.max_iterations = max(params.max_iterations, params.unsuccess_iteration*10);
 				continue;
 			}
+			if (strcmp(argv[cnt], "-stop_prob") == 0) {
+				cnt++;
+				if (cnt >= argc)
+					throw "Use -stop_prob <probability>";
+				params.stop_improve_prob = convert_double(argv[cnt]);
+				if (params.stop_improve_prob <= 0 || params.stop_improve_prob >= 1)
+					throw "-stop_prob must be in range (0,1)";
+				continue;
+			}
+			if (strcmp(argv[cnt], "-walltime") == 0) {
+				cnt++;
+				if (cnt >= argc)
+					throw "Use -walltime <time_in_minutes>";
+				params.wall_time_budget = convert_double(argv[cnt]) * 60;
+				if (params.wall_time_budget <= 0)
+					throw "-walltime must be positive";
+				continue;
+			}
 			if (strcmp(argv[cnt], "-lsbran") == 0) {
 				params.leastSquareBranch = true;
 				continue;
@@ -3150,6 +3241,46 @@ void parseArg(int argc, char *argv[], Params &params) {
                 continue;
             }
 
+            if (strcmp(argv[cnt], "-lspr") == 0) {
+				cnt++;
+				if (cnt >= argc)
+					throw "Use -lspr <max_radius>";
+                params.lazy_spr_radius = convert_int(argv[cnt]);
+                if (params.lazy_spr_radius < 0)
+                    throw("Non-negative -lspr expected");
+                continue;
+            }
+
+            if (strcmp(argv[cnt], "-lspr-moves") == 0) {
+				cnt++;
+				if (cnt >= argc)
+					throw "Use -lspr-moves <num_moves>";
+                params.lazy_spr_moves = convert_int(argv[cnt]);
+                if (params.lazy_spr_moves < 1)
+                    throw("Positive -lspr-moves expected");
+                continue;
+            }
+
+            if (strcmp(argv[cnt], "-bme-spr") == 0) {
+				cnt++;
+				if (cnt >= argc)
+					throw "Use -bme-spr <radius>";
+                params.bme_spr_radius = convert_int(argv[cnt]);
+                if (params.bme_spr_radius < 1)
+                    throw("Positive -bme-spr expected");
+                continue;
+            }
+
+            if (strcmp(argv[cnt], "-psub") == 0) {
+				cnt++;
+				if (cnt >= argc)
+					throw "Use -psub <fraction>";
+                params.pattern_subsample = convert_double(argv[cnt]);
+                if (params.pattern_subsample <= 0.0 || params.pattern_subsample >= 1.0)
+                    throw("-psub must be in range (0,1)");
+                continue;
+            }
+
             if (strcmp(argv[cnt], "-bl-eval") == 0) {
 				cnt++;
 				if (cnt >= argc)
@@ -3291,6 +3422,51 @@ void parseArg(int argc, char *argv[], Params &params) {
 				continue;
 			}
             
+            if (strcmp(argv[cnt], "-jobs") == 0) {
+                cnt++;
+                if (cnt >= argc)
+                    throw "Use -jobs <job_file>";
+                params.jobs_file = argv[cnt];
+                continue;
+            }
+
+            if (strcmp(argv[cnt], "-njobs") == 0) {
+                cnt++;
+                if (cnt >= argc)
+                    throw "Use -njobs <num_jobs>|AUTO";
+                if (strcmp(argv[cnt], "AUTO") == 0)
+                    params.num_jobs = 0;
+                else {
+                    params.num_jobs = convert_int(argv[cnt]);
+                    if (params.num_jobs < 1)
+                        throw "At least 1 job please";
+                }
+                continue;
+            }
+
+            if (strcmp(argv[cnt], "-place") == 0) {
+                cnt++;
+                if (cnt >= argc)
+                    throw "Use -place <reference_prefix>";
+                params.place_ref = argv[cnt];
+                continue;
+            }
+
+            if (strcmp(argv[cnt], "-place-keep") == 0) {
+                cnt++;
+                if (cnt >= argc)
+                    throw "Use -place-keep <num_placements>";
+                params.place_keep = convert_int(argv[cnt]);
+                if (params.place_keep < 1)
+                    throw "Number of placements to keep must be positive";
+                continue;
+            }
+
+            if (strcmp(argv[cnt], "-place-fast") == 0) {
+                params.place_fast = true;
+                continue;
+            }
+
             if (strcmp(argv[cnt], "-ntmax") == 0) {
                 cnt++;
                 if (cnt >= argc)
@@ -3339,13 +3515,15 @@ void parseArg(int argc, char *argv[], Params &params) {
                 }
 				cnt++;
 				if (cnt >= argc)
-					throw "Use -t,-te <start_tree | BIONJ | PARS | PLLPARS>";
+					throw "Use -t,-te <start_tree | BIONJ | BME | PARS | PLLPARS>";
 				if (strcmp(argv[cnt], "BIONJ") == 0)
 					params.start_tree = STT_BIONJ;
 				else if (strcmp(argv[cnt], "PARS") == 0)
 					params.start_tree = STT_PARSIMONY;
 				else if (strcmp(argv[cnt], "PLLPARS") == 0)
 					params.start_tree = STT_PLL_PARSIMONY;
+				else if (strcmp(argv[cnt], "BME") == 0)
+					params.start_tree = STT_BME;
                 else if (strcmp(argv[cnt], "RANDOM") == 0)
 					params.start_tree = STT_RANDOM_TREE;
 				else
@@ -3528,7 +3706,8 @@ void parseArg(int argc, char *argv[], Params &params) {
         }
 
     } // for
-    if (!params.user_file && !params.aln_file && !params.ngs_file && !params.ngs_mapped_reads && !params.partition_file) {
+    if (!params.user_file && !params.aln_file && !params.ngs_file && !params.ngs_mapped_reads && !params.partition_file
+        && !params.jobs_file) {
 #ifdef IQ_TREE
         quickStartGuide();
 //        usage_iqtree(argv, false);
@@ -3560,9 +3739,13 @@ void parseArg(int argc, char *argv[], Params &params) {
             params.out_prefix = params.ngs_file;
         else if (params.ngs_mapped_reads)
             params.out_prefix = params.ngs_mapped_reads;
+        else if (params.jobs_file)
+            params.out_prefix = params.jobs_file;
         else
             params.out_prefix = params.user_file;
     }
+    if (params.place_ref && strcmp(params.place_ref, params.out_prefix) == 0)
+        outError("Output prefix must differ from the -place prefix, otherwise the reference tree is overwritten");
 //    if (MPIHelper::getInstance().isWorker()) {
     // BUG: setting out_prefix this way cause access to stack, which is cleaned up after returning from this function
 //        string newPrefix = string(params.out_prefix) + "."  + NumberToString(MPIHelper::getInstance().getProcessID()) ;
@@ -3624,6 +3807,12 @@ void usage(char* argv[]) {
     cout << "  -k% <n>           Find optimal set of size relative the total number of taxa" << endl;
     cout << "  -diet <min_diet>  Minimum diet portion (%) to be preserved for each predator" << endl;
     cout << endl;
+
+    cout << "OPTIONS FOR LINEAR/INTEGER PROGRAMMING:" << endl;
+    cout << "  -gurobi           Solve with external gurobi_cl instead of built-in solver" << endl;
+    cout << "  -gthreads <num>   Number of threads for gurobi_cl (default: 1)" << endl;
+    cout << "    NOTE: the built-in solver uses the number of threads given by -nt" << endl;
+    cout << endl;
     //if (!full_command) exit(0);
 
     cout << "MISCELLANEOUS:" << endl;
@@ -3652,8 +3841,11 @@ void usage_iqtree(char* argv[], bool full_command) {
             << "  -q <partition_file>  Edge-linked partition model (file in NEXUS/RAxML format)" << endl
             << " -spp <partition_file> Like -q option but allowing partition-specific rates" << endl
             << "  -sp <partition_file> Edge-unlinked partition model (like -M option of RAxML)" << endl
-            << "  -t <start_tree_file> or -t BIONJ or -t RANDOM" << endl
+            << "  -t <start_tree_file> or -t BIONJ or -t BME or -t RANDOM" << endl
             << "                       Starting tree (default: 99 parsimony tree and BIONJ)" << endl
+            << "                       BME: BIONJ improved by balanced minimum evolution," << endl
+            << "                       needs about 32*n^2 bytes RAM for n sequences," << endl
+            << "                       otherwise only NNI moves with less memory" << endl
             << "  -te <user_tree_file> Like -t but fixing user tree (no tree search performed)" << endl
             << "  -o <outgroup_taxon>  Outgroup taxon name for writing .treefile" << endl
             << "  -pre <PREFIX>        Prefix for all output files (default: aln/partition)" << endl
@@ -3661,6 +3853,11 @@ void usage_iqtree(char* argv[], bool full_command) {
             << "  -nt <num_threads>    Number of cores/threads or AUTO for automatic detection" << endl
             << "  -ntmax <max_threads> Max number of threads by -nt AUTO (default: #CPU cores)" << endl
 #endif
+            << "  -jobs <job_file>     Run each line of job_file (IQ-TREE options) as an" << endl
+            << "                       independent analysis in its own process, each with" << endl
+            << "                       the -nt threads given on its line" << endl
+            << "  -njobs <num_jobs>    Number of -jobs analyses at the same time or AUTO for" << endl
+            << "                       one per CPU core (default: 1)" << endl
             << "  -seed <number>       Random seed number, normally used for debugging purpose" << endl
             << "  -v, -vv, -vvv        Verbose mode, printing more messages to screen" << endl
             << "  -quiet               Quiet mode, suppress printing to screen (stdout)" << endl
@@ -3682,9 +3879,18 @@ void usage_iqtree(char* argv[], bool full_command) {
             << "  -nbest <number>      Number of best trees retained during search (defaut: 5)" << endl
             << "  -n <#iterations>     Fix number of iterations to stop (default: auto)" << endl
             << "  -nstop <number>      Number of unsuccessful iterations to stop (default: 100)" << endl
+            << "  -stop_prob <prob>    Stop earlier if the predicted probability to find a better" << endl
+            << "                       tree in the next -nstop iterations is below <prob> (default: off)" << endl
+            << "  -walltime <minutes>  Fit the tree search into a wall-clock budget for the run" << endl
             << "  -pers <proportion>   Perturbation strength for randomized NNI (default: 0.5)" << endl
             << "  -sprrad <number>     Radius for parsimony SPR search (default: 6)" << endl
             << "  -allnni              Perform more thorough NNI search (default: off)" << endl
+            << "  -lspr <radius>       Lazy SPR search after each NNI search (default: off)" << endl
+            << "  -lspr-moves <number> Number of lazy SPR moves re-evaluated per round (default: 20)" << endl
+            << "  -bme-spr <radius>    SPR radius of the BME search of -t BME, 1 for NNI only (default: 5)" << endl
+            << "  -psub <fraction>     Start the search on a random subsample with this fraction" << endl
+            << "                       of patterns, grown to the full data when the search" << endl
+            << "                       stalls (default: off, try 0.05 for long alignments)" << endl
             << "  -g <constraint_tree> (Multifurcating) topological constraint tree file" << endl
             << "  -fast                Fast search to resemble FastTree" << endl
 //            << "  -iqp                 Use the IQP tree perturbation (default: randomized NNI)" << endl
@@ -3870,11 +4076,19 @@ void usage_iqtree(char* argv[], bool full_command) {
             << "  -net                 Computing consensus network to .nex file" << endl
             << "  -sup <target_tree>   Assigning support values for <target_tree> to .suptree" << endl
             << "  -suptag <name>       Node name (or ALL) to assign tree IDs where node occurs" << endl
+            << endl << "GENE/SITE CONCORDANCE FACTORS:" << endl
+            << "  -t <tree_file>       Reference tree to assign concordance factors" << endl
+            << "  -gcf <gene_trees>    Gene concordance factors from a set of gene trees" << endl
+            << "  -scf <#quartets>     Site concordance factors from <#quartets> quartets per" << endl
+            << "                       branch, requires an alignment (-s, -q, -spp or -sp)" << endl
             << endl << "ROBINSON-FOULDS DISTANCE:" << endl
             << "  -rf_all              Computing all-to-all RF distances of trees in <treefile>" << endl
             << "  -rf <treefile2>      Computing all RF distances between two sets of trees" << endl
             << "                       stored in <treefile> and <treefile2>" << endl
             << "  -rf_adj              Computing RF distances of adjacent trees in <treefile>" << endl
+            << "  -tdist RF|QD|TD|MSD|KF Distance computed by -rf_all, -rf and -rf_adj instead of" << endl
+            << "                       RF: quartet, triplet (needs -rooted), matching split or" << endl
+            << "                       Kuhner-Felsenstein branch score (default: RF)" << endl
             << endl << "TREE TOPOLOGY TEST:" << endl
             << "  -z <trees_file>      Evaluating a set of user trees" << endl
             << "  -zb <#replicates>    Performing BP,KH,SH,ELW tests for trees passed via -z" << endl
@@ -3883,7 +4097,15 @@ void usage_iqtree(char* argv[], bool full_command) {
             << endl << "ANCESTRAL STATE RECONSTRUCTION:" << endl
             << "  -asr                 Ancestral state reconstruction by empirical Bayes" << endl
             << "  -asr-min <prob>      Min probability of ancestral state (default: equil freq)" << endl
-//            << "  -wja                 Write ancestral sequences by joint reconstruction" << endl
+            << "  -asr-joint           Ancestral sequences by joint maximum likelihood" << endl
+            << "  -wsc                 Write expected substitutions per branch and site" << endl
+            << "  -wsct                Like -wsc but per substitution type" << endl
+            << endl << "SEQUENCE PLACEMENT:" << endl
+            << "  -place <prefix>      Place sequences of the alignment (-s) that are not in" << endl
+            << "                       <prefix>.treefile onto this fixed tree, with model" << endl
+            << "                       parameters from <prefix>.ckp.gz, write .jplace file" << endl
+            << "  -place-keep <num>    Max number of placements per sequence (default: 7)" << endl
+            << "  -place-fast          Only score placements at the middle of each branch" << endl
 
 
             << endl;
@@ -3893,6 +4115,8 @@ void usage_iqtree(char* argv[], bool full_command) {
 			cout << "  -ru <num_taxa>       Create a random tree under Uniform model" << endl;
 			cout << "  -rcat <num_taxa>     Create a random caterpillar tree" << endl;
 			cout << "  -rbal <num_taxa>     Create a random balanced tree" << endl;
+			cout << "  -rbatch              Generate -r/-ru/-rcat/-rbal trees in parallel batches" << endl;
+			cout << "                       (trees differ from the default for the same seed)" << endl;
 			cout << "  -rcsg <num_taxa>     Create a random circular split network" << endl;
 			cout << "  -rlen <min_len> <mean_len> <max_len>  " << endl;
 			cout << "                       min, mean, and max branch lengths of random trees" << endl;
@@ -4443,6 +4667,18 @@ Params& Params::getInstance() {
 }
 
 
+size_t getL2CacheSize() {
+    static size_t l2_size = 0;
+    if (l2_size)
+        return l2_size;
+    long size = 0;
+#if defined(_SC_LEVEL2_CACHE_SIZE)
+    size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+#endif
+    l2_size = (size > 0) ? size : 256*1024;
+    return l2_size;
+}
+
 int countPhysicalCPUCores() {
     uint32_t registers[4];
     unsigned logicalcpucount;
@@ -332,6 +332,15 @@ const int RF_ALL_PAIR = 2;
 const int RF_TWO_TREE_SETS = 3;
 const int RF_TWO_TREE_SETS_EXTENDED = 4; // work for trees with non-equal taxon sets
 
+/**
+        tree distance computed by -rf_all, -rf_adj and -rf
+ */
+const int TREE_DIST_RF = 0;
+const int TREE_DIST_QUARTET = 1;
+const int TREE_DIST_TRIPLET = 2; // rooted trees only
+const int TREE_DIST_MATCHING_SPLIT = 3;
+const int TREE_DIST_KF = 4; // Kuhner-Felsenstein branch score
+
 /**
         split weight summarization
  */
@@ -427,7 +436,7 @@ enum LEAST_SQUARE_VAR {
 };
 
 enum START_TREE_TYPE {
-	STT_BIONJ, STT_PARSIMONY, STT_PLL_PARSIMONY, STT_RANDOM_TREE
+	STT_BIONJ, STT_PARSIMONY, STT_PLL_PARSIMONY, STT_RANDOM_TREE, STT_BME
 };
 
 const int MCAT_LOG = 1; // categorize by log(rate) for Meyer & von Haeseler model
@@ -485,6 +494,10 @@ enum AncestralSeqType {
     AST_NONE, AST_MARGINAL, AST_JOINT
 };
 
+enum SubstCountType {
+    SCT_NONE, SCT_TOTAL, SCT_TYPE
+};
+
 
 const int BRLEN_OPTIMIZE = 0; // optimize branch lengths
 const int BRLEN_FIX      = 1; // fix branch lengths
@@ -695,6 +708,29 @@ public:
 	 */
 	int brlen_num_traversal;
 
+	/**
+	 *  Maximum regrafting radius of the lazy SPR search following each NNI search,
+	 *  0 to switch it off (DEFAULT: 0)
+	 */
+	int lazy_spr_radius;
+
+	/**
+	 *  Number of best lazy SPR moves fully re-evaluated per round (DEFAULT: 20)
+	 */
+	int lazy_spr_moves;
+
+	/**
+	 *  Maximum regrafting radius of SPR moves in the balanced minimum evolution
+	 *  search of -t BME, 1 for NNI moves only (DEFAULT: 5)
+	 */
+	int bme_spr_radius;
+
+	/**
+	 *  Fraction of patterns in the initial pattern subsample of the tree search, which
+	 *  grows until the full data are used, 0 to switch it off (DEFAULT: 0)
+	 */
+	double pattern_subsample;
+
     /**
      *  Number of branch length optimization rounds performed after
      *  each NNI step (DEFAULT: 1)
@@ -761,6 +797,18 @@ public:
      */
     int unsuccess_iteration;
 
+    /**
+     *  Stop the search early once the predicted probability of improving the best tree
+     *  within the next unsuccess_iteration iterations drops below this value (0 to disable)
+     */
+    double stop_improve_prob;
+
+    /**
+     *  Wall-clock budget in seconds for the whole run; the tree search stops when the next
+     *  iteration is predicted to overrun it (0 to disable)
+     */
+    double wall_time_budget;
+
     char *binary_aln_file;
 
     /**
@@ -967,6 +1015,12 @@ public:
      */
     TreeGenType tree_gen;
 
+    /**
+            TRUE to generate random trees in parallel batches with per-tree random streams
+            instead of one by one from the global random generator (-rbatch)
+     */
+    bool random_tree_batch;
+
     /**
             when generating random split graph, specify the number of
             splits here!
@@ -1146,6 +1200,16 @@ public:
     */
     char *support_tag;
 
+    /**
+            gene trees to compute gene concordance factors for the branches of user_file
+     */
+    char *gene_trees_file;
+
+    /**
+            number of quartets drawn per branch to compute site concordance factors, 0 to skip
+     */
+    int site_concordance;
+
     /**
             2nd alignment used in computing multinomialProb (Added by MA)
      */
@@ -1440,9 +1504,15 @@ public:
     bool gurobi_format;
 
     /**
-            number of threads for gurobi call
+            TRUE to solve LP/ILP problems by calling the external gurobi_cl,
+            FALSE to use the built-in branch-and-bound solver (default)
      */
-    bool gurobi_threads;
+    bool gurobi_solver;
+
+    /**
+            number of threads for gurobi_cl, the built-in solver uses num_threads
+     */
+    int gurobi_threads;
 
     /**
             TRUE if doing bootstrap on the input trees (good, bad, ugly)
@@ -1485,6 +1555,12 @@ public:
      */
     int rf_dist_mode;
 
+    /**
+            tree distance used with rf_dist_mode: TREE_DIST_RF (default), TREE_DIST_QUARTET,
+            TREE_DIST_TRIPLET, TREE_DIST_MATCHING_SPLIT or TREE_DIST_KF
+     */
+    int tree_dist;
+
     /**
             compute the site-specific rates by Meyer & von Haeseler method
      */
@@ -1574,6 +1650,13 @@ public:
     /** minimum probability to assign an ancestral state */
     double min_ancestral_prob;
 
+    /**
+        SCT_NONE: do not print substitution counts (default)
+        SCT_TOTAL: print expected number of substitutions per branch and site
+        SCT_TYPE: print expected number of substitutions per branch, site and substitution type
+    */
+    SubstCountType print_subst_count;
+
     /**
         0: print nothing
         1: print site state frequency vectors
@@ -1880,6 +1963,27 @@ public:
     /** maximum number of threads, default: #CPU scores  */
     int num_threads_max;
 
+    /**
+        file with one command line per line, each run as an independent analysis
+        in its own process (option -jobs), NULL to run a single analysis
+    */
+    char *jobs_file;
+
+    /** number of -jobs analyses running at the same time, 0 for one per CPU core (DEFAULT: 1) */
+    int num_jobs;
+
+    /**
+        prefix of a reference analysis (<prefix>.treefile, <prefix>.ckp.gz) onto whose tree
+        the other sequences of the alignment are placed (option -place), NULL for no placement
+    */
+    char *place_ref;
+
+    /** maximum number of placements reported per query sequence */
+    int place_keep;
+
+    /** TRUE to only prescore placements at the middle of each branch (option -place-fast) */
+    bool place_fast;
+
     /** either MTC_AIC, MTC_AICc, MTC_BIC */
     ModelTestCriterion model_test_criterion;
 
@@ -2537,6 +2641,11 @@ void trimString(string &str);
 */
 int countPhysicalCPUCores();
 
+/**
+    @return size of the L2 cache in bytes, 256KB if it cannot be detected
+*/
+size_t getL2CacheSize();
+
 void print_stacktrace(ostream &out, unsigned int max_frames = 63);
 
 /**
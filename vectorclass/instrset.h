@@ -164,6 +164,7 @@ namespace VCL_NAMESPACE {
     bool hasFMA4(void);                              // true if FMA4 instructions supported
     bool hasXOP(void);                               // true if XOP  instructions supported
     bool hasAVX512ER(void);                          // true if AVX512ER instructions supported
+    bool hasAVX512VPOPCNTDQ(void);                   // true if AVX512VPOPCNTDQ instructions supported
 #ifdef VCL_NAMESPACE
 }
 #endif
@@ -180,6 +180,14 @@ bool hasAVX512ER(void) {
     return ((abcd[1] & (1 << 27)) != 0);                   // ebx bit 27 indicates AVX512ER
 }
 
+// detect if CPU supports the AVX512VPOPCNTDQ instruction set
+bool hasAVX512VPOPCNTDQ(void) {
+    if (instrset_detect() < 9) return false;               // must have AVX512F
+    int abcd[4];                                           // cpuid results
+    cpuid(abcd, 7);                                        // call cpuid function 7
+    return ((abcd[2] & (1 << 14)) != 0);                   // ecx bit 14 indicates AVX512VPOPCNTDQ
+}
+
 
 #ifdef VCL_NAMESPACE
 }
@@ -310,6 +310,12 @@ static inline double horizontal_add (Vec1d const & a) {
     return a.xmm;
 }
 
+// Select between two operands. Corresponds to this pseudocode:
+// result = s ? a : b;
+static inline Vec1d select(Vec1db const & s, Vec1d const & a, Vec1d const & b) {
+    return s.xmm ? a : b;
+}
+
 // function max: a > b ? a : b
 static inline Vec1d max(Vec1d const & a, Vec1d const & b) {
     return max(a.xmm,b.xmm);